@@ -45,6 +45,7 @@
  *    mpp_buffer_group_limit_get
  *    mpp_buffer_group_put
  *    mpp_buffer_group_limit_config
+ *    mpp_buffer_group_cache_config
  *
  * 3. buffer allocator management
  *    this part is for allocator on different os, it does not have user interface
@@ -120,12 +121,15 @@ typedef enum {
  * ion      : use ion device under Android/Linux, MppBuffer will encapsulte ion file handle
  * ext_dma  : the DMABUF(DMA buffers) come from the application
  * drm      : use the drm device interface for memory management
+ * memfd    : anonymous shared memory from memfd_create for cpu only platform,
+ *            the buffer has a real fd for sharing and import like dma buffer
  */
 typedef enum {
     MPP_BUFFER_TYPE_NORMAL,
     MPP_BUFFER_TYPE_ION,
     MPP_BUFFER_TYPE_EXT_DMA,
     MPP_BUFFER_TYPE_DRM,
+    MPP_BUFFER_TYPE_MEMFD,
     MPP_BUFFER_TYPE_BUTT,
 } MppBufferType;
 
@@ -142,13 +146,20 @@ typedef enum {
  *                  = 0x00080003
  *
  * flags originate from drm_rockchip_gem_mem_type
+ *
+ * HUGEPAGE / POPULATE flags are only used by memfd buffer:
+ * HUGEPAGE : try hugetlb memfd first then fallback to transparent hugepage
+ * POPULATE : prefault the whole buffer on allocation
  */
 
-#define MPP_BUFFER_FLAGS_MASK           0x000f0000      //ROCKCHIP_BO_MASK << 16
+#define MPP_BUFFER_FLAGS_MASK           0x003f0000
+#define MPP_BUFFER_FLAGS_DRM_MASK       0x000f0000      //ROCKCHIP_BO_MASK << 16
 #define MPP_BUFFER_FLAGS_CONTIG         0x00010000      //ROCKCHIP_BO_CONTIG << 16
 #define MPP_BUFFER_FLAGS_CACHABLE       0x00020000      //ROCKCHIP_BO_CACHABLE << 16
 #define MPP_BUFFER_FLAGS_WC             0x00040000      //ROCKCHIP_BO_WC << 16
 #define MPP_BUFFER_FLAGS_SECURE         0x00080000      //ROCKCHIP_BO_SECURE << 16
+#define MPP_BUFFER_FLAGS_HUGEPAGE       0x00100000
+#define MPP_BUFFER_FLAGS_POPULATE       0x00200000
 
 /*
  * MppBufferInfo variable's meaning is different in different MppBufferType
@@ -169,6 +180,12 @@ typedef enum {
  * hnd  - ion handle in user space
  * fd   - ion buffer file handle for map / unmap
  *
+ * MPP_BUFFER_TYPE_MEMFD
+ *
+ * ptr  - virtual address of the shared mapping in user space
+ * fd   - memfd file handle which can be passed to other process or imported
+ *        as MPP_BUFFER_TYPE_EXT_DMA / MPP_BUFFER_TYPE_MEMFD buffer
+ *
  */
 typedef struct MppBufferInfo_t {
     MppBufferType   type;
@@ -309,6 +326,14 @@ MppBufferType mpp_buffer_group_type(MppBufferGroup group);
  */
 MPP_RET mpp_buffer_group_limit_config(MppBufferGroup group, size_t size, RK_S32 count);
 
+/*
+ * unused buffer cache config for internal mode group
+ * min : unused buffer smaller than request are kept while total unused size
+ *       is below min. 0 - release them on each mismatch
+ * max : max total size of unused buffer. 0 - no limit
+ */
+MPP_RET mpp_buffer_group_cache_config(MppBufferGroup group, size_t min, size_t max);
+
 #ifdef __cplusplus
 }
 #endif
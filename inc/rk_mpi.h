@@ -206,10 +206,73 @@ typedef struct MppApi_t {
      */
     MPP_RET (*control)(MppCtx ctx, MpiCmd cmd, MppParam param);
 
+    /*
+     * batch data flow interface
+     * These function pointers take the head of the reserved segment so the
+     * size of MppApi and the offset of the fields before are not changed.
+     * Library without batch interface leaves them as zero.
+     */
+    /**
+     * @brief send multiple video stream packets to decoder, async interface
+     *        Packets are queued in order with one decoder wakeup. It stops at
+     *        the first packet which can not be queued.
+     * @param[in] ctx The context of mpp, created by mpp_create() and initiated
+     *                by mpp_init().
+     * @param[in] packets The input video stream array.
+     * @param[in] count The packet count in the array.
+     * @param[out] done The count of packets sent to decoder.
+     * @return 0 when at least one packet is sent, otherwise the error code of
+     *         decode_put_packet. For details, please refer mpp_err.h.
+     */
+    MPP_RET (*decode_put_packets)(MppCtx ctx, MppPacket *packets, RK_S32 count, RK_S32 *done);
+    /**
+     * @brief get multiple video frames from decoder, async interface
+     *        Wait with output timeout for the first frame then take all ready
+     *        frames up to count with one decoder wakeup.
+     * @param[in] ctx The context of mpp, created by mpp_create() and initiated
+     *                by mpp_init().
+     * @param[out] frames The output picture array.
+     * @param[in] count The max frame count of the array.
+     * @param[out] done The count of frames returned.
+     * @return 0 for success, others for failure. The return value is an
+     *         error code. For details, please refer mpp_err.h.
+     */
+    MPP_RET (*decode_get_frames)(MppCtx ctx, MppFrame *frames, RK_S32 count, RK_S32 *done);
+    /**
+     * @brief send multiple video frames to encoder, async interface
+     *        With MPP_ENC_SET_PIPE_DEPTH larger than 1 each frame takes one
+     *        free input task and the encoder is woken up once. It waits with
+     *        input timeout for the first frame only and stops at the first
+     *        frame without free task. With pipe depth 1 frames are encoded in
+     *        turn as encode_put_frame.
+     * @param[in] ctx The context of mpp, created by mpp_create() and initiated
+     *                by mpp_init().
+     * @param[in] frames The input video data array.
+     * @param[in] count The frame count in the array.
+     * @param[out] done The count of frames sent to encoder.
+     * @return 0 when at least one frame is sent, otherwise the error code of
+     *         encode_put_frame. For details, please refer mpp_err.h.
+     */
+    MPP_RET (*encode_put_frames)(MppCtx ctx, MppFrame *frames, RK_S32 count, RK_S32 *done);
+    /**
+     * @brief get multiple encoded video packets from encoder, async interface
+     *        Wait with output timeout for the first packet then take all ready
+     *        packets up to count.
+     * @param[in] ctx The context of mpp, created by mpp_create() and initiated
+     *                by mpp_init().
+     * @param[out] packets The output compressed data array.
+     * @param[in] count The max packet count of the array.
+     * @param[out] done The count of packets returned.
+     * @return 0 for success, others for failure. The return value is an
+     *         error code. For details, please refer mpp_err.h.
+     */
+    MPP_RET (*encode_get_packets)(MppCtx ctx, MppPacket *packets, RK_S32 count, RK_S32 *done);
+
     /**
      * @brief The reserved segment, may be used in the future
+     *        It is 16 RK_U32 minus the four batch function pointers above.
      */
-    RK_U32 reserv[16];
+    RK_U32 reserv[16 - 4 * sizeof(void *) / sizeof(RK_U32)];
 } MppApi;
 
 
@@ -17,6 +17,8 @@
 #ifndef __RK_MPI_CMD_H__
 #define __RK_MPI_CMD_H__
 
+#include "rk_type.h"
+
 /*
  * Command id bit usage is defined as follows:
  * bit 20 - 23  - module id
@@ -69,6 +71,20 @@ typedef enum {
      */
     MPP_SET_INPUT_TIMEOUT,              /* parameter type RK_S64 */
     MPP_SET_OUTPUT_TIMEOUT,             /* parameter type RK_S64 */
+    /*
+     * worker thread mode, need to setup before init
+     * 0 - one thread for each parser / hal / encoder worker
+     * 1 - run workers as jobs on process-wide shared worker pool
+     */
+    MPP_SET_WORKER_POOL,                /* parameter type RK_U32 */
+    MPP_GET_POOL_STATS,                 /* parameter should be pointer to MppPoolStats */
+    /*
+     * process-wide pipeline trace in Chrome trace JSON format
+     * MPP_SET_TRACE  - ring size in event count, 0 for disable
+     * MPP_DUMP_TRACE - dump file path, NULL for env mpp_trace_file path
+     */
+    MPP_SET_TRACE,                      /* parameter type RK_U32 */
+    MPP_DUMP_TRACE,                     /* parameter type const char * */
     MPP_CMD_END,
 
     MPP_CODEC_CMD_BASE                  = CMD_MODULE_CODEC,
@@ -89,6 +105,16 @@ typedef enum {
     MPP_DEC_SET_DISABLE_ERROR,          /* When set it will disable sw/hw error (H.264 / H.265) */
     MPP_DEC_SET_IMMEDIATE_OUT,
     MPP_DEC_SET_ENABLE_DEINTERLACE,     /* MPP enable deinterlace by default. Vpuapi can disable it */
+    MPP_DEC_SET_ZERO_COPY_INPUT,        /* Send MppBuffer backed input packet to hardware by reference without copy */
+    MPP_DEC_GET_EVENT_FD,               /* Get readiness eventfd for poll / epoll. Enable event driven non-block get_frame */
+    MPP_DEC_GET_EVENT,                  /* Get and clear pending readiness event bits MPP_DEC_EVENT_XXX */
+    MPP_DEC_SET_PERF_STATS,             /* Enable per stage latency statistic with histogram, parameter is RK_U32 */
+    MPP_DEC_GET_PERF_STATS,             /* Get per stage latency statistic, parameter should be pointer to MppPerfStats */
+    MPP_DEC_GET_WAIT_STATS,             /* Get parser wait reason statistic and queue depth, parameter should be pointer to MppDecWaitStats */
+    MPP_DEC_SET_PIPE_CFG,               /* Set pipeline queue depth, parameter should be pointer to MppDecPipeCfg */
+    MPP_DEC_GET_PIPE_CFG,               /* Get pipeline queue depth, parameter should be pointer to MppDecPipeCfg */
+    MPP_DEC_SET_PIPE_PRESET,            /* Set pipeline queue depth preset, parameter should be pointer to MppDecPipePreset */
+    MPP_DEC_SET_PARSER_PIPELINE_MODE,   /* Need to setup before init. Parse next frame while hardware is decoding when fast mode is off */
 
     MPP_DEC_CMD_QUERY                   = CMD_MODULE_CODEC | CMD_CTX_ID_DEC | CMD_DEC_QUERY,
     /* query decoder runtime information for decode stage */
@@ -119,6 +145,20 @@ typedef enum {
     MPP_ENC_SET_QP_RANGE,               /* used for adjusting qp range, the parameter can be 1 or 2 */
     MPP_ENC_SET_ROI_CFG,                /* set MppEncROICfg structure */
     MPP_ENC_SET_CTU_QP,                 /* for H265 Encoder,set CTU's size and QP */
+    MPP_ENC_SET_PERF_STATS,             /* Enable per stage latency statistic with histogram, parameter is RK_U32 */
+    MPP_ENC_GET_PERF_STATS,             /* Get per stage latency statistic, parameter should be pointer to MppPerfStats */
+    /*
+     * Need to setup before init. Max input frame count in flight, parameter is RK_S32
+     * 1 - default, encode_put_frame returns after the frame is encoded
+     * N - encode_put_frame returns after the frame is queued to encoder. The
+     *     frame buffer and its meta data must be kept unchanged until the
+     *     packet of this frame is returned by encode_get_packet.
+     * NOTE: N is the input queue depth. Encoder still encodes one frame at a
+     *       time. Only next task and its output packet are prepared while the
+     *       hardware is encoding current frame. Rate control, header and user
+     *       data of next frame start after current frame is done.
+     */
+    MPP_ENC_SET_PIPE_DEPTH,
 
     /* User define rate control stategy API control */
     MPP_ENC_CFG_RC_API                  = CMD_MODULE_CODEC | CMD_CTX_ID_ENC | CMD_ENC_CFG_RC_API,
@@ -175,6 +215,53 @@ typedef enum {
     MPI_CMD_BUTT,
 } MpiCmd;
 
+/*
+ * process-wide descriptor recycle pool statistic for MPP_GET_POOL_STATS
+ *
+ * hits       - descriptor served by a recycled one
+ * misses     - descriptor served by a new heap allocation
+ * used       - descriptor currently in use
+ * high_water - max descriptor in use at the same time
+ */
+typedef struct MppPoolStat_t {
+    RK_U64  hits;
+    RK_U64  misses;
+    RK_S32  used;
+    RK_S32  high_water;
+} MppPoolStat;
+
+typedef struct MppPoolStats_t {
+    MppPoolStat frame;
+    MppPoolStat packet;
+    MppPoolStat meta;
+} MppPoolStats;
+
+/*
+ * per stage latency statistic for MPP_DEC_GET_PERF_STATS / MPP_ENC_GET_PERF_STATS
+ *
+ * All time values are in microsecond. count / sum are always valid when the
+ * statistic is enabled. min / max / percentile come from a log bucketed
+ * histogram with the relative error below 1 / 16.
+ */
+#define MPP_PERF_STAGE_MAX              16
+
+typedef struct MppPerfStage_t {
+    char    name[16];
+    RK_S64  count;
+    RK_S64  sum;
+    RK_S64  min;
+    RK_S64  max;
+    RK_S64  p50;
+    RK_S64  p90;
+    RK_S64  p99;
+    RK_S64  p999;
+} MppPerfStage;
+
+typedef struct MppPerfStats_t {
+    RK_S32          stage_count;
+    MppPerfStage    stages[MPP_PERF_STAGE_MAX];
+} MppPerfStats;
+
 #include "rk_vdec_cmd.h"
 #include "rk_venc_cmd.h"
 #include "rk_venc_cfg.h"
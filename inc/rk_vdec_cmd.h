@@ -19,6 +19,22 @@
 
 #include "rk_type.h"
 
+/*
+ * decoder readiness event from MPP_DEC_GET_EVENT
+ *
+ * The eventfd from MPP_DEC_GET_EVENT_FD becomes readable when any event bit
+ * is raised. User should call MPP_DEC_GET_EVENT to read and clear the bits
+ * then put packets until MPP_ERR_BUFFER_FULL and get frames until NULL.
+ *
+ * MPP_DEC_EVENT_FRAME_READY    - new frame is available for get_frame
+ * MPP_DEC_EVENT_INPUT_READY    - packet queue has space for put_packet
+ * MPP_DEC_EVENT_INFO_CHANGE    - info change frame is output and decoder is
+ *                                waiting for MPP_DEC_SET_INFO_CHANGE_READY
+ */
+#define MPP_DEC_EVENT_FRAME_READY   (0x00000001)
+#define MPP_DEC_EVENT_INPUT_READY   (0x00000002)
+#define MPP_DEC_EVENT_INFO_CHANGE   (0x00000004)
+
 /*
  * decoder query interface is only for debug usage
  */
@@ -29,6 +45,7 @@
 #define MPP_DEC_QUERY_DEC_IN_PKT    (0x00000010)
 #define MPP_DEC_QUERY_DEC_WORK      (0x00000020)
 #define MPP_DEC_QUERY_DEC_OUT_FRM   (0x00000040)
+#define MPP_DEC_QUERY_STRM_COPY     (0x00000080)
 
 #define MPP_DEC_QUERY_ALL           (MPP_DEC_QUERY_STATUS       | \
                                      MPP_DEC_QUERY_WAIT         | \
@@ -36,7 +53,8 @@
                                      MPP_DEC_QUERY_BPS          | \
                                      MPP_DEC_QUERY_DEC_IN_PKT   | \
                                      MPP_DEC_QUERY_DEC_WORK     | \
-                                     MPP_DEC_QUERY_DEC_OUT_FRM)
+                                     MPP_DEC_QUERY_DEC_OUT_FRM  | \
+                                     MPP_DEC_QUERY_STRM_COPY)
 
 typedef struct MppDecQueryCfg_t {
     /*
@@ -49,6 +67,7 @@ typedef struct MppDecQueryCfg_t {
      * bit 4 - for querying decoder input packet count
      * bit 5 - for querying decoder start hardware times
      * bit 6 - for querying decoder output frame count
+     * bit 7 - for querying decoder stream bytes copied / referenced
      */
     RK_U32      query_flag;
 
@@ -60,6 +79,94 @@ typedef struct MppDecQueryCfg_t {
     RK_U32      dec_in_pkt_cnt;
     RK_U32      dec_hw_run_cnt;
     RK_U32      dec_out_frm_cnt;
+
+    /*
+     * stream bytes on input stage (put_packet) and hardware stage (packet slot)
+     * copy - bytes duplicated by memcpy
+     * ref  - bytes passed by MppBuffer reference without copy
+     */
+    RK_U64      in_copy_size;
+    RK_U64      in_ref_size;
+    RK_U64      hal_copy_size;
+    RK_U64      hal_ref_size;
 } MppDecQueryCfg;
 
+/*
+ * decoder parser wait statistic from MPP_DEC_GET_WAIT_STATS
+ *
+ * Each time the parser blocks every reason in the wait condition counts once
+ * and the whole blocked time in microsecond is added to each of them.
+ */
+typedef enum MppDecWaitReason_e {
+    MPP_DEC_WAIT_PKT_IN,                /* no input packet */
+    MPP_DEC_WAIT_TASK_HND,              /* no idle hal task handle */
+    MPP_DEC_WAIT_PKT_SLOT,              /* no packet slot or packet buffer */
+    MPP_DEC_WAIT_FRM_SLOT,              /* no unused frame slot */
+    MPP_DEC_WAIT_DIS_QUE_FULL,          /* output frame queue is full */
+    MPP_DEC_WAIT_BUF_UNUSED,            /* no unused buffer in buffer group */
+    MPP_DEC_WAIT_INFO_CHANGE,           /* info change is not ready */
+    MPP_DEC_WAIT_PREV_TASK,             /* previous task is not done */
+    MPP_DEC_WAIT_OTHERS,                /* external group / buffer match / all done */
+    MPP_DEC_WAIT_BUTT,
+} MppDecWaitReason;
+
+typedef struct MppDecWaitStat_t {
+    RK_U64      count;
+    RK_U64      time;
+} MppDecWaitStat;
+
+typedef struct MppDecWaitStats_t {
+    MppDecWaitStat  reasons[MPP_DEC_WAIT_BUTT];
+    RK_U64          wait_count;
+    RK_U64          work_count;
+
+    /* current queue depth */
+    RK_S32          packet_queue;       /* input packets not taken by parser */
+    RK_S32          frame_queue;        /* output frames not taken by user */
+    RK_S32          task_processing;    /* hal tasks sent to hardware */
+    RK_S32          task_idle;          /* hal tasks free for parser */
+} MppDecWaitStats;
+
+/*
+ * decoder pipeline depth from MPP_DEC_SET_PIPE_CFG / MPP_DEC_GET_PIPE_CFG
+ *
+ * packet_queue - input packets put_packet accepts before MPP_ERR_BUFFER_FULL
+ * frame_queue  - output frames waiting for user before parser pauses
+ * task_queue   - MppTask count of advanced mode input / output task queue
+ * packet_bufs  - internal stream buffer count for hardware input
+ *
+ * packet_queue and frame_queue can be changed at any time. After init they
+ * must be less than the ring size created on init, which is twice the depth
+ * on init and at least 16 packets / 64 frames. task_queue and packet_bufs
+ * need to setup before init. Zero keeps the current value.
+ */
+typedef struct MppDecPipeCfg_t {
+    RK_S32      packet_queue;
+    RK_S32      frame_queue;
+    RK_S32      task_queue;
+    RK_S32      packet_bufs;
+} MppDecPipeCfg;
+
+/*
+ * decoder pipeline preset for MPP_DEC_SET_PIPE_PRESET, set before init
+ *
+ * DEFAULT      - packet 4 / frame 4 / task 4 / buffer 3
+ * LOW_LATENCY  - packet 1 / frame 1 / task 1 / buffer 2
+ *                Each frame goes through the pipeline nearly alone so the
+ *                decode latency is close to one hardware run. Parser and
+ *                hardware overlap less and throughput drops on high bitrate
+ *                stream. Use with MPP_DEC_SET_IMMEDIATE_OUT for stream
+ *                without reorder like video conference.
+ * THROUGHPUT   - packet 16 / frame 16 / task 8 / buffer 6
+ *                Parser runs further ahead of hardware and user so that the
+ *                burst of large frames is absorbed. Latency and memory grow
+ *                with the queue depth.
+ */
+typedef enum MppDecPipePreset_e {
+    MPP_DEC_PIPE_DEFAULT,
+    MPP_DEC_PIPE_LOW_LATENCY,
+    MPP_DEC_PIPE_THROUGHPUT,
+    MPP_DEC_PIPE_BUTT,
+} MppDecPipePreset;
+
 #endif /*__RK_VDEC_CMD_H__*/
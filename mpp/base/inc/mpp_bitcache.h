@@ -0,0 +1,289 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MPP_BITCACHE_H__
+#define __MPP_BITCACHE_H__
+
+#include "rk_type.h"
+#include "mpp_err.h"
+
+/*
+ * 64 bit cached bit reader
+ * Same read semantic as BitReadCtx_t in mpp_bitread.h. The cache is refilled
+ * by unaligned word load and emulation prevention bytes are only checked
+ * byte by byte when the refill window has zero byte.
+ *
+ * The read macros have the same names as mpp_bitread.h. So a parser switches
+ * by including mpp_bitcache.h and using BitCacheCtx_t. File using both
+ * readers should define MPP_BITCACHE_NO_MACRO and call the functions.
+ */
+#ifndef MPP_BITCACHE_NO_MACRO
+#ifdef __MPP_BITREAD_H__
+#error "mpp_bitread.h and mpp_bitcache.h define the same read macros"
+#endif
+
+#define   __BITREAD_ERR   __bitread_error
+
+#define READ_ONEBIT(bitctx, out)\
+    do {\
+        RK_S32 _out; \
+        bitctx->ret = mpp_bitcache_read_bits(bitctx, 1, &_out); \
+        if (!bitctx->ret) { *out = _out; }\
+        else { goto __BITREAD_ERR; }\
+    } while (0)
+
+#define READ_BITS(bitctx, num_bits, out)\
+    do {\
+        RK_S32 _out; \
+        bitctx->ret = mpp_bitcache_read_bits(bitctx, num_bits, &_out); \
+        if (!bitctx->ret) { *out = _out; }\
+        else { goto __BITREAD_ERR; }\
+    } while (0)
+
+#define READ_BITS_LONG(bitctx, num_bits, out)\
+    do {\
+        RK_U32 _out; \
+        bitctx->ret = mpp_bitcache_read_longbits(bitctx, num_bits, &_out); \
+        if (!bitctx->ret) { *out = _out; }\
+        else { goto __BITREAD_ERR; }\
+    } while (0)
+
+#define SHOW_BITS(bitctx, num_bits, out)\
+    do {\
+        RK_S32 _out; \
+        bitctx->ret = mpp_bitcache_show_bits(bitctx, num_bits, &_out); \
+        if (!bitctx->ret) { *out = _out; }\
+        else { goto __BITREAD_ERR; }\
+    } while (0)
+
+#define SHOW_BITS_LONG(bitctx, num_bits, out)\
+    do {\
+        RK_U32 _out; \
+        bitctx->ret = mpp_bitcache_show_longbits(bitctx, num_bits, &_out); \
+        if (!bitctx->ret) { *out = _out; }\
+        else { goto __BITREAD_ERR; }\
+    } while (0)
+
+#define SKIP_BITS(bitctx, num_bits)\
+    do {\
+        bitctx->ret = mpp_bitcache_skip_bits(bitctx, num_bits); \
+        if (bitctx->ret) { goto __BITREAD_ERR; }\
+    } while (0)
+
+#define SKIP_BITS_LONG(bitctx, num_bits)\
+    do {\
+        bitctx->ret = mpp_bitcache_skip_bits(bitctx, num_bits); \
+        if (bitctx->ret) { goto __BITREAD_ERR; }\
+    } while (0)
+
+#define READ_UE(bitctx, out)\
+    do {\
+        RK_U32 _out; \
+        bitctx->ret = mpp_bitcache_read_ue(bitctx, &_out); \
+        if (!bitctx->ret) { *out = _out; }\
+        else { goto __BITREAD_ERR; }\
+    } while (0)
+
+#define READ_SE(bitctx, out)\
+    do {\
+        RK_S32 _out; \
+        bitctx->ret = mpp_bitcache_read_se(bitctx, &_out); \
+        if (!bitctx->ret) { *out = _out; }\
+        else { goto __BITREAD_ERR; }\
+    } while (0)
+#endif /* MPP_BITCACHE_NO_MACRO */
+
+typedef struct BitCacheCtx_t {
+    // next byte to load into cache and the end of stream
+    const RK_U8 *data;
+    const RK_U8 *end;
+    // unread bits in MSB order, bits below cache_bits are zero
+    RK_U64 cache;
+    RK_S32 cache_bits;
+    // zero bytes before data for emulation prevention detection (0 - 2)
+    RK_S32 zero_bytes;
+    // Number of emulation presentation bytes (0x000003) we met.
+    RK_S64 emulation_prevention_bytes_;
+    // count PPS SPS SEI read bits
+    RK_S32 used_bits;
+    RK_U8  *buf;
+    RK_S32 buf_len;
+    // ctx
+    MPP_RET   ret;
+    RK_S32    need_prevention_detection;
+} BitCacheCtx_t;
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+//!< set bit cache context
+void    mpp_bitcache_init(BitCacheCtx_t *bitctx, RK_U8 *data, RK_S32 size);
+
+//!< set whether detect 0x03 (used in h264 and h265)
+void    mpp_bitcache_set_pre_detection(BitCacheCtx_t *bitctx);
+
+//!< fill cache to more than 56 bits or to the end of stream
+void    mpp_bitcache_refill(BitCacheCtx_t *bitctx);
+
+//!< read ue with more than 32 bits code or across the end of cache
+MPP_RET mpp_bitcache_read_ue_slow(BitCacheCtx_t *bitctx, RK_U32 *val);
+
+//!< check whether has more rbsp data(used in h264)
+RK_U32  mpp_bitcache_has_more_rbsp_data(BitCacheCtx_t *bitctx);
+
+//!< align bits and get current pointer
+RK_U8  *mpp_bitcache_align_get_bits(BitCacheCtx_t *bitctx);
+
+#ifdef  __cplusplus
+}
+#endif
+
+//!< bits left in cache and stream
+static inline RK_S32 mpp_bitcache_bits_left(BitCacheCtx_t *bitctx)
+{
+    return bitctx->cache_bits + (RK_S32)(bitctx->end - bitctx->data) * 8;
+}
+
+static inline MPP_RET mpp_bitcache_peek(BitCacheCtx_t *bitctx, RK_S32 num_bits,
+                                        RK_U32 *out)
+{
+    if (bitctx->cache_bits < num_bits) {
+        mpp_bitcache_refill(bitctx);
+        if (bitctx->cache_bits < num_bits)
+            return MPP_ERR_READ_BIT;
+    }
+
+    /* two step shift for zero num_bits */
+    *out = (RK_U32)((bitctx->cache >> 1) >> (63 - num_bits));
+
+    return MPP_OK;
+}
+
+static inline void mpp_bitcache_flush(BitCacheCtx_t *bitctx, RK_S32 num_bits)
+{
+    bitctx->cache <<= num_bits;
+    bitctx->cache_bits -= num_bits;
+    bitctx->used_bits += num_bits;
+}
+
+//!< Read bits (0-31)
+static inline MPP_RET mpp_bitcache_read_bits(BitCacheCtx_t *bitctx,
+                                             RK_S32 num_bits, RK_S32 *out)
+{
+    RK_U32 val;
+
+    if ((RK_U32)num_bits > 31 || mpp_bitcache_peek(bitctx, num_bits, &val)) {
+        *out = 0;
+        return MPP_ERR_READ_BIT;
+    }
+
+    mpp_bitcache_flush(bitctx, num_bits);
+    *out = (RK_S32)val;
+
+    return MPP_OK;
+}
+
+//!< Read bits (0-32)
+static inline MPP_RET mpp_bitcache_read_longbits(BitCacheCtx_t *bitctx,
+                                                 RK_S32 num_bits, RK_U32 *out)
+{
+    if ((RK_U32)num_bits > 32 || mpp_bitcache_peek(bitctx, num_bits, out))
+        return MPP_ERR_READ_BIT;
+
+    mpp_bitcache_flush(bitctx, num_bits);
+
+    return MPP_OK;
+}
+
+//!< Show bits (0-32)
+static inline MPP_RET mpp_bitcache_show_bits(BitCacheCtx_t *bitctx,
+                                             RK_S32 num_bits, RK_S32 *out)
+{
+    RK_U32 val;
+
+    if ((RK_U32)num_bits > 32 || mpp_bitcache_peek(bitctx, num_bits, &val))
+        return MPP_ERR_READ_BIT;
+
+    *out = (RK_S32)val;
+
+    return MPP_OK;
+}
+
+//!< Show bits (0-32)
+static inline MPP_RET mpp_bitcache_show_longbits(BitCacheCtx_t *bitctx,
+                                                 RK_S32 num_bits, RK_U32 *out)
+{
+    if ((RK_U32)num_bits > 32)
+        return MPP_ERR_READ_BIT;
+
+    return mpp_bitcache_peek(bitctx, num_bits, out);
+}
+
+//!< skip bits (any length)
+static inline MPP_RET mpp_bitcache_skip_bits(BitCacheCtx_t *bitctx,
+                                             RK_S32 num_bits)
+{
+    while (num_bits > bitctx->cache_bits) {
+        num_bits -= bitctx->cache_bits;
+        bitctx->used_bits += bitctx->cache_bits;
+        bitctx->cache = 0;
+        bitctx->cache_bits = 0;
+        mpp_bitcache_refill(bitctx);
+        if (!bitctx->cache_bits)
+            return MPP_ERR_READ_BIT;
+    }
+
+    if (num_bits > 0)
+        mpp_bitcache_flush(bitctx, num_bits);
+
+    return MPP_OK;
+}
+
+//!< read ue(1-32), leading zeros counted by clz
+static inline MPP_RET mpp_bitcache_read_ue(BitCacheCtx_t *bitctx, RK_U32 *val)
+{
+    if (bitctx->cache_bits < 32)
+        mpp_bitcache_refill(bitctx);
+
+    if (bitctx->cache) {
+        RK_S32 zeros = __builtin_clzll(bitctx->cache);
+        RK_S32 len = zeros * 2 + 1;
+
+        if (zeros < 32 && len <= bitctx->cache_bits) {
+            *val = (RK_U32)((bitctx->cache >> (64 - len)) - 1);
+            mpp_bitcache_flush(bitctx, len);
+            return MPP_OK;
+        }
+    }
+
+    return mpp_bitcache_read_ue_slow(bitctx, val);
+}
+
+//!< read se(1-31)
+static inline MPP_RET mpp_bitcache_read_se(BitCacheCtx_t *bitctx, RK_S32 *val)
+{
+    RK_U32 ue;
+
+    if (mpp_bitcache_read_ue(bitctx, &ue))
+        return MPP_ERR_READ_BIT;
+
+    *val = (ue & 1) ? (RK_S32)((ue >> 1) + 1) : -(RK_S32)(ue >> 1);
+
+    return MPP_OK;
+}
+
+#endif /* __MPP_BITCACHE_H__ */
@@ -24,6 +24,10 @@
 #include "mpp_common.h"
 #include "mpp_err.h"
 
+#if defined(__MPP_BITCACHE_H__) && !defined(MPP_BITCACHE_NO_MACRO)
+#error "mpp_bitread.h and mpp_bitcache.h define the same read macros"
+#endif
+
 #define   __BITREAD_ERR   __bitread_error
 
 #define READ_ONEBIT(bitctx, out)\
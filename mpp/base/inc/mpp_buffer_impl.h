@@ -36,14 +36,21 @@
 #define MPP_BUF_FUNCTION_LEAVE_OK()     mpp_buf_dbg_f(MPP_BUF_DBG_FUNCTION, "success\n")
 #define MPP_BUF_FUNCTION_LEAVE_FAIL()   mpp_buf_dbg_f(MPP_BUF_DBG_FUNCTION, "failed\n")
 
+// unused buffer size class bin count, bin n holds buffer size in [2^n, 2^(n+1))
+#define MPP_BUF_BIN_NUM                 32
+
 typedef struct MppBufferImpl_t          MppBufferImpl;
 typedef struct MppBufferGroupImpl_t     MppBufferGroupImpl;
 typedef void (*MppBufCallback)(void *, void *);
 
-// use index instead of pointer to avoid invalid pointer
+/*
+ * Buffer is always released before its group is destroyed so the group
+ * pointer is valid during the whole buffer life time. group_id is kept for log.
+ */
 struct MppBufferImpl_t {
     char                tag[MPP_TAG_SIZE];
     const char          *caller;
+    MppBufferGroupImpl  *group;
     RK_U32              group_id;
     RK_S32              buffer_id;
     MppBufferMode       mode;
@@ -60,8 +67,15 @@ struct MppBufferImpl_t {
     // used flag is for used/unused list detection
     RK_U32              used;
     RK_U32              internal;
-    RK_S32              ref_count;
+    /*
+     * ref_count is atomic. Increase from non-zero and decrease to non-zero
+     * are done without lock. Zero crossing is done with group buf_lock for
+     * moving buffer between list_used and list_unused.
+     */
+    volatile RK_S32     ref_count;
     struct list_head    list_status;
+    // link to list_bins in MppBufferGroupImpl when unused
+    struct list_head    list_bin;
 };
 
 struct MppBufferGroupImpl_t {
@@ -81,6 +95,18 @@ struct MppBufferGroupImpl_t {
     RK_S32              count_used;
     RK_S32              count_unused;
 
+    /*
+     * unused buffer cache control in internal mode
+     * cache_min   - unused buffer smaller than request are kept until the
+     *               total unused size is below cache_min
+     * cache_max   - returned buffer is released when the total unused size
+     *               will go beyond cache_max, 0 for no limit
+     * unused_size - total size of the unused buffer
+     */
+    size_t              cache_min;
+    size_t              cache_max;
+    size_t              unused_size;
+
     MppAllocator        allocator;
     MppAllocatorApi     *alloc_api;
 
@@ -92,6 +118,11 @@ struct MppBufferGroupImpl_t {
     RK_U32              clear_on_exit;
     // is_orphan: 0 - normal group 1 - orphan group
     RK_U32              is_orphan;
+    // is_misc: 0 - normal group 1 - misc group
+    RK_U32              is_misc;
+
+    // lock for buffer list / counter / log in this group
+    Mutex               *buf_lock;
 
     // buffer log function
     RK_U32              log_runtime_en;
@@ -105,6 +136,8 @@ struct MppBufferGroupImpl_t {
     // link to list_status in MppBufferImpl
     struct list_head    list_used;
     struct list_head    list_unused;
+    // link to list_bin in MppBufferImpl indexed by size class
+    struct list_head    list_bins[MPP_BUF_BIN_NUM];
 };
 
 #ifdef __cplusplus
@@ -122,9 +155,9 @@ extern RK_U32 mpp_buffer_debug;
  *                            It required map to access. This is an optimization
  *                            for reducing virtual memory usage.
  *
- *  mpp_buffer_get_unused   : get unused buffer with size. it will first search
- *                            the unused list. if failed it will create on from
- *                            group allocator.
+ *  mpp_buffer_get_unused   : get unused buffer with size. it will search the
+ *                            size class bins for the best fit buffer. if failed
+ *                            it will create on from group allocator.
  *
  *  mpp_buffer_ref_inc      : increase buffer's reference counter. if it is unused
  *                            then it will be moved to used list.
@@ -151,6 +184,7 @@ MPP_RET mpp_buffer_group_deinit(MppBufferGroupImpl *p);
 MPP_RET mpp_buffer_group_reset(MppBufferGroupImpl *p);
 MPP_RET mpp_buffer_group_set_callback(MppBufferGroupImpl *p,
                                       MppBufCallback callback, void *arg);
+MPP_RET mpp_buffer_group_set_cache(MppBufferGroupImpl *p, size_t min, size_t max);
 // mpp_buffer_group helper function
 void mpp_buffer_group_dump(MppBufferGroupImpl *p);
 void mpp_buffer_service_dump();
@@ -18,6 +18,7 @@
 #define __MPP_FRAME_IMPL_H__
 
 #include "mpp_frame.h"
+#include "mpp_mem_pool.h"
 
 typedef struct MppFrameImpl_t MppFrameImpl;
 
@@ -137,6 +138,9 @@ RK_U32  mpp_frame_get_fbc_stride(MppFrame frame);
 
 MPP_RET check_is_mpp_frame(void *pointer);
 
+// descriptor pool statistic for all MppFrame
+MPP_RET mpp_frame_pool_info(MppMemPoolInfo *info);
+
 #ifdef __cplusplus
 }
 #endif
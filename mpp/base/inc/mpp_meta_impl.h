@@ -21,22 +21,44 @@
 
 #include "mpp_list.h"
 #include "mpp_meta.h"
+#include "mpp_mem_pool.h"
 
-typedef struct MppMetaDef_t {
-    MppMetaKey          key;
-    MppMetaType         type;
-} MppMetaDef;
+/*
+ * All meta key and its value type
+ * The key is mapped to a fixed index for direct array access in MppMetaImpl
+ */
+#define META_ENTRY_TABLE(ENTRY) \
+    /* data flow type */ \
+    ENTRY(KEY_INPUT_FRAME,          TYPE_FRAME) \
+    ENTRY(KEY_OUTPUT_FRAME,         TYPE_FRAME) \
+    ENTRY(KEY_INPUT_PACKET,         TYPE_PACKET) \
+    ENTRY(KEY_OUTPUT_PACKET,        TYPE_PACKET) \
+    /* buffer for motion detection */ \
+    ENTRY(KEY_MOTION_INFO,          TYPE_BUFFER) \
+    /* buffer storing the HDR information for current frame*/ \
+    ENTRY(KEY_HDR_INFO,             TYPE_BUFFER) \
+    ENTRY(KEY_OUTPUT_INTRA,         TYPE_S32) \
+    ENTRY(KEY_INPUT_BLOCK,          TYPE_S32) \
+    ENTRY(KEY_OUTPUT_BLOCK,         TYPE_S32) \
+    /* extra information for tsvc */ \
+    ENTRY(KEY_TEMPORAL_ID,          TYPE_S32) \
+    ENTRY(KEY_LONG_REF_IDX,         TYPE_S32) \
+    ENTRY(KEY_ROI_DATA,             TYPE_PTR) \
+    ENTRY(KEY_OSD_DATA,             TYPE_PTR) \
+    ENTRY(KEY_USER_DATA,            TYPE_PTR) \
+    ENTRY(KEY_USER_DATAS,           TYPE_PTR) \
+    ENTRY(KEY_MV_LIST,              TYPE_PTR) \
+    ENTRY(KEY_ENC_MARK_LTR,         TYPE_S32) \
+    ENTRY(KEY_ENC_USE_LTR,          TYPE_S32) \
+    ENTRY(KEY_ENC_FRAME_QP,         TYPE_S32) \
+    ENTRY(KEY_ENC_BASE_LAYER_PID,   TYPE_S32)
 
-typedef struct MppMetaImpl_t {
-    char                tag[MPP_TAG_SIZE];
-    const char          *caller;
-    RK_S32              meta_id;
-    RK_S32              ref_count;
+#define EXPAND_AS_META_INDEX(key, type)     META_IDX_##key,
 
-    struct list_head    list_meta;
-    struct list_head    list_node;
-    RK_S32              node_count;
-} MppMetaImpl;
+typedef enum MppMetaIndex_e {
+    META_ENTRY_TABLE(EXPAND_AS_META_INDEX)
+    META_IDX_BUTT,
+} MppMetaIndex;
 
 typedef union MppMetaVal_u {
     RK_S32              val_s32;
@@ -47,15 +69,20 @@ typedef union MppMetaVal_u {
     MppBuffer           buffer;
 } MppMetaVal;
 
-typedef struct MppMetaNode_t {
-    struct list_head    list_meta;
-    struct list_head    list_node;
-    MppMetaImpl         *meta;
-    RK_S32              node_id;
+/*
+ * value is stored inline at the key index
+ * bit in node_mask is set when the value is valid and cleared on get
+ */
+typedef struct MppMetaImpl_t {
+    char                tag[MPP_TAG_SIZE];
+    const char          *caller;
+    RK_S32              meta_id;
+    volatile RK_S32     ref_count;
 
-    RK_S32              type_id;
-    MppMetaVal          val;
-} MppMetaNode;
+    struct list_head    list_meta;
+    volatile RK_U32     node_mask;
+    MppMetaVal          vals[META_IDX_BUTT];
+} MppMetaImpl;
 
 #ifdef __cplusplus
 extern "C" {
@@ -63,7 +90,9 @@ extern "C" {
 
 RK_S32 mpp_meta_size(MppMeta meta);
 MPP_RET mpp_meta_inc_ref(MppMeta meta);
-MppMetaNode *mpp_meta_next_node(MppMeta meta);
+void mpp_meta_dump(MppMeta meta);
+// descriptor pool statistic for all MppMeta
+MPP_RET mpp_meta_pool_info(MppMemPoolInfo *info);
 
 #ifdef __cplusplus
 }
@@ -18,6 +18,7 @@
 #define __MPP_PACKET_IMPL_H__
 
 #include "mpp_meta.h"
+#include "mpp_mem_pool.h"
 
 #define MPP_PACKET_FLAG_EOS             (0x00000001)
 #define MPP_PACKET_FLAG_EXTRA_DATA      (0x00000002)
@@ -63,6 +64,9 @@ MPP_RET mpp_packet_append(MppPacket dst, MppPacket src);
 /* pointer check function */
 MPP_RET check_is_mpp_packet(void *ptr);
 
+// descriptor pool statistic for all MppPacket
+MPP_RET mpp_packet_pool_info(MppMemPoolInfo *info);
+
 #ifdef __cplusplus
 }
 #endif
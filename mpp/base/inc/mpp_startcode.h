@@ -0,0 +1,45 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MPP_STARTCODE_H__
+#define __MPP_STARTCODE_H__
+
+#include "rk_type.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Search the first 00 00 01 start code prefix in buf
+ * Return the offset of the first zero byte of the start code or -1 when no
+ * complete start code is found. SSE2 / NEON is used when available then
+ * word-at-a-time search as fallback.
+ */
+RK_S32 mpp_find_startcode(const RK_U8 *buf, RK_S32 size);
+
+/*
+ * Continue start code search with the last bytes before buf
+ * prev is the previous bytes shifted in one by one (last byte in bit 0-7).
+ * Return the offset of the 0x01 byte of the start code or -1 when not found.
+ */
+RK_S32 mpp_find_startcode_end(const RK_U8 *buf, RK_S32 size, RK_U32 prev);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /*__MPP_STARTCODE_H__*/
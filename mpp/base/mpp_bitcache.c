@@ -0,0 +1,178 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_bitcache"
+
+#include <string.h>
+
+#include "mpp_common.h"
+#include "mpp_bitcache.h"
+
+#define HAS_ZERO_BYTE(x)    (((x) - 0x0101010101010101ULL) & ~(x) & 0x8080808080808080ULL)
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define BITCACHE_BE64(x)    (x)
+#else
+#define BITCACHE_BE64(x)    __builtin_bswap64(x)
+#endif
+
+/* 0x03 after two zero bytes is emulation prevention byte and skipped */
+static RK_S32 is_emulation_byte(BitCacheCtx_t *bitctx, const RK_U8 *p)
+{
+    return bitctx->need_prevention_detection && p >= bitctx->buf + 2 &&
+           p[0] == 0x03 && !p[-1] && !p[-2];
+}
+
+void mpp_bitcache_refill(BitCacheCtx_t *bitctx)
+{
+    const RK_U8 *p = bitctx->data;
+    RK_U64 cache = bitctx->cache;
+    RK_S32 bits = bitctx->cache_bits;
+
+    if (bits > 56)
+        return;
+
+    /*
+     * word load when there is no 0x03 byte in the window then no emulation
+     * prevention byte can be in it. Only zero bytes on its tail are kept for
+     * the next refill.
+     */
+    if (p + 8 <= bitctx->end) {
+        RK_U64 word;
+
+        memcpy(&word, p, sizeof(word));
+        if (!bitctx->need_prevention_detection ||
+            !HAS_ZERO_BYTE(word ^ 0x0303030303030303ULL)) {
+            RK_S32 bytes = (64 - bits) >> 3;
+            RK_U64 tail;
+
+            word = BITCACHE_BE64(word);
+            word &= ~0ULL << (64 - bytes * 8);
+            tail = word >> (64 - bytes * 8);
+            bitctx->cache = cache | (word >> bits);
+            bitctx->cache_bits = bits + bytes * 8;
+            bitctx->data = p + bytes;
+            bitctx->zero_bytes = (tail & 0xff) ? 0 : (tail & 0xff00) ? 1 : 2;
+            return;
+        }
+    }
+
+    while (bits <= 56 && p < bitctx->end) {
+        RK_U8 byte = *p++;
+
+        if (bitctx->need_prevention_detection) {
+            if (byte == 0x03 && bitctx->zero_bytes >= 2) {
+                bitctx->emulation_prevention_bytes_++;
+                bitctx->zero_bytes = 0;
+                continue;
+            }
+            bitctx->zero_bytes = byte ? 0 : MPP_MIN(bitctx->zero_bytes + 1, 2);
+        }
+
+        cache |= (RK_U64)byte << (56 - bits);
+        bits += 8;
+    }
+
+    bitctx->cache = cache;
+    bitctx->cache_bits = bits;
+    bitctx->data = p;
+}
+
+MPP_RET mpp_bitcache_read_ue_slow(BitCacheCtx_t *bitctx, RK_U32 *val)
+{
+    RK_S32 zeros = 0;
+    RK_S32 rest = 0;
+
+    // Count the number of contiguous zero bits.
+    while (!bitctx->cache) {
+        zeros += bitctx->cache_bits;
+        bitctx->used_bits += bitctx->cache_bits;
+        bitctx->cache_bits = 0;
+        if (zeros > 31)
+            return MPP_ERR_READ_BIT;
+
+        mpp_bitcache_refill(bitctx);
+        if (!bitctx->cache_bits)
+            return MPP_ERR_READ_BIT;
+    }
+
+    rest = __builtin_clzll(bitctx->cache);
+    zeros += rest;
+    mpp_bitcache_flush(bitctx, rest + 1);
+    if (zeros > 31)
+        return MPP_ERR_READ_BIT;
+
+    // Calculate exp-Golomb code value of size zeros.
+    if (mpp_bitcache_read_bits(bitctx, zeros, &rest))
+        return MPP_ERR_READ_BIT;
+
+    *val = (RK_U32)((1ULL << zeros) - 1 + rest);
+
+    return MPP_OK;
+}
+
+RK_U32 mpp_bitcache_has_more_rbsp_data(BitCacheCtx_t *bitctx)
+{
+    // remove tail byte which equal zero
+    while (bitctx->end > bitctx->data && !bitctx->end[-1])
+        bitctx->end--;
+
+    // Load the cache first then the stop byte may be the only byte left.
+    if (!bitctx->cache_bits)
+        mpp_bitcache_refill(bitctx);
+
+    // Nonzero byte after the cache is more data.
+    if (bitctx->end > bitctx->data)
+        return 1;
+
+    // We have more RBSP data if the last non-zero bit we find is not the
+    // first available bit.
+    return bitctx->cache && __builtin_ctzll(bitctx->cache) < 63;
+}
+
+void mpp_bitcache_init(BitCacheCtx_t *bitctx, RK_U8 *data, RK_S32 size)
+{
+    memset(bitctx, 0, sizeof(BitCacheCtx_t));
+    bitctx->data = data;
+    bitctx->end = data + size;
+    bitctx->buf = data;
+    bitctx->buf_len = size;
+}
+
+void mpp_bitcache_set_pre_detection(BitCacheCtx_t *bitctx)
+{
+    bitctx->need_prevention_detection = 1;
+}
+
+RK_U8 *mpp_bitcache_align_get_bits(BitCacheCtx_t *bitctx)
+{
+    const RK_U8 *p = bitctx->data;
+    RK_S32 bytes;
+
+    mpp_bitcache_flush(bitctx, bitctx->cache_bits & 7);
+
+    /* walk back over the cached bytes to the byte after the last read one */
+    bytes = bitctx->cache_bits >> 3;
+    while (bytes) {
+        p--;
+        if (!is_emulation_byte(bitctx, p))
+            bytes--;
+    }
+    if (p > bitctx->buf && is_emulation_byte(bitctx, p - 1))
+        p--;
+
+    return (RK_U8 *)p;
+}
@@ -23,6 +23,7 @@
 #include "mpp_env.h"
 #include "mpp_list.h"
 #include "mpp_common.h"
+#include "mpp_atomic.h"
 
 #include "mpp_frame_impl.h"
 #include "mpp_buf_slot.h"
@@ -180,6 +181,7 @@ typedef struct MppBufSlotLog_t {
 struct MppBufSlotEntry_t {
     MppBufSlotsImpl     *slots;
     struct list_head    list;
+    // status word is updated by atomic compare and swap
     SlotStatus          status;
     RK_S32              index;
 
@@ -209,7 +211,7 @@ struct MppBufSlotsImpl_t {
     AlignFunc           hal_len_align;          // default NULL
     size_t              buf_size;
     RK_S32              buf_count;
-    RK_S32              used_count;
+    volatile RK_S32     used_count;
     // buffer size equal to (h_stride * v_stride) * numerator / denominator
     // internal parameter
     RK_U32              numerator;
@@ -230,6 +232,13 @@ struct MppBufSlotsImpl_t {
     mpp_list            *logs;
 
     MppBufSlotEntry     *slots;
+    /*
+     * free slot bitmap, bit set for slot not on_used
+     * NOTE: slots and free_map are only resized on setup / info change ready
+     *       when there is no slot flag operation in flight
+     */
+    volatile RK_U32     *free_map;
+    RK_S32              map_words;
 };
 
 static RK_U32 default_align_16(RK_U32 val)
@@ -237,6 +246,70 @@ static RK_U32 default_align_16(RK_U32 val)
     return MPP_ALIGN(val, 16);
 }
 
+static SlotStatus slot_status_get(MppBufSlotEntry *slot)
+{
+    SlotStatus status;
+
+    status.val = MPP_LOAD_ACQUIRE(&slot->status.val);
+    return status;
+}
+
+static RK_U32 slot_status_is_idle(SlotStatus status)
+{
+    return status.on_used &&
+           !status.not_ready &&
+           !status.codec_use &&
+           !status.hal_output &&
+           !status.hal_use &&
+           !status.queue_use;
+}
+
+static void slot_map_resize(MppBufSlotsImpl *impl, RK_S32 count)
+{
+    RK_S32 words = (count + 31) >> 5;
+
+    if (words <= impl->map_words)
+        return;
+
+    impl->free_map = mpp_realloc((RK_U32 *)impl->free_map, RK_U32, words);
+    memset((RK_U32 *)impl->free_map + impl->map_words, 0,
+           sizeof(RK_U32) * (words - impl->map_words));
+    impl->map_words = words;
+}
+
+static void slot_map_put(MppBufSlotsImpl *impl, RK_S32 index)
+{
+    MPP_FETCH_OR(&impl->free_map[index >> 5], 1U << (index & 31));
+}
+
+/* find first free slot and clear its bit, return -1 on no free slot */
+static RK_S32 slot_map_get(MppBufSlotsImpl *impl)
+{
+    RK_S32 count = impl->buf_count;
+    RK_S32 words = (count + 31) >> 5;
+    RK_S32 i;
+
+    for (i = 0; i < words; i++) {
+        volatile RK_U32 *word = &impl->free_map[i];
+        RK_U32 bits = *word;
+
+        while (bits) {
+            RK_S32 bit = __builtin_ctz(bits);
+            RK_U32 mask = 1U << bit;
+
+            if ((i << 5) + bit >= count)
+                break;
+
+            if (MPP_FETCH_AND(word, ~mask) & mask)
+                return (i << 5) + bit;
+
+            bits = *word;
+        }
+    }
+
+    return -1;
+}
+
 static void generate_info_set(MppBufSlotsImpl *impl, MppFrame frame, RK_U32 force_default_align)
 {
     RK_U32 width  = mpp_frame_get_width(frame);
@@ -293,7 +366,7 @@ static void _dump_slots(const char *caller, MppBufSlotsImpl *impl)
     mpp_log("display count %d\n", impl->display_count);
 
     for (i = 0; i < impl->buf_count; i++, slot++) {
-        SlotStatus status = slot->status;
+        SlotStatus status = slot_status_get(slot);
         mpp_log("slot %2d used %d refer %d decoding %d display %d status %08x\n",
                 i, status.on_used, status.codec_use, status.hal_use, status.queue_use, status.val);
     }
@@ -302,12 +375,14 @@ static void _dump_slots(const char *caller, MppBufSlotsImpl *impl)
 
     mpp_list *logs = impl->logs;
     if (logs) {
+        logs->lock();
         while (logs->list_size()) {
             MppBufSlotLog log;
             logs->del_at_head(&log, sizeof(log));
             mpp_log("index %2d op: %s status in %08x out %08x",
                     log.index, op_string[log.ops], log.status_in.val, log.status_out.val);
         }
+        logs->unlock();
     }
 
     mpp_assert(0);
@@ -324,145 +399,157 @@ static void add_slot_log(mpp_list *logs, RK_S32 index, MppBufSlotOps op, SlotSta
             before,
             after,
         };
+
+        // flag operation is not protected by slots lock
+        logs->lock();
         if (logs->list_size() >= SLOT_OPS_MAX_COUNT)
             logs->del_at_head(NULL, sizeof(log));
         logs->add_at_tail(&log, sizeof(log));
+        logs->unlock();
     }
 }
 
-static void slot_ops_with_log(MppBufSlotsImpl *impl, MppBufSlotEntry *slot, MppBufSlotOps op, void *arg)
+static SlotStatus slot_ops_with_log(MppBufSlotsImpl *impl, MppBufSlotEntry *slot, MppBufSlotOps op, void *arg)
 {
     RK_U32 error = 0;
     RK_S32 index = slot->index;
-    SlotStatus status = slot->status;
-    SlotStatus before = status;
-    switch (op) {
-    case SLOT_INIT : {
-        status.val = 0;
-    } break;
-    case SLOT_SET_ON_USE : {
-        status.on_used = 1;
-    } break;
-    case SLOT_CLR_ON_USE : {
-        status.on_used = 0;
-    } break;
-    case SLOT_SET_NOT_READY : {
-        status.not_ready = 1;
-    } break;
-    case SLOT_CLR_NOT_READY : {
-        status.not_ready = 0;
-    } break;
-    case SLOT_SET_CODEC_READY : {
-        status.not_ready = 0;
-    } break;
-    case SLOT_CLR_CODEC_READY : {
-        status.not_ready = 1;
-    } break;
-    case SLOT_SET_CODEC_USE : {
-        status.codec_use = 1;
-    } break;
-    case SLOT_CLR_CODEC_USE : {
-        status.codec_use = 0;
-    } break;
-    case SLOT_SET_HAL_INPUT : {
-        status.hal_use++;
-    } break;
-    case SLOT_CLR_HAL_INPUT : {
-        if (status.hal_use)
-            status.hal_use--;
-        else {
-            mpp_err("can not clr hal_input on slot %d\n", slot->index);
-            error = 1;
-        }
-    } break;
-    case SLOT_SET_HAL_OUTPUT : {
-        status.hal_output = 1;
-        status.not_ready  = 1;
-    } break;
-    case SLOT_CLR_HAL_OUTPUT : {
-        status.hal_output = 0;
-        // NOTE: set output index ready here
-        status.not_ready  = 0;
-    } break;
-    case SLOT_SET_QUEUE_USE :
-    case SLOT_ENQUEUE_OUTPUT :
-    case SLOT_ENQUEUE_DISPLAY :
-    case SLOT_ENQUEUE_DEINTER :
-    case SLOT_ENQUEUE_CONVERT : {
-        status.queue_use++;
-    } break;
-    case SLOT_CLR_QUEUE_USE :
-    case SLOT_DEQUEUE_OUTPUT :
-    case SLOT_DEQUEUE_DISPLAY :
-    case SLOT_DEQUEUE_DEINTER :
-    case SLOT_DEQUEUE_CONVERT : {
-        if (status.queue_use)
-            status.queue_use--;
-        else {
-            mpp_err("can not clr queue_use on slot %d\n", slot->index);
+    SlotStatus status;
+    SlotStatus before;
+
+    do {
+        before = slot_status_get(slot);
+        status = before;
+
+        switch (op) {
+        case SLOT_INIT : {
+            status.val = 0;
+        } break;
+        case SLOT_SET_ON_USE : {
+            status.on_used = 1;
+        } break;
+        case SLOT_CLR_ON_USE : {
+            status.on_used = 0;
+        } break;
+        case SLOT_SET_NOT_READY : {
+            status.not_ready = 1;
+        } break;
+        case SLOT_CLR_NOT_READY : {
+            status.not_ready = 0;
+        } break;
+        case SLOT_SET_CODEC_READY : {
+            status.not_ready = 0;
+        } break;
+        case SLOT_CLR_CODEC_READY : {
+            status.not_ready = 1;
+        } break;
+        case SLOT_SET_CODEC_USE : {
+            status.codec_use = 1;
+        } break;
+        case SLOT_CLR_CODEC_USE : {
+            status.codec_use = 0;
+        } break;
+        case SLOT_SET_HAL_INPUT : {
+            status.hal_use++;
+        } break;
+        case SLOT_CLR_HAL_INPUT : {
+            if (status.hal_use)
+                status.hal_use--;
+            else {
+                mpp_err("can not clr hal_input on slot %d\n", index);
+                error = 1;
+            }
+        } break;
+        case SLOT_SET_HAL_OUTPUT : {
+            status.hal_output = 1;
+            status.not_ready  = 1;
+        } break;
+        case SLOT_CLR_HAL_OUTPUT : {
+            status.hal_output = 0;
+            // NOTE: set output index ready here
+            status.not_ready  = 0;
+        } break;
+        case SLOT_SET_QUEUE_USE :
+        case SLOT_ENQUEUE_OUTPUT :
+        case SLOT_ENQUEUE_DISPLAY :
+        case SLOT_ENQUEUE_DEINTER :
+        case SLOT_ENQUEUE_CONVERT : {
+            status.queue_use++;
+        } break;
+        case SLOT_CLR_QUEUE_USE :
+        case SLOT_DEQUEUE_OUTPUT :
+        case SLOT_DEQUEUE_DISPLAY :
+        case SLOT_DEQUEUE_DEINTER :
+        case SLOT_DEQUEUE_CONVERT : {
+            if (status.queue_use)
+                status.queue_use--;
+            else {
+                mpp_err("can not clr queue_use on slot %d\n", index);
+                error = 1;
+            }
+        } break;
+        case SLOT_SET_EOS : {
+            status.eos = 1;
+        } break;
+        case SLOT_CLR_EOS : {
+            status.eos = 0;
+        } break;
+        case SLOT_SET_FRAME : {
+            status.has_frame = (arg) ? (1) : (0);
+        } break;
+        case SLOT_CLR_FRAME : {
+            status.has_frame = 0;
+        } break;
+        case SLOT_SET_BUFFER : {
+            status.has_buffer = (arg) ? (1) : (0);
+        } break;
+        case SLOT_CLR_BUFFER : {
+            status.has_buffer = 0;
+        } break;
+        default : {
+            mpp_err("found invalid operation code %d\n", op);
             error = 1;
+        } break;
         }
-    } break;
-    case SLOT_SET_EOS : {
-        status.eos = 1;
-    } break;
-    case SLOT_CLR_EOS : {
-        status.eos = 0;
+    } while (!error && !MPP_BOOL_CAS(&slot->status.val, before.val, status.val));
+
+    if (op == SLOT_CLR_EOS)
         slot->eos = 0;
-    } break;
-    case SLOT_SET_FRAME : {
-        status.has_frame = (arg) ? (1) : (0);
-    } break;
-    case SLOT_CLR_FRAME : {
-        status.has_frame = 0;
-    } break;
-    case SLOT_SET_BUFFER : {
-        status.has_buffer = (arg) ? (1) : (0);
-    } break;
-    case SLOT_CLR_BUFFER : {
-        status.has_buffer = 0;
-    } break;
-    default : {
-        mpp_err("found invalid operation code %d\n", op);
-        error = 1;
-    } break;
-    }
-    slot->status = status;
+
     buf_slot_dbg(BUF_SLOT_DBG_OPS_RUNTIME, "slot %3d index %2d op: %s arg %010p status in %08x out %08x",
                  impl->slots_idx, index, op_string[op], arg, before.val, status.val);
     add_slot_log(impl->logs, index, op, before, status);
     if (error)
         dump_slots(impl);
+
+    return status;
 }
 
 static void init_slot_entry(MppBufSlotsImpl *impl, RK_S32 pos, RK_S32 count)
 {
-    MppBufSlotEntry *slot = impl->slots;
+    MppBufSlotEntry *slot = impl->slots + pos;
+
+    slot_map_resize(impl, pos + count);
+
     for (RK_S32 i = 0; i < count; i++, slot++) {
         slot->slots = impl;
         INIT_LIST_HEAD(&slot->list);
         slot->index = pos + i;
         slot->frame = NULL;
+        slot->status.val = 0;
         slot_ops_with_log(impl, slot, SLOT_INIT, NULL);
+        slot_map_put(impl, pos + i);
     }
 }
 
 /*
- * only called on unref / displayed / decoded
+ * only called on unref / displayed / decoded with slots lock
  *
  * NOTE: MppFrame will be destroyed outside mpp
  *       but MppBuffer must dec_ref here
  */
 static void check_entry_unused(MppBufSlotsImpl *impl, MppBufSlotEntry *entry)
 {
-    SlotStatus status = entry->status;
-
-    if (status.on_used &&
-        !status.not_ready &&
-        !status.codec_use &&
-        !status.hal_output &&
-        !status.hal_use &&
-        !status.queue_use) {
+    if (slot_status_is_idle(slot_status_get(entry))) {
         if (entry->frame) {
             slot_ops_with_log(impl, entry, SLOT_CLR_FRAME, entry->frame);
             mpp_frame_deinit(&entry->frame);
@@ -474,7 +561,9 @@ static void check_entry_unused(MppBufSlotsImpl *impl, MppBufSlotEntry *entry)
         }
 
         slot_ops_with_log(impl, entry, SLOT_CLR_ON_USE, NULL);
-        impl->used_count--;
+        MPP_FETCH_SUB(&impl->used_count, 1);
+        // slot can be taken by mpp_buf_slot_get_unused after this point
+        slot_map_put(impl, entry->index);
     }
 }
 
@@ -491,8 +580,8 @@ static void clear_slots_impl(MppBufSlotsImpl *impl)
     }
 
     for (i = 0; i < impl->buf_count; i++, slot++) {
-        mpp_assert(!slot->status.on_used);
-        if (slot->status.on_used) {
+        mpp_assert(!slot_status_get(slot).on_used);
+        if (slot_status_get(slot).on_used) {
             dump_slots(impl);
             mpp_buf_slot_reset(impl, i);
         }
@@ -513,6 +602,7 @@ static void clear_slots_impl(MppBufSlotsImpl *impl)
         delete impl->lock;
 
     mpp_free(impl->slots);
+    mpp_free((RK_U32 *)impl->free_map);
     mpp_free(impl);
 }
 
@@ -528,7 +618,7 @@ MPP_RET mpp_buf_slot_init(MppBufSlots *slots)
         return MPP_NOK;
     }
 
-    mpp_env_get_u32("buf_slot_debug", &buf_slot_debug, BUF_SLOT_DBG_OPS_HISTORY);
+    mpp_env_get_u32("buf_slot_debug", &buf_slot_debug, 0);
 
     do {
         impl->lock = new Mutex();
@@ -601,7 +691,7 @@ MPP_RET mpp_buf_slot_setup(MppBufSlots slots, RK_S32 count)
     } else {
         // record the slot count for info changed ready config
         if (count > impl->buf_count) {
-            mpp_realloc(impl->slots, MppBufSlotEntry, count);
+            impl->slots = mpp_realloc(impl->slots, MppBufSlotEntry, count);
             init_slot_entry(impl, impl->buf_count, (count - impl->buf_count));
         }
         impl->new_count = count;
@@ -639,7 +729,9 @@ MPP_RET mpp_buf_slot_ready(MppBufSlots slots)
 
     // ready mean the info_set will be copy to info as the new configuration
     if (impl->buf_count != impl->new_count) {
-        mpp_realloc(impl->slots, MppBufSlotEntry, impl->new_count);
+        impl->slots = mpp_realloc(impl->slots, MppBufSlotEntry, impl->new_count);
+        slot_map_resize(impl, impl->new_count);
+        memset((RK_U32 *)impl->free_map, 0, sizeof(RK_U32) * impl->map_words);
         init_slot_entry(impl, 0, impl->new_count);
     }
     impl->buf_count = impl->new_count;
@@ -649,8 +741,10 @@ MPP_RET mpp_buf_slot_ready(MppBufSlots slots)
 
     if (impl->logs) {
         mpp_list *logs = impl->logs;
+        logs->lock();
         while (logs->list_size())
             logs->del_at_head(NULL, sizeof(MppBufSlotLog));
+        logs->unlock();
     }
     impl->info_changed  = 0;
     return MPP_OK;
@@ -676,19 +770,19 @@ MPP_RET mpp_buf_slot_get_unused(MppBufSlots slots, RK_S32 *index)
     }
 
     MppBufSlotsImpl *impl = (MppBufSlotsImpl *)slots;
-    AutoMutex auto_lock(impl->lock);
-    RK_S32 i;
-    MppBufSlotEntry *slot = impl->slots;
-    for (i = 0; i < impl->buf_count; i++, slot++) {
-        if (!slot->status.on_used) {
-            *index = i;
-            slot_ops_with_log(impl, slot, SLOT_SET_ON_USE, NULL);
-            slot_ops_with_log(impl, slot, SLOT_SET_NOT_READY, NULL);
-            impl->used_count++;
-            return MPP_OK;
-        }
+    RK_S32 i = slot_map_get(impl);
+
+    if (i >= 0) {
+        MppBufSlotEntry *slot = &impl->slots[i];
+
+        *index = i;
+        slot_ops_with_log(impl, slot, SLOT_SET_ON_USE, NULL);
+        slot_ops_with_log(impl, slot, SLOT_SET_NOT_READY, NULL);
+        MPP_FETCH_ADD(&impl->used_count, 1);
+        return MPP_OK;
     }
 
+    AutoMutex auto_lock(impl->lock);
     *index = -1;
     mpp_err_f("failed to get a unused slot\n");
     dump_slots(impl);
@@ -704,7 +798,6 @@ MPP_RET mpp_buf_slot_set_flag(MppBufSlots slots, RK_S32 index, SlotUsageType typ
     }
 
     MppBufSlotsImpl *impl = (MppBufSlotsImpl *)slots;
-    AutoMutex auto_lock(impl->lock);
     slot_assert(impl, (index >= 0) && (index < impl->buf_count));
     slot_ops_with_log(impl, &impl->slots[index], set_flag_op[type], NULL);
     return MPP_OK;
@@ -718,15 +811,18 @@ MPP_RET mpp_buf_slot_clr_flag(MppBufSlots slots, RK_S32 index, SlotUsageType typ
     }
 
     MppBufSlotsImpl *impl = (MppBufSlotsImpl *)slots;
-    AutoMutex auto_lock(impl->lock);
     slot_assert(impl, (index >= 0) && (index < impl->buf_count));
     MppBufSlotEntry *slot = &impl->slots[index];
-    slot_ops_with_log(impl, slot, clr_flag_op[type], NULL);
+    SlotStatus status = slot_ops_with_log(impl, slot, clr_flag_op[type], NULL);
 
     if (type == SLOT_HAL_OUTPUT)
-        impl->decode_count++;
+        MPP_FETCH_ADD(&impl->decode_count, 1);
 
-    check_entry_unused(impl, slot);
+    // only the last user releasing the slot need the lock
+    if (slot_status_is_idle(status)) {
+        AutoMutex auto_lock(impl->lock);
+        check_entry_unused(impl, slot);
+    }
     return MPP_OK;
 }
 
@@ -762,7 +858,7 @@ MPP_RET mpp_buf_slot_dequeue(MppBufSlots slots, RK_S32 *index, SlotQueueType typ
         return MPP_NOK;
 
     MppBufSlotEntry *slot = list_entry(impl->queue[type].next, MppBufSlotEntry, list);
-    if (slot->status.not_ready)
+    if (slot_status_get(slot).not_ready)
         return MPP_NOK;
 
     // make sure that this slot is just the next display slot
@@ -798,7 +894,7 @@ MPP_RET mpp_buf_slot_set_prop(MppBufSlots slots, RK_S32 index, SlotPropType type
     case SLOT_FRAME: {
         MppFrame frame = val;
 
-        slot_assert(impl, slot->status.not_ready);
+        slot_assert(impl, slot_status_get(slot).not_ready);
         /*
          * we need to detect infomation change here
          * there are two types of info change:
@@ -885,8 +981,8 @@ MPP_RET mpp_buf_slot_get_prop(MppBufSlots slots, RK_S32 index, SlotPropType type
         MppFrame *frame = (MppFrame *)val;
         //*frame = (slot->status.has_frame) ? (slot->frame) : (NULL);
 
-        mpp_assert(slot->status.has_frame);
-        if (slot->status.has_frame) {
+        mpp_assert(slot_status_get(slot).has_frame);
+        if (slot_status_get(slot).has_frame) {
             if (NULL == *frame )
                 mpp_frame_init(frame);
             if (*frame)
@@ -896,12 +992,12 @@ MPP_RET mpp_buf_slot_get_prop(MppBufSlots slots, RK_S32 index, SlotPropType type
     } break;
     case SLOT_FRAME_PTR: {
         MppFrame *frame = (MppFrame *)val;
-        mpp_assert(slot->status.has_frame);
-        *frame = (slot->status.has_frame) ? (slot->frame) : (NULL);
+        mpp_assert(slot_status_get(slot).has_frame);
+        *frame = (slot_status_get(slot).has_frame) ? (slot->frame) : (NULL);
     } break;
     case SLOT_BUFFER: {
         MppBuffer *buffer = (MppBuffer *)val;
-        *buffer = (slot->status.has_buffer) ? (slot->buffer) : (NULL);
+        *buffer = (slot_status_get(slot).has_buffer) ? (slot->buffer) : (NULL);
     } break;
     default : {
     } break;
@@ -928,7 +1024,11 @@ MPP_RET mpp_buf_slot_reset(MppBufSlots slots, RK_S32 index)
     list_del_init(&slot->list);
     slot_ops_with_log(impl, slot, SLOT_CLR_QUEUE_USE, NULL);
     slot_ops_with_log(impl, slot, SLOT_DEQUEUE, NULL);
-    slot_ops_with_log(impl, slot, SLOT_CLR_ON_USE, NULL);
+    if (slot_status_get(slot).on_used) {
+        slot_ops_with_log(impl, slot, SLOT_CLR_ON_USE, NULL);
+        MPP_FETCH_SUB(&impl->used_count, 1);
+        slot_map_put(impl, index);
+    }
     return MPP_OK;
 }
 
@@ -944,7 +1044,7 @@ MPP_RET mpp_buf_slot_default_info(MppBufSlots slots, RK_S32 index, void *val)
     slot_assert(impl, (index >= 0) && (index < impl->buf_count));
     MppBufSlotEntry *slot = &impl->slots[index];
 
-    slot_assert(impl, slot->status.not_ready);
+    slot_assert(impl, slot_status_get(slot).not_ready);
     slot_assert(impl, NULL == slot->frame);
     slot_assert(impl, impl->info_set);
 
@@ -980,8 +1080,7 @@ RK_S32 mpp_slots_get_used_count(MppBufSlots slots)
         return 0;
     }
     MppBufSlotsImpl *impl = (MppBufSlotsImpl *)slots;
-    AutoMutex auto_lock(impl->lock);
-    return impl->used_count;
+    return MPP_LOAD_ACQUIRE(&impl->used_count);
 }
 
 RK_S32 mpp_slots_get_unused_count(MppBufSlots slots)
@@ -992,9 +1091,10 @@ RK_S32 mpp_slots_get_unused_count(MppBufSlots slots)
     }
 
     MppBufSlotsImpl *impl = (MppBufSlotsImpl *)slots;
-    AutoMutex auto_lock(impl->lock);
-    slot_assert(impl, (impl->used_count >= 0) && (impl->used_count <= impl->buf_count));
-    return impl->buf_count - impl->used_count;
+    RK_S32 used_count = MPP_LOAD_ACQUIRE(&impl->used_count);
+
+    slot_assert(impl, (used_count >= 0) && (used_count <= impl->buf_count));
+    return impl->buf_count - used_count;
 }
 
 MPP_RET mpp_slots_set_prop(MppBufSlots slots, SlotsPropType type, void *val)
@@ -377,3 +377,13 @@ MPP_RET mpp_buffer_group_limit_config(MppBufferGroup group, size_t size, RK_S32
     return MPP_OK;
 }
 
+MPP_RET mpp_buffer_group_cache_config(MppBufferGroup group, size_t min, size_t max)
+{
+    if (NULL == group) {
+        mpp_err_f("input invalid group %p\n", group);
+        return MPP_NOK;
+    }
+
+    return mpp_buffer_group_set_cache((MppBufferGroupImpl *)group, min, max);
+}
+
@@ -21,13 +21,12 @@
 #include "mpp_log.h"
 #include "mpp_mem.h"
 #include "mpp_env.h"
+#include "mpp_atomic.h"
 
 #include "mpp_buffer_impl.h"
 
 #define BUFFER_OPS_MAX_COUNT            1024
 
-#define SEARCH_GROUP_BY_ID(id)  ((MppBufferService::get_instance())->get_group_by_id(id))
-
 typedef MPP_RET (*BufferOp)(MppAllocator allocator, MppBufferInfo *data);
 
 typedef enum MppBufOps_e {
@@ -117,6 +116,7 @@ static const char *type2str[MPP_BUFFER_TYPE_BUTT] = {
     "ion",
     "dma-buf",
     "drm",
+    "memfd",
 };
 static const char *ops2str[BUF_OPS_BUTT] = {
     "grp create ",
@@ -194,15 +194,23 @@ static void buffer_group_dump_log(MppBufferGroupImpl *group)
     }
 }
 
-static MPP_RET deinit_buffer_no_lock(MppBufferImpl *buffer, const char *caller)
+/*
+ * NOTE: group buf_lock should be held by caller
+ * return 1 when the last buffer of an orphan group is released then the
+ * group should be put by caller after releasing group buf_lock
+ */
+static RK_U32 deinit_buffer_no_lock(MppBufferImpl *buffer, const char *caller)
 {
+    MppBufferGroupImpl *group = buffer->group;
+    RK_U32 release = 0;
+
     if (!MppBufferService::get_instance()->is_finalizing()) {
         mpp_assert(buffer->ref_count == 0);
         mpp_assert(buffer->used == 0);
     }
 
     list_del_init(&buffer->list_status);
-    MppBufferGroupImpl *group = SEARCH_GROUP_BY_ID(buffer->group_id);
+    list_del_init(&buffer->list_bin);
     if (group) {
         BufferOp func = (group->mode == MPP_BUFFER_INTERNAL) ?
                         (group->alloc_api->free) :
@@ -213,39 +221,159 @@ static MPP_RET deinit_buffer_no_lock(MppBufferImpl *buffer, const char *caller)
 
         buffer_group_add_log(group, buffer, BUF_DESTROY, caller);
 
-        if (group->is_orphan && !group->usage) {
-            MppBufferService::get_instance()->put_group(group);
-        }
+        if (group->is_orphan && !group->usage)
+            release = 1;
     } else {
         mpp_assert(MppBufferService::get_instance()->is_finalizing());
     }
 
     mpp_free(buffer);
 
-    return MPP_OK;
+    return release;
+}
+
+static void put_orphan_group(MppBufferGroupImpl *group)
+{
+    AutoMutex auto_lock(MppBufferService::get_lock());
+
+    MppBufferService::get_instance()->put_group(group);
+}
+
+static RK_S32 buffer_bin_idx(size_t size)
+{
+    RK_U32 val = (size > (size_t)0xffffffff) ? (0xffffffff) : ((RK_U32)size);
+
+    return mpp_log2(val);
+}
+
+/* NOTE: group buf_lock should be held by caller */
+static void buffer_unused_add(MppBufferGroupImpl *group, MppBufferImpl *buffer)
+{
+    RK_S32 idx = buffer_bin_idx(buffer->info.size);
+
+    list_add_tail(&buffer->list_status, &group->list_unused);
+    list_add_tail(&buffer->list_bin, &group->list_bins[idx]);
+    group->count_unused++;
+    group->unused_size += buffer->info.size;
+}
+
+/* NOTE: group buf_lock should be held by caller */
+static void buffer_unused_del(MppBufferGroupImpl *group, MppBufferImpl *buffer)
+{
+    list_del_init(&buffer->list_status);
+    list_del_init(&buffer->list_bin);
+    group->count_unused--;
+    group->unused_size -= buffer->info.size;
+}
+
+/*
+ * Search the smallest unused buffer not less than size. Bins above the
+ * size class only have larger buffer so the first hit bin has the best one.
+ */
+static MppBufferImpl *buffer_get_best_fit(MppBufferGroupImpl *group, size_t size)
+{
+    RK_S32 idx;
+
+    for (idx = buffer_bin_idx(size); idx < MPP_BUF_BIN_NUM; idx++) {
+        MppBufferImpl *pos, *best = NULL;
+
+        list_for_each_entry(pos, &group->list_bins[idx], MppBufferImpl, list_bin) {
+            mpp_buf_dbg(MPP_BUF_DBG_CHECK_SIZE, "request size %d on buf idx %d size %d\n",
+                        size, pos->buffer_id, pos->info.size);
+            // exact size is the common case on fixed resolution
+            if (pos->info.size == size)
+                return pos;
+
+            if (pos->info.size > size &&
+                (NULL == best || pos->info.size < best->info.size))
+                best = pos;
+        }
+
+        if (best)
+            return best;
+    }
+
+    return NULL;
+}
+
+/*
+ * Release unused buffer smaller than size from the smallest class. The
+ * buffer is kept when total unused size is under cache_min unless the group
+ * reaches its count limit and needs room for the new buffer.
+ */
+static RK_U32 buffer_group_trim(MppBufferGroupImpl *group, size_t size)
+{
+    RK_U32 release = 0;
+    RK_S32 idx;
+
+    for (idx = 0; idx < MPP_BUF_BIN_NUM; idx++) {
+        MppBufferImpl *pos, *n;
+
+        list_for_each_entry_safe(pos, n, &group->list_bins[idx], MppBufferImpl, list_bin) {
+            RK_U32 full = group->limit_count && group->buffer_count >= group->limit_count;
+
+            if (pos->info.size >= size)
+                continue;
+
+            if (!full && group->unused_size <= group->cache_min)
+                return release;
+
+            buffer_unused_del(group, pos);
+            release |= deinit_buffer_no_lock(pos, __FUNCTION__);
+        }
+    }
+
+    return release;
+}
+
+/* increase ref_count without lock when the buffer is already in use */
+static RK_S32 try_inc_buffer_ref(MppBufferImpl *buffer)
+{
+    RK_S32 ref = buffer->ref_count;
+
+    while (ref > 0) {
+        RK_S32 old = MPP_VAL_CAS(&buffer->ref_count, ref, ref + 1);
+
+        if (old == ref)
+            return 1;
+
+        ref = old;
+    }
+
+    return 0;
 }
 
+/* decrease ref_count without lock when the buffer is still in use after */
+static RK_S32 try_dec_buffer_ref(MppBufferImpl *buffer)
+{
+    RK_S32 ref = buffer->ref_count;
+
+    while (ref > 1) {
+        RK_S32 old = MPP_VAL_CAS(&buffer->ref_count, ref, ref - 1);
+
+        if (old == ref)
+            return 1;
+
+        ref = old;
+    }
+
+    return 0;
+}
+
+/* NOTE: group buf_lock should be held by caller */
 static MPP_RET inc_buffer_ref_no_lock(MppBufferImpl *buffer, const char *caller)
 {
-    MPP_RET ret = MPP_OK;
-    MppBufferGroupImpl *group = SEARCH_GROUP_BY_ID(buffer->group_id);
+    MppBufferGroupImpl *group = buffer->group;
+
     if (!buffer->used) {
-        // NOTE: when increasing ref_count the unused buffer must be under certain group
-        mpp_assert(group);
         buffer->used = 1;
-        if (group) {
-            list_del_init(&buffer->list_status);
-            list_add_tail(&buffer->list_status, &group->list_used);
-            group->count_used++;
-            group->count_unused--;
-        } else {
-            mpp_err_f("unused buffer without group\n");
-            ret = MPP_NOK;
-        }
+        buffer_unused_del(group, buffer);
+        list_add_tail(&buffer->list_status, &group->list_used);
+        group->count_used++;
     }
     buffer_group_add_log(group, buffer, BUF_REF_INC, caller);
-    buffer->ref_count++;
-    return ret;
+    MPP_FETCH_ADD(&buffer->ref_count, 1);
+    return MPP_OK;
 }
 
 static void dump_buffer_info(MppBufferImpl *buffer)
@@ -259,7 +387,6 @@ MPP_RET mpp_buffer_create(const char *tag, const char *caller,
                           MppBufferGroupImpl *group, MppBufferInfo *info,
                           MppBufferImpl **buffer)
 {
-    AutoMutex auto_lock(MppBufferService::get_lock());
     MPP_BUF_FUNCTION_ENTER();
 
     MPP_RET ret = MPP_OK;
@@ -268,10 +395,11 @@ MPP_RET mpp_buffer_create(const char *tag, const char *caller,
 
     if (NULL == group) {
         mpp_err_f("can not create buffer without group\n");
-        ret = MPP_NOK;
-        goto RET;
+        return MPP_NOK;
     }
 
+    AutoMutex auto_lock(group->buf_lock);
+
     if (group->limit_count && group->buffer_count >= group->limit_count) {
         if (group->log_runtime_en)
             mpp_log_f("group %d reach count limit %d\n", group->group_id, group->limit_count);
@@ -310,15 +438,16 @@ MPP_RET mpp_buffer_create(const char *tag, const char *caller,
 
     strncpy(p->tag, tag, sizeof(p->tag));
     p->caller = caller;
+    p->group = group;
     p->group_id = group->group_id;
     p->buffer_id = group->buffer_id;
     INIT_LIST_HEAD(&p->list_status);
-    list_add_tail(&p->list_status, &group->list_unused);
+    INIT_LIST_HEAD(&p->list_bin);
+    buffer_unused_add(group, p);
 
     group->buffer_id++;
     group->usage += info->size;
     group->buffer_count++;
-    group->count_unused++;
 
     buffer_group_add_log(group, p,
                          (group->mode == MPP_BUFFER_INTERNAL) ? (BUF_CREATE) : (BUF_COMMIT),
@@ -338,13 +467,14 @@ RET:
 
 MPP_RET mpp_buffer_mmap(MppBufferImpl *buffer, const char* caller)
 {
-    AutoMutex auto_lock(MppBufferService::get_lock());
     MPP_BUF_FUNCTION_ENTER();
 
     MPP_RET ret = MPP_NOK;
-    MppBufferGroupImpl *group = SEARCH_GROUP_BY_ID(buffer->group_id);
+    MppBufferGroupImpl *group = buffer->group;
 
     if (group && group->alloc_api && group->alloc_api->mmap) {
+        AutoMutex auto_lock(group->buf_lock);
+
         ret = group->alloc_api->mmap(group->allocator, &buffer->info);
 
         buffer_group_add_log(group, buffer, BUF_MMAP, caller);
@@ -360,10 +490,19 @@ MPP_RET mpp_buffer_mmap(MppBufferImpl *buffer, const char* caller)
 
 MPP_RET mpp_buffer_ref_inc(MppBufferImpl *buffer, const char* caller)
 {
-    AutoMutex auto_lock(MppBufferService::get_lock());
     MPP_BUF_FUNCTION_ENTER();
 
-    MPP_RET ret = inc_buffer_ref_no_lock(buffer, caller);
+    MPP_RET ret = MPP_OK;
+    MppBufferGroupImpl *group = buffer->group;
+
+    // history log list needs group lock so disable lock free path on it
+    if (!group->log_history_en && try_inc_buffer_ref(buffer)) {
+        buffer_group_add_log(group, buffer, BUF_REF_INC, caller);
+    } else {
+        AutoMutex auto_lock(group->buf_lock);
+
+        ret = inc_buffer_ref_no_lock(buffer, caller);
+    }
 
     MPP_BUF_FUNCTION_LEAVE();
     return ret;
@@ -372,33 +511,38 @@ MPP_RET mpp_buffer_ref_inc(MppBufferImpl *buffer, const char* caller)
 
 MPP_RET mpp_buffer_ref_dec(MppBufferImpl *buffer, const char* caller)
 {
-    AutoMutex auto_lock(MppBufferService::get_lock());
     MPP_BUF_FUNCTION_ENTER();
 
     MPP_RET ret = MPP_OK;
-    MppBufferGroupImpl *group = SEARCH_GROUP_BY_ID(buffer->group_id);
-    if (group)
+    MppBufferGroupImpl *group = buffer->group;
+    RK_U32 release = 0;
+
+    if (!group->log_history_en && try_dec_buffer_ref(buffer)) {
         buffer_group_add_log(group, buffer, BUF_REF_DEC, caller);
+        MPP_BUF_FUNCTION_LEAVE();
+        return ret;
+    }
 
-    if (buffer->ref_count <= 0) {
-        mpp_err_f("found non-positive ref_count %d caller %s\n",
-                  buffer->ref_count, buffer->caller);
-        mpp_abort();
-        ret = MPP_NOK;
-    } else {
-        buffer->ref_count--;
-        if (0 == buffer->ref_count) {
+    {
+        AutoMutex auto_lock(group->buf_lock);
+
+        buffer_group_add_log(group, buffer, BUF_REF_DEC, caller);
+
+        if (buffer->ref_count <= 0) {
+            mpp_err_f("found non-positive ref_count %d caller %s\n",
+                      buffer->ref_count, buffer->caller);
+            mpp_abort();
+            ret = MPP_NOK;
+        } else if (0 == MPP_SUB_FETCH(&buffer->ref_count, 1)) {
             buffer->used = 0;
             list_del_init(&buffer->list_status);
-            if (group == MppBufferService::get_instance()->get_misc(group->mode, group->type)) {
-                deinit_buffer_no_lock(buffer, caller);
+            if (group->is_misc || buffer->discard) {
+                release = deinit_buffer_no_lock(buffer, caller);
+            } else if (group->mode == MPP_BUFFER_INTERNAL && group->cache_max &&
+                       group->unused_size + buffer->info.size > group->cache_max) {
+                release = deinit_buffer_no_lock(buffer, caller);
             } else {
-                if (buffer->discard) {
-                    deinit_buffer_no_lock(buffer, caller);
-                } else {
-                    list_add_tail(&buffer->list_status, &group->list_unused);
-                    group->count_unused++;
-                }
+                buffer_unused_add(group, buffer);
             }
             group->count_used--;
             if (group->callback)
@@ -406,43 +550,38 @@ MPP_RET mpp_buffer_ref_dec(MppBufferImpl *buffer, const char* caller)
         }
     }
 
+    if (release)
+        put_orphan_group(group);
+
     MPP_BUF_FUNCTION_LEAVE();
     return ret;
 }
 
 MppBufferImpl *mpp_buffer_get_unused(MppBufferGroupImpl *p, size_t size)
 {
-    AutoMutex auto_lock(MppBufferService::get_lock());
     MPP_BUF_FUNCTION_ENTER();
 
     MppBufferImpl *buffer = NULL;
+    RK_U32 release = 0;
 
-    if (!list_empty(&p->list_unused)) {
-        MppBufferImpl *pos, *n;
-        RK_S32 found = 0;
-        RK_S32 search_count = 0;
+    {
+        AutoMutex auto_lock(p->buf_lock);
 
-        list_for_each_entry_safe(pos, n, &p->list_unused, MppBufferImpl, list_status) {
-            mpp_buf_dbg(MPP_BUF_DBG_CHECK_SIZE, "request size %d on buf idx %d size %d\n",
-                        size, pos->buffer_id, pos->info.size);
-            if (pos->info.size >= size) {
-                buffer = pos;
-                inc_buffer_ref_no_lock(buffer, __FUNCTION__);
-                found = 1;
-                break;
-            } else {
-                if (MPP_BUFFER_INTERNAL == p->mode) {
-                    deinit_buffer_no_lock(pos, __FUNCTION__);
-                    p->count_unused--;
-                } else
-                    search_count++;
-            }
+        buffer = buffer_get_best_fit(p, size);
+        if (buffer) {
+            inc_buffer_ref_no_lock(buffer, __FUNCTION__);
+        } else if (p->count_unused) {
+            // all unused buffer are smaller than the request here
+            if (MPP_BUFFER_INTERNAL == p->mode)
+                release = buffer_group_trim(p, size);
+            else
+                mpp_err_f("can not found match buffer with size larger than %d\n", size);
         }
-
-        if (!found && search_count)
-            mpp_err_f("can not found match buffer with size larger than %d\n", size);
     }
 
+    if (release)
+        put_orphan_group(p);
+
     MPP_BUF_FUNCTION_LEAVE();
     return buffer;
 }
@@ -503,12 +642,12 @@ MPP_RET mpp_buffer_group_deinit(MppBufferGroupImpl *p)
 
 MPP_RET mpp_buffer_group_reset(MppBufferGroupImpl *p)
 {
-    AutoMutex auto_lock(MppBufferService::get_lock());
     if (NULL == p) {
         mpp_err_f("found NULL pointer\n");
         return MPP_ERR_NULL_PTR;
     }
 
+    AutoMutex auto_lock(p->buf_lock);
     MPP_BUF_FUNCTION_ENTER();
 
     buffer_group_add_log(p, NULL, GRP_RESET, NULL);
@@ -525,8 +664,8 @@ MPP_RET mpp_buffer_group_reset(MppBufferGroupImpl *p)
     if (!list_empty(&p->list_unused)) {
         MppBufferImpl *pos, *n;
         list_for_each_entry_safe(pos, n, &p->list_unused, MppBufferImpl, list_status) {
+            buffer_unused_del(p, pos);
             deinit_buffer_no_lock(pos, __FUNCTION__);
-            p->count_unused--;
         }
     }
 
@@ -537,12 +676,12 @@ MPP_RET mpp_buffer_group_reset(MppBufferGroupImpl *p)
 MPP_RET mpp_buffer_group_set_callback(MppBufferGroupImpl *p,
                                       MppBufCallback callback, void *arg)
 {
-    AutoMutex auto_lock(MppBufferService::get_lock());
     if (NULL == p) {
         mpp_err_f("found NULL pointer\n");
         return MPP_ERR_NULL_PTR;
     }
 
+    AutoMutex auto_lock(p->buf_lock);
     MPP_BUF_FUNCTION_ENTER();
 
     p->callback = callback;
@@ -552,6 +691,41 @@ MPP_RET mpp_buffer_group_set_callback(MppBufferGroupImpl *p,
     return MPP_OK;
 }
 
+MPP_RET mpp_buffer_group_set_cache(MppBufferGroupImpl *p, size_t min, size_t max)
+{
+    if (NULL == p) {
+        mpp_err_f("found NULL pointer\n");
+        return MPP_ERR_NULL_PTR;
+    }
+
+    AutoMutex auto_lock(p->buf_lock);
+    MPP_BUF_FUNCTION_ENTER();
+
+    if (max && min > max) {
+        mpp_err_f("invalid cache min %d larger than max %d\n", min, max);
+        return MPP_NOK;
+    }
+
+    p->cache_min = min;
+    p->cache_max = max;
+
+    // release the oldest unused buffer to fit the new max
+    if (max && MPP_BUFFER_INTERNAL == p->mode) {
+        MppBufferImpl *pos, *n;
+
+        list_for_each_entry_safe(pos, n, &p->list_unused, MppBufferImpl, list_status) {
+            if (p->unused_size <= max)
+                break;
+
+            buffer_unused_del(p, pos);
+            deinit_buffer_no_lock(pos, __FUNCTION__);
+        }
+    }
+
+    MPP_BUF_FUNCTION_LEAVE();
+    return MPP_OK;
+}
+
 void mpp_buffer_group_dump(MppBufferGroupImpl *group, const char *caller)
 {
     mpp_log("\ndumping buffer group %p id %d from %s\n", group,
@@ -559,6 +733,8 @@ void mpp_buffer_group_dump(MppBufferGroupImpl *group, const char *caller)
     mpp_log("mode %s\n", mode2str[group->mode]);
     mpp_log("type %s\n", type2str[group->type]);
     mpp_log("limit size %d count %d\n", group->limit_size, group->limit_count);
+    mpp_log("cache min %d max %d unused size %d\n", group->cache_min,
+            group->cache_max, group->unused_size);
 
     mpp_log("used buffer count %d\n", group->count_used);
 
@@ -592,7 +768,8 @@ MppBufferGroupImpl *mpp_buffer_get_misc_group(MppBufferMode mode, MppBufferType
         offset += snprintf(tag + offset, sizeof(tag) - offset, "misc");
         offset += snprintf(tag + offset, sizeof(tag) - offset, "_%s",
                            type == MPP_BUFFER_TYPE_ION ? "ion" :
-                           type == MPP_BUFFER_TYPE_DRM ? "drm" : "na");
+                           type == MPP_BUFFER_TYPE_DRM ? "drm" :
+                           type == MPP_BUFFER_TYPE_MEMFD ? "memfd" : "na");
         offset += snprintf(tag + offset, sizeof(tag) - offset, "_%s",
                            mode == MPP_BUFFER_INTERNAL ? "int" : "ext");
 
@@ -648,13 +825,14 @@ MppBufferService::~MppBufferService()
         }
     }
 
-    // remove all orphan buffer
+    // remove all orphan group with buffer not released
     if (!list_empty(&mListOrphan)) {
-        MppBufferImpl *pos, *n;
+        MppBufferGroupImpl *pos, *n;
 
         mpp_log_f("cleaning leaked buffer\n");
-        list_for_each_entry_safe(pos, n, &mListOrphan, MppBufferImpl, list_status) {
-            deinit_buffer_no_lock(pos, __FUNCTION__);
+        list_for_each_entry_safe(pos, n, &mListOrphan, MppBufferGroupImpl, list_group) {
+            pos->clear_on_exit = 1;
+            put_group(pos);
         }
     }
     finished = 1;
@@ -677,6 +855,8 @@ MppBufferGroupImpl *MppBufferService::get_group(const char *tag, const char *cal
 {
     MppBufferType buffer_type = (MppBufferType)(type & MPP_BUFFER_TYPE_MASK);
     MppBufferGroupImpl *p = mpp_calloc(MppBufferGroupImpl, 1);
+    RK_S32 i;
+
     if (NULL == p) {
         mpp_err("MppBufferService failed to allocate group context\n");
         return NULL;
@@ -688,6 +868,8 @@ MppBufferGroupImpl *MppBufferService::get_group(const char *tag, const char *cal
     INIT_LIST_HEAD(&p->list_group);
     INIT_LIST_HEAD(&p->list_used);
     INIT_LIST_HEAD(&p->list_unused);
+    for (i = 0; i < MPP_BUF_BIN_NUM; i++)
+        INIT_LIST_HEAD(&p->list_bins[i]);
 
     mpp_env_get_u32("mpp_buffer_debug", &mpp_buffer_debug, 0);
     p->log_runtime_en   = (mpp_buffer_debug & MPP_BUF_DBG_OPS_RUNTIME) ? (1) : (0);
@@ -706,6 +888,8 @@ MppBufferGroupImpl *MppBufferService::get_group(const char *tag, const char *cal
     p->limit    = BUFFER_GROUP_SIZE_DEFAULT;
     p->group_id = id;
     p->clear_on_exit = (mpp_buffer_debug & MPP_BUF_DBG_CLR_ON_EXIT) ? (1) : (0);
+    p->is_misc  = is_misc;
+    p->buf_lock = new Mutex();
 
     mpp_allocator_get(&p->allocator, &p->alloc_api, type);
 
@@ -748,55 +932,65 @@ void MppBufferService::set_misc(MppBufferMode mode, MppBufferType type, MppBuffe
 
 void MppBufferService::put_group(MppBufferGroupImpl *p)
 {
+    RK_U32 destroy = 0;
+
     if (finished)
         return ;
 
-    buffer_group_add_log(p, NULL, GRP_RELEASE, __FUNCTION__);
+    {
+        AutoMutex auto_lock(p->buf_lock);
 
-    // remove unused list
-    if (!list_empty(&p->list_unused)) {
-        MppBufferImpl *pos, *n;
-        list_for_each_entry_safe(pos, n, &p->list_unused, MppBufferImpl, list_status) {
-            deinit_buffer_no_lock(pos, __FUNCTION__);
-            p->count_unused--;
+        buffer_group_add_log(p, NULL, GRP_RELEASE, __FUNCTION__);
+
+        // remove unused list
+        if (!list_empty(&p->list_unused)) {
+            MppBufferImpl *pos, *n;
+            list_for_each_entry_safe(pos, n, &p->list_unused, MppBufferImpl, list_status) {
+                buffer_unused_del(p, pos);
+                deinit_buffer_no_lock(pos, __FUNCTION__);
+            }
         }
-    }
 
-    if (list_empty(&p->list_used)) {
-        destroy_group(p);
-    } else {
-        if (!finalizing ||
-            (finalizing && (mpp_buffer_debug & MPP_BUF_DBG_DUMP_ON_EXIT))) {
-            mpp_err("mpp_group %p tag %s caller %s mode %s type %s deinit with %d bytes not released\n",
-                    p, p->tag, p->caller, mode2str[p->mode], type2str[p->type], p->usage);
+        if (list_empty(&p->list_used)) {
+            destroy = 1;
+        } else {
+            if (!finalizing ||
+                (finalizing && (mpp_buffer_debug & MPP_BUF_DBG_DUMP_ON_EXIT))) {
+                mpp_err("mpp_group %p tag %s caller %s mode %s type %s deinit with %d bytes not released\n",
+                        p, p->tag, p->caller, mode2str[p->mode], type2str[p->type], p->usage);
 
-            mpp_buffer_group_dump(p, __FUNCTION__);
-        }
+                mpp_buffer_group_dump(p, __FUNCTION__);
+            }
 
-        /* if clear on exit we need to release remaining buffer */
-        if (p->clear_on_exit) {
-            MppBufferImpl *pos, *n;
+            /* if clear on exit we need to release remaining buffer */
+            if (p->clear_on_exit) {
+                MppBufferImpl *pos, *n;
 
-            mpp_err("force release all remaining buffer\n");
+                mpp_err("force release all remaining buffer\n");
 
-            list_for_each_entry_safe(pos, n, &p->list_used, MppBufferImpl, list_status) {
-                mpp_err("clearing buffer %p\n", pos);
-                pos->ref_count = 0;
-                pos->used = 0;
-                pos->discard = 0;
-                deinit_buffer_no_lock(pos, __FUNCTION__);
-                p->count_used--;
-            }
+                list_for_each_entry_safe(pos, n, &p->list_used, MppBufferImpl, list_status) {
+                    mpp_err("clearing buffer %p\n", pos);
+                    pos->ref_count = 0;
+                    pos->used = 0;
+                    pos->discard = 0;
+                    deinit_buffer_no_lock(pos, __FUNCTION__);
+                    p->count_used--;
+                }
 
-            destroy_group(p);
-        } else {
-            // otherwise move the group to list_orphan and wait for buffer release
-            buffer_group_add_log(p, NULL, GRP_ORPHAN, __FUNCTION__);
-            list_del_init(&p->list_group);
-            list_add_tail(&p->list_group, &mListOrphan);
-            p->is_orphan = 1;
+                destroy = 1;
+            } else {
+                // otherwise move the group to list_orphan and wait for buffer release
+                buffer_group_add_log(p, NULL, GRP_ORPHAN, __FUNCTION__);
+                list_del_init(&p->list_group);
+                list_add_tail(&p->list_group, &mListOrphan);
+                p->is_orphan = 1;
+            }
         }
     }
+
+    // group lock is released in destroy_group so call it without lock
+    if (destroy)
+        destroy_group(p);
 }
 
 void MppBufferService::destroy_group(MppBufferGroupImpl *group)
@@ -829,6 +1023,7 @@ void MppBufferService::destroy_group(MppBufferGroupImpl *group)
     mpp_assert(group->allocator);
     mpp_allocator_put(&group->allocator);
     list_del_init(&group->list_group);
+    delete group->buf_lock;
     mpp_free(group);
     group_count--;
 
@@ -862,8 +1057,10 @@ void MppBufferService::dump_misc_group()
 
     for (i = 0; i < MPP_BUFFER_MODE_BUTT; i++)
         for (j = 0; j < MPP_BUFFER_TYPE_BUTT; j++) {
-            if (misc[i][j])
+            if (misc[i][j]) {
+                AutoMutex auto_lock(misc[i][j]->buf_lock);
                 mpp_buffer_group_dump(misc[i][j], __FUNCTION__);
+            }
         }
 }
 
@@ -21,11 +21,18 @@
 #include "mpp_log.h"
 #include "mpp_mem.h"
 #include "mpp_common.h"
+#include "mpp_mem_pool.h"
 #include "mpp_frame_impl.h"
 #include "mpp_meta_impl.h"
 
 static const char *module_name = MODULE_TAG;
 
+static MppMemPool get_frame_pool()
+{
+    static MppMemPool pool = mpp_mem_pool_init(sizeof(MppFrameImpl));
+    return pool;
+}
+
 static void setup_mpp_frame_name(MppFrameImpl *frame)
 {
     frame->name = module_name;
@@ -48,7 +55,7 @@ MPP_RET mpp_frame_init(MppFrame *frame)
         return MPP_ERR_NULL_PTR;
     }
 
-    MppFrameImpl *p = mpp_calloc(MppFrameImpl, 1);
+    MppFrameImpl *p = (MppFrameImpl *)mpp_mem_pool_get(get_frame_pool());
     if (NULL == p) {
         mpp_err_f("malloc failed\n");
         return MPP_ERR_NULL_PTR;
@@ -74,11 +81,16 @@ MPP_RET mpp_frame_deinit(MppFrame *frame)
     if (p->meta)
         mpp_meta_put(p->meta);
 
-    mpp_free(*frame);
+    mpp_mem_pool_put(get_frame_pool(), p);
     *frame = NULL;
     return MPP_OK;
 }
 
+MPP_RET mpp_frame_pool_info(MppMemPoolInfo *info)
+{
+    return mpp_mem_pool_info(get_frame_pool(), info);
+}
+
 MppFrame mpp_frame_get_next(MppFrame frame)
 {
     if (check_is_mpp_frame(frame))
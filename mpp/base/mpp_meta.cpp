@@ -20,41 +20,57 @@
 
 #include "mpp_mem.h"
 #include "mpp_list.h"
+#include "mpp_mem_pool.h"
+#include "mpp_atomic.h"
 
 #include "mpp_meta_impl.h"
 
-static MppMetaDef meta_defs[] = {
-    /* categorized by type */
-    /* data flow type */
-    {   KEY_INPUT_FRAME,        TYPE_FRAME,     },
-    {   KEY_OUTPUT_FRAME,       TYPE_FRAME,     },
-    {   KEY_INPUT_PACKET,       TYPE_PACKET,    },
-    {   KEY_OUTPUT_PACKET,      TYPE_PACKET,    },
-    /* buffer for motion detection */
-    {   KEY_MOTION_INFO,        TYPE_BUFFER,    },
-    /* buffer storing the HDR information for current frame*/
-    {   KEY_HDR_INFO,           TYPE_BUFFER,    },
-
-    {   KEY_OUTPUT_INTRA,       TYPE_S32,       },
-    {   KEY_INPUT_BLOCK,        TYPE_S32,       },
-    {   KEY_OUTPUT_BLOCK,       TYPE_S32,       },
-
-    /* extra information for tsvc */
-    {   KEY_TEMPORAL_ID,        TYPE_S32,       },
-    {   KEY_LONG_REF_IDX,       TYPE_S32,       },
-
-    {   KEY_ROI_DATA,           TYPE_PTR,       },
-    {   KEY_OSD_DATA,           TYPE_PTR,       },
-    {   KEY_USER_DATA,          TYPE_PTR,       },
-    {   KEY_USER_DATAS,         TYPE_PTR,       },
-    {   KEY_MV_LIST,            TYPE_PTR,       },
-
-    {   KEY_ENC_MARK_LTR,       TYPE_S32,       },
-    {   KEY_ENC_USE_LTR,        TYPE_S32,       },
-    {   KEY_ENC_FRAME_QP,       TYPE_S32,       },
-    {   KEY_ENC_BASE_LAYER_PID, TYPE_S32,       },
+typedef struct MppMetaDef_t {
+    MppMetaKey          key;
+    MppMetaType         type;
+} MppMetaDef;
+
+#define EXPAND_AS_META_DEF(key, type)   { key, type, },
+#define EXPAND_AS_META_CASE(key, type)  case key : return META_IDX_##key;
+
+static const MppMetaDef meta_defs[] = {
+    META_ENTRY_TABLE(EXPAND_AS_META_DEF)
 };
 
+/* presence bitmask of MppMetaImpl can only hold 32 keys */
+typedef char meta_key_count_check[(META_IDX_BUTT <= 32) ? 1 : -1];
+
+static inline RK_S32 meta_key_to_index(MppMetaKey key)
+{
+    switch (key) {
+        META_ENTRY_TABLE(EXPAND_AS_META_CASE)
+    default : {
+    } break;
+    }
+
+    return -1;
+}
+
+/*
+ * get_index_of_key does two things:
+ * 1. Map the key to its fixed value index
+ * 2. Check the key / type pair is correct or not.
+ *    If failed on check return negative value
+ */
+static inline RK_S32 get_index_of_key(MppMetaKey key, MppMetaType type)
+{
+    RK_S32 index = meta_key_to_index(key);
+
+    if (index < 0 || meta_defs[index].type != type)
+        return -1;
+
+    return index;
+}
+
+/*
+ * MppMetaService only tracks the meta alive for leak check.
+ * The key-value access on meta is lock free and has no allocation.
+ */
 class MppMetaService
 {
 private:
@@ -65,11 +81,10 @@ private:
     MppMetaService &operator=(const MppMetaService &);
 
     struct list_head    mlist_meta;
-    struct list_head    mlist_node;
+    MppMemPool          mpool;
 
     RK_U32              meta_id;
     RK_U32              meta_count;
-    RK_U32              node_count;
     RK_U32              finished;
 
 public:
@@ -82,32 +97,19 @@ public:
         return &lock;
     }
 
-    /*
-     * get_index_of_key does two things:
-     * 1. Check the key / type pair is correct or not.
-     *    If failed on check return negative value
-     * 2. Compare all exsisting meta data defines to find the non-negative index
-     */
-    RK_S32 get_index_of_key(MppMetaKey key, MppMetaType type);
-
     MppMetaImpl  *get_meta(const char *tag, const char *caller);
     void          put_meta(MppMetaImpl *meta);
-    void          inc_ref(MppMetaImpl *meta);
-
-    MppMetaNode  *get_node(MppMetaImpl *meta, RK_S32 index);
-    void          put_node(MppMetaNode *node);
-    MppMetaNode  *find_node(MppMetaImpl *meta, RK_S32 index);
-    MppMetaNode  *next_node(MppMetaImpl *meta);
+    MppMemPool    get_pool() { return mpool; };
 };
 
 MppMetaService::MppMetaService()
-    : meta_id(0),
+    : mpool(NULL),
+      meta_id(0),
       meta_count(0),
-      node_count(0),
       finished(0)
 {
     INIT_LIST_HEAD(&mlist_meta);
-    INIT_LIST_HEAD(&mlist_node);
+    mpool = mpp_mem_pool_init(sizeof(MppMetaImpl));
 }
 
 MppMetaService::~MppMetaService()
@@ -122,43 +124,24 @@ MppMetaService::~MppMetaService()
         }
     }
 
-    if (!list_empty(&mlist_node)) {
-        MppMetaNode *pos, *n;
-
-        mpp_log_f("cleaning leaked metadata key-value node\n");
-
-        list_for_each_entry_safe(pos, n, &mlist_node, MppMetaNode, list_node) {
-            put_node(pos);
-        }
-    }
+    /*
+     * NOTE: keep the pool like frame and packet pool. It may still be used
+     * by other static object destructor and mpp_meta_pool_info.
+     */
     finished = 1;
 }
 
-RK_S32 MppMetaService::get_index_of_key(MppMetaKey key, MppMetaType type)
-{
-    RK_S32 i = 0;
-    RK_S32 num = MPP_ARRAY_ELEMS(meta_defs);
-
-    for (i = 0; i < num; i++) {
-        if ((meta_defs[i].key == key) && (meta_defs[i].type == type))
-            break;
-    }
-
-    return (i < num) ? (i) : (-1);
-}
-
 MppMetaImpl *MppMetaService::get_meta(const char *tag, const char *caller)
 {
-    MppMetaImpl *impl = mpp_malloc(MppMetaImpl, 1);
+    MppMetaImpl *impl = (MppMetaImpl *)mpp_mem_pool_get(mpool);
     if (impl) {
         const char *tag_src = (tag) ? (tag) : (MODULE_TAG);
         strncpy(impl->tag, tag_src, sizeof(impl->tag));
         impl->caller = caller;
         impl->meta_id = meta_id++;
         INIT_LIST_HEAD(&impl->list_meta);
-        INIT_LIST_HEAD(&impl->list_node);
         impl->ref_count = 1;
-        impl->node_count = 0;
+        impl->node_mask = 0;
 
         list_add_tail(&impl->list_meta, &mlist_meta);
         meta_count++;
@@ -173,107 +156,10 @@ void MppMetaService::put_meta(MppMetaImpl *meta)
     if (finished)
         return ;
 
-    mpp_assert(meta->ref_count);
-    if (meta->ref_count)
-        meta->ref_count--;
-
-    if (meta->ref_count)
-        return;
-
-    while (!list_empty(&meta->list_node)) {
-        MppMetaNode *node = list_entry(meta->list_node.next, MppMetaNode, list_meta);
-        put_node(node);
-    }
-    mpp_assert(meta->node_count == 0);
+    // TODO: may be we need to release MppFrame / MppPacket / MppBuffer here
     list_del_init(&meta->list_meta);
     meta_count--;
-    mpp_free(meta);
-}
-
-void MppMetaService::inc_ref(MppMetaImpl *meta)
-{
-    mpp_assert(meta->ref_count);
-    meta->ref_count++;
-}
-
-MppMetaNode *MppMetaService::find_node(MppMetaImpl *meta, RK_S32 type_id)
-{
-    MppMetaNode *node = NULL;
-    if (meta->node_count) {
-        MppMetaNode *n, *pos;
-
-        list_for_each_entry_safe(pos, n, &meta->list_node, MppMetaNode, list_meta) {
-            if (pos->type_id == type_id) {
-                node = pos;
-                break;
-            }
-        }
-    }
-    return node;
-}
-
-MppMetaNode *MppMetaService::next_node(MppMetaImpl *meta)
-{
-    MppMetaNode *node = NULL;
-    if (meta->node_count) {
-        node = list_entry(meta->list_node.next, MppMetaNode, list_meta);
-
-        list_del_init(&node->list_meta);
-        list_del_init(&node->list_node);
-        meta->node_count--;
-        node_count--;
-    }
-    return node;
-}
-
-MppMetaNode *MppMetaService::get_node(MppMetaImpl *meta, RK_S32 type_id)
-{
-    MppMetaNode *node = find_node(meta, type_id);
-
-    if (NULL == node) {
-        node = mpp_malloc(MppMetaNode, 1);
-        if (node) {
-            INIT_LIST_HEAD(&node->list_meta);
-            INIT_LIST_HEAD(&node->list_node);
-            node->meta = meta;
-            node->node_id = meta->meta_id++;
-            node->type_id = type_id;
-            memset(&node->val, 0, sizeof(node->val));
-
-            meta->node_count++;
-            list_add_tail(&node->list_meta, &meta->list_node);
-            list_add_tail(&node->list_node, &mlist_node);
-            node_count++;
-        } else {
-            mpp_err_f("failed to malloc meta data node\n");
-        }
-    }
-
-    return node;
-}
-
-void MppMetaService::put_node(MppMetaNode *node)
-{
-    MppMetaImpl *meta = node->meta;
-    list_del_init(&node->list_meta);
-    list_del_init(&node->list_node);
-    meta->node_count--;
-    node_count--;
-    // TODO: may be we need to release MppFrame / MppPacket / MppBuffer here
-    switch (meta_defs[node->type_id].type) {
-    case TYPE_FRAME : {
-        // mpp_frame_deinit(&node->val.frame);
-    } break;
-    case TYPE_PACKET : {
-        // mpp_packet_deinit(&node->val.packet);
-    } break;
-    case TYPE_BUFFER : {
-        //mpp_buffer_put(node->val.buffer);
-    } break;
-    default : {
-    } break;
-    }
-    mpp_free(node);
+    mpp_mem_pool_put(mpool, meta);
 }
 
 MPP_RET mpp_meta_get_with_tag(MppMeta *meta, const char *tag, const char *caller)
@@ -297,9 +183,15 @@ MPP_RET mpp_meta_put(MppMeta meta)
         return MPP_ERR_NULL_PTR;
     }
 
+    MppMetaImpl *impl = (MppMetaImpl *)meta;
+    RK_S32 ref_count = MPP_SUB_FETCH(&impl->ref_count, 1);
+
+    mpp_assert(ref_count >= 0);
+    if (ref_count)
+        return MPP_OK;
+
     MppMetaService *service = MppMetaService::get_instance();
     AutoMutex auto_lock(service->get_lock());
-    MppMetaImpl *impl = (MppMetaImpl *)meta;
     service->put_meta(impl);
     return MPP_OK;
 }
@@ -311,10 +203,11 @@ MPP_RET mpp_meta_inc_ref(MppMeta meta)
         return MPP_ERR_NULL_PTR;
     }
 
-    MppMetaService *service = MppMetaService::get_instance();
-    AutoMutex auto_lock(service->get_lock());
     MppMetaImpl *impl = (MppMetaImpl *)meta;
-    service->inc_ref(impl);
+    RK_S32 ref_count = MPP_FETCH_ADD(&impl->ref_count, 1);
+
+    mpp_assert(ref_count);
+    (void)ref_count;
     return MPP_OK;
 }
 
@@ -327,57 +220,70 @@ RK_S32 mpp_meta_size(MppMeta meta)
 
     MppMetaImpl *impl = (MppMetaImpl *)meta;
 
-    return impl->node_count;
+    return __builtin_popcount(MPP_LOAD_ACQUIRE(&impl->node_mask));
 }
 
-MppMetaNode *mpp_meta_next_node(MppMeta meta)
+MPP_RET mpp_meta_pool_info(MppMemPoolInfo *info)
+{
+    MppMetaService *service = MppMetaService::get_instance();
+
+    return mpp_mem_pool_info(service->get_pool(), info);
+}
+
+void mpp_meta_dump(MppMeta meta)
 {
     if (NULL == meta) {
         mpp_err_f("found NULL input\n");
-        return NULL;
+        return;
     }
 
     MppMetaImpl *impl = (MppMetaImpl *)meta;
-    MppMetaService *service = MppMetaService::get_instance();
-    AutoMutex auto_lock(service->get_lock());
-    MppMetaNode *node = service->next_node(impl);
+    RK_U32 mask = MPP_LOAD_ACQUIRE(&impl->node_mask);
+    RK_S32 i;
+
+    mpp_log("meta %p id %d tag %s caller %s size %d\n", impl, impl->meta_id,
+            impl->tag, impl->caller, __builtin_popcount(mask));
 
-    return node;
+    for (i = 0; i < META_IDX_BUTT; i++) {
+        if (mask & (1U << i))
+            mpp_log("meta %p key %08x type %08x val %p\n", impl,
+                    meta_defs[i].key, meta_defs[i].type, impl->vals[i].val_ptr);
+    }
 }
 
+/*
+ * NOTE: one key should not be set and get from different threads at the same
+ *       time. The value is written before the presence bit is set and the bit
+ *       is cleared before the value is taken by get.
+ */
 static MPP_RET set_val_by_key(MppMetaImpl *meta, MppMetaKey key, MppMetaType type, MppMetaVal *val)
 {
-    MPP_RET ret = MPP_NOK;
-    MppMetaService *service = MppMetaService::get_instance();
-    AutoMutex auto_lock(service->get_lock());
-    RK_S32 index = service->get_index_of_key(key, type);
+    RK_S32 index = get_index_of_key(key, type);
     if (index < 0)
-        return ret;
+        return MPP_NOK;
 
-    MppMetaNode *node = service->get_node(meta, index);
-    if (node) {
-        node->val = *val;
-        ret = MPP_OK;
-    }
-    return ret;
+    meta->vals[index] = *val;
+    MPP_FETCH_OR(&meta->node_mask, 1U << index);
+    return MPP_OK;
 }
 
 static MPP_RET get_val_by_key(MppMetaImpl *meta, MppMetaKey key, MppMetaType type, MppMetaVal *val)
 {
-    MPP_RET ret = MPP_NOK;
-    MppMetaService *service = MppMetaService::get_instance();
-    AutoMutex auto_lock(service->get_lock());
-    RK_S32 index = service->get_index_of_key(key, type);
+    RK_S32 index = get_index_of_key(key, type);
+    RK_U32 bit;
+
     if (index < 0)
-        return ret;
+        return MPP_NOK;
 
-    MppMetaNode *node = service->find_node(meta, index);
-    if (node) {
-        *val = node->val;
-        service->put_node(node);
-        ret = MPP_OK;
-    }
-    return ret;
+    bit = 1U << index;
+    if (!(MPP_LOAD_ACQUIRE(&meta->node_mask) & bit))
+        return MPP_NOK;
+
+    if (!(MPP_FETCH_AND(&meta->node_mask, ~bit) & bit))
+        return MPP_NOK;
+
+    *val = meta->vals[index];
+    return MPP_OK;
 }
 
 MPP_RET mpp_meta_set_s32(MppMeta meta, MppMetaKey key, RK_S32 val)
@@ -20,11 +20,18 @@
 
 #include "mpp_log.h"
 #include "mpp_mem.h"
+#include "mpp_mem_pool.h"
 #include "mpp_packet_impl.h"
 #include "mpp_meta_impl.h"
 
 static const char *module_name = MODULE_TAG;
 
+static MppMemPool get_packet_pool()
+{
+    static MppMemPool pool = mpp_mem_pool_init(sizeof(MppPacketImpl));
+    return pool;
+}
+
 #define setup_mpp_packet_name(packet) \
     ((MppPacketImpl*)packet)->name = module_name;
 
@@ -45,7 +52,7 @@ MPP_RET mpp_packet_new(MppPacket *packet)
         return MPP_ERR_NULL_PTR;
     }
 
-    MppPacketImpl *p = mpp_calloc(MppPacketImpl, 1);
+    MppPacketImpl *p = (MppPacketImpl *)mpp_mem_pool_get(get_packet_pool());
     *packet = p;
     if (NULL == p) {
         mpp_err_f("malloc failed\n");
@@ -174,11 +181,16 @@ MPP_RET mpp_packet_deinit(MppPacket *packet)
     if (p->meta)
         mpp_meta_put(p->meta);
 
-    mpp_free(p);
+    mpp_mem_pool_put(get_packet_pool(), p);
     *packet = NULL;
     return MPP_OK;
 }
 
+MPP_RET mpp_packet_pool_info(MppMemPoolInfo *info)
+{
+    return mpp_mem_pool_info(get_packet_pool(), info);
+}
+
 void mpp_packet_set_pos(MppPacket packet, void *pos)
 {
     if (check_is_mpp_packet(packet))
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_startcode"
+
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define STARTCODE_SSE2
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define STARTCODE_NEON
+#endif
+
+#include "mpp_startcode.h"
+
+#define HAS_ZERO_BYTE(x)    (((x) - 0x0101010101010101ULL) & ~(x) & 0x8080808080808080ULL)
+
+/*
+ * scalar search on start position in [start, size - 3]
+ * The third byte of the window decides the step. When it is larger than one
+ * no start code can begin on any of the three positions.
+ */
+static RK_S32 find_startcode_c(const RK_U8 *buf, RK_S32 start, RK_S32 size)
+{
+    RK_S32 i = start;
+
+    while (i + 2 < size) {
+        RK_U8 c = buf[i + 2];
+
+        if (c > 1) {
+            i += 3;
+        } else if (c == 0) {
+            i++;
+        } else {
+            if (!buf[i] && !buf[i + 1])
+                return i;
+
+            i += 3;
+        }
+    }
+
+    return -1;
+}
+
+#if defined(STARTCODE_NEON)
+/* 4 bits mask per byte from the compare result */
+static RK_U64 neon_cmp_mask(uint8x16_t cmp)
+{
+    uint8x8_t res = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+
+    return vget_lane_u64(vreinterpret_u64_u8(res), 0);
+}
+#endif
+
+RK_S32 mpp_find_startcode(const RK_U8 *buf, RK_S32 size)
+{
+    RK_S32 i = 0;
+
+    if (NULL == buf || size < 3)
+        return -1;
+
+#if defined(STARTCODE_SSE2)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi8(1);
+
+        /* check 16 start positions with the two following bytes */
+        while (i + 18 <= size) {
+            __m128i v0 = _mm_loadu_si128((const __m128i *)(buf + i));
+            RK_U32 m = _mm_movemask_epi8(_mm_cmpeq_epi8(v0, zero));
+
+            if (m) {
+                __m128i v1 = _mm_loadu_si128((const __m128i *)(buf + i + 1));
+                __m128i v2 = _mm_loadu_si128((const __m128i *)(buf + i + 2));
+
+                m &= _mm_movemask_epi8(_mm_cmpeq_epi8(v1, zero));
+                m &= _mm_movemask_epi8(_mm_cmpeq_epi8(v2, one));
+                if (m)
+                    return i + __builtin_ctz(m);
+            }
+            i += 16;
+        }
+    }
+#elif defined(STARTCODE_NEON)
+    {
+        const uint8x16_t zero = vdupq_n_u8(0);
+        const uint8x16_t one = vdupq_n_u8(1);
+
+        while (i + 18 <= size) {
+            RK_U64 m = neon_cmp_mask(vceqq_u8(vld1q_u8(buf + i), zero));
+
+            if (m) {
+                m &= neon_cmp_mask(vceqq_u8(vld1q_u8(buf + i + 1), zero));
+                m &= neon_cmp_mask(vceqq_u8(vld1q_u8(buf + i + 2), one));
+                if (m)
+                    return i + (__builtin_ctzll(m) >> 2);
+            }
+            i += 16;
+        }
+    }
+#endif
+
+    /* word-at-a-time: start code can only begin on a zero byte */
+    while (i + 10 <= size) {
+        RK_U64 word;
+
+        memcpy(&word, buf + i, sizeof(word));
+        if (HAS_ZERO_BYTE(word)) {
+            RK_S32 pos = find_startcode_c(buf, i, i + 10);
+
+            if (pos >= 0)
+                return pos;
+        }
+        i += 8;
+    }
+
+    return find_startcode_c(buf, i, size);
+}
+
+RK_S32 mpp_find_startcode_end(const RK_U8 *buf, RK_S32 size, RK_U32 prev)
+{
+    RK_S32 pos;
+
+    if (NULL == buf || size <= 0)
+        return -1;
+
+    /* start code across the previous bytes */
+    if (!(prev & 0xFFFF) && buf[0] == 1)
+        return 0;
+
+    if (size > 1 && !(prev & 0xFF) && !buf[0] && buf[1] == 1)
+        return 1;
+
+    pos = mpp_find_startcode(buf, size);
+
+    return (pos < 0) ? -1 : pos + 2;
+}
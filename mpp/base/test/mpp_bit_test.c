@@ -19,10 +19,20 @@
 #include <stdlib.h>
 
 #include "mpp_log.h"
+#include "mpp_mem.h"
+#include "mpp_time.h"
 #include "mpp_common.h"
 #include "mpp_bitwrite.h"
+#include "mpp_bitread.h"
+
+/* both readers are used here so call the functions directly */
+#define MPP_BITCACHE_NO_MACRO
+#include "mpp_bitcache.h"
 
 #define BIT_WRITER_BUFFER_SIZE  1024
+#define BIT_READ_BUFFER_SIZE    (SZ_1M)
+#define BIT_READ_OPS_COUNT      (200000)
+#define BIT_READ_LOOP_COUNT     (10)
 
 /*
  * type is for operation type
@@ -80,6 +90,312 @@ void proc_bit_ops(MppWriteCtx *writer, BitOps *ops)
     }
 }
 
+/*
+ * reader check and benchmark
+ * random bits / ue / se with many zero values are written with emulation
+ * prevention then read back by BitReadCtx_t and BitCacheCtx_t.
+ */
+typedef enum BitReadOpsType_e {
+    BIT_READ_BITS,
+    BIT_READ_LONG,
+    BIT_READ_UE,
+    BIT_READ_SE,
+    BIT_READ_BUTT,
+} BitReadOpsType;
+
+typedef struct BitReadOps_t {
+    BitReadOpsType  type;
+    RK_S32          val;
+    RK_S32          len;
+} BitReadOps;
+
+static RK_S32 gen_read_ops(BitReadOps *ops, RK_S32 count, RK_U8 *buf, RK_S32 size)
+{
+    MppWriteCtx writer;
+    RK_S32 i;
+
+    mpp_writer_init(&writer, buf, size);
+
+    for (i = 0; i < count; i++) {
+        BitReadOps *op = &ops[i];
+        RK_S32 zero = !(rand() & 7);
+
+        op->type = (BitReadOpsType)(rand() % BIT_READ_BUTT);
+        switch (op->type) {
+        case BIT_READ_BITS : {
+            op->len = 1 + rand() % 24;
+            op->val = zero ? 0 : rand() & ((1 << op->len) - 1);
+            mpp_writer_put_bits(&writer, op->val, op->len);
+        } break;
+        case BIT_READ_LONG : {
+            op->len = 32;
+            op->val = zero ? 0 : (RK_S32)((RK_U32)rand() << 16 ^ rand());
+            mpp_writer_put_bits(&writer, (RK_U32)op->val >> 16, 16);
+            mpp_writer_put_bits(&writer, op->val & 0xffff, 16);
+        } break;
+        case BIT_READ_UE : {
+            op->val = zero ? 0 : rand() & ((1 << (rand() % 20)) - 1);
+            mpp_writer_put_ue(&writer, op->val);
+        } break;
+        case BIT_READ_SE : {
+            op->val = zero ? 0 : (rand() & 0xfff) - 0x800;
+            mpp_writer_put_se(&writer, op->val);
+        } break;
+        default : {
+        } break;
+        }
+    }
+    mpp_writer_trailing(&writer);
+
+    mpp_log("read ops %d stream %d bytes emulation %d\n",
+            count, writer.byte_cnt, writer.emul_cnt);
+
+    return writer.byte_cnt;
+}
+
+static MPP_RET check_bitread(BitReadOps *ops, RK_S32 count, RK_U8 *buf, RK_S32 size)
+{
+    BitReadCtx_t ctx;
+    RK_S32 i;
+
+    mpp_set_bitread_ctx(&ctx, buf, size);
+    mpp_set_pre_detection(&ctx);
+
+    for (i = 0; i < count; i++) {
+        BitReadOps *op = &ops[i];
+        RK_S32 val = 0;
+        MPP_RET ret = MPP_NOK;
+
+        switch (op->type) {
+        case BIT_READ_BITS : {
+            ret = mpp_read_bits(&ctx, op->len, &val);
+        } break;
+        case BIT_READ_LONG : {
+            ret = mpp_read_longbits(&ctx, op->len, (RK_U32 *)&val);
+        } break;
+        case BIT_READ_UE : {
+            ret = mpp_read_ue(&ctx, (RK_U32 *)&val);
+        } break;
+        case BIT_READ_SE : {
+            ret = mpp_read_se(&ctx, &val);
+        } break;
+        default : {
+        } break;
+        }
+
+        if (ret || val != op->val) {
+            mpp_err("bitread op %d type %d ret %d val %d expect %d\n",
+                    i, op->type, ret, val, op->val);
+            return MPP_NOK;
+        }
+    }
+
+    return mpp_has_more_rbsp_data(&ctx) ? MPP_NOK : MPP_OK;
+}
+
+static MPP_RET check_bitcache(BitReadOps *ops, RK_S32 count, RK_U8 *buf, RK_S32 size)
+{
+    BitCacheCtx_t ctx;
+    RK_S32 i;
+
+    mpp_bitcache_init(&ctx, buf, size);
+    mpp_bitcache_set_pre_detection(&ctx);
+
+    for (i = 0; i < count; i++) {
+        BitReadOps *op = &ops[i];
+        RK_S32 val = 0;
+        MPP_RET ret = MPP_NOK;
+
+        switch (op->type) {
+        case BIT_READ_BITS : {
+            ret = mpp_bitcache_read_bits(&ctx, op->len, &val);
+        } break;
+        case BIT_READ_LONG : {
+            ret = mpp_bitcache_read_longbits(&ctx, op->len, (RK_U32 *)&val);
+        } break;
+        case BIT_READ_UE : {
+            ret = mpp_bitcache_read_ue(&ctx, (RK_U32 *)&val);
+        } break;
+        case BIT_READ_SE : {
+            ret = mpp_bitcache_read_se(&ctx, &val);
+        } break;
+        default : {
+        } break;
+        }
+
+        if (ret || val != op->val) {
+            mpp_err("bitcache op %d type %d ret %d val %d expect %d\n",
+                    i, op->type, ret, val, op->val);
+            return MPP_NOK;
+        }
+    }
+
+    return mpp_bitcache_has_more_rbsp_data(&ctx) ? MPP_NOK : MPP_OK;
+}
+
+/* compare position, rbsp data check and align after each op */
+static MPP_RET check_bitcache_align(BitReadOps *ops, RK_S32 count, RK_U8 *buf, RK_S32 size)
+{
+    RK_S32 i;
+
+    for (i = 0; i < count; i++) {
+        BitReadCtx_t ref;
+        BitReadCtx_t ref_tmp;
+        BitCacheCtx_t ctx;
+        BitCacheCtx_t ctx_tmp;
+        RK_S32 j;
+
+        mpp_set_bitread_ctx(&ref, buf, size);
+        mpp_set_pre_detection(&ref);
+        mpp_bitcache_init(&ctx, buf, size);
+        mpp_bitcache_set_pre_detection(&ctx);
+
+        for (j = 0; j < i; j++) {
+            RK_U32 val;
+
+            if (ops[j].type == BIT_READ_UE || ops[j].type == BIT_READ_SE) {
+                mpp_read_ue(&ref, &val);
+                mpp_bitcache_read_ue(&ctx, &val);
+            } else {
+                mpp_skip_bits(&ref, ops[j].len);
+                mpp_bitcache_skip_bits(&ctx, ops[j].len);
+            }
+        }
+
+        /* rbsp data check on copy for it loads next byte in BitReadCtx_t */
+        ref_tmp = ref;
+        ctx_tmp = ctx;
+
+        if (ref.used_bits != ctx.used_bits ||
+            mpp_has_more_rbsp_data(&ref_tmp) != mpp_bitcache_has_more_rbsp_data(&ctx_tmp) ||
+            mpp_align_get_bits(&ref) != mpp_bitcache_align_get_bits(&ctx)) {
+            mpp_err("bitcache position mismatch on op %d\n", i);
+            return MPP_NOK;
+        }
+    }
+
+    return MPP_OK;
+}
+
+/* rbsp trailing check when the stop byte is the only byte after the cache */
+static MPP_RET check_bitcache_tail(void)
+{
+    RK_U8 data[24];
+    RK_S32 len;
+    RK_S32 pad;
+    RK_S32 pos;
+
+    for (len = 1; len <= 20; len++) {
+        for (pad = 0; pad < 3; pad++) {
+            RK_S32 size = len + pad;
+
+            for (pos = 0; pos < size; pos++)
+                data[pos] = (pos < len - 1) ? (RK_U8)(pos + 1) : (pos == len - 1) ? 0x80 : 0;
+
+            for (pos = 0; pos < len; pos++) {
+                BitReadCtx_t ref;
+                BitCacheCtx_t ctx;
+                RK_S32 bits = pos * 8;
+                RK_U32 val;
+
+                mpp_set_bitread_ctx(&ref, data, size);
+                mpp_set_pre_detection(&ref);
+                mpp_bitcache_init(&ctx, data, size);
+                mpp_bitcache_set_pre_detection(&ctx);
+
+                /* long reads to empty the cache on byte boundary */
+                for (; bits >= 32; bits -= 32) {
+                    mpp_read_longbits(&ref, 32, &val);
+                    mpp_bitcache_read_longbits(&ctx, 32, &val);
+                }
+                if (bits) {
+                    mpp_read_longbits(&ref, bits, &val);
+                    mpp_bitcache_read_longbits(&ctx, bits, &val);
+                }
+
+                if (mpp_has_more_rbsp_data(&ref) != mpp_bitcache_has_more_rbsp_data(&ctx)) {
+                    mpp_err("bitcache rbsp tail mismatch len %d pad %d pos %d\n",
+                            len, pad, pos);
+                    return MPP_NOK;
+                }
+            }
+        }
+    }
+
+    return MPP_OK;
+}
+
+static MPP_RET bench_bitread(BitReadOps *ops, RK_S32 count, RK_U8 *buf, RK_S32 size)
+{
+    RK_S64 time_ref;
+    RK_S64 time_opt;
+    RK_S32 i;
+
+    time_ref = mpp_time();
+    for (i = 0; i < BIT_READ_LOOP_COUNT; i++) {
+        if (check_bitread(ops, count, buf, size))
+            return MPP_NOK;
+    }
+    time_ref = mpp_time() - time_ref;
+
+    time_opt = mpp_time();
+    for (i = 0; i < BIT_READ_LOOP_COUNT; i++) {
+        if (check_bitcache(ops, count, buf, size))
+            return MPP_NOK;
+    }
+    time_opt = mpp_time() - time_opt;
+
+    mpp_log("bitread %.1f MB/s bitcache %.1f MB/s\n",
+            (float)size * BIT_READ_LOOP_COUNT / MPP_MAX(time_ref, 1),
+            (float)size * BIT_READ_LOOP_COUNT / MPP_MAX(time_opt, 1));
+
+    return MPP_OK;
+}
+
+static MPP_RET test_bitread(void)
+{
+    MPP_RET ret = MPP_NOK;
+    BitReadOps *ops = mpp_malloc(BitReadOps, BIT_READ_OPS_COUNT);
+    RK_U8 *buf = mpp_malloc(RK_U8, BIT_READ_BUFFER_SIZE);
+    RK_S32 size;
+
+    if (NULL == ops || NULL == buf) {
+        mpp_err("mpp_bit_test malloc failed\n");
+        goto DONE;
+    }
+
+    srand(1234);
+    size = gen_read_ops(ops, BIT_READ_OPS_COUNT, buf, BIT_READ_BUFFER_SIZE);
+
+    ret = check_bitread(ops, BIT_READ_OPS_COUNT, buf, size);
+    if (ret) {
+        mpp_err("bitread check failed\n");
+        goto DONE;
+    }
+
+    ret = check_bitcache(ops, BIT_READ_OPS_COUNT, buf, size);
+    if (ret) {
+        mpp_err("bitcache check failed\n");
+        goto DONE;
+    }
+
+    ret = check_bitcache_tail();
+    if (ret)
+        goto DONE;
+
+    /* position check is quadratic so only on the stream head */
+    ret = check_bitcache_align(ops, 400, buf, size);
+    if (ret)
+        goto DONE;
+
+    ret = bench_bitread(ops, BIT_READ_OPS_COUNT, buf, size);
+
+DONE:
+    MPP_FREE(ops);
+    MPP_FREE(buf);
+    return ret;
+}
+
 int main()
 {
     MPP_RET ret = MPP_ERR_UNKNOW;
@@ -113,7 +429,7 @@ int main()
 
     mpp_log("stream %s\n", buf);
 
-    ret = MPP_OK;
+    ret = test_bitread();
 TEST_FAILED:
     if (data)
         free(data);
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_buf_slot_test"
+
+#include <pthread.h>
+
+#include "mpp_log.h"
+#include "mpp_common.h"
+#include "mpp_buf_slot.h"
+
+#define SLOT_TEST_COUNT         40
+#define SLOT_TEST_THREADS       4
+#define SLOT_TEST_LOOP          100000
+
+static MppBufSlots slots = NULL;
+
+/* simulate decoder slot life cycle: decode -> reference -> hal -> release */
+static void *slot_worker(void *arg)
+{
+    RK_S32 i;
+
+    for (i = 0; i < SLOT_TEST_LOOP; i++) {
+        RK_S32 index = -1;
+
+        mpp_buf_slot_get_unused(slots, &index);
+        mpp_assert(index >= 0 && index < SLOT_TEST_COUNT);
+
+        mpp_buf_slot_set_flag(slots, index, SLOT_CODEC_USE);
+        mpp_buf_slot_set_flag(slots, index, SLOT_HAL_INPUT);
+        mpp_buf_slot_set_flag(slots, index, SLOT_CODEC_READY);
+        mpp_buf_slot_clr_flag(slots, index, SLOT_HAL_INPUT);
+        mpp_buf_slot_clr_flag(slots, index, SLOT_CODEC_USE);
+    }
+
+    (void)arg;
+    return NULL;
+}
+
+int main()
+{
+    pthread_t thds[SLOT_TEST_THREADS];
+    RK_S32 index[SLOT_TEST_COUNT];
+    RK_S32 i;
+    MPP_RET ret;
+
+    mpp_log("mpp_buf_slot_test start\n");
+
+    ret = mpp_buf_slot_init(&slots);
+    if (ret) {
+        mpp_err("mpp_buf_slot_init failed\n");
+        return ret;
+    }
+
+    mpp_buf_slot_setup(slots, SLOT_TEST_COUNT);
+
+    // slot should be allocated from the lowest free index
+    for (i = 0; i < SLOT_TEST_COUNT; i++) {
+        mpp_buf_slot_get_unused(slots, &index[i]);
+        if (index[i] != i) {
+            mpp_err("get unused slot %d expect %d\n", index[i], i);
+            ret = MPP_NOK;
+            goto DONE;
+        }
+    }
+
+    if (mpp_slots_get_unused_count(slots)) {
+        mpp_err("unused count %d on all slot used\n", mpp_slots_get_unused_count(slots));
+        ret = MPP_NOK;
+        goto DONE;
+    }
+
+    for (i = SLOT_TEST_COUNT - 1; i >= 0; i--) {
+        mpp_buf_slot_set_flag(slots, i, SLOT_CODEC_USE);
+        mpp_buf_slot_set_flag(slots, i, SLOT_CODEC_READY);
+        mpp_buf_slot_clr_flag(slots, i, SLOT_CODEC_USE);
+    }
+
+    if (mpp_slots_get_used_count(slots)) {
+        mpp_err("used count %d after all slot released\n", mpp_slots_get_used_count(slots));
+        ret = MPP_NOK;
+        goto DONE;
+    }
+
+    mpp_log("mpp_buf_slot_test single thread success\n");
+
+    for (i = 0; i < SLOT_TEST_THREADS; i++)
+        pthread_create(&thds[i], NULL, slot_worker, NULL);
+
+    for (i = 0; i < SLOT_TEST_THREADS; i++)
+        pthread_join(thds[i], NULL);
+
+    if (mpp_slots_get_used_count(slots)) {
+        mpp_err("used count %d after multi thread test\n", mpp_slots_get_used_count(slots));
+        ret = MPP_NOK;
+        goto DONE;
+    }
+
+    mpp_log("mpp_buf_slot_test multi thread success\n");
+
+DONE:
+    mpp_buf_slot_deinit(slots);
+    mpp_log("mpp_buf_slot_test %s\n", ret ? "failed" : "success");
+
+    return ret;
+}
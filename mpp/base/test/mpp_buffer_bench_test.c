@@ -0,0 +1,169 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_buffer_bench"
+
+#include <string.h>
+
+#include "mpp_log.h"
+#include "mpp_env.h"
+#include "mpp_time.h"
+#include "mpp_common.h"
+#include "mpp_thread.h"
+#include "mpp_buffer.h"
+
+#define BUF_BENCH_THREAD_MAX        16
+#define BUF_BENCH_LOOP_COUNT        200000
+#define BUF_BENCH_BUF_COUNT         4
+#define BUF_BENCH_BUF_SIZE          SZ_4K
+
+/*
+ * mpp_buffer contention benchmark
+ *
+ * case 0 - each thread get / put buffer on its own group
+ * case 1 - all threads inc / dec ref_count on one shared buffer
+ * case 2 - all threads get / put buffer on one shared group
+ *
+ * env mpp_buf_bench_thd sets the thread count (default 4)
+ */
+typedef struct BufBenchCtx_t {
+    RK_S32          id;
+    RK_S32          mode;
+    MppBufferGroup  group;
+    MppBuffer       shared;
+    RK_S32          error;
+} BufBenchCtx;
+
+static void *buf_bench_thread(void *arg)
+{
+    BufBenchCtx *ctx = (BufBenchCtx *)arg;
+    MppBuffer bufs[BUF_BENCH_BUF_COUNT];
+    RK_S32 i, j;
+
+    for (i = 0; i < BUF_BENCH_LOOP_COUNT; i++) {
+        if (ctx->mode == 1) {
+            mpp_buffer_inc_ref(ctx->shared);
+            mpp_buffer_put(ctx->shared);
+            continue;
+        }
+
+        for (j = 0; j < BUF_BENCH_BUF_COUNT; j++) {
+            bufs[j] = NULL;
+            if (mpp_buffer_get(ctx->group, &bufs[j], BUF_BENCH_BUF_SIZE))
+                ctx->error++;
+        }
+
+        /* simulate frame reference from decoder and display */
+        for (j = 0; j < BUF_BENCH_BUF_COUNT; j++) {
+            if (NULL == bufs[j])
+                continue;
+
+            mpp_buffer_inc_ref(bufs[j]);
+            mpp_buffer_put(bufs[j]);
+            mpp_buffer_put(bufs[j]);
+        }
+    }
+
+    return NULL;
+}
+
+static RK_S64 buf_bench_run(RK_S32 mode, RK_S32 thd_cnt)
+{
+    pthread_t thds[BUF_BENCH_THREAD_MAX];
+    BufBenchCtx ctxs[BUF_BENCH_THREAD_MAX];
+    MppBufferGroup shared_group = NULL;
+    MppBuffer shared = NULL;
+    RK_S64 time;
+    RK_S32 error = 0;
+    RK_S32 i;
+
+    memset(ctxs, 0, sizeof(ctxs));
+
+    if (mode) {
+        mpp_buffer_group_get_internal(&shared_group, MPP_BUFFER_TYPE_NORMAL);
+        mpp_buffer_get(shared_group, &shared, BUF_BENCH_BUF_SIZE);
+    }
+
+    for (i = 0; i < thd_cnt; i++) {
+        ctxs[i].id = i;
+        ctxs[i].mode = mode;
+        ctxs[i].shared = shared;
+        if (mode)
+            ctxs[i].group = shared_group;
+        else
+            mpp_buffer_group_get_internal(&ctxs[i].group, MPP_BUFFER_TYPE_NORMAL);
+    }
+
+    time = mpp_time();
+
+    for (i = 0; i < thd_cnt; i++)
+        pthread_create(&thds[i], NULL, buf_bench_thread, &ctxs[i]);
+
+    for (i = 0; i < thd_cnt; i++)
+        pthread_join(thds[i], NULL);
+
+    time = mpp_time() - time;
+
+    for (i = 0; i < thd_cnt; i++) {
+        error += ctxs[i].error;
+        if (!mode)
+            mpp_buffer_group_put(ctxs[i].group);
+    }
+
+    if (shared)
+        mpp_buffer_put(shared);
+    if (shared_group)
+        mpp_buffer_group_put(shared_group);
+
+    if (error)
+        mpp_err("case %d found %d error\n", mode, error);
+
+    return (error) ? (-1) : (time);
+}
+
+int main()
+{
+    static const char *case_name[] = {
+        "group per thread",
+        "shared buffer",
+        "shared group",
+    };
+    RK_S32 thd_cnt = 4;
+    RK_S32 ret = 0;
+    RK_S32 i;
+
+    mpp_env_get_u32("mpp_buf_bench_thd", (RK_U32 *)&thd_cnt, 4);
+    thd_cnt = MPP_CLIP3(1, BUF_BENCH_THREAD_MAX, thd_cnt);
+
+    mpp_log("mpp_buffer_bench start with %d threads %d loops\n",
+            thd_cnt, BUF_BENCH_LOOP_COUNT);
+
+    for (i = 0; i < (RK_S32)MPP_ARRAY_ELEMS(case_name); i++) {
+        RK_S64 time = buf_bench_run(i, thd_cnt);
+
+        if (time < 0) {
+            ret = -1;
+            continue;
+        }
+
+        mpp_log("case %d %-16s cost %8lld us %6lld ns per loop\n", i,
+                case_name[i], time, time * 1000 / BUF_BENCH_LOOP_COUNT);
+    }
+
+    mpp_log("mpp_buffer_bench %s\n", ret ? "failed" : "success");
+
+    return ret;
+}
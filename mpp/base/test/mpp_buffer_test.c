@@ -234,11 +234,93 @@ int main()
 
     mpp_log("mpp_buffer_test normal mode success\n");
 
+    mpp_log("mpp_buffer_test best fit with cache start\n");
+
+    /* keep all mismatch buffer and cache at most half of the buffers */
+    mpp_buffer_group_cache_config(group, (count + 1) * count * SZ_1K / 2,
+                                  (count + 1) * count * SZ_1K / 2);
+
+    for (i = 0; i < count; i++) {
+        size_t req = (count - i) * SZ_1K - SZ_1K / 2;
+
+        ret = mpp_buffer_get(group, &normal_buffer[i], req);
+        if (MPP_OK != ret || mpp_buffer_get_size(normal_buffer[i]) != req + SZ_1K / 2) {
+            mpp_err("mpp_buffer_test best fit size %d failed\n", req);
+            goto MPP_BUFFER_failed;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (normal_buffer[i]) {
+            ret = mpp_buffer_put(normal_buffer[i]);
+            if (MPP_OK != ret) {
+                mpp_err("mpp_buffer_test mpp_buffer_put best fit failed\n");
+                goto MPP_BUFFER_failed;
+            }
+            normal_buffer[i] = NULL;
+        }
+    }
+
+    mpp_log("mpp_buffer_test best fit with cache success\n");
+
     if (group) {
         mpp_buffer_group_put(group);
         group = NULL;
     }
 
+    mpp_log("mpp_buffer_test memfd import start\n");
+
+    ret = mpp_buffer_group_get_internal(&group, MPP_BUFFER_TYPE_MEMFD |
+                                        MPP_BUFFER_FLAGS_POPULATE);
+    if (MPP_OK != ret) {
+        mpp_err("mpp_buffer_test mpp_buffer_group_get memfd failed\n");
+        goto MPP_BUFFER_failed;
+    }
+
+    ret = mpp_buffer_get(group, &normal_buffer[0], size);
+    if (MPP_OK != ret) {
+        mpp_err("mpp_buffer_test mpp_buffer_get memfd failed\n");
+        goto MPP_BUFFER_failed;
+    }
+
+    memset(mpp_buffer_get_ptr(normal_buffer[0]), 0x5a, size);
+
+    /* the memfd is shared as an external dma buffer */
+    commit.type = MPP_BUFFER_TYPE_EXT_DMA;
+    commit.size = size;
+    commit.ptr  = NULL;
+    commit.hnd  = NULL;
+    commit.fd   = mpp_buffer_get_fd(normal_buffer[0]);
+    commit.index = 0;
+
+    ret = mpp_buffer_import(&normal_buffer[1], &commit);
+    if (MPP_OK != ret) {
+        mpp_err("mpp_buffer_test mpp_buffer_import memfd failed\n");
+        goto MPP_BUFFER_failed;
+    }
+
+    if (mpp_buffer_get_ptr(normal_buffer[1]) == mpp_buffer_get_ptr(normal_buffer[0]) ||
+        memcmp(mpp_buffer_get_ptr(normal_buffer[1]),
+               mpp_buffer_get_ptr(normal_buffer[0]), size)) {
+        mpp_err("mpp_buffer_test memfd import content mismatch\n");
+        ret = MPP_NOK;
+        goto MPP_BUFFER_failed;
+    }
+
+    for (i = 1; i >= 0; i--) {
+        ret = mpp_buffer_put(normal_buffer[i]);
+        if (MPP_OK != ret) {
+            mpp_err("mpp_buffer_test mpp_buffer_put memfd failed\n");
+            goto MPP_BUFFER_failed;
+        }
+        normal_buffer[i] = NULL;
+    }
+
+    mpp_buffer_group_put(group);
+    group = NULL;
+
+    mpp_log("mpp_buffer_test memfd import success\n");
+
     mpp_log("mpp_buffer_test success\n");
 
     ret = mpp_buffer_get(NULL, &legacy_buffer, MPP_BUFFER_TEST_SIZE);
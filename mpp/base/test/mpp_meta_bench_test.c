@@ -0,0 +1,255 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_meta_bench"
+
+#include <string.h>
+#include <pthread.h>
+
+#include "mpp_mem.h"
+#include "mpp_log.h"
+#include "mpp_env.h"
+#include "mpp_time.h"
+#include "mpp_common.h"
+#include "mpp_meta.h"
+
+#define META_BENCH_THREAD_MAX       16
+#define META_BENCH_LOOP_COUNT       200000
+
+/*
+ * MppMeta set / get benchmark
+ *
+ * Each thread sets and gets the keys used by encoder task per frame on its
+ * own meta. The legacy case is the previous linked list storage with one
+ * global lock and one malloc per key for comparison.
+ *
+ * env mpp_meta_bench_thd sets the thread count (default 4)
+ */
+typedef struct LegacyNode_t {
+    struct LegacyNode_t *next;
+    RK_S32              type_id;
+    void                *val;
+} LegacyNode;
+
+typedef struct LegacyMeta_t {
+    LegacyNode          *head;
+    RK_S32              node_count;
+} LegacyMeta;
+
+typedef struct LegacyDef_t {
+    MppMetaKey          key;
+    MppMetaType         type;
+} LegacyDef;
+
+static const LegacyDef legacy_defs[] = {
+    {   KEY_INPUT_FRAME,        TYPE_FRAME,     },
+    {   KEY_OUTPUT_FRAME,       TYPE_FRAME,     },
+    {   KEY_INPUT_PACKET,       TYPE_PACKET,    },
+    {   KEY_OUTPUT_PACKET,      TYPE_PACKET,    },
+    {   KEY_MOTION_INFO,        TYPE_BUFFER,    },
+    {   KEY_HDR_INFO,           TYPE_BUFFER,    },
+    {   KEY_OUTPUT_INTRA,       TYPE_S32,       },
+    {   KEY_INPUT_BLOCK,        TYPE_S32,       },
+    {   KEY_OUTPUT_BLOCK,       TYPE_S32,       },
+    {   KEY_TEMPORAL_ID,        TYPE_S32,       },
+    {   KEY_LONG_REF_IDX,       TYPE_S32,       },
+    {   KEY_ROI_DATA,           TYPE_PTR,       },
+    {   KEY_OSD_DATA,           TYPE_PTR,       },
+};
+
+static pthread_mutex_t legacy_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static RK_S32 legacy_index(MppMetaKey key, MppMetaType type)
+{
+    RK_S32 i;
+
+    for (i = 0; i < (RK_S32)MPP_ARRAY_ELEMS(legacy_defs); i++)
+        if (legacy_defs[i].key == key && legacy_defs[i].type == type)
+            return i;
+
+    return -1;
+}
+
+static MPP_RET legacy_set(LegacyMeta *meta, MppMetaKey key, MppMetaType type, void *val)
+{
+    LegacyNode *node;
+    RK_S32 index;
+
+    pthread_mutex_lock(&legacy_lock);
+    index = legacy_index(key, type);
+    for (node = meta->head; node; node = node->next)
+        if (node->type_id == index)
+            break;
+
+    if (NULL == node) {
+        node = mpp_malloc(LegacyNode, 1);
+        node->type_id = index;
+        node->next = meta->head;
+        meta->head = node;
+        meta->node_count++;
+    }
+    node->val = val;
+    pthread_mutex_unlock(&legacy_lock);
+
+    return MPP_OK;
+}
+
+static MPP_RET legacy_get(LegacyMeta *meta, MppMetaKey key, MppMetaType type, void **val)
+{
+    LegacyNode **prev;
+    MPP_RET ret = MPP_NOK;
+    RK_S32 index;
+
+    pthread_mutex_lock(&legacy_lock);
+    index = legacy_index(key, type);
+    for (prev = &meta->head; *prev; prev = &(*prev)->next) {
+        LegacyNode *node = *prev;
+
+        if (node->type_id == index) {
+            *val = node->val;
+            *prev = node->next;
+            meta->node_count--;
+            mpp_free(node);
+            ret = MPP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&legacy_lock);
+
+    return ret;
+}
+
+typedef struct MetaBenchCtx_t {
+    RK_S32          mode;
+    RK_S32          error;
+} MetaBenchCtx;
+
+static void *meta_bench_thread(void *arg)
+{
+    MetaBenchCtx *ctx = (MetaBenchCtx *)arg;
+    LegacyMeta legacy = { NULL, 0 };
+    MppMeta meta = NULL;
+    MppFrame frame = (MppFrame)ctx;
+    MppPacket packet = (MppPacket)&legacy;
+    void *roi = &frame;
+    void *osd = &packet;
+    RK_S32 i;
+
+    mpp_meta_get(&meta);
+
+    for (i = 0; i < META_BENCH_LOOP_COUNT; i++) {
+        MppFrame frm = NULL;
+        MppPacket pkt = NULL;
+        void *ptr0 = NULL;
+        void *ptr1 = NULL;
+
+        if (ctx->mode) {
+            legacy_set(&legacy, KEY_INPUT_FRAME, TYPE_FRAME, frame);
+            legacy_set(&legacy, KEY_OUTPUT_PACKET, TYPE_PACKET, packet);
+            legacy_set(&legacy, KEY_ROI_DATA, TYPE_PTR, roi);
+            legacy_set(&legacy, KEY_OSD_DATA, TYPE_PTR, osd);
+
+            legacy_get(&legacy, KEY_INPUT_FRAME, TYPE_FRAME, &frm);
+            legacy_get(&legacy, KEY_OUTPUT_PACKET, TYPE_PACKET, &pkt);
+            legacy_get(&legacy, KEY_ROI_DATA, TYPE_PTR, &ptr0);
+            legacy_get(&legacy, KEY_OSD_DATA, TYPE_PTR, &ptr1);
+        } else {
+            mpp_meta_set_frame(meta, KEY_INPUT_FRAME, frame);
+            mpp_meta_set_packet(meta, KEY_OUTPUT_PACKET, packet);
+            mpp_meta_set_ptr(meta, KEY_ROI_DATA, roi);
+            mpp_meta_set_ptr(meta, KEY_OSD_DATA, osd);
+
+            mpp_meta_get_frame(meta, KEY_INPUT_FRAME, &frm);
+            mpp_meta_get_packet(meta, KEY_OUTPUT_PACKET, &pkt);
+            mpp_meta_get_ptr(meta, KEY_ROI_DATA, &ptr0);
+            mpp_meta_get_ptr(meta, KEY_OSD_DATA, &ptr1);
+        }
+
+        if (frm != frame || pkt != packet || ptr0 != roi || ptr1 != osd)
+            ctx->error++;
+    }
+
+    if (mpp_meta_size(meta) || legacy.node_count)
+        ctx->error++;
+
+    mpp_meta_put(meta);
+
+    return NULL;
+}
+
+static RK_S64 meta_bench_run(RK_S32 mode, RK_S32 thd_cnt)
+{
+    pthread_t thds[META_BENCH_THREAD_MAX];
+    MetaBenchCtx ctxs[META_BENCH_THREAD_MAX];
+    RK_S64 time;
+    RK_S32 error = 0;
+    RK_S32 i;
+
+    memset(ctxs, 0, sizeof(ctxs));
+
+    time = mpp_time();
+
+    for (i = 0; i < thd_cnt; i++) {
+        ctxs[i].mode = mode;
+        pthread_create(&thds[i], NULL, meta_bench_thread, &ctxs[i]);
+    }
+
+    for (i = 0; i < thd_cnt; i++)
+        pthread_join(thds[i], NULL);
+
+    time = mpp_time() - time;
+
+    for (i = 0; i < thd_cnt; i++)
+        error += ctxs[i].error;
+
+    if (error)
+        mpp_err("case %d found %d error\n", mode, error);
+
+    return (error) ? (-1) : (time);
+}
+
+int main()
+{
+    static const char *case_name[] = {
+        "flat meta",
+        "legacy list",
+    };
+    RK_S32 thd_cnt = 4;
+    RK_S32 ret = 0;
+    RK_S32 i;
+
+    mpp_env_get_u32("mpp_meta_bench_thd", (RK_U32 *)&thd_cnt, 4);
+    thd_cnt = MPP_CLIP3(1, META_BENCH_THREAD_MAX, thd_cnt);
+
+    mpp_log("mpp_meta_bench start with %d threads %d loops\n",
+            thd_cnt, META_BENCH_LOOP_COUNT);
+
+    for (i = 0; i < (RK_S32)MPP_ARRAY_ELEMS(case_name); i++) {
+        RK_S64 time = meta_bench_run(i, thd_cnt);
+
+        if (time < 0) {
+            ret = -1;
+            continue;
+        }
+
+        mpp_log("case %d %-12s cost %8lld us %6lld ns per loop\n", i,
+                case_name[i], time, time * 1000 / META_BENCH_LOOP_COUNT);
+    }
+
+    mpp_log("mpp_meta_bench %s\n", ret ? "failed" : "success");
+
+    return ret;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_startcode_test"
+
+#include <stdlib.h>
+
+#include "mpp_log.h"
+#include "mpp_mem.h"
+#include "mpp_time.h"
+#include "mpp_common.h"
+#include "mpp_startcode.h"
+
+#define TEST_BUF_SIZE       (4096)
+#define TEST_LOOP_COUNT     (2000)
+#define BENCH_BUF_SIZE      (SZ_4M)
+#define BENCH_LOOP_COUNT    (20)
+
+static RK_S32 find_startcode_ref(const RK_U8 *buf, RK_S32 size)
+{
+    RK_S32 i;
+
+    for (i = 0; i + 2 < size; i++) {
+        if (!buf[i] && !buf[i + 1] && buf[i + 2] == 1)
+            return i;
+    }
+
+    return -1;
+}
+
+/* random data with zero runs and start codes on the given density */
+static void fill_random(RK_U8 *buf, RK_S32 size, RK_S32 density)
+{
+    RK_S32 i;
+
+    for (i = 0; i < size; i++) {
+        RK_S32 r = rand() % density;
+
+        if (r == 0)
+            buf[i] = 0;
+        else if (r == 1)
+            buf[i] = 1;
+        else
+            buf[i] = (RK_U8)rand();
+    }
+}
+
+static MPP_RET check_buffer(const RK_U8 *buf, RK_S32 size)
+{
+    RK_S32 start;
+
+    /* check every start offset to cover unaligned head and short tail */
+    for (start = 0; start < 40 && start < size; start++) {
+        RK_S32 len = size - start;
+        RK_S32 ref = find_startcode_ref(buf + start, len);
+        RK_S32 pos = mpp_find_startcode(buf + start, len);
+
+        if (ref != pos) {
+            mpp_err("start %d size %d mismatch ref %d pos %d\n",
+                    start, len, ref, pos);
+            return MPP_NOK;
+        }
+    }
+
+    return MPP_OK;
+}
+
+static MPP_RET check_end(void)
+{
+    const RK_U8 data0[] = { 0x01, 0x65 };
+    const RK_U8 data1[] = { 0x00, 0x01, 0x65 };
+    const RK_U8 data2[] = { 0x11, 0x00, 0x00, 0x00, 0x01 };
+
+    if (mpp_find_startcode_end(data0, sizeof(data0), 0x12340000) != 0 ||
+        mpp_find_startcode_end(data0, sizeof(data0), 0x12340100) != -1 ||
+        mpp_find_startcode_end(data1, sizeof(data1), 0x12345600) != 1 ||
+        mpp_find_startcode_end(data1, sizeof(data1), 0x12345601) != -1 ||
+        mpp_find_startcode_end(data2, sizeof(data2), 0xffffffff) != 4) {
+        mpp_err("start code end check failed\n");
+        return MPP_NOK;
+    }
+
+    return MPP_OK;
+}
+
+int main()
+{
+    MPP_RET ret = MPP_NOK;
+    RK_U8 *buf = NULL;
+    RK_S32 i;
+
+    mpp_log("mpp_startcode_test start\n");
+
+    buf = mpp_malloc(RK_U8, BENCH_BUF_SIZE);
+    if (NULL == buf) {
+        mpp_err("mpp_startcode_test malloc failed\n");
+        goto TEST_FAILED;
+    }
+
+    srand(1234);
+
+    for (i = 0; i < TEST_LOOP_COUNT; i++) {
+        RK_S32 size = rand() % TEST_BUF_SIZE;
+
+        fill_random(buf, size, 2 + (i % 64));
+        ret = check_buffer(buf, size);
+        if (ret)
+            goto TEST_FAILED;
+    }
+
+    ret = check_end();
+    if (ret)
+        goto TEST_FAILED;
+
+    /* throughput on start code free data with random zero bytes */
+    fill_random(buf, BENCH_BUF_SIZE, 256);
+    for (i = 2; i < BENCH_BUF_SIZE; i++) {
+        if (buf[i] == 1 && !buf[i - 1] && !buf[i - 2])
+            buf[i] = 2;
+    }
+
+    {
+        RK_S64 time_ref;
+        RK_S64 time_opt;
+        RK_S32 ref = 0;
+        RK_S32 pos = 0;
+
+        time_ref = mpp_time();
+        for (i = 0; i < BENCH_LOOP_COUNT; i++)
+            ref += find_startcode_ref(buf, BENCH_BUF_SIZE);
+        time_ref = mpp_time() - time_ref;
+
+        time_opt = mpp_time();
+        for (i = 0; i < BENCH_LOOP_COUNT; i++)
+            pos += mpp_find_startcode(buf, BENCH_BUF_SIZE);
+        time_opt = mpp_time() - time_opt;
+
+        if (ref != pos) {
+            mpp_err("benchmark result mismatch %d vs %d\n", ref, pos);
+            ret = MPP_NOK;
+            goto TEST_FAILED;
+        }
+
+        mpp_log("byte loop %.1f MB/s search %.1f MB/s\n",
+                (float)BENCH_BUF_SIZE * BENCH_LOOP_COUNT / MPP_MAX(time_ref, 1),
+                (float)BENCH_BUF_SIZE * BENCH_LOOP_COUNT / MPP_MAX(time_opt, 1));
+    }
+
+    MPP_FREE(buf);
+    mpp_log("mpp_startcode_test success\n");
+    return MPP_OK;
+
+TEST_FAILED:
+    MPP_FREE(buf);
+    mpp_log("mpp_startcode_test failed\n");
+    return ret;
+}
@@ -18,8 +18,10 @@
 
 #include <string.h>
 
+#include "mpp_env.h"
 #include "mpp_log.h"
 #include "mpp_mem.h"
+#include "mpp_time.h"
 #include "mpp_common.h"
 
 #include "dummy_dec_api.h"
@@ -49,6 +51,9 @@ typedef struct DummyDec_t {
     RK_U32          frame_count;
     RK_S32          prev_index;
     RK_S32          slot_index[DUMMY_DEC_REF_COUNT];
+
+    /* simulated parsing time in microsecond from dummy_dec_parse_time */
+    RK_U32          parse_time;
 } DummyDec;
 
 MPP_RET dummy_dec_init(void *dec, ParserCfg *cfg)
@@ -86,6 +91,11 @@ MPP_RET dummy_dec_init(void *dec, ParserCfg *cfg)
     for (i = 0; i < DUMMY_DEC_REF_COUNT; i++) {
         p->slot_index[i] = -1;
     }
+    mpp_env_get_u32("dummy_dec_parse_time", &p->parse_time, 0);
+
+    // NOTE: decoder checks unused frame slot before parse
+    mpp_buf_slot_setup(p->frame_slots, DUMMY_DEC_FRAME_COUNT);
+    p->slots_inited = 1;
     return MPP_OK;
 }
 
@@ -141,6 +151,7 @@ MPP_RET dummy_dec_prepare(void *dec, MppPacket pkt, HalDecTask *task)
     DummyDec *p;
     RK_U8 *data;
     size_t length;
+    MppBuffer buffer;
 
     if (NULL == dec) {
         mpp_err_f("found NULL intput\n");
@@ -160,17 +171,33 @@ MPP_RET dummy_dec_prepare(void *dec, MppPacket pkt, HalDecTask *task)
     // set pos to indicate that buffer is done
     data    = mpp_packet_get_data(pkt);
     length  = mpp_packet_get_length(pkt);
-    if (length > p->stream_size) {
-        p->stream = mpp_realloc(p->stream, RK_U8, length);
-        mpp_packet_set_data(p->task_pkt, p->stream);
-        p->stream_size = length;
-    }
-    if (p->stream) {
-        memcpy(p->stream, data, length);
+    buffer  = mpp_packet_get_buffer(pkt);
+
+    /*
+     * packet with MppBuffer is passed to task by reference then decoder can
+     * send the buffer to hardware without copy on zero copy input mode
+     */
+    if (buffer && data == mpp_buffer_get_ptr(buffer)) {
+        mpp_packet_set_data(p->task_pkt, data);
+        mpp_packet_set_size(p->task_pkt, mpp_buffer_get_size(buffer));
         mpp_packet_set_length(p->task_pkt, length);
+        mpp_packet_set_buffer(p->task_pkt, buffer);
     } else {
-        mpp_err("failed to found task buffer for hardware\n");
-        return MPP_ERR_UNKNOW;
+        mpp_packet_set_buffer(p->task_pkt, NULL);
+
+        if (length > p->stream_size) {
+            p->stream = mpp_realloc(p->stream, RK_U8, length);
+            p->stream_size = length;
+        }
+        if (p->stream) {
+            mpp_packet_set_data(p->task_pkt, p->stream);
+            mpp_packet_set_size(p->task_pkt, p->stream_size);
+            memcpy(p->stream, data, length);
+            mpp_packet_set_length(p->task_pkt, length);
+        } else {
+            mpp_err("failed to found task buffer for hardware\n");
+            return MPP_ERR_UNKNOW;
+        }
     }
     mpp_packet_set_pos(pkt, data + length);
 
@@ -284,13 +311,30 @@ MPP_RET dummy_dec_parse(void *dec, HalDecTask *task)
 
     p->frame_count = ++frame_count;
 
+    if (p->parse_time)
+        usleep(p->parse_time);
+
     return MPP_OK;
 }
 
 MPP_RET dummy_dec_callback(void *dec, void *err_info)
 {
-    (void)dec;
-    (void)err_info;
+    DummyDec *p = (DummyDec *)dec;
+    IOCallbackCtx *ctx = (IOCallbackCtx *)err_info;
+    HalDecTask *task = (HalDecTask *)ctx->task;
+    MppFrame frame = NULL;
+
+    /* only touch the frame of the task for it runs on hal thread */
+    if (NULL == task || task->output < 0)
+        return MPP_OK;
+
+    if (!ctx->hard_err && !task->flags.parse_err && !task->flags.ref_err)
+        return MPP_OK;
+
+    mpp_buf_slot_get_prop(p->frame_slots, task->output, SLOT_FRAME_PTR, &frame);
+    if (frame)
+        mpp_frame_set_errinfo(frame, MPP_FRAME_ERR_UNKNOW);
+
     return MPP_OK;
 }
 const ParserApi dummy_dec_parser = {
@@ -53,6 +53,7 @@ static MPP_RET init_input_ctx(H264dInputCtx_t *p_Inp, ParserCfg *init)
 
     p_Inp->init = *init;
     mpp_env_get_u32("rkv_h264d_mvc_disable", &p_Inp->mvc_disable, 1);
+    mpp_env_get_u32("rkv_h264d_nalu_index", &p_Inp->nalu_index, 1);
     open_stream_file(p_Inp, "/sdcard");
     if (rkv_h264d_parse_debug & H264D_DBG_WRITE_ES_EN) {
         p_Inp->spspps_size = HEAD_BUF_MAX_SIZE;
@@ -189,6 +190,7 @@ static MPP_RET free_dxva_ctx(H264dDxvaCtx_t *p_dxva)
 
     MPP_FREE(p_dxva->slice_long);
     MPP_FREE(p_dxva->bitstream);
+    MPP_FREE(p_dxva->nalu_idx);
     MPP_FREE(p_dxva->syn.buf);
 
 __RETURN:
@@ -207,8 +209,10 @@ static MPP_RET init_dxva_ctx(H264dDxvaCtx_t *p_dxva)
     p_dxva->slice_long  = mpp_calloc(DXVA_Slice_H264_Long,  p_dxva->max_slice_size);
     MEM_CHECK(ret, p_dxva->slice_long);
     p_dxva->bitstream   = mpp_malloc(RK_U8, p_dxva->max_strm_size);
+    p_dxva->idx_max     = MAX_NALU_IDX_NUM;
+    p_dxva->nalu_idx    = mpp_calloc(H264dNaluIdx_t, p_dxva->idx_max);
     p_dxva->syn.buf     = mpp_calloc(DXVA2_DecodeBufferDesc, SYNTAX_BUF_SIZE);
-    MEM_CHECK(ret, p_dxva->bitstream && p_dxva->syn.buf);
+    MEM_CHECK(ret, p_dxva->bitstream && p_dxva->nalu_idx && p_dxva->syn.buf);
 
 __RETURN:
     return ret = MPP_OK;
@@ -427,6 +431,9 @@ MPP_RET h264d_reset(void *decoder)
     p_Dec->is_parser_end  = 0;
     p_Dec->dxva_ctx->strm_offset = 0;
     p_Dec->dxva_ctx->slice_count = 0;
+    p_Dec->dxva_ctx->idx_count   = 0;
+    p_Dec->dxva_ctx->idx_base    = NULL;
+    p_Dec->p_Inp->copy_size      = 0;
     p_Dec->last_frame_slot_idx   = -1;
 
 __RETURN:
@@ -570,8 +577,19 @@ MPP_RET h264d_prepare(void *decoder, MppPacket pkt, HalDecTask *task)
         mpp_packet_set_length(p_Dec->task_pkt, MPP_ALIGN(p_Dec->dxva_ctx->strm_offset, 16));
         mpp_packet_set_size(p_Dec->task_pkt, p_Dec->dxva_ctx->max_strm_size);
         task->input_packet = p_Dec->task_pkt;
+        H264D_DBG(H264D_DBG_INPUT, "[pkt_in_timeUs] stream len=%d, parser copy=%d, nalu index=%d",
+                  p_Dec->dxva_ctx->strm_offset, p_Inp->copy_size, p_Dec->dxva_ctx->idx_count);
+        p_Inp->copy_size = 0;
     } else {
         task->input_packet = NULL;
+        //!< input packet will be released, copy the referenced slice data
+        if (p_Dec->dxva_ctx->idx_count && !mpp_packet_get_length(pkt)) {
+            RK_U32 i = 0;
+
+            for (i = 0; i < p_Dec->dxva_ctx->idx_count; i++)
+                p_Inp->copy_size += p_Dec->dxva_ctx->nalu_idx[i].length;
+            parse_fill_stream(p_Dec->dxva_ctx, p_Dec->dxva_ctx->bitstream, 0);
+        }
     }
 __RETURN:
 
@@ -581,6 +599,24 @@ __FAILED:
 }
 
 
+/*!
+***********************************************************************
+* \brief
+*   fill stream to hardware buffer with nalu index
+***********************************************************************
+*/
+MPP_RET h264d_fill_stream(void *decoder, HalDecTask *task, void *dst)
+{
+    H264_DecCtx_t *p_Dec = (H264_DecCtx_t *)decoder;
+    H264dDxvaCtx_t *dxva_ctx = p_Dec->dxva_ctx;
+
+    if (!dxva_ctx->idx_count || task->input_packet != p_Dec->task_pkt)
+        return MPP_NOK;
+
+    return parse_fill_stream(dxva_ctx, (RK_U8 *)dst,
+                             (RK_U32)mpp_packet_get_length(task->input_packet));
+}
+
 /*!
 ***********************************************************************
 * \brief
@@ -598,6 +634,8 @@ MPP_RET h264d_parse(void *decoder, HalDecTask *in_task)
     p_err->cur_err_flag  = 0;
     p_err->used_ref_flag = 0;
     p_Dec->is_parser_end = 0;
+    //!< nalu index is consumed by fill_stream before parse
+    p_Dec->dxva_ctx->idx_count = 0;
     memset(&p_Dec->p_Cur->sei, 0, sizeof(p_Dec->p_Cur->sei));
 
     ret = parse_loop(p_Dec);
@@ -690,6 +728,7 @@ const ParserApi api_h264d_parser = {
     .deinit = h264d_deinit,
     .prepare = h264d_prepare,
     .parse = h264d_parse,
+    .fill_stream = h264d_fill_stream,
     .reset = h264d_reset,
     .flush = h264d_flush,
     .control = h264d_control,
@@ -861,6 +861,17 @@ typedef struct h264_old_slice_par_t {
 #define BITSTREAM_MAX_SIZE         (2*1024*1024)
 #define BITSTREAM_ADD_SIZE         (512)
 #define SYNTAX_BUF_SIZE            (5)
+#define MAX_NALU_IDX_NUM           (20)
+#define ADD_NALU_IDX_SIZE          (16)
+
+//!< slice nalu referenced from input packet on nalu index mode
+typedef struct h264d_nalu_idx_t {
+    RK_U32    offset;      //!< offset of nalu data in input packet
+    RK_U32    length;      //!< nalu length without start code
+    RK_U32    type;
+    RK_U32    strm_pos;    //!< start code position in bitstream
+} H264dNaluIdx_t;
+
 typedef struct h264d_dxva_ctx_t {
     RK_U8                            cfgBitstrmRaw;
     struct _DXVA_PicParams_H264_MVC  pp;
@@ -871,6 +882,11 @@ typedef struct h264d_dxva_ctx_t {
     RK_U8                            *bitstream;
     RK_U32                           max_strm_size;
     RK_U32                           strm_offset;
+    //!< nalu index, slice data is not copied to bitstream
+    RK_U8                            *idx_base;
+    H264dNaluIdx_t                   *nalu_idx;
+    RK_U32                           idx_count;
+    RK_U32                           idx_max;
     struct h264d_syntax_t            syn;
     struct h264_dec_ctx_t            *p_Dec;
 } H264dDxvaCtx_t;
@@ -893,6 +909,8 @@ typedef struct h264d_input_ctx_t {
     RK_S64 in_dts;
     RK_U8  has_get_eos;
     RK_U32 mvc_disable;
+    RK_U32 nalu_index;     //!< reference slice data in input packet
+    RK_U32 copy_size;      //!< stream bytes copied in parser for one task
     //!< output data
     RK_U8  task_valid;
     RK_U32 task_eos;
@@ -22,6 +22,7 @@
 
 #include "mpp_mem.h"
 #include "mpp_packet_impl.h"
+#include "mpp_startcode.h"
 #include "hal_task.h"
 
 #include "h264d_global.h"
@@ -34,6 +35,8 @@
 #include "h264d_fill.h"
 
 #define  HEAD_SYNTAX_MAX_SIZE        (12800)
+//!< slice header window, slice data is only needed by hardware
+#define  HEAD_SLICE_MAX_SIZE         (4096)
 #define NALU_TYPE_NORMAL_LENGTH      (1)
 #define NALU_TYPE_EXT_LENGTH         (5)
 
@@ -146,6 +149,41 @@ static void find_prefix_code(RK_U8 *p_data, H264dCurStream_t *p_strm)
     }
 }
 
+/*
+ * Copy nalu payload to nalu_buf until the next start code in one memcpy
+ * The bytes after nalu header are not checked by judge_is_new_frame so they
+ * are not needed to be handled one by one.
+ */
+static MPP_RET copy_nalu_payload(H264dInputCtx_t *p_Inp, H264dCurStream_t *p_strm,
+                                 MppPacketImpl *pkt_impl)
+{
+    MPP_RET ret = MPP_ERR_UNKNOW;
+    RK_U8 *src = &p_Inp->in_buf[p_strm->nalu_offset];
+    RK_S32 end = mpp_find_startcode_end(src, (RK_S32)pkt_impl->length,
+                                        p_strm->prefixdata);
+    RK_U32 size = (end < 0) ? (RK_U32)pkt_impl->length : (RK_U32)(end + 1);
+    RK_U32 i;
+
+    if (p_strm->nalu_len + size > p_strm->nalu_max_size) {
+        RK_U32 add_size = p_strm->nalu_len + size - p_strm->nalu_max_size;
+
+        FUN_CHECK(ret = realloc_buffer(&p_strm->nalu_buf, &p_strm->nalu_max_size,
+                                       MPP_MAX(NALU_BUF_ADD_SIZE, add_size)));
+    }
+    memcpy(&p_strm->nalu_buf[p_strm->nalu_len], src, size);
+    p_strm->nalu_len += size;
+    p_strm->nalu_offset += size;
+    pkt_impl->length -= size;
+    p_strm->curdata = &src[size - 1];
+
+    for (i = (size > 4) ? (size - 4) : 0; i < size; i++)
+        p_strm->prefixdata = (p_strm->prefixdata << 8) | src[i];
+
+    return ret = MPP_OK;
+__FAILED:
+    return ret;
+}
+
 static MPP_RET parser_nalu_header(H264_SLICE_t *currSlice)
 {
     MPP_RET ret = MPP_ERR_UNKNOW;
@@ -322,10 +360,70 @@ __FAILED:
     return ret;
 }
 
+//!< return input packet data when current nalu is inside of it
+static RK_U8 *get_nalu_pkt_base(H264dInputCtx_t *p_Inp, H264dCurStream_t *p_strm)
+{
+    RK_U8 *base = NULL;
+
+    if (!p_Inp->in_pkt || !p_strm->nalu_buf)
+        return NULL;
+
+    base = (RK_U8 *)mpp_packet_get_data(p_Inp->in_pkt);
+    if (p_strm->nalu_buf < base ||
+        p_strm->nalu_buf + p_strm->nalu_len > base + mpp_packet_get_size(p_Inp->in_pkt))
+        return NULL;
+
+    return base;
+}
+
+/*
+ * Record slice nalu inside of the input packet instead of copying it
+ * The input packet is kept by mpp_dec until the stream is filled to hardware
+ * buffer. Return MPP_NOK when the nalu has to be copied.
+ */
+static MPP_RET store_nalu_idx(H264dInputCtx_t *p_Inp, H264dCurStream_t *p_strm,
+                              H264dDxvaCtx_t *dxva_ctx)
+{
+    MPP_RET ret = MPP_ERR_UNKNOW;
+    H264dNaluIdx_t *p_idx = NULL;
+    RK_U8 *base = NULL;
+
+    if (!p_Inp->nalu_index)
+        return MPP_NOK;
+
+    base = get_nalu_pkt_base(p_Inp, p_strm);
+    if (NULL == base || (dxva_ctx->idx_count && dxva_ctx->idx_base != base))
+        return MPP_NOK;
+
+    if (dxva_ctx->idx_count >= dxva_ctx->idx_max) {
+        dxva_ctx->idx_max += ADD_NALU_IDX_SIZE;
+        dxva_ctx->nalu_idx = mpp_realloc(dxva_ctx->nalu_idx, H264dNaluIdx_t,
+                                         dxva_ctx->idx_max);
+        MEM_CHECK(ret, dxva_ctx->nalu_idx);
+    }
+    p_idx = &dxva_ctx->nalu_idx[dxva_ctx->idx_count++];
+    p_idx->offset   = (RK_U32)(p_strm->nalu_buf - base);
+    p_idx->length   = p_strm->nalu_len;
+    p_idx->type     = p_strm->nalu_type;
+    p_idx->strm_pos = dxva_ctx->strm_offset;
+    dxva_ctx->idx_base = base;
+
+    return ret = MPP_OK;
+__FAILED:
+    dxva_ctx->idx_max = 0;
+    dxva_ctx->idx_count = 0;
+    return ret;
+}
+
 static MPP_RET store_cur_nalu(H264dCurCtx_t *p_Cur, H264dCurStream_t *p_strm, H264dDxvaCtx_t *dxva_ctx)
 {
     MPP_RET ret = MPP_ERR_UNKNOW;
     RK_U8 *p_des = NULL;
+    H264dInputCtx_t *p_Inp = p_Cur->p_Inp;
+
+    //!< nalu copied to nalu_buf on prepare
+    if (p_strm->nalu_buf && !get_nalu_pkt_base(p_Inp, p_strm))
+        p_Inp->copy_size += p_strm->nalu_len;
 
     //!< fill head buffer
     if (   (p_strm->nalu_type == H264_NALU_TYPE_SLICE)
@@ -337,8 +435,17 @@ static MPP_RET store_cur_nalu(H264dCurCtx_t *p_Cur, H264dCurStream_t *p_strm, H2
            || (p_strm->nalu_type == H264_NALU_TYPE_PREFIX)
            || (p_strm->nalu_type == H264_NALU_TYPE_SLC_EXT)) {
 
-        RK_U32 head_size = MPP_MIN(HEAD_SYNTAX_MAX_SIZE, p_strm->nalu_len);
-        RK_U32 add_size = head_size + sizeof(H264dNaluHead_t);
+        RK_U32 head_max = HEAD_SYNTAX_MAX_SIZE;
+        RK_U32 head_size = 0;
+        RK_U32 add_size = 0;
+
+        if (p_strm->nalu_type == H264_NALU_TYPE_SLICE
+            || p_strm->nalu_type == H264_NALU_TYPE_IDR
+            || p_strm->nalu_type == H264_NALU_TYPE_SLC_EXT)
+            head_max = HEAD_SLICE_MAX_SIZE;
+
+        head_size = MPP_MIN(head_max, p_strm->nalu_len);
+        add_size = head_size + sizeof(H264dNaluHead_t);
 
         if ((p_strm->head_offset + add_size) >= p_strm->head_max_size) {
             FUN_CHECK(ret = realloc_buffer(&p_strm->head_buf, &p_strm->head_max_size, add_size));
@@ -349,6 +456,7 @@ static MPP_RET store_cur_nalu(H264dCurCtx_t *p_Cur, H264dCurStream_t *p_strm, H2
         ((H264dNaluHead_t *)p_des)->sodb_len = head_size;
         memcpy(p_des + sizeof(H264dNaluHead_t), p_strm->nalu_buf, head_size);
         p_strm->head_offset += add_size;
+        p_Inp->copy_size += head_size;
     }    //!< fill sodb buffer
     if ((p_strm->nalu_type == H264_NALU_TYPE_SLICE)
         || (p_strm->nalu_type == H264_NALU_TYPE_IDR)) {
@@ -361,11 +469,13 @@ static MPP_RET store_cur_nalu(H264dCurCtx_t *p_Cur, H264dCurStream_t *p_strm, H2
 
         p_des = &dxva_ctx->bitstream[dxva_ctx->strm_offset];
         memcpy(p_des, g_start_precode, sizeof(g_start_precode));
-        memcpy(p_des + sizeof(g_start_precode), p_strm->nalu_buf, p_strm->nalu_len);
+        if (store_nalu_idx(p_Inp, p_strm, dxva_ctx)) {
+            memcpy(p_des + sizeof(g_start_precode), p_strm->nalu_buf, p_strm->nalu_len);
+            p_Inp->copy_size += p_strm->nalu_len;
+        }
         dxva_ctx->strm_offset += add_size;
     }
     if (rkv_h264d_parse_debug & H264D_DBG_WRITE_ES_EN) {
-        H264dInputCtx_t *p_Inp = p_Cur->p_Inp;
         if ((p_strm->nalu_type == H264_NALU_TYPE_SPS)
             || (p_strm->nalu_type == H264_NALU_TYPE_PPS)) {
             if (p_Inp->spspps_update_flag) {
@@ -553,23 +663,28 @@ MPP_RET parse_prepare(H264dInputCtx_t *p_Inp, H264dCurCtx_t *p_Cur)
     }
 
     while (pkt_impl->length > 0) {
-        p_strm->curdata = &p_Inp->in_buf[p_strm->nalu_offset++];
-        pkt_impl->length--;
-        p_strm->prefixdata = (p_strm->prefixdata << 8) | (*p_strm->curdata);
-        if (p_strm->startcode_found) {
-            if (p_strm->nalu_len >= p_strm->nalu_max_size) {
-                FUN_CHECK(ret = realloc_buffer(&p_strm->nalu_buf, &p_strm->nalu_max_size, NALU_BUF_ADD_SIZE));
-            }
-            p_strm->nalu_buf[p_strm->nalu_len++] = *p_strm->curdata;
-            if ((p_strm->nalu_len == NALU_TYPE_NORMAL_LENGTH)
-                || (p_strm->nalu_len == NALU_TYPE_EXT_LENGTH)) {
-                FUN_CHECK(ret = judge_is_new_frame(p_Cur, p_strm));
-                if (p_Cur->p_Dec->is_new_frame) {
-                    FUN_CHECK(ret = add_empty_nalu(p_strm));
-                    p_strm->head_offset = 0;
-                    p_Cur->p_Inp->task_valid = 1;
-                    p_Cur->p_Dec->is_new_frame = 0;
-                    break;
+        if (p_strm->startcode_found && p_strm->nalu_len >= NALU_TYPE_EXT_LENGTH) {
+            //!< fast path for payload after nalu header
+            FUN_CHECK(ret = copy_nalu_payload(p_Inp, p_strm, pkt_impl));
+        } else {
+            p_strm->curdata = &p_Inp->in_buf[p_strm->nalu_offset++];
+            pkt_impl->length--;
+            p_strm->prefixdata = (p_strm->prefixdata << 8) | (*p_strm->curdata);
+            if (p_strm->startcode_found) {
+                if (p_strm->nalu_len >= p_strm->nalu_max_size) {
+                    FUN_CHECK(ret = realloc_buffer(&p_strm->nalu_buf, &p_strm->nalu_max_size, NALU_BUF_ADD_SIZE));
+                }
+                p_strm->nalu_buf[p_strm->nalu_len++] = *p_strm->curdata;
+                if ((p_strm->nalu_len == NALU_TYPE_NORMAL_LENGTH)
+                    || (p_strm->nalu_len == NALU_TYPE_EXT_LENGTH)) {
+                    FUN_CHECK(ret = judge_is_new_frame(p_Cur, p_strm));
+                    if (p_Cur->p_Dec->is_new_frame) {
+                        FUN_CHECK(ret = add_empty_nalu(p_strm));
+                        p_strm->head_offset = 0;
+                        p_Cur->p_Inp->task_valid = 1;
+                        p_Cur->p_Dec->is_new_frame = 0;
+                        break;
+                    }
                 }
             }
         }
@@ -623,6 +738,7 @@ MPP_RET parse_prepare_fast(H264dInputCtx_t *p_Inp, H264dCurCtx_t *p_Cur)
     H264_DecCtx_t   *p_Dec   = p_Inp->p_Dec;
     H264dCurStream_t *p_strm = &p_Cur->strm;
     MppPacketImpl *pkt_impl  = (MppPacketImpl *)p_Inp->in_pkt;
+    RK_U8 *slice_data = NULL;
 
     p_Dec->nalu_ret = NALU_NULL;
     p_Inp->task_valid = 0;
@@ -642,11 +758,16 @@ MPP_RET parse_prepare_fast(H264dInputCtx_t *p_Inp, H264dCurCtx_t *p_Cur)
                 if (p_strm->nalu_type == H264_NALU_TYPE_SLICE
                     || p_strm->nalu_type == H264_NALU_TYPE_IDR || p_strm->nalu_type == H264_NALU_TYPE_SLC_EXT) {
                     p_strm->nalu_len += (RK_U32)pkt_impl->length;
-                    if (p_strm->nalu_len >= p_strm->nalu_max_size) {
-                        RK_U32 add_size =  pkt_impl->length + 1 - p_strm->nalu_max_size;
-                        FUN_CHECK(ret = realloc_buffer(&p_strm->nalu_buf, &p_strm->nalu_max_size, MPP_MAX(NALU_BUF_ADD_SIZE, add_size)));
+                    if (p_Inp->nalu_index) {
+                        //!< slice data is stored from input packet directly
+                        slice_data = p_strm->curdata;
+                    } else {
+                        if (p_strm->nalu_len >= p_strm->nalu_max_size) {
+                            RK_U32 add_size =  pkt_impl->length + 1 - p_strm->nalu_max_size;
+                            FUN_CHECK(ret = realloc_buffer(&p_strm->nalu_buf, &p_strm->nalu_max_size, MPP_MAX(NALU_BUF_ADD_SIZE, add_size)));
+                        }
+                        memcpy(&p_strm->nalu_buf[0], p_strm->curdata, pkt_impl->length + 1);
                     }
-                    memcpy(&p_strm->nalu_buf[0], p_strm->curdata, pkt_impl->length + 1);
                     pkt_impl->length = 0;
                     p_Cur->p_Inp->task_valid = 1;
                     break;
@@ -668,7 +789,13 @@ MPP_RET parse_prepare_fast(H264dInputCtx_t *p_Inp, H264dCurCtx_t *p_Cur)
         }
     }
     if (p_Cur->p_Inp->task_valid) {
-        FUN_CHECK(ret = store_cur_nalu(p_Cur, p_strm, p_Dec->dxva_ctx));
+        RK_U8 *nalu_buf = p_strm->nalu_buf;
+
+        if (slice_data)
+            p_strm->nalu_buf = slice_data;
+        ret = store_cur_nalu(p_Cur, p_strm, p_Dec->dxva_ctx);
+        p_strm->nalu_buf = nalu_buf;
+        FUN_CHECK(ret);
         FUN_CHECK(ret = add_empty_nalu(p_strm));
         p_strm->head_offset = 0;
         p_Cur->last_dts = p_Cur->p_Inp->in_dts;
@@ -697,6 +824,35 @@ __FAILED:
 /*!
 ***********************************************************************
 * \brief
+*    write bitstream with the slice data referenced by nalu index
+*    When dst is the bitstream itself only the referenced data is copied.
+***********************************************************************
+*/
+MPP_RET parse_fill_stream(H264dDxvaCtx_t *dxva_ctx, RK_U8 *dst, RK_U32 length)
+{
+    RK_U32 pos = 0;
+    RK_U32 i = 0;
+
+    for (i = 0; i < dxva_ctx->idx_count; i++) {
+        H264dNaluIdx_t *p_idx = &dxva_ctx->nalu_idx[i];
+        RK_U32 data_pos = p_idx->strm_pos + sizeof(g_start_precode);
+
+        if (dst != dxva_ctx->bitstream)
+            memcpy(dst + pos, dxva_ctx->bitstream + pos, data_pos - pos);
+        memcpy(dst + data_pos, dxva_ctx->idx_base + p_idx->offset, p_idx->length);
+        pos = data_pos + p_idx->length;
+    }
+    if (dst != dxva_ctx->bitstream && length > pos)
+        memcpy(dst + pos, dxva_ctx->bitstream + pos, length - pos);
+
+    dxva_ctx->idx_count = 0;
+    dxva_ctx->idx_base = NULL;
+
+    return MPP_OK;
+}
+/*!
+***********************************************************************
+* \brief
 *    main function for parser avcC header
 ***********************************************************************
 */
@@ -36,6 +36,7 @@ MPP_RET parse_prepare(H264dInputCtx_t *p_Inp, H264dCurCtx_t *p_Cur);
 MPP_RET parse_prepare_fast(H264dInputCtx_t *p_Inp, H264dCurCtx_t *p_Cur);
 MPP_RET parse_prepare_avcC_header(H264dInputCtx_t *p_Inp, H264dCurCtx_t *p_Cur);
 MPP_RET parse_prepare_avcC_data(H264dInputCtx_t *p_Inp, H264dCurCtx_t *p_Cur);
+MPP_RET parse_fill_stream(H264dDxvaCtx_t *dxva_ctx, RK_U8 *dst, RK_U32 length);
 
 #ifdef  __cplusplus
 }
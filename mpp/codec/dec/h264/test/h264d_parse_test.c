@@ -0,0 +1,567 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* NOTE: parser source is included to reach its static helpers */
+#include "h264d_parse.c"
+
+#include <stdio.h>
+
+#include "mpp_log.h"
+#include "mpp_time.h"
+#include "mpp_common.h"
+
+#undef  MODULE_TAG
+#define MODULE_TAG "h264d_parse_test"
+
+#define TEST_SEED           (0x264)
+#define TEST_FRAME_COUNT    (240)
+#define TEST_GOP            (30)
+#define TEST_SLICE_COUNT    (4)
+#define TEST_SLICE_SIZE     (SZ_2K)
+#define TEST_LARGE_SIZE     (SZ_128K)
+#define TEST_STREAM_SIZE    (SZ_8M)
+/* small initial buffers to run the realloc path of both loops */
+#define TEST_INIT_BUF_SIZE  (64)
+
+typedef enum SplitMode_e {
+    SPLIT_TINY,         /* 1 ~ 16 bytes, start code split everywhere */
+    SPLIT_MIXED,        /* 1 ~ 4K bytes */
+    SPLIT_LARGE,        /* 1 ~ 256K bytes, several frames in one packet */
+    SPLIT_BUTT,
+} SplitMode;
+
+static const char *split_name[SPLIT_BUTT] = {
+    "tiny",
+    "mixed",
+    "large",
+};
+
+typedef struct ParseTestCtx_t {
+    H264_DecCtx_t   *p_Dec;
+    H264dInputCtx_t *p_Inp;
+    H264dCurCtx_t   *p_Cur;
+    H264dDxvaCtx_t  *dxva;
+    MppPacket       pkt;
+} ParseTestCtx;
+
+typedef struct ParseTestStat_t {
+    RK_S32  calls;
+    RK_S32  nalus;
+    RK_S32  tasks;
+    RK_S64  time_ref;
+    RK_S64  time_new;
+} ParseTestStat;
+
+/*
+ * parse_prepare before the start code search fast path
+ * All bytes are fed through prefixdata and find_prefix_code one by one.
+ */
+static MPP_RET parse_prepare_ref(H264dInputCtx_t *p_Inp, H264dCurCtx_t *p_Cur)
+{
+    MPP_RET ret = MPP_ERR_UNKNOW;
+
+    H264_DecCtx_t   *p_Dec   = p_Inp->p_Dec;
+    H264dCurStream_t *p_strm = &p_Cur->strm;
+    MppPacketImpl *pkt_impl  = (MppPacketImpl *)p_Inp->in_pkt;
+
+    p_Dec->nalu_ret = NALU_NULL;
+    p_Inp->task_valid = 0;
+
+    //!< check eos
+    if (p_Inp->pkt_eos && !p_Inp->in_length) {
+        FUN_CHECK(ret = store_cur_nalu(p_Cur, p_strm, p_Dec->dxva_ctx));
+        FUN_CHECK(ret = add_empty_nalu(p_strm));
+        p_Dec->p_Inp->task_valid = 1;
+        p_Dec->p_Inp->task_eos = 1;
+        goto __RETURN;
+    }
+    //!< check input
+    if (!p_Inp->in_length) {
+        p_Dec->nalu_ret = HaveNoStream;
+        goto __RETURN;
+    }
+
+    while (pkt_impl->length > 0) {
+        p_strm->curdata = &p_Inp->in_buf[p_strm->nalu_offset++];
+        pkt_impl->length--;
+        p_strm->prefixdata = (p_strm->prefixdata << 8) | (*p_strm->curdata);
+        if (p_strm->startcode_found) {
+            if (p_strm->nalu_len >= p_strm->nalu_max_size) {
+                FUN_CHECK(ret = realloc_buffer(&p_strm->nalu_buf, &p_strm->nalu_max_size, NALU_BUF_ADD_SIZE));
+            }
+            p_strm->nalu_buf[p_strm->nalu_len++] = *p_strm->curdata;
+            if ((p_strm->nalu_len == NALU_TYPE_NORMAL_LENGTH)
+                || (p_strm->nalu_len == NALU_TYPE_EXT_LENGTH)) {
+                FUN_CHECK(ret = judge_is_new_frame(p_Cur, p_strm));
+                if (p_Cur->p_Dec->is_new_frame) {
+                    FUN_CHECK(ret = add_empty_nalu(p_strm));
+                    p_strm->head_offset = 0;
+                    p_Cur->p_Inp->task_valid = 1;
+                    p_Cur->p_Dec->is_new_frame = 0;
+                    break;
+                }
+            }
+        }
+
+        find_prefix_code(p_strm->curdata, p_strm);
+
+        if (p_strm->endcode_found) {
+            p_strm->nalu_len -= START_PREFIX_3BYTE;
+            if (p_strm->nalu_len > START_PREFIX_3BYTE) {
+                while (p_strm->nalu_buf[p_strm->nalu_len - 1] == 0x00) {
+                    p_strm->nalu_len--;
+                }
+            }
+            p_Dec->nalu_ret = EndOfNalu;
+            FUN_CHECK(ret = store_cur_nalu(p_Cur, p_strm, p_Dec->dxva_ctx));
+            reset_nalu(p_strm);
+            break;
+        }
+    }
+    p_Inp->in_length = pkt_impl->length;
+    //!< check input
+    if (!p_Inp->in_length) {
+        p_strm->nalu_offset = 0;
+        p_Dec->nalu_ret = HaveNoStream;
+    }
+
+    if (p_Inp->pkt_eos) {
+        FUN_CHECK(ret = store_cur_nalu(p_Cur, p_strm, p_Dec->dxva_ctx));
+        FUN_CHECK(ret = add_empty_nalu(p_strm));
+        p_Dec->p_Inp->task_valid = 1;
+        p_Dec->p_Inp->task_eos = 1;
+    }
+
+__RETURN:
+
+    return ret = MPP_OK;
+__FAILED:
+    return ret;
+}
+
+static MPP_RET test_ctx_init(ParseTestCtx *ctx)
+{
+    H264dCurStream_t *p_strm = NULL;
+
+    memset(ctx, 0, sizeof(*ctx));
+
+    ctx->p_Dec = mpp_calloc(H264_DecCtx_t, 1);
+    ctx->p_Inp = mpp_calloc(H264dInputCtx_t, 1);
+    ctx->p_Cur = mpp_calloc(H264dCurCtx_t, 1);
+    ctx->dxva  = mpp_calloc(H264dDxvaCtx_t, 1);
+    if (!ctx->p_Dec || !ctx->p_Inp || !ctx->p_Cur || !ctx->dxva)
+        return MPP_ERR_MALLOC;
+
+    ctx->p_Dec->p_Inp = ctx->p_Inp;
+    ctx->p_Dec->p_Cur = ctx->p_Cur;
+    ctx->p_Dec->dxva_ctx = ctx->dxva;
+    ctx->p_Inp->p_Dec = ctx->p_Dec;
+    ctx->p_Inp->p_Cur = ctx->p_Cur;
+    ctx->p_Cur->p_Dec = ctx->p_Dec;
+    ctx->p_Cur->p_Inp = ctx->p_Inp;
+    ctx->dxva->p_Dec  = ctx->p_Dec;
+
+    p_strm = &ctx->p_Cur->strm;
+    p_strm->nalu_max_size = TEST_INIT_BUF_SIZE;
+    p_strm->nalu_buf = mpp_malloc_size(RK_U8, p_strm->nalu_max_size);
+    p_strm->head_max_size = TEST_INIT_BUF_SIZE;
+    p_strm->head_buf = mpp_malloc_size(RK_U8, p_strm->head_max_size);
+    ctx->dxva->max_strm_size = TEST_INIT_BUF_SIZE;
+    ctx->dxva->bitstream = mpp_malloc(RK_U8, ctx->dxva->max_strm_size);
+    if (!p_strm->nalu_buf || !p_strm->head_buf || !ctx->dxva->bitstream)
+        return MPP_ERR_MALLOC;
+
+    return MPP_OK;
+}
+
+static void test_ctx_deinit(ParseTestCtx *ctx)
+{
+    if (ctx->p_Cur) {
+        MPP_FREE(ctx->p_Cur->strm.nalu_buf);
+        MPP_FREE(ctx->p_Cur->strm.head_buf);
+    }
+    if (ctx->dxva) {
+        MPP_FREE(ctx->dxva->bitstream);
+        MPP_FREE(ctx->dxva->nalu_idx);
+    }
+    if (ctx->pkt)
+        mpp_packet_deinit(&ctx->pkt);
+
+    MPP_FREE(ctx->p_Dec);
+    MPP_FREE(ctx->p_Inp);
+    MPP_FREE(ctx->p_Cur);
+    MPP_FREE(ctx->dxva);
+}
+
+/* write payload with emulation prevention so that only real start codes exist */
+static RK_S32 put_payload(RK_U8 *buf, RK_S32 size)
+{
+    RK_S32 zeros = 0;
+    RK_S32 pos = 0;
+    RK_S32 i;
+
+    for (i = 0; i < size; i++) {
+        /* many zeros to stress the start code search */
+        RK_U8 c = (rand() & 3) ? (RK_U8)rand() : 0;
+
+        if (i == size - 1 && !c)
+            c = 0x80;
+
+        if (zeros >= 2 && c <= 3) {
+            buf[pos++] = 3;
+            zeros = 0;
+        }
+
+        buf[pos++] = c;
+        zeros = c ? 0 : zeros + 1;
+    }
+
+    return pos;
+}
+
+static RK_S32 put_nal(RK_U8 *buf, const RK_U8 *head, RK_S32 head_len,
+                      RK_S32 size)
+{
+    RK_S32 pos = 0;
+
+    /* 3 or 4 bytes start code */
+    if (rand() & 1)
+        buf[pos++] = 0;
+    buf[pos++] = 0;
+    buf[pos++] = 0;
+    buf[pos++] = 1;
+
+    memcpy(buf + pos, head, head_len);
+    pos += head_len;
+
+    pos += put_payload(buf + pos, size);
+
+    /* trailing zero bytes before next start code */
+    if (!(rand() & 7)) {
+        RK_S32 zeros = rand() % 3 + 1;
+
+        memset(buf + pos, 0, zeros);
+        pos += zeros;
+    }
+
+    return pos;
+}
+
+static RK_S32 put_nal_simple(RK_U8 *buf, RK_U8 type, RK_S32 size)
+{
+    RK_U8 head = (RK_U8)((rand() & 0x60) | type);
+
+    return put_nal(buf, &head, 1, size);
+}
+
+static RK_S32 put_slice(RK_U8 *buf, RK_U8 type, RK_S32 first, RK_S32 size)
+{
+    RK_U8 head[5];
+    RK_S32 len = 0;
+
+    head[len++] = (RK_U8)(0x60 | type);
+    if (type == H264_NALU_TYPE_SLC_EXT) {
+        /* mvc extension header without zero bytes */
+        head[len++] = 0x41;
+        head[len++] = 0x01;
+        head[len++] = 0x07;
+    }
+    /* first_mb_in_slice 0 as ue '1', otherwise 1 or 2 as ue '01x' */
+    head[len++] = first ? (RK_U8)(0x80 | (rand() & 0x7f)) :
+                  (RK_U8)(0x40 | (rand() & 0x3f));
+
+    return put_nal(buf, head, len, size);
+}
+
+static RK_S32 build_stream(RK_U8 *buf)
+{
+    RK_S32 pos = 0;
+    RK_S32 i, j;
+
+    /* garbage before the first start code */
+    buf[pos++] = 0x55;
+    buf[pos++] = 0;
+
+    for (i = 0; i < TEST_FRAME_COUNT; i++) {
+        RK_S32 idr = !(i % TEST_GOP);
+        RK_S32 slices = rand() % TEST_SLICE_COUNT + 1;
+
+        if (rand() & 1)
+            pos += put_nal_simple(buf + pos, H264_NALU_TYPE_AUD, 1);
+        if (idr) {
+            pos += put_nal_simple(buf + pos, H264_NALU_TYPE_SPS, rand() % 32 + 4);
+            pos += put_nal_simple(buf + pos, H264_NALU_TYPE_PPS, rand() % 8);
+        }
+        if (!(rand() & 3))
+            pos += put_nal_simple(buf + pos, H264_NALU_TYPE_SEI, rand() % 64);
+
+        for (j = 0; j < slices; j++) {
+            RK_U8 type = idr ? H264_NALU_TYPE_IDR : H264_NALU_TYPE_SLICE;
+            RK_S32 size = rand() % TEST_SLICE_SIZE;
+
+            if (!idr && !(rand() & 7))
+                type = H264_NALU_TYPE_SLC_EXT;
+            /* short slices end inside of the nalu header window */
+            if (!(rand() & 7))
+                size = rand() % 4;
+            /* large slices go over the slice header window and nalu_buf */
+            if (!(rand() % 50))
+                size = TEST_LARGE_SIZE;
+
+            pos += put_slice(buf + pos, type, !j, size);
+        }
+
+        if (!(rand() & 15))
+            pos += put_nal_simple(buf + pos, H264_NALU_TYPE_FILL, rand() % 16);
+        if (!(rand() % 40))
+            pos += put_nal_simple(buf + pos, H264_NALU_TYPE_EOSEQ, 0);
+    }
+
+    return pos;
+}
+
+static RK_S32 get_split(SplitMode mode)
+{
+    switch (mode) {
+    case SPLIT_TINY:
+        return rand() % 16 + 1;
+    case SPLIT_MIXED:
+        return rand() % SZ_4K + 1;
+    default:
+        return rand() % SZ_256K + 1;
+    }
+}
+
+/* head buffer of one task ends with the frame end nalu added on new frame */
+static RK_S32 get_task_head_size(H264dCurStream_t *p_strm)
+{
+    RK_S32 size = 0;
+
+    while (size + (RK_S32)sizeof(H264dNaluHead_t) <= (RK_S32)p_strm->head_max_size) {
+        H264dNaluHead_t *p_head = (H264dNaluHead_t *)(p_strm->head_buf + size);
+
+        size += sizeof(H264dNaluHead_t);
+        if (p_head->is_frame_end)
+            return size;
+
+        size += p_head->sodb_len;
+    }
+
+    return -1;
+}
+
+#define CHECK_EQ(name, a, b) \
+    do { \
+        if ((a) != (b)) { \
+            mpp_err("call %d %s mismatch ref %lld new %lld\n", \
+                    stat->calls, name, (RK_S64)(a), (RK_S64)(b)); \
+            return MPP_NOK; \
+        } \
+    } while (0)
+
+#define CHECK_BUF(name, a, b, size) \
+    do { \
+        if ((size) && memcmp(a, b, size)) { \
+            mpp_err("call %d %s mismatch size %d\n", stat->calls, name, \
+                    (RK_S32)(size)); \
+            return MPP_NOK; \
+        } \
+    } while (0)
+
+static MPP_RET compare_ctx(ParseTestCtx *ref, ParseTestCtx *cmp,
+                           MPP_RET ret_ref, MPP_RET ret_cmp,
+                           ParseTestStat *stat)
+{
+    H264dCurStream_t *s0 = &ref->p_Cur->strm;
+    H264dCurStream_t *s1 = &cmp->p_Cur->strm;
+
+    CHECK_EQ("ret", ret_ref, ret_cmp);
+    CHECK_EQ("nalu_ret", ref->p_Dec->nalu_ret, cmp->p_Dec->nalu_ret);
+    CHECK_EQ("task_valid", ref->p_Inp->task_valid, cmp->p_Inp->task_valid);
+    CHECK_EQ("in_length", ref->p_Inp->in_length, cmp->p_Inp->in_length);
+    CHECK_EQ("copy_size", ref->p_Inp->copy_size, cmp->p_Inp->copy_size);
+    CHECK_EQ("have_slice_data", ref->p_Dec->have_slice_data,
+             cmp->p_Dec->have_slice_data);
+    CHECK_EQ("curr_pts", ref->p_Cur->curr_pts, cmp->p_Cur->curr_pts);
+
+    CHECK_EQ("nalu_offset", s0->nalu_offset, s1->nalu_offset);
+    CHECK_EQ("curdata", s0->curdata, s1->curdata);
+    CHECK_EQ("nalu_type", s0->nalu_type, s1->nalu_type);
+    CHECK_EQ("prefixdata", s0->prefixdata, s1->prefixdata);
+    CHECK_EQ("startcode_found", s0->startcode_found, s1->startcode_found);
+    CHECK_EQ("endcode_found", s0->endcode_found, s1->endcode_found);
+    CHECK_EQ("nalu_len", s0->nalu_len, s1->nalu_len);
+    CHECK_BUF("nalu_buf", s0->nalu_buf, s1->nalu_buf, s0->nalu_len);
+
+    CHECK_EQ("head_offset", s0->head_offset, s1->head_offset);
+    CHECK_BUF("head_buf", s0->head_buf, s1->head_buf, s0->head_offset);
+
+    CHECK_EQ("strm_offset", ref->dxva->strm_offset, cmp->dxva->strm_offset);
+    CHECK_BUF("bitstream", ref->dxva->bitstream, cmp->dxva->bitstream,
+              ref->dxva->strm_offset);
+
+    if (ref->p_Dec->nalu_ret == EndOfNalu)
+        stat->nalus++;
+
+    if (ref->p_Inp->task_valid) {
+        RK_S32 head_size = get_task_head_size(s0);
+
+        CHECK_EQ("task head size", head_size, get_task_head_size(s1));
+        if (head_size <= 0) {
+            mpp_err("call %d task without frame end\n", stat->calls);
+            return MPP_NOK;
+        }
+        CHECK_BUF("task head_buf", s0->head_buf, s1->head_buf, head_size);
+        stat->tasks++;
+    }
+
+    return MPP_OK;
+}
+
+/* task is taken by parse_loop and hal, then parser starts a new task */
+static void consume_task(ParseTestCtx *ctx)
+{
+    ctx->dxva->strm_offset = 0;
+    ctx->p_Inp->copy_size = 0;
+}
+
+static void set_input(ParseTestCtx *ctx, RK_U8 *data, RK_S32 size, RK_S64 pts)
+{
+    mpp_packet_init(&ctx->pkt, data, size);
+    mpp_packet_set_pts(ctx->pkt, pts);
+}
+
+/* same steps as h264d_prepare on one packet */
+static void load_input(ParseTestCtx *ctx)
+{
+    H264dInputCtx_t *p_Inp = ctx->p_Inp;
+
+    p_Inp->in_pkt = ctx->pkt;
+    p_Inp->in_pts = mpp_packet_get_pts(ctx->pkt);
+    p_Inp->in_dts = mpp_packet_get_dts(ctx->pkt);
+    p_Inp->in_length = mpp_packet_get_length(ctx->pkt);
+    p_Inp->pkt_eos = mpp_packet_get_eos(ctx->pkt);
+    p_Inp->in_buf = (RK_U8 *)mpp_packet_get_pos(ctx->pkt);
+}
+
+static MPP_RET run_split(RK_U8 *stream, RK_S32 stream_size, SplitMode mode)
+{
+    ParseTestCtx ref;
+    ParseTestCtx cmp;
+    ParseTestStat stat;
+    MPP_RET ret = MPP_NOK;
+    RK_S32 pos = 0;
+    RK_S64 pts = 0;
+
+    memset(&stat, 0, sizeof(stat));
+
+    if (test_ctx_init(&ref) || test_ctx_init(&cmp)) {
+        mpp_err("failed to init parser context\n");
+        goto DONE;
+    }
+
+    ret = MPP_OK;
+    while (!ret && pos < stream_size) {
+        RK_S32 size = MPP_MIN(get_split(mode), stream_size - pos);
+
+        set_input(&ref, stream + pos, size, pts);
+        set_input(&cmp, stream + pos, size, pts);
+
+        while (!ret && mpp_packet_get_length(ref.pkt)) {
+            load_input(&ref);
+            load_input(&cmp);
+
+            do {
+                MPP_RET ret_ref;
+                MPP_RET ret_cmp;
+                RK_S64 time;
+
+                time = mpp_time();
+                ret_ref = parse_prepare_ref(ref.p_Inp, ref.p_Cur);
+                stat.time_ref += mpp_time() - time;
+
+                time = mpp_time();
+                ret_cmp = parse_prepare(cmp.p_Inp, cmp.p_Cur);
+                stat.time_new += mpp_time() - time;
+
+                stat.calls++;
+                ret = compare_ctx(&ref, &cmp, ret_ref, ret_cmp, &stat);
+                if (ret)
+                    break;
+            } while (mpp_packet_get_length(ref.pkt) && !ref.p_Inp->task_valid);
+
+            if (!ret && ref.p_Inp->task_valid) {
+                consume_task(&ref);
+                consume_task(&cmp);
+            }
+        }
+
+        mpp_packet_deinit(&ref.pkt);
+        mpp_packet_deinit(&cmp.pkt);
+        pos += size;
+        pts++;
+    }
+
+    if (ret)
+        mpp_err("split %s mismatch at stream pos %d\n", split_name[mode], pos);
+    else
+        mpp_log("split %-5s packets %6lld calls %6d nalus %5d tasks %4d ref %6lld us new %6lld us\n",
+                split_name[mode], pts, stat.calls, stat.nalus, stat.tasks,
+                stat.time_ref, stat.time_new);
+
+    if (!ret && (!stat.tasks || !stat.nalus)) {
+        mpp_err("split %s has no task or nalu output\n", split_name[mode]);
+        ret = MPP_NOK;
+    }
+
+DONE:
+    test_ctx_deinit(&ref);
+    test_ctx_deinit(&cmp);
+
+    return ret;
+}
+
+int main()
+{
+    MPP_RET ret = MPP_NOK;
+    RK_U8 *stream = NULL;
+    RK_S32 stream_size = 0;
+    RK_S32 mode;
+
+    mpp_log("h264d_parse_test start\n");
+
+    stream = mpp_malloc(RK_U8, TEST_STREAM_SIZE);
+    if (NULL == stream) {
+        mpp_err("failed to malloc stream\n");
+        goto DONE;
+    }
+
+    srand(TEST_SEED);
+    stream_size = build_stream(stream);
+    mpp_log("stream size %d\n", stream_size);
+
+    for (mode = 0; mode < SPLIT_BUTT; mode++) {
+        ret = run_split(stream, stream_size, (SplitMode)mode);
+        if (ret)
+            break;
+    }
+
+DONE:
+    MPP_FREE(stream);
+    mpp_log("h264d_parse_test %s\n", ret ? "failed" : "success");
+
+    return ret;
+}
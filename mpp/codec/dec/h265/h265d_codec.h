@@ -81,6 +81,8 @@ typedef struct SplitContext {
      */
     RK_S32 key_frame;
     RK_S32 eos;
+
+    RK_U32 last_au_size;      ///< size of the last access unit for buffer reserve
 } SplitContext_t;
 
 typedef struct H265dContext {
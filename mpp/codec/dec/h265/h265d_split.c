@@ -0,0 +1,351 @@
+/*
+ *
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "H265D_SPLIT"
+
+#include "mpp_mem.h"
+#include "mpp_common.h"
+#include "mpp_startcode.h"
+
+#include "h265d_parser.h"
+#include "h265d_split.h"
+
+#define START_CODE 0x000001 ///< start_code_prefix_one_3bytes
+
+/* access units ending on packet boundary before passing packet through */
+
+/* shift the last bytes of buf[0, end) into state */
+static RK_U64 split_update_state(RK_U64 state, const RK_U8 *buf, RK_S32 end)
+{
+    RK_S32 i = (end > 8) ? (end - 8) : 0;
+
+    for (; i < end; i++)
+        state = (state << 8) | buf[i];
+
+    return state;
+}
+
+/*
+ * Check the nal header after the start code in state64
+ * Return 1 when the nal is the beginning of the next access unit.
+ */
+static RK_S32 hevc_check_frame_end(SplitContext_t *sc)
+{
+    RK_S32 nut, layer_id;
+
+    if (((sc->state64 >> 3 * 8) & 0xFFFFFF) != START_CODE)
+        return 0;
+
+    nut = (sc->state64 >> (2 * 8 + 1)) & 0x3F;
+    layer_id  =  (((sc->state64 >> 2 * 8) & 0x01) << 5) + (((sc->state64 >> 1 * 8) & 0xF8) >> 3);
+    // Beginning of access unit
+    if ((nut >= NAL_VPS && nut <= NAL_AUD) || nut == NAL_SEI_PREFIX ||
+        (nut >= 41 && nut <= 44) || (nut >= 48 && nut <= 55)) {
+        if (sc->frame_start_found && !layer_id) {
+            sc->frame_start_found = 0;
+            return 1;
+        }
+    } else if (nut <= NAL_RASL_R ||
+               (nut >= NAL_BLA_W_LP && nut <= NAL_CRA_NUT)) {
+        int first_slice_segment_in_pic_flag = (sc->state64 & 0xFF) >> 7;
+
+        if (first_slice_segment_in_pic_flag && !layer_id) {
+            if (!sc->frame_start_found) {
+                sc->frame_start_found = 1;
+            } else { // First slice of next frame found
+                sc->frame_start_found = 0;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Find the end of the current frame in the bitstream.
+ * Start code is searched by mpp_find_startcode and only the nal header after
+ * it is checked. Byte by byte state is only used for the start code across
+ * the previous buffer.
+ * @return the position of the first byte of the next frame, or END_NOT_FOUND
+ */
+static RK_S32 hevc_find_frame_end(SplitContext_t *sc, const RK_U8 *buf,
+                                  int buf_size)
+{
+    RK_U64 state = sc->state64;
+    RK_S32 i;
+
+    for (i = 0; i < buf_size && i < 5; i++) {
+        sc->state64 = (sc->state64 << 8) | buf[i];
+        if (hevc_check_frame_end(sc))
+            return i - 5;
+    }
+
+    while (i < buf_size) {
+        RK_S32 pos = mpp_find_startcode(buf + i - 5, buf_size - i + 5);
+
+        /* nal header and the first slice byte should be in buffer */
+        if (pos < 0 || i + pos >= buf_size)
+            break;
+
+        i += pos;
+        sc->state64 = split_update_state(state, buf, i + 1);
+        if (hevc_check_frame_end(sc))
+            return i - 5;
+        i++;
+    }
+
+    sc->state64 = split_update_state(state, buf, buf_size);
+    return END_NOT_FOUND;
+}
+
+/* double the buffer size and keep room for an access unit as the last one */
+static RK_S32 split_buffer_reserve(SplitContext_t *sc, RK_U32 size)
+{
+    RK_U32 new_size;
+    RK_U8 *new_buffer;
+
+    if (size <= sc->buffer_size)
+        return MPP_OK;
+
+    new_size = MPP_MAX(sc->buffer_size * 2, size);
+    new_size = MPP_MAX(new_size, sc->last_au_size + MPP_INPUT_BUFFER_PADDING_SIZE);
+    new_buffer = mpp_realloc(sc->buffer, RK_U8, new_size);
+    if (!new_buffer) {
+        sc->buffer_size = 0;
+        return MPP_ERR_NOMEM;
+    }
+    sc->buffer_size = new_size;
+    sc->buffer = new_buffer;
+
+    return MPP_OK;
+}
+
+static RK_S32 mpp_combine_frame(SplitContext_t *sc, RK_S32 next, const RK_U8 **buf, RK_S32 *buf_size)
+{
+    if (sc->overread) {
+        mpp_log("overread %d, state:%X next:%d index:%d o_index:%d\n",
+                sc->overread, sc->state, next, sc->index, sc->overread_index);
+        mpp_log("%X %X %X %X\n", (*buf)[0], (*buf)[1], (*buf)[2], (*buf)[3]);
+    }
+
+    /* Copy overread bytes from last frame into buffer. */
+    if (sc->overread > 0) {
+        memmove(&sc->buffer[sc->index], &sc->buffer[sc->overread_index], sc->overread);
+        sc->index += sc->overread;
+        sc->overread_index += sc->overread;
+        sc->overread = 0;
+    }
+
+    /* flush remaining if EOF */
+    if (!*buf_size && next == END_NOT_FOUND) {
+        next = 0;
+    }
+
+    sc->last_index = sc->index;
+
+    /* copy into buffer end return */
+    if (next == END_NOT_FOUND) {
+        RK_U32 min_size = (*buf_size) + sc->index + MPP_INPUT_BUFFER_PADDING_SIZE;
+
+        /* reserve the whole access unit on its first packet */
+        if (!sc->index)
+            min_size = MPP_MAX(min_size, sc->last_au_size + MPP_INPUT_BUFFER_PADDING_SIZE);
+
+        if (split_buffer_reserve(sc, min_size))
+            return MPP_ERR_NOMEM;
+
+        memcpy(&sc->buffer[sc->index], *buf, *buf_size);
+        sc->index += *buf_size;
+
+        return -1;
+    }
+
+    *buf_size =
+        sc->overread_index = sc->index + next;
+    if (*buf_size > 0)
+        sc->last_au_size = *buf_size;
+
+    /* append to buffer */
+    if (sc->index) {
+        RK_U32 min_size = next + sc->index + MPP_INPUT_BUFFER_PADDING_SIZE;
+
+        if (split_buffer_reserve(sc, min_size))
+            return MPP_ERR_NOMEM;
+
+        if (next > -MPP_INPUT_BUFFER_PADDING_SIZE)
+            memcpy(&sc->buffer[sc->index], *buf,
+                   next + MPP_INPUT_BUFFER_PADDING_SIZE);
+        sc->index = 0;
+        *buf = sc->buffer;
+    }
+
+    /* store overread bytes */
+    for (; next < 0; next++) {
+        sc->state = (sc->state << 8) | sc->buffer[sc->last_index + next];
+        sc->state64 = (sc->state64 << 8) | sc->buffer[sc->last_index + next];
+        sc->overread++;
+    }
+
+    if (sc->overread) {
+        mpp_log("overread %d, state:%X next:%d index:%d o_index:%d\n",
+                sc->overread, sc->state, next, sc->index, sc->overread_index);
+        mpp_log("%X %X %X %X\n", (*buf)[0], (*buf)[1], (*buf)[2], (*buf)[3]);
+    }
+
+    return 0;
+}
+
+RK_S32 h265d_split_init(void **sc)
+{
+    SplitContext_t *s = NULL;
+    if (s == NULL) {
+        s = mpp_calloc(SplitContext_t, 1);
+        if (s != NULL) {
+            *sc = s;
+        } else {
+            mpp_err("split alloc context fail");
+            return MPP_ERR_NOMEM;
+        }
+    }
+    s->buffer = mpp_malloc(RK_U8, MAX_FRAME_SIZE);
+    s->buffer_size = MAX_FRAME_SIZE;
+    s->fetch_timestamp = 1;
+    return MPP_OK;
+}
+
+static void mpp_fetch_timestamp(SplitContext_t *s, RK_S32 off)
+{
+    RK_S32 i;
+
+    s->dts = s->pts = -1;
+    s->offset = 0;
+    for (i = 0; i < MPP_PARSER_PTS_NB; i++) {
+        h265d_dbg(H265D_DBG_TIME, "s->cur_offset %lld s->cur_frame_offset[%d] %lld s->frame_offset %lld s->next_frame_offset %lld",
+                  s->cur_offset, i, s->cur_frame_offset[i], s->frame_offset, s->next_frame_offset);
+        if ( s->cur_offset + off >= s->cur_frame_offset[i]
+             && (s->frame_offset < s->cur_frame_offset[i] ||
+                 (!s->frame_offset && !s->next_frame_offset)) // first field/frame
+             // check disabled since MPEG-TS does not send complete PES packets
+             && /*s->next_frame_offset + off <*/  s->cur_frame_end[i]) {
+            s->dts = s->cur_frame_dts[i];
+            s->pts = s->cur_frame_pts[i];
+            s->offset = s->next_frame_offset - s->cur_frame_offset[i];
+            if (s->cur_offset + off < s->cur_frame_end[i])
+                break;
+        }
+    }
+}
+
+RK_S32 h265d_split_frame(void *sc,
+                         const RK_U8 **poutbuf, RK_S32 *poutbuf_size,
+                         const RK_U8 *buf, RK_S32 buf_size, RK_S64 pts,
+                         RK_S64 dts)
+{
+    RK_S32 next, i;
+
+    SplitContext_t *s = (SplitContext_t*)sc;
+
+    if (s->cur_offset + buf_size !=
+        s->cur_frame_end[s->cur_frame_start_index]) { /* skip remainder packets */
+        /* add a new packet descriptor */
+        i = (s->cur_frame_start_index + 1) & (MPP_PARSER_PTS_NB - 1);
+        s->cur_frame_start_index = i;
+        s->cur_frame_offset[i] = s->cur_offset;
+        s->cur_frame_end[i] = s->cur_offset + buf_size;
+        s->cur_frame_pts[i] = pts;
+        s->cur_frame_dts[i] = dts;
+        h265d_dbg(H265D_DBG_TIME, "s->cur_frame_start_index = %d,cur_frame_offset = %lld,s->cur_frame_end = %lld pts = %lld",
+                  s->cur_frame_start_index, s->cur_frame_offset[i], s->cur_frame_end[i], pts);
+    }
+
+    if (s->fetch_timestamp) {
+        s->fetch_timestamp = 0;
+        s->last_pts = s->pts;
+        s->last_dts = s->dts;
+        mpp_fetch_timestamp(s, 0);
+    }
+
+    if (s->eos && !buf_size) {
+        *poutbuf      = s->buffer;
+        *poutbuf_size = s->index;
+        return 0;
+    }
+
+    next = hevc_find_frame_end(s, buf, buf_size);
+    if (s->eos && buf_size && next == END_NOT_FOUND) {
+        next = buf_size;
+    }
+
+    if (mpp_combine_frame(s, next, &buf, &buf_size) < 0) {
+        *poutbuf      = NULL;
+        *poutbuf_size = 0;
+        s->cur_offset += buf_size;
+        return buf_size;
+    }
+
+    *poutbuf      = buf;
+    *poutbuf_size = buf_size;
+
+    if (next < 0)
+        next = 0;
+
+    if (*poutbuf_size) {
+        /* fill the data for the current frame */
+        s->frame_offset = s->next_frame_offset;
+
+        /* offset of the next frame */
+        s->next_frame_offset = s->cur_offset + next;
+        s->fetch_timestamp = 1;
+    }
+
+    s->cur_offset += next;
+    return next;
+}
+
+RK_S32 h265d_split_reset(void *sc)
+{
+    RK_U8 *buf = NULL;
+    RK_U32 size = 0;
+    SplitContext_t *s = (SplitContext_t*)sc;
+    if (sc == NULL) {
+        return MPP_OK;
+    }
+    buf = s->buffer;
+    size = s->buffer_size;
+    memset(s, 0, sizeof(SplitContext_t));
+    s->fetch_timestamp = 1;
+    s->buffer = buf;
+    s->buffer_size = size;
+    s->eos = 0;
+    return MPP_OK;
+}
+
+
+RK_S32 h265d_split_deinit(void *sc)
+{
+    SplitContext_t *s = (SplitContext_t *)sc;
+    if (s->buffer) {
+        mpp_free(s->buffer);
+        s->buffer = NULL;
+    }
+    if (s) {
+        mpp_free(s);
+        s = NULL;
+    }
+    return MPP_OK;
+}
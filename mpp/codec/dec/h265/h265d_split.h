@@ -0,0 +1,44 @@
+/*
+ *
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __H265D_SPLIT_H__
+#define __H265D_SPLIT_H__
+
+#include "rk_type.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * split input stream to access unit for need_split mode
+ * h265d_split_frame returns the consumed bytes of buf. When one access unit
+ * is found poutbuf / poutbuf_size is set, otherwise poutbuf_size is zero.
+ */
+RK_S32 h265d_split_init(void **sc);
+RK_S32 h265d_split_frame(void *sc,
+                         const RK_U8 **poutbuf, RK_S32 *poutbuf_size,
+                         const RK_U8 *buf, RK_S32 buf_size, RK_S64 pts,
+                         RK_S64 dts);
+RK_S32 h265d_split_reset(void *sc);
+RK_S32 h265d_split_deinit(void *sc);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __H265D_SPLIT_H__ */
@@ -0,0 +1,346 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "h265d_split_test"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mpp_log.h"
+#include "mpp_mem.h"
+#include "mpp_time.h"
+#include "mpp_common.h"
+
+#include "h265d_codec.h"
+#include "h265d_split.h"
+
+#define TEST_FRAME_COUNT    (60)
+#define TEST_FRAME_SIZE     (SZ_512K)
+#define TEST_SLICE_COUNT    (4)
+#define TEST_GOP            (30)
+#define TEST_CHUNK_SIZE     (SZ_4K)
+#define MAX_TEST_AU_COUNT   (4096)
+
+typedef struct SplitTestStream_t {
+    RK_U8   *buf;
+    RK_S32  size;
+    RK_S32  au_count;
+    RK_S32  au_pos[MAX_TEST_AU_COUNT + 1];
+} SplitTestStream;
+
+static RK_S32 put_nal(RK_U8 *buf, RK_S32 type, RK_S32 first, RK_S32 size)
+{
+    RK_S32 i;
+
+    buf[0] = 0;
+    buf[1] = 0;
+    buf[2] = 0;
+    buf[3] = 1;
+    buf[4] = (RK_U8)(type << 1);
+    buf[5] = 1;
+    buf[6] = first ? 0x80 : 0x40;
+
+    /* payload without start code emulation */
+    for (i = 7; i < size; i++) {
+        RK_U8 c = (RK_U8)rand();
+
+        if (c < 4 && !buf[i - 1])
+            c = 0x55;
+        buf[i] = c;
+    }
+
+    return size;
+}
+
+/* 4K like stream: parameter sets + IDR on gop start, multi-slice pictures */
+static MPP_RET gen_stream(SplitTestStream *s)
+{
+    RK_S32 max_size = TEST_FRAME_COUNT * (TEST_FRAME_SIZE + SZ_1K);
+    RK_S32 pos = 0;
+    RK_S32 i, j;
+
+    s->buf = mpp_malloc(RK_U8, max_size);
+    if (NULL == s->buf)
+        return MPP_ERR_MALLOC;
+
+    for (i = 0; i < TEST_FRAME_COUNT; i++) {
+        RK_S32 idr = !(i % TEST_GOP);
+        RK_S32 frm_size = idr ? TEST_FRAME_SIZE : TEST_FRAME_SIZE / 4 + rand() % (TEST_FRAME_SIZE / 2);
+        RK_S32 slice_size = frm_size / TEST_SLICE_COUNT;
+
+        s->au_pos[s->au_count++] = pos;
+
+        if (idr) {
+            pos += put_nal(s->buf + pos, 32, 1, 32);
+            pos += put_nal(s->buf + pos, 33, 1, 64);
+            pos += put_nal(s->buf + pos, 34, 1, 16);
+        }
+
+        for (j = 0; j < TEST_SLICE_COUNT; j++)
+            pos += put_nal(s->buf + pos, idr ? 19 : 1, !j, slice_size);
+    }
+
+    s->au_pos[s->au_count] = pos;
+    s->size = pos;
+
+    return MPP_OK;
+}
+
+static MPP_RET load_stream(SplitTestStream *s, const char *name)
+{
+    FILE *fp = fopen(name, "rb");
+    long size;
+
+    if (NULL == fp) {
+        mpp_err("failed to open %s\n", name);
+        return MPP_ERR_OPEN_FILE;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    s->buf = mpp_malloc(RK_U8, size);
+    if (NULL == s->buf || fread(s->buf, 1, size, fp) != (size_t)size) {
+        fclose(fp);
+        return MPP_NOK;
+    }
+    fclose(fp);
+
+    s->size = (RK_S32)size;
+    s->au_count = 0;
+
+    return MPP_OK;
+}
+
+/*
+ * splitter cuts before the three byte start code so the zero byte of the
+ * four byte start code stays on the tail of the previous access unit
+ */
+static RK_S32 au_split_pos(SplitTestStream *s, RK_S32 idx)
+{
+    if (idx <= 0 || idx >= s->au_count)
+        return idx <= 0 ? 0 : s->size;
+
+    return s->au_pos[idx] + 1;
+}
+
+typedef enum SplitPktMode_e {
+    SPLIT_PKT_CHUNK,        /* fixed size packets */
+    SPLIT_PKT_AU,           /* one packet per access unit */
+    SPLIT_PKT_MIXED,        /* aligned run then packets across au boundary */
+    SPLIT_PKT_BUTT,
+} SplitPktMode;
+
+static const char *pkt_mode_name[SPLIT_PKT_BUTT] = {
+    "fixed chunk",
+    "au aligned",
+    "mixed",
+};
+
+/* packet end positions of each mode */
+static RK_S32 gen_packets(SplitTestStream *s, SplitPktMode mode, RK_S32 *ends)
+{
+    RK_S32 count = 0;
+    RK_S32 pos;
+    RK_S32 k;
+
+    switch (mode) {
+    case SPLIT_PKT_CHUNK : {
+        for (pos = TEST_CHUNK_SIZE; pos < s->size; pos += TEST_CHUNK_SIZE)
+            ends[count++] = pos;
+    } break;
+    case SPLIT_PKT_AU : {
+        for (k = 1; k <= s->au_count; k++)
+            ends[count++] = s->au_pos[k];
+    } break;
+    case SPLIT_PKT_MIXED : {
+        /*
+         * eight whole au packets then one au cut in three packets where the
+         * middle packet has the tail of this au and the head of the next one
+         */
+        for (k = 0; k < s->au_count; k++) {
+            RK_S32 size = s->au_pos[k + 1] - s->au_pos[k];
+
+            if (k % 10 == 8 && k + 1 < s->au_count) {
+                ends[count++] = s->au_pos[k] + size / 3;
+                ends[count++] = s->au_pos[k + 1] + (s->au_pos[k + 2] - s->au_pos[k + 1]) / 2;
+                ends[count++] = s->au_pos[k + 2];
+                k++;
+            } else
+                ends[count++] = s->au_pos[k + 1];
+        }
+    } break;
+    default : {
+    } break;
+    }
+
+    if (!count || ends[count - 1] != s->size)
+        ends[count++] = s->size;
+
+    return count;
+}
+
+/*
+ * feed the stream as packets and check each output access unit against the
+ * access unit boundary of the generated stream
+ */
+static MPP_RET run_split(SplitTestStream *s, SplitPktMode mode, RK_S32 loop)
+{
+    SplitContext_t *sc = NULL;
+    RK_S32 *ends = NULL;
+    RK_S32 pkt_count;
+    RK_S64 time_start;
+    RK_S64 time_used;
+    RK_S64 out_bytes = 0;
+    RK_S32 out_count = 0;
+    MPP_RET ret = MPP_OK;
+    RK_S32 i;
+
+    if (mode != SPLIT_PKT_CHUNK && !s->au_count) {
+        mpp_log("skip %s split on file input\n", pkt_mode_name[mode]);
+        return MPP_OK;
+    }
+
+    ends = mpp_malloc(RK_S32, s->size / TEST_CHUNK_SIZE + s->au_count * 2 + 2);
+    if (NULL == ends)
+        return MPP_ERR_MALLOC;
+
+    pkt_count = gen_packets(s, mode, ends);
+
+    time_start = mpp_time();
+
+    for (i = 0; i < loop; i++) {
+        RK_S32 pkt_idx;
+        RK_S32 pos = 0;
+
+        out_bytes = 0;
+        out_count = 0;
+
+        h265d_split_init((void **)&sc);
+        if (NULL == sc) {
+            ret = MPP_ERR_MALLOC;
+            goto RET;
+        }
+
+        for (pkt_idx = 0; pkt_idx < pkt_count; pkt_idx++) {
+            RK_S32 len = ends[pkt_idx] - pos;
+
+            sc->eos = (ends[pkt_idx] == s->size);
+
+            while (len > 0) {
+                const RK_U8 *out = NULL;
+                RK_S32 out_size = 0;
+                RK_S32 consume;
+
+                consume = h265d_split_frame(sc, &out, &out_size, s->buf + pos,
+                                            len, 0, 0);
+                pos += consume;
+                len -= consume;
+
+                if (!out_size)
+                    continue;
+
+                if (s->au_count) {
+                    RK_S32 au_start = 0;
+                    RK_S32 au_size = 0;
+
+                    if (out_count < s->au_count) {
+                        au_start = au_split_pos(s, out_count);
+                        au_size = au_split_pos(s, out_count + 1) - au_start;
+                    }
+
+                    if (out_size != au_size || memcmp(out, s->buf + au_start, au_size)) {
+                        mpp_err("%s au %d size %d expect %d at packet %d\n",
+                                pkt_mode_name[mode], out_count, out_size,
+                                au_size, pkt_idx);
+                        ret = MPP_NOK;
+                        goto RET;
+                    }
+                }
+
+                out_bytes += out_size;
+                out_count++;
+            }
+        }
+
+        h265d_split_deinit(sc);
+        sc = NULL;
+    }
+
+    time_used = mpp_time() - time_start;
+
+    if (s->au_count && (out_count != s->au_count || out_bytes != s->size)) {
+        mpp_err("%s au count %d bytes %lld expect %d %d\n", pkt_mode_name[mode],
+                out_count, out_bytes, s->au_count, s->size);
+        ret = MPP_NOK;
+        goto RET;
+    }
+
+    mpp_log("%s split %d au %lld bytes %.1f MB/s\n",
+            pkt_mode_name[mode], out_count, out_bytes,
+            (float)s->size * loop / MPP_MAX(time_used, 1));
+
+RET:
+    if (sc)
+        h265d_split_deinit(sc);
+    MPP_FREE(ends);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    MPP_RET ret = MPP_NOK;
+    SplitTestStream *s = NULL;
+    RK_S32 loop = 10;
+    RK_S32 mode;
+
+    mpp_log("h265d_split_test start\n");
+
+    s = mpp_calloc(SplitTestStream, 1);
+    if (NULL == s)
+        goto TEST_FAILED;
+
+    srand(1234);
+
+    if (argc > 2 && !strcmp(argv[1], "-i")) {
+        ret = load_stream(s, argv[2]);
+        loop = 1;
+    } else {
+        ret = gen_stream(s);
+    }
+    if (ret)
+        goto TEST_FAILED;
+
+    for (mode = SPLIT_PKT_CHUNK; mode < SPLIT_PKT_BUTT; mode++) {
+        ret = run_split(s, (SplitPktMode)mode, loop);
+        if (ret)
+            goto TEST_FAILED;
+    }
+
+    MPP_FREE(s->buf);
+    MPP_FREE(s);
+    mpp_log("h265d_split_test success\n");
+    return MPP_OK;
+
+TEST_FAILED:
+    if (s)
+        MPP_FREE(s->buf);
+    MPP_FREE(s);
+    mpp_log("h265d_split_test failed\n");
+    return ret;
+}
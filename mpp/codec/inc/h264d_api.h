@@ -40,6 +40,7 @@ MPP_RET  h264d_flush  (void *decoder);
 MPP_RET  h264d_control(void *decoder, MpiCmd cmd_type, void *param);
 MPP_RET  h264d_prepare(void *decoder, MppPacket pkt, HalDecTask *task);
 MPP_RET  h264d_parse  (void *decoder, HalDecTask *task);
+MPP_RET  h264d_fill_stream(void *decoder, HalDecTask *task, void *dst);
 MPP_RET  h264d_callback(void *decoder, void *err_info);
 
 #ifdef  __cplusplus
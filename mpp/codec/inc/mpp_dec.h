@@ -26,9 +26,11 @@ typedef void* MppDec;
 typedef struct {
     MppCodingType       coding;
     RK_U32              fast_mode;
+    RK_U32              pipeline_mode;
     RK_U32              need_split;
     RK_U32              internal_pts;
     RK_U32              immedaite_out;
+    RK_U32              worker_pool;
     void                *mpp;
 } MppDecCfg;
 
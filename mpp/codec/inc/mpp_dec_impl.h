@@ -46,9 +46,14 @@ typedef struct MppDecImpl_t {
     Parser              parser;
     MppHal              hal;
 
-    // worker thread
+    // worker thread or job on worker pool
     MppThread           *thread_parser;
     MppThread           *thread_hal;
+    RK_U32              use_worker_pool;
+    // parser DecTask kept across parser job steps
+    void                *task_parser;
+    RK_U32              parser_waiting;
+    RK_U32              hal_waiting;
 
     // common resource
     MppBufSlots         frame_slots;
@@ -64,29 +69,44 @@ typedef struct MppDecImpl_t {
     RK_U32              parser_notify_flag;
     RK_U32              hal_notify_flag;
 
+    // parser wait reason statistic
+    RK_S64              parser_wait_start;
+    MppDecWaitStat      wait_stats[MPP_DEC_WAIT_BUTT];
+
     // reset process:
     // 1. mpp_dec set reset flag and signal parser
     // 2. mpp_dec wait on parser_reset sem
-    // 3. parser wait hal reset done
+    // 3. parser signal hal and wait hal reset done without blocking
     // 4. hal wait vproc reset done
     // 5. vproc do reset and signal hal
     // 6. hal do reset and signal parser
     // 7. parser do reset and signal mpp_dec
     // 8. mpp_dec reset done
     RK_U32              reset_flag;
+    // drop output frame on reset and stop instead of pending it
+    RK_U32              frame_ring_abort;
+    // frames pending on full frame ring, output never waits on the ring
+    mpp_list            *frame_pending;
+    RK_U32              hal_frame_wait;
 
     RK_U32              hal_reset_post;
     RK_U32              hal_reset_done;
+    RK_U32              hal_reset_wait;
     sem_t               parser_reset;
     sem_t               hal_reset;
 
     // work mode flags
     RK_U32              parser_need_split;
     RK_U32              parser_fast_mode;
+    /* parse ahead and only wait previous task on register generation */
+    RK_U32              parser_pipeline;
+    /* pass reference frame error to task on the coding with pipeline support */
+    RK_U32              parser_refer_check;
     RK_U32              parser_internal_pts;
     RK_U32              disable_error;
     RK_U32              use_preset_time_order;
     RK_U32              enable_deinterlace;
+    RK_U32              zero_copy_input;
 
     // dec parser thread runtime resource context
     MppPacket           mpp_pkt_in;
@@ -101,12 +121,15 @@ typedef struct MppDecImpl_t {
     RK_U32              dec_in_pkt_count;
     RK_U32              dec_hw_run_count;
     RK_U32              dec_out_frame_count;
+    RK_U64              dec_hal_copy_size;
+    RK_U64              dec_hal_ref_size;
 } MppDecImpl;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+void mpp_dec_push_frame(MppDecImpl *dec, MppFrame frame);
 
 #ifdef __cplusplus
 }
@@ -153,6 +153,7 @@ typedef void* MppEnc;
 
 typedef struct MppEncInitCfg_t {
     MppCodingType       coding;
+    RK_U32              worker_pool;
     void                *mpp;
 } MppEncInitCfg;
 
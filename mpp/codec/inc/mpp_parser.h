@@ -30,6 +30,7 @@ MPP_RET mpp_parser_deinit(Parser prs);
 
 MPP_RET mpp_parser_prepare(Parser prs, MppPacket pkt, HalDecTask *task);
 MPP_RET mpp_parser_parse(Parser prs, HalDecTask *task);
+MPP_RET mpp_parser_fill_stream(Parser prs, HalDecTask *task, void *dst);
 
 MPP_RET mpp_parser_reset(Parser prs);
 MPP_RET mpp_parser_flush(Parser prs);
@@ -54,6 +54,8 @@ typedef struct DecParserInitCfg_t {
  * init     - decoder initialization function
  * deinit   - decoder de-initialization function
  * parse    - decoder main working function, mpp_dec will input packet and get output syntax
+ * fill_stream - optional, write the prepared stream of task to hardware buffer
+ *            when the stream is not fully stored in task input_packet
  * reset    - decoder reset function
  * flush    - decoder output all frames
  * control  - decoder configure function
@@ -69,6 +71,7 @@ typedef struct ParserApi_t {
 
     MPP_RET (*prepare)(void *ctx, MppPacket pkt, HalDecTask *task);
     MPP_RET (*parse)(void *ctx, HalDecTask *task);
+    MPP_RET (*fill_stream)(void *ctx, HalDecTask *task, void *dst);
 
     MPP_RET (*reset)(void *ctx);
     MPP_RET (*flush)(void *ctx);
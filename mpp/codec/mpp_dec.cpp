@@ -22,6 +22,8 @@
 #include "mpp_mem.h"
 #include "mpp_log.h"
 #include "mpp_time.h"
+#include "mpp_trace.h"
+#include "mpp_atomic.h"
 
 #include "mpp.h"
 #include "mpp_dec_impl.h"
@@ -65,7 +67,7 @@ typedef union PaserTaskWait_u {
         RK_U32      task_hnd        : 1;   // 0x0100 MPP_DEC_NOTIFY_TASK_HND_VALID
         RK_U32      prev_task       : 1;   // 0x0200 MPP_DEC_NOTIFY_TASK_PREV_DONE
         RK_U32      dec_pic_match   : 1;   // 0x0400 MPP_DEC_NOTIFY_BUFFER_MATCH
-        RK_U32      reserv0800      : 1;   // 0x0800
+        RK_U32      dec_ts_full     : 1;   // 0x0800 MPP_DEC_NOTIFY_TIMESTAMP_VALID
 
         RK_U32      dec_pkt_idx     : 1;   // 0x1000
         RK_U32      dec_pkt_buf     : 1;   // 0x2000
@@ -120,6 +122,60 @@ static void dec_task_init(DecTask *task)
     hal_task_info_init(&task->info, MPP_CTX_DEC);
 }
 
+/* map PaserTaskWait bit to MppDecWaitReason */
+static const RK_U8 wait_reason_map[15] = {
+    MPP_DEC_WAIT_PKT_IN,        // dec_pkt_in
+    MPP_DEC_WAIT_DIS_QUE_FULL,  // dis_que_full
+    MPP_DEC_WAIT_OTHERS,        // reserv0004
+    MPP_DEC_WAIT_OTHERS,        // reserv0008
+    MPP_DEC_WAIT_OTHERS,        // ext_buf_grp
+    MPP_DEC_WAIT_INFO_CHANGE,   // info_change
+    MPP_DEC_WAIT_BUF_UNUSED,    // dec_pic_unusd
+    MPP_DEC_WAIT_OTHERS,        // dec_all_done
+    MPP_DEC_WAIT_TASK_HND,      // task_hnd
+    MPP_DEC_WAIT_PREV_TASK,     // prev_task
+    MPP_DEC_WAIT_OTHERS,        // dec_pic_match
+    MPP_DEC_WAIT_OTHERS,        // dec_ts_full
+    MPP_DEC_WAIT_PKT_SLOT,      // dec_pkt_idx
+    MPP_DEC_WAIT_PKT_SLOT,      // dec_pkt_buf
+    MPP_DEC_WAIT_FRM_SLOT,      // dec_slot_idx
+};
+
+static RK_U32 wait_to_reasons(RK_U32 wait)
+{
+    RK_U32 reasons = 0;
+    RK_U32 i;
+
+    for (i = 0; i < MPP_ARRAY_ELEMS(wait_reason_map); i++)
+        if (wait & (1 << i))
+            reasons |= 1 << wait_reason_map[i];
+
+    return reasons;
+}
+
+static void dec_wait_stat_start(MppDecImpl *dec, RK_U32 wait)
+{
+    RK_U32 reasons = wait_to_reasons(wait);
+    RK_S32 i;
+
+    for (i = 0; i < MPP_DEC_WAIT_BUTT; i++)
+        if (reasons & (1 << i))
+            dec->wait_stats[i].count++;
+
+    dec->parser_wait_start = mpp_time();
+}
+
+static void dec_wait_stat_end(MppDecImpl *dec)
+{
+    RK_U32 reasons = wait_to_reasons(dec->parser_wait_flag);
+    RK_S64 time = mpp_time() - dec->parser_wait_start;
+    RK_S32 i;
+
+    for (i = 0; i < MPP_DEC_WAIT_BUTT; i++)
+        if (reasons & (1 << i))
+            dec->wait_stats[i].time += time;
+}
+
 /*
  * return MPP_OK for not wait
  * return MPP_NOK for wait
@@ -169,15 +225,22 @@ static RK_U32 reset_parser_thread(Mpp *mpp, DecTask *task)
     MppBufSlots packet_slots = dec->packet_slots;
     HalDecTask *task_dec = &task->info.dec;
 
-    dec_dbg_reset("reset: parser reset start\n");
-    dec_dbg_reset("reset: parser wait hal proc reset start\n");
+    if (!dec->hal_reset_wait) {
+        dec_dbg_reset("reset: parser reset start\n");
+        dec_dbg_reset("reset: parser wait hal proc reset start\n");
 
-    hal->lock();
-    dec->hal_reset_post++;
-    hal->signal();
-    hal->unlock();
+        hal->lock();
+        dec->hal_reset_post++;
+        hal->signal();
+        hal->unlock();
+        dec->hal_reset_wait = 1;
+    }
 
-    sem_wait(&dec->hal_reset);
+    // hal job signals parser job when its reset is done
+    if (sem_trywait(&dec->hal_reset))
+        return MPP_NOK;
+
+    dec->hal_reset_wait = 0;
 
     dec_dbg_reset("reset: parser check hal proc task empty start\n");
 
@@ -225,6 +288,9 @@ static RK_U32 reset_parser_thread(Mpp *mpp, DecTask *task)
             dec->mpp_pkt_in = NULL;
         }
 
+        // parser is the consumer of packet ring so drop input packets here
+        mpp->flush_packets();
+
         while (MPP_OK == mpp_buf_slot_dequeue(frame_slots, &index, QUEUE_DISPLAY)) {
             /* release extra ref in slot's MppBuffer */
             MppBuffer buffer = NULL;
@@ -234,10 +300,9 @@ static RK_U32 reset_parser_thread(Mpp *mpp, DecTask *task)
             mpp_buf_slot_clr_flag(frame_slots, index, SLOT_QUEUE_USE);
         }
 
-        if (dec->use_preset_time_order) {
-            AutoMutex autoLock(mpp->mTimeStamps->mutex());
+        // NOTE: hal thread is idle on reset so timestamp ring can be flushed
+        if (dec->use_preset_time_order)
             mpp->mTimeStamps->flush();
-        }
 
         if (task->status.dec_pkt_copy_rdy) {
             mpp_buf_slot_clr_flag(packet_slots, task_dec->input,  SLOT_HAL_INPUT);
@@ -247,6 +312,12 @@ static RK_U32 reset_parser_thread(Mpp *mpp, DecTask *task)
 
         task->status.task_parsed_rdy = 0;
         // IMPORTANT: clear flag in MppDec context
+        if (dec->parser_waiting) {
+            mpp_clock_pause(dec->clocks[DEC_PRS_WAIT]);
+            mpp_trace_end(mpp, "prs wait", -1, dec->parser_wait_flag);
+            dec_wait_stat_end(dec);
+            dec->parser_waiting = 0;
+        }
         dec->parser_status_flag = 0;
         dec->parser_wait_flag = 0;
     }
@@ -331,14 +402,17 @@ static void mpp_dec_put_frame(Mpp *mpp, RK_S32 index, HalDecTaskFlag flags)
     if (!change) {
         if (dec->use_preset_time_order) {
             MppPacket pkt = NULL;
-            mpp_list *ts = mpp->mTimeStamps;
+            MppRing *ts = mpp->mTimeStamps;
+            RK_S32 ts_full = ts->is_full();
 
-            AutoMutex autoLock(ts->mutex());
-            if (ts->list_size()) {
-                ts->del_at_head(&pkt, sizeof(pkt));
+            if (MPP_OK == ts->pop(&pkt)) {
                 mpp_frame_set_dts(frame, mpp_packet_get_dts(pkt));
                 mpp_frame_set_pts(frame, mpp_packet_get_pts(pkt));
                 mpp_packet_deinit(&pkt);
+
+                // parser holds input packet on full timestamp ring
+                if (ts_full)
+                    mpp_dec_notify(dec, MPP_DEC_NOTIFY_TIMESTAMP_VALID);
             } else
                 mpp_err_f("pull out packet error.\n");
         }
@@ -388,7 +462,6 @@ static void mpp_dec_put_frame(Mpp *mpp, RK_S32 index, HalDecTaskFlag flags)
         dec_vproc_signal(dec->vproc);
     } else {
         // direct output -> copy a new MppFrame and output
-        mpp_list *list = mpp->mFrames;
         MppFrame out = NULL;
 
         mpp_frame_init(&out);
@@ -397,11 +470,7 @@ static void mpp_dec_put_frame(Mpp *mpp, RK_S32 index, HalDecTaskFlag flags)
         if (mpp_debug & MPP_DBG_PTS)
             mpp_log("output frame pts %lld\n", mpp_frame_get_pts(out));
 
-        list->lock();
-        list->add_at_tail(&out, sizeof(out));
-        mpp->mFramePutCount++;
-        list->signal();
-        list->unlock();
+        mpp_dec_push_frame(dec, out);
 
         if (fake_frame)
             mpp_frame_deinit(&frame);
@@ -452,6 +521,76 @@ static void mpp_dec_put_task(Mpp *mpp, DecTask *task)
     task->hnd = NULL;
 }
 
+static MPP_RET dec_push_frame_ring(MppDecImpl *dec, MppFrame *frame)
+{
+    Mpp *mpp = (Mpp *)dec->mpp;
+    RK_U32 event = MPP_DEC_EVENT_FRAME_READY;
+
+    // frame may be released by user once it is pushed
+    if (mpp_frame_get_info_change(*frame))
+        event |= MPP_DEC_EVENT_INFO_CHANGE;
+
+    if (mpp->mFrames->push(frame))
+        return MPP_NOK;
+
+    mpp->mFramePutCount++;
+    mpp->set_event(event);
+    return MPP_OK;
+}
+
+static void *dec_frame_destructor(void *arg)
+{
+    mpp_frame_deinit((MppFrame *)arg);
+    return NULL;
+}
+
+/*
+ * Frame output never waits on the frame ring. When the ring is full the frame
+ * is kept in order on pending list and pushed on next get_frame. The hal job
+ * waits for the pending list before it starts next task so the frames pending
+ * are limited by the hal task instead of blocking hardware output.
+ */
+void mpp_dec_push_frame(MppDecImpl *dec, MppFrame frame)
+{
+    mpp_list *pending = dec->frame_pending;
+    AutoMutex auto_lock(pending->mutex());
+
+    if (!pending->list_size() && !dec_push_frame_ring(dec, &frame))
+        return;
+
+    // frames are flushed on reset and stop
+    if (MPP_LOAD_ACQUIRE(&dec->frame_ring_abort)) {
+        mpp_frame_deinit(&frame);
+        return;
+    }
+
+    dec_dbg_detail("%p frame ring is full, pending frame\n", dec);
+    pending->add_at_tail(&frame, sizeof(frame));
+}
+
+/* push pending frames to frame ring, return MPP_NOK when ring is full */
+static MPP_RET dec_flush_pending_frames(MppDecImpl *dec)
+{
+    mpp_list *pending = dec->frame_pending;
+    AutoMutex auto_lock(pending->mutex());
+    MppFrame frame = NULL;
+
+    while (pending->list_size()) {
+        if (MPP_LOAD_ACQUIRE(&dec->frame_ring_abort)) {
+            pending->flush();
+            break;
+        }
+
+        pending->del_at_head(&frame, sizeof(frame));
+        if (dec_push_frame_ring(dec, &frame)) {
+            pending->add_at_head(&frame, sizeof(frame));
+            return MPP_NOK;
+        }
+    }
+
+    return MPP_OK;
+}
+
 static void reset_hal_thread(Mpp *mpp)
 {
     MppDecImpl *dec = (MppDecImpl *)mpp->mDec;
@@ -471,6 +610,9 @@ static void reset_hal_thread(Mpp *mpp)
         mpp_buf_slot_clr_flag(frame_slots, index, SLOT_QUEUE_USE);
     }
 
+    // frames pending on full frame ring are dropped on reset
+    dec_flush_pending_frames(dec);
+
     // Need to set processed task to idle status
     while (MPP_OK == hal_task_get_hnd(tasks, TASK_PROC_DONE, &task)) {
         if (task) {
@@ -482,6 +624,54 @@ static void reset_hal_thread(Mpp *mpp)
     dec->thread_hal->unlock(THREAD_OUTPUT);
 }
 
+/* collect the previous task from hal and return MPP_NOK when it is not done */
+static MPP_RET dec_check_prev_task(HalTaskGroup tasks, DecTask *task)
+{
+    HalTaskHnd task_prev = NULL;
+
+    if (task->status.prev_task_rdy)
+        return MPP_OK;
+
+    hal_task_get_hnd(tasks, TASK_PROC_DONE, &task_prev);
+    if (NULL == task_prev) {
+        task->wait.prev_task = 1;
+        return MPP_NOK;
+    }
+
+    task->status.prev_task_rdy  = 1;
+    task->wait.prev_task = 0;
+    hal_task_hnd_set_status(task_prev, TASK_IDLE);
+    return MPP_OK;
+}
+
+/*
+ * On pipeline mode the task is parsed before the hardware callback of its
+ * reference frames. Pass the reference error marked by the callback to the
+ * task like the parser does with its dpb error status. It is also done with
+ * pipeline mode off so that both modes output the same frame errinfo.
+ */
+static void dec_check_refer_error(MppDecImpl *dec, HalDecTask *task_dec)
+{
+    RK_U32 i;
+
+    if (dec->disable_error || task_dec->flags.ref_err)
+        return;
+
+    for (i = 0; i < MPP_ARRAY_ELEMS(task_dec->refer); i++) {
+        RK_S32 index = task_dec->refer[i];
+        MppFrame frame = NULL;
+
+        if (index < 0 || index == task_dec->output)
+            continue;
+
+        mpp_buf_slot_get_prop(dec->frame_slots, index, SLOT_FRAME_PTR, &frame);
+        if (frame && mpp_frame_get_errinfo(frame)) {
+            task_dec->flags.ref_err = 1;
+            break;
+        }
+    }
+}
+
 static MPP_RET try_proc_dec_task(Mpp *mpp, DecTask *task)
 {
     MppDecImpl *dec = (MppDecImpl *)mpp->mDec;
@@ -511,29 +701,39 @@ static MPP_RET try_proc_dec_task(Mpp *mpp, DecTask *task)
      * 2. get packet for parser preparing
      */
     if (!dec->mpp_pkt_in && !task->status.curr_task_rdy) {
-        mpp_list *packets = mpp->mPackets;
-        AutoMutex autolock(packets->mutex());
+        MppRing *packets = mpp->mPackets;
+
+        // keep packet in ring until its timestamp can be recorded
+        task->wait.dec_ts_full = dec->use_preset_time_order &&
+                                 mpp->mTimeStamps->is_full();
+        if (task->wait.dec_ts_full)
+            return MPP_NOK;
 
-        if (!packets->list_size()) {
+        if (packets->pop(&dec->mpp_pkt_in)) {
             task->wait.dec_pkt_in = 1;
             return MPP_NOK;
         }
 
         task->wait.dec_pkt_in = 0;
-        packets->del_at_head(&dec->mpp_pkt_in, sizeof(dec->mpp_pkt_in));
         mpp->mPacketGetCount++;
         dec->dec_in_pkt_count++;
 
+        // same queue depth as the put_packet accept rule
+        if (packets->ring_size() < mpp->mPipeCfg.packet_queue)
+            mpp->set_event(MPP_DEC_EVENT_INPUT_READY);
+
         if (dec->use_preset_time_order) {
             MppPacket pkt_in = NULL;
-            mpp_list *ts = mpp->mTimeStamps;
+            MppRing *ts = mpp->mTimeStamps;
 
-            AutoMutex autoLock(ts->mutex());
             mpp_packet_new(&pkt_in);
             if (pkt_in) {
                 mpp_packet_set_pts(pkt_in, mpp_packet_get_pts(dec->mpp_pkt_in));
                 mpp_packet_set_dts(pkt_in, mpp_packet_get_dts(dec->mpp_pkt_in));
-                ts->add_at_tail(&pkt_in, sizeof(pkt_in));
+                if (ts->push(&pkt_in)) {
+                    mpp_err_f("push timestamp failed on ring full\n");
+                    mpp_packet_deinit(&pkt_in);
+                }
             }
         }
     }
@@ -568,11 +768,17 @@ static MPP_RET try_proc_dec_task(Mpp *mpp, DecTask *task)
             mpp_log("input packet pts %lld\n",
                     mpp_packet_get_pts(dec->mpp_pkt_in));
 
+        mpp_trace_begin(mpp, "prs prepare", -1, 0);
         mpp_clock_start(dec->clocks[DEC_PRS_PREPARE]);
         mpp_parser_prepare(dec->parser, dec->mpp_pkt_in, task_dec);
         mpp_clock_pause(dec->clocks[DEC_PRS_PREPARE]);
+        mpp_trace_end(mpp, "prs prepare", task_dec->input, task_dec->valid);
 
-        if (0 == mpp_packet_get_length(dec->mpp_pkt_in)) {
+        /*
+         * Parser may reference the stream in input packet on a valid task.
+         * Then the consumed packet is released after the stream copy.
+         */
+        if (0 == mpp_packet_get_length(dec->mpp_pkt_in) && !task_dec->valid) {
             mpp_packet_deinit(&dec->mpp_pkt_in);
             dec->mpp_pkt_in = NULL;
         }
@@ -606,11 +812,31 @@ static MPP_RET try_proc_dec_task(Mpp *mpp, DecTask *task)
 
     /*
      * 5. malloc hardware buffer for the packet slot index
+     *
+     *    On zero copy input mode when the prepared packet is a MppBuffer from
+     *    its beginning the buffer is attached to the packet slot directly.
+     *    The packet slot holds the reference until hardware has finished.
+     *    Stream is only copied to buffer from packet group. A buffer borrowed
+     *    from application is never reused for the copy.
      */
     task->hal_pkt_idx_in = task_dec->input;
     stream_size = mpp_packet_get_size(task_dec->input_packet);
 
     mpp_buf_slot_get_prop(packet_slots, task->hal_pkt_idx_in, SLOT_BUFFER, &hal_buf_in);
+    if (!task->status.dec_pkt_copy_rdy) {
+        MppBuffer pkt_buf = mpp_packet_get_buffer(task_dec->input_packet);
+
+        if (dec->zero_copy_input && pkt_buf &&
+            mpp_packet_get_data(task_dec->input_packet) == mpp_buffer_get_ptr(pkt_buf)) {
+            if (pkt_buf != hal_buf_in)
+                mpp_buf_slot_set_prop(packet_slots, task->hal_pkt_idx_in, SLOT_BUFFER, pkt_buf);
+            hal_buf_in = pkt_buf;
+        } else if (hal_buf_in &&
+                   ((MppBufferImpl *)hal_buf_in)->group != (MppBufferGroupImpl *)mpp->mPacketGroup) {
+            hal_buf_in = NULL;
+        }
+    }
+
     if (NULL == hal_buf_in) {
         mpp_buffer_get(mpp->mPacketGroup, &hal_buf_in, stream_size);
         if (hal_buf_in) {
@@ -631,34 +857,37 @@ static MPP_RET try_proc_dec_task(Mpp *mpp, DecTask *task)
      * 6. copy prepared stream to hardware buffer
      */
     if (!task->status.dec_pkt_copy_rdy) {
-        void *dst = mpp_buffer_get_ptr(task->hal_pkt_buf_in);
-        void *src = mpp_packet_get_data(task_dec->input_packet);
         size_t length = mpp_packet_get_length(task_dec->input_packet);
 
-        memcpy(dst, src, length);
+        if (task->hal_pkt_buf_in == mpp_packet_get_buffer(task_dec->input_packet)) {
+            dec->dec_hal_ref_size += length;
+        } else {
+            void *dst = mpp_buffer_get_ptr(task->hal_pkt_buf_in);
+            void *src = mpp_packet_get_data(task_dec->input_packet);
+
+            if (mpp_parser_fill_stream(dec->parser, task_dec, dst))
+                memcpy(dst, src, length);
+            dec->dec_hal_copy_size += length;
+        }
         mpp_buf_slot_set_flag(packet_slots, task_dec->input, SLOT_CODEC_READY);
         mpp_buf_slot_set_flag(packet_slots, task_dec->input, SLOT_HAL_INPUT);
         task->status.dec_pkt_copy_rdy = 1;
-    }
 
-    /* 7.1 if not fast mode wait previous task done here */
-    if (!dec->parser_fast_mode) {
-        // wait previous task done
-        if (!task->status.prev_task_rdy) {
-            HalTaskHnd task_prev = NULL;
-            hal_task_get_hnd(tasks, TASK_PROC_DONE, &task_prev);
-            if (task_prev) {
-                task->status.prev_task_rdy  = 1;
-                task->wait.prev_task = 0;
-                hal_task_hnd_set_status(task_prev, TASK_IDLE);
-                task_prev = NULL;
-            } else {
-                task->wait.prev_task = 1;
-                return MPP_NOK;
-            }
+        if (dec->mpp_pkt_in && 0 == mpp_packet_get_length(dec->mpp_pkt_in)) {
+            mpp_packet_deinit(&dec->mpp_pkt_in);
+            dec->mpp_pkt_in = NULL;
         }
     }
 
+    /*
+     * 7.1 if not fast mode wait previous task done here
+     *     On pipeline mode this wait is deferred to register generation
+     */
+    if (!dec->parser_fast_mode && !dec->parser_pipeline) {
+        if (dec_check_prev_task(tasks, task))
+            return MPP_NOK;
+    }
+
     // for vp9 only wait all task is processed
     if (task->wait.dec_all_done) {
         if (!hal_task_check_empty(dec->tasks, TASK_PROCESSING))
@@ -671,7 +900,7 @@ static MPP_RET try_proc_dec_task(Mpp *mpp, DecTask *task)
 
     /* too many frame delay in dispaly queue */
     if (mpp->mFrames) {
-        task->wait.dis_que_full = (mpp->mFrames->list_size() > 4) ? 1 : 0;
+        task->wait.dis_que_full = (mpp->mFrames->ring_size() > mpp->mPipeCfg.frame_queue) ? 1 : 0;
         if (task->wait.dis_que_full)
             return MPP_ERR_DISPLAY_FULL;
     }
@@ -697,9 +926,11 @@ static MPP_RET try_proc_dec_task(Mpp *mpp, DecTask *task)
      *    4. detect whether output index has MppBuffer and task valid
      */
     if (!task->status.task_parsed_rdy) {
+        mpp_trace_begin(mpp, "prs parse", task_dec->input, 0);
         mpp_clock_start(dec->clocks[DEC_PRS_PARSE]);
         mpp_parser_parse(dec->parser, task_dec);
         mpp_clock_pause(dec->clocks[DEC_PRS_PARSE]);
+        mpp_trace_end(mpp, "prs parse", task_dec->input, task_dec->output);
         task->status.task_parsed_rdy = 1;
     }
 
@@ -804,15 +1035,33 @@ static MPP_RET try_proc_dec_task(Mpp *mpp, DecTask *task)
     if (task->wait.dec_pic_match)
         return MPP_NOK;
 
+    /*
+     * 11.1 on pipeline mode the frame is parsed while previous task is on
+     *      hardware. Hal without fast mode has only one register set and the
+     *      hardware runs in order so waiting previous task here also ensures
+     *      all reference frames are decoded and their callbacks are done.
+     */
+    if (dec->parser_pipeline) {
+        if (dec_check_prev_task(tasks, task))
+            return MPP_NOK;
+    }
+
+    if (dec->parser_refer_check)
+        dec_check_refer_error(dec, task_dec);
+
     /* generating registers table */
+    mpp_trace_begin(mpp, "gen reg", task_dec->input, task_dec->output);
     mpp_clock_start(dec->clocks[DEC_HAL_GEN_REG]);
     mpp_hal_reg_gen(dec->hal, &task->info);
     mpp_clock_pause(dec->clocks[DEC_HAL_GEN_REG]);
+    mpp_trace_end(mpp, "gen reg", task_dec->input, task_dec->output);
 
     /* send current register set to hardware */
+    mpp_trace_begin(mpp, "hw start", task_dec->input, task_dec->output);
     mpp_clock_start(dec->clocks[DEC_HW_START]);
     mpp_hal_hw_start(dec->hal, &task->info);
     mpp_clock_pause(dec->clocks[DEC_HW_START]);
+    mpp_trace_end(mpp, "hw start", task_dec->input, task_dec->output);
 
     /*
      * 12. send dxva output information and buffer information to hal thread
@@ -834,70 +1083,99 @@ static MPP_RET try_proc_dec_task(Mpp *mpp, DecTask *task)
     return MPP_OK;
 }
 
-void *mpp_dec_parser_thread(void *data)
+static void mpp_dec_parser_exit(Mpp *mpp, DecTask *task)
 {
-    Mpp *mpp = (Mpp*)data;
     MppDecImpl *dec = (MppDecImpl *)mpp->mDec;
-    MppThread *parser = dec->thread_parser;
     MppBufSlots packet_slots = dec->packet_slots;
+    HalDecTask *task_dec = &task->info.dec;
 
-    DecTask task;
-    HalDecTask  *task_dec = &task.info.dec;
+    if (dec->parser_waiting) {
+        mpp_clock_pause(dec->clocks[DEC_PRS_WAIT]);
+        dec_wait_stat_end(dec);
+        dec->parser_waiting = 0;
+    }
+    mpp_clock_pause(dec->clocks[DEC_PRS_TOTAL]);
 
-    dec_task_init(&task);
+    mpp_dbg(MPP_DBG_INFO, "mpp_dec_parser_thread is going to exit\n");
+    if (task->hnd && task_dec->valid) {
+        mpp_buf_slot_set_flag(packet_slots, task_dec->input, SLOT_CODEC_READY);
+        mpp_buf_slot_set_flag(packet_slots, task_dec->input, SLOT_HAL_INPUT);
+        mpp_buf_slot_clr_flag(packet_slots, task_dec->input, SLOT_HAL_INPUT);
+    }
+    mpp_buffer_group_clear(mpp->mPacketGroup);
+    mpp_dbg(MPP_DBG_INFO, "mpp_dec_parser_thread exited\n");
+}
 
-    mpp_clock_start(dec->clocks[DEC_PRS_TOTAL]);
+/*
+ * One step of parser working loop. It is driven by parser thread or by the
+ * shared worker pool and resumed by mpp_dec_notify.
+ */
+static MppJobRet mpp_dec_parser_job(void *data)
+{
+    Mpp *mpp = (Mpp*)data;
+    MppDecImpl *dec = (MppDecImpl *)mpp->mDec;
+    MppThread *parser = dec->thread_parser;
+    DecTask *task = (DecTask *)dec->task_parser;
+    RK_U32 running = 1;
+
+    if (dec->parser_waiting) {
+        mpp_clock_pause(dec->clocks[DEC_PRS_WAIT]);
+        mpp_trace_end(mpp, "prs wait", -1, dec->parser_wait_flag);
+        dec_wait_stat_end(dec);
+        dec->parser_waiting = 0;
+    }
 
-    while (1) {
-        {
-            AutoMutex autolock(parser->mutex());
-            if (MPP_THREAD_RUNNING != parser->get_status())
-                break;
+    {
+        AutoMutex autolock(parser->mutex());
+        if (MPP_THREAD_RUNNING != parser->get_status())
+            running = 0;
 
-            /*
-             * parser thread need to wait at cases below:
-             * 1. no task slot for output
-             * 2. no packet for parsing
-             * 3. info change on progress
-             * 3. no buffer on analyzing output task
-             */
-            if (check_task_wait(dec, &task)) {
-                mpp_clock_start(dec->clocks[DEC_PRS_WAIT]);
-                parser->wait();
-                mpp_clock_pause(dec->clocks[DEC_PRS_WAIT]);
-            }
+        /*
+         * parser thread need to wait at cases below:
+         * 1. no task slot for output
+         * 2. no packet for parsing
+         * 3. info change on progress
+         * 3. no buffer on analyzing output task
+         */
+        if (running && check_task_wait(dec, task)) {
+            /* wait reason bits of PaserTaskWait in arg */
+            mpp_trace_begin(mpp, "prs wait", -1, task->wait.val);
+            mpp_clock_start(dec->clocks[DEC_PRS_WAIT]);
+            dec_wait_stat_start(dec, task->wait.val);
+            dec->parser_waiting = 1;
+            return MPP_JOB_WAIT;
         }
+    }
 
-        if (dec->reset_flag) {
-            reset_parser_thread(mpp, &task);
+    if (!running) {
+        mpp_dec_parser_exit(mpp, task);
+        return MPP_JOB_EXIT;
+    }
 
-            AutoMutex autolock(parser->mutex(THREAD_CONTROL));
-            dec->reset_flag = 0;
-            sem_post(&dec->parser_reset);
-            continue;
-        }
+    if (dec->reset_flag) {
+        if (reset_parser_thread(mpp, task))
+            return MPP_JOB_WAIT;
 
-        // NOTE: ignore return value here is to fast response to reset.
-        // Otherwise we can loop all dec task until it is failed.
-        mpp_clock_start(dec->clocks[DEC_PRS_PROC]);
-        try_proc_dec_task(mpp, &task);
-        mpp_clock_pause(dec->clocks[DEC_PRS_PROC]);
+        AutoMutex autolock(parser->mutex(THREAD_CONTROL));
+        dec->reset_flag = 0;
+        sem_post(&dec->parser_reset);
+        return MPP_JOB_CONTINUE;
     }
 
-    mpp_clock_pause(dec->clocks[DEC_PRS_TOTAL]);
+    // NOTE: ignore return value here is to fast response to reset.
+    // Otherwise we can loop all dec task until it is failed.
+    mpp_clock_start(dec->clocks[DEC_PRS_PROC]);
+    try_proc_dec_task(mpp, task);
+    mpp_clock_pause(dec->clocks[DEC_PRS_PROC]);
 
-    mpp_dbg(MPP_DBG_INFO, "mpp_dec_parser_thread is going to exit\n");
-    if (task.hnd && task_dec->valid) {
-        mpp_buf_slot_set_flag(packet_slots, task_dec->input, SLOT_CODEC_READY);
-        mpp_buf_slot_set_flag(packet_slots, task_dec->input, SLOT_HAL_INPUT);
-        mpp_buf_slot_clr_flag(packet_slots, task_dec->input, SLOT_HAL_INPUT);
-    }
-    mpp_buffer_group_clear(mpp->mPacketGroup);
-    mpp_dbg(MPP_DBG_INFO, "mpp_dec_parser_thread exited\n");
-    return NULL;
+    return MPP_JOB_CONTINUE;
 }
 
-void *mpp_dec_hal_thread(void *data)
+/*
+ * One step of hal working loop. It is driven by hal thread or by the shared
+ * worker pool and resumed by the parser notification.
+ */
+static MppJobRet mpp_dec_hal_job(void *data)
 {
     Mpp *mpp = (Mpp*)data;
     MppDecImpl *dec = (MppDecImpl *)mpp->mDec;
@@ -910,129 +1188,154 @@ void *mpp_dec_hal_thread(void *data)
     HalTaskInfo task_info;
     HalDecTask  *task_dec = &task_info.dec;
 
-    mpp_clock_start(dec->clocks[DEC_HAL_TOTAL]);
+    if (dec->hal_waiting) {
+        mpp_clock_pause(dec->clocks[DEC_HAL_WAIT]);
+        mpp_trace_end(mpp, "hal wait", -1, 0);
+        dec->hal_waiting = 0;
+    }
 
-    while (1) {
-        /* hal thread wait for dxva interface intput first */
-        {
-            AutoMutex work_lock(hal->mutex());
-            if (MPP_THREAD_RUNNING != hal->get_status())
-                break;
+    /* frames pending on full frame ring are output before next task */
+    if (dec->frame_pending->list_size()) {
+        hal->lock();
+        dec->hal_frame_wait = 1;
+        hal->unlock();
 
-            if (hal_task_get_hnd(tasks, TASK_PROCESSING, &task)) {
-                // process all task then do reset process
-                if (dec->hal_reset_post != dec->hal_reset_done) {
-                    dec_dbg_reset("reset: hal reset start\n");
-                    reset_hal_thread(mpp);
-                    dec_dbg_reset("reset: hal reset done\n");
-                    dec->hal_reset_done++;
-                    sem_post(&dec->hal_reset);
-                    continue;
-                }
+        if (dec_flush_pending_frames(dec))
+            return MPP_JOB_WAIT;
 
-                mpp_dec_notify(dec, MPP_DEC_NOTIFY_TASK_ALL_DONE);
-                mpp_clock_start(dec->clocks[DEC_HAL_WAIT]);
-                hal->wait();
-                mpp_clock_pause(dec->clocks[DEC_HAL_WAIT]);
-                continue;
+        hal->lock();
+        dec->hal_frame_wait = 0;
+        hal->unlock();
+    }
+
+    /* hal thread wait for dxva interface intput first */
+    {
+        AutoMutex work_lock(hal->mutex());
+        if (MPP_THREAD_RUNNING != hal->get_status()) {
+            mpp_clock_pause(dec->clocks[DEC_HAL_TOTAL]);
+
+            mpp_assert(mpp->mTaskPutCount == mpp->mTaskGetCount);
+            mpp_dbg(MPP_DBG_INFO, "mpp_dec_hal_thread exited\n");
+            return MPP_JOB_EXIT;
+        }
+
+        if (hal_task_get_hnd(tasks, TASK_PROCESSING, &task)) {
+            // process all task then do reset process
+            if (dec->hal_reset_post != dec->hal_reset_done) {
+                dec_dbg_reset("reset: hal reset start\n");
+                reset_hal_thread(mpp);
+                dec_dbg_reset("reset: hal reset done\n");
+                dec->hal_reset_done++;
+                sem_post(&dec->hal_reset);
+
+                dec->thread_parser->lock();
+                dec->thread_parser->signal();
+                dec->thread_parser->unlock();
+                return MPP_JOB_CONTINUE;
             }
+
+            mpp_dec_notify(dec, MPP_DEC_NOTIFY_TASK_ALL_DONE);
+            mpp_trace_begin(mpp, "hal wait", -1, 0);
+            mpp_clock_start(dec->clocks[DEC_HAL_WAIT]);
+            dec->hal_waiting = 1;
+            return MPP_JOB_WAIT;
         }
+    }
 
-        if (task) {
-            RK_U32 notify_flag = MPP_DEC_NOTIFY_TASK_HND_VALID;
+    if (task) {
+        RK_U32 notify_flag = MPP_DEC_NOTIFY_TASK_HND_VALID;
 
-            mpp_clock_start(dec->clocks[DEC_HAL_PROC]);
-            mpp->mTaskGetCount++;
+        mpp_clock_start(dec->clocks[DEC_HAL_PROC]);
+        mpp->mTaskGetCount++;
 
-            hal_task_hnd_get_info(task, &task_info);
+        hal_task_hnd_get_info(task, &task_info);
 
+        /*
+         * check info change flag
+         * if this is a frame with that flag, only output an empty
+         * MppFrame without any image data for info change.
+         */
+        if (task_dec->flags.info_change) {
+            mpp_dec_flush(dec);
+            mpp_dec_push_display(mpp, task_dec->flags);
+            mpp_dec_put_frame(mpp, task_dec->output, task_dec->flags);
+
+            hal_task_hnd_set_status(task, TASK_IDLE);
+            task = NULL;
+            mpp_dec_notify(dec, notify_flag);
+            mpp_clock_pause(dec->clocks[DEC_HAL_PROC]);
+            return MPP_JOB_CONTINUE;
+        }
+        /*
+         * check eos task
+         * if this task is invalid while eos flag is set, we will
+         * flush display queue then push the eos frame to info that
+         * all frames have decoded.
+         */
+        if (task_dec->flags.eos &&
+            (!task_dec->valid || task_dec->output < 0)) {
+            mpp_dec_push_display(mpp, task_dec->flags);
             /*
-             * check info change flag
-             * if this is a frame with that flag, only output an empty
-             * MppFrame without any image data for info change.
-             */
-            if (task_dec->flags.info_change) {
-                mpp_dec_flush(dec);
-                mpp_dec_push_display(mpp, task_dec->flags);
-                mpp_dec_put_frame(mpp, task_dec->output, task_dec->flags);
-
-                hal_task_hnd_set_status(task, TASK_IDLE);
-                task = NULL;
-                mpp_dec_notify(dec, notify_flag);
-                mpp_clock_pause(dec->clocks[DEC_HAL_PROC]);
-                continue;
-            }
-            /*
-             * check eos task
-             * if this task is invalid while eos flag is set, we will
-             * flush display queue then push the eos frame to info that
-             * all frames have decoded.
+             * Use -1 as invalid buffer slot index.
+             * Reason: the last task maybe is a empty task with eos flag
+             * only but this task may go through vproc process also. We need
+             * create a buffer slot index for it.
              */
-            if (task_dec->flags.eos &&
-                (!task_dec->valid || task_dec->output < 0)) {
-                mpp_dec_push_display(mpp, task_dec->flags);
-                /*
-                 * Use -1 as invalid buffer slot index.
-                 * Reason: the last task maybe is a empty task with eos flag
-                 * only but this task may go through vproc process also. We need
-                 * create a buffer slot index for it.
-                 */
-                mpp_dec_put_frame(mpp, -1, task_dec->flags);
-
-                hal_task_hnd_set_status(task, TASK_IDLE);
-                task = NULL;
-                mpp_dec_notify(dec, notify_flag);
-                mpp_clock_pause(dec->clocks[DEC_HAL_PROC]);
-                continue;
-            }
+            mpp_dec_put_frame(mpp, -1, task_dec->flags);
 
-            mpp_clock_start(dec->clocks[DEC_HW_WAIT]);
-            mpp_hal_hw_wait(dec->hal, &task_info);
-            mpp_clock_pause(dec->clocks[DEC_HW_WAIT]);
-            dec->dec_hw_run_count++;
+            hal_task_hnd_set_status(task, TASK_IDLE);
+            task = NULL;
+            mpp_dec_notify(dec, notify_flag);
+            mpp_clock_pause(dec->clocks[DEC_HAL_PROC]);
+            return MPP_JOB_CONTINUE;
+        }
 
-            /*
-             * when hardware decoding is done:
-             * 1. clear decoding flag (mark buffer is ready)
-             * 2. use get_display to get a new frame with buffer
-             * 3. add frame to output list
-             * repeat 2 and 3 until not frame can be output
-             */
-            mpp_buf_slot_clr_flag(packet_slots, task_dec->input,
-                                  SLOT_HAL_INPUT);
+        mpp_trace_begin(mpp, "hw wait", task_dec->input, task_dec->output);
+        mpp_clock_start(dec->clocks[DEC_HW_WAIT]);
+        MppThread::block_begin();
+        mpp_hal_hw_wait(dec->hal, &task_info);
+        MppThread::block_end();
+        mpp_clock_pause(dec->clocks[DEC_HW_WAIT]);
+        mpp_trace_end(mpp, "hw wait", task_dec->input, task_dec->output);
+        dec->dec_hw_run_count++;
 
-            hal_task_hnd_set_status(task, (dec->parser_fast_mode) ?
-                                    (TASK_IDLE) : (TASK_PROC_DONE));
+        /*
+         * when hardware decoding is done:
+         * 1. clear decoding flag (mark buffer is ready)
+         * 2. use get_display to get a new frame with buffer
+         * 3. add frame to output list
+         * repeat 2 and 3 until not frame can be output
+         */
+        mpp_buf_slot_clr_flag(packet_slots, task_dec->input,
+                              SLOT_HAL_INPUT);
 
-            if (dec->parser_fast_mode)
-                notify_flag |= MPP_DEC_NOTIFY_TASK_HND_VALID;
-            else
-                notify_flag |= MPP_DEC_NOTIFY_TASK_PREV_DONE;
+        hal_task_hnd_set_status(task, (dec->parser_fast_mode) ?
+                                (TASK_IDLE) : (TASK_PROC_DONE));
 
-            task = NULL;
+        if (dec->parser_fast_mode)
+            notify_flag |= MPP_DEC_NOTIFY_TASK_HND_VALID;
+        else
+            notify_flag |= MPP_DEC_NOTIFY_TASK_PREV_DONE;
 
-            if (task_dec->output >= 0)
-                mpp_buf_slot_clr_flag(frame_slots, task_dec->output, SLOT_HAL_OUTPUT);
+        task = NULL;
 
-            for (RK_U32 i = 0; i < MPP_ARRAY_ELEMS(task_dec->refer); i++) {
-                RK_S32 index = task_dec->refer[i];
-                if (index >= 0)
-                    mpp_buf_slot_clr_flag(frame_slots, index, SLOT_HAL_INPUT);
-            }
-            if (task_dec->flags.eos)
-                mpp_dec_flush(dec);
-            mpp_dec_push_display(mpp, task_dec->flags);
+        if (task_dec->output >= 0)
+            mpp_buf_slot_clr_flag(frame_slots, task_dec->output, SLOT_HAL_OUTPUT);
 
-            mpp_dec_notify(dec, notify_flag);
-            mpp_clock_pause(dec->clocks[DEC_HAL_PROC]);
+        for (RK_U32 i = 0; i < MPP_ARRAY_ELEMS(task_dec->refer); i++) {
+            RK_S32 index = task_dec->refer[i];
+            if (index >= 0)
+                mpp_buf_slot_clr_flag(frame_slots, index, SLOT_HAL_INPUT);
         }
-    }
+        if (task_dec->flags.eos)
+            mpp_dec_flush(dec);
+        mpp_dec_push_display(mpp, task_dec->flags);
 
-    mpp_clock_pause(dec->clocks[DEC_HAL_TOTAL]);
+        mpp_dec_notify(dec, notify_flag);
+        mpp_clock_pause(dec->clocks[DEC_HAL_PROC]);
+    }
 
-    mpp_assert(mpp->mTaskPutCount == mpp->mTaskGetCount);
-    mpp_dbg(MPP_DBG_INFO, "mpp_dec_hal_thread exited\n");
-    return NULL;
+    return MPP_JOB_CONTINUE;
 }
 
 static MPP_RET dec_release_task_in_port(MppPort port)
@@ -1254,6 +1557,38 @@ static const char *timing_str[DEC_TIMING_BUTT] = {
     "hw wait   ",
 };
 
+static void mpp_dec_get_perf_stats(MppDecImpl *dec, MppPerfStats *stats)
+{
+    size_t len;
+    RK_S32 i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (i = 0; i < DEC_TIMING_BUTT && i < MPP_PERF_STAGE_MAX; i++) {
+        MppPerfStage *stage = &stats->stages[i];
+        MppClockStat stat;
+
+        mpp_clock_get_stat(dec->clocks[i], &stat);
+
+        strncpy(stage->name, timing_str[i], sizeof(stage->name) - 1);
+        /* drop the alignment space for log */
+        len = strlen(stage->name);
+        while (len && stage->name[len - 1] == ' ')
+            stage->name[--len] = '\0';
+
+        stage->count = stat.count;
+        stage->sum   = stat.sum;
+        stage->min   = stat.min;
+        stage->max   = stat.max;
+        stage->p50   = stat.p50;
+        stage->p90   = stat.p90;
+        stage->p99   = stat.p99;
+        stage->p999  = stat.p999;
+    }
+
+    stats->stage_count = i;
+}
+
 MPP_RET mpp_dec_init(MppDec *dec, MppDecCfg *cfg)
 {
     RK_S32 i;
@@ -1264,6 +1599,8 @@ MPP_RET mpp_dec_init(MppDec *dec, MppDecCfg *cfg)
     Parser parser = NULL;
     MppHal hal = NULL;
     RK_S32 hal_task_count = 0;
+    RK_U32 pipeline = 0;
+    RK_U32 refer_check = 0;
     MppDecImpl *p = NULL;
     IOInterruptCB cb = {NULL, NULL};
 
@@ -1286,6 +1623,22 @@ MPP_RET mpp_dec_init(MppDec *dec, MppDecCfg *cfg)
     coding = cfg->coding;
     hal_task_count = (cfg->fast_mode) ? (3) : (2);
 
+    /*
+     * NOTE: pipeline mode is only for the parser that the hal callback only
+     * marks error on the frame of its own task. The callback runs on hal
+     * thread while next frame is parsing. VP9 parser updates probability from
+     * callback and HEVC parser updates max_ra and dpb error flag from parser
+     * state so both need the callback done before parsing next frame.
+     * Reference error check is on for these codings with or without pipeline.
+     */
+    refer_check = !cfg->fast_mode && (coding == MPP_VIDEO_CodingAVC ||
+                                      coding == MPP_VIDEO_CodingUnused);
+    pipeline = (cfg->fast_mode) ? 0 : cfg->pipeline_mode;
+    if (pipeline && !refer_check) {
+        mpp_log("parser pipeline mode is not supported on coding %x\n", coding);
+        pipeline = 0;
+    }
+
     do {
         ret = mpp_buf_slot_init(&frame_slots);
         if (ret) {
@@ -1347,7 +1700,10 @@ MPP_RET mpp_dec_init(MppDec *dec, MppDecCfg *cfg)
         p->mpp                  = cfg->mpp;
         p->parser_need_split    = cfg->need_split;
         p->parser_fast_mode     = cfg->fast_mode;
+        p->parser_pipeline      = pipeline;
+        p->parser_refer_check   = refer_check;
         p->parser_internal_pts  = cfg->internal_pts;
+        p->use_worker_pool      = cfg->worker_pool;
         p->enable_deinterlace   = 1;
 
         p->statistics_en        = (mpp_dec_debug & MPP_DEC_DBG_TIMING) ? 1 : 0;
@@ -1361,6 +1717,8 @@ MPP_RET mpp_dec_init(MppDec *dec, MppDecCfg *cfg)
         sem_init(&p->parser_reset, 0, 0);
         sem_init(&p->hal_reset, 0, 0);
 
+        p->frame_pending = new mpp_list(dec_frame_destructor);
+
         *dec = p;
         dec_dbg_func("%p out\n", p);
         return MPP_OK;
@@ -1433,6 +1791,11 @@ MPP_RET mpp_dec_deinit(MppDec ctx)
     sem_destroy(&dec->parser_reset);
     sem_destroy(&dec->hal_reset);
 
+    if (dec->frame_pending) {
+        delete dec->frame_pending;
+        dec->frame_pending = NULL;
+    }
+
     mpp_free(dec);
     dec_dbg_func("%p out\n", dec);
     return MPP_OK;
@@ -1446,10 +1809,27 @@ MPP_RET mpp_dec_start(MppDec ctx)
     dec_dbg_func("%p in\n", dec);
 
     if (dec->coding != MPP_VIDEO_CodingMJPEG) {
-        dec->thread_parser = new MppThread(mpp_dec_parser_thread,
-                                           dec->mpp, "mpp_dec_parser");
-        dec->thread_hal = new MppThread(mpp_dec_hal_thread,
-                                        dec->mpp, "mpp_dec_hal");
+        DecTask *task = mpp_calloc(DecTask, 1);
+
+        if (NULL == task) {
+            mpp_err_f("failed to malloc parser task\n");
+            return MPP_ERR_MALLOC;
+        }
+
+        dec_task_init(task);
+        dec->task_parser = task;
+        dec->parser_waiting = 0;
+        dec->hal_waiting = 0;
+
+        dec->thread_parser = new MppThread(mpp_dec_parser_job, dec->mpp,
+                                           "mpp_dec_parser",
+                                           dec->use_worker_pool);
+        dec->thread_hal = new MppThread(mpp_dec_hal_job, dec->mpp,
+                                        "mpp_dec_hal",
+                                        dec->use_worker_pool);
+
+        mpp_clock_start(dec->clocks[DEC_PRS_TOTAL]);
+        mpp_clock_start(dec->clocks[DEC_HAL_TOTAL]);
 
         dec->thread_parser->start();
         dec->thread_hal->start();
@@ -1470,6 +1850,8 @@ MPP_RET mpp_dec_stop(MppDec ctx)
 
     dec_dbg_func("%p in\n", dec);
 
+    MPP_STORE_RELEASE(&dec->frame_ring_abort, 1);
+
     if (dec->thread_parser)
         dec->thread_parser->stop();
 
@@ -1485,6 +1867,11 @@ MPP_RET mpp_dec_stop(MppDec ctx)
         dec->thread_hal = NULL;
     }
 
+    if (dec->frame_pending)
+        dec->frame_pending->flush();
+
+    MPP_FREE(dec->task_parser);
+
     dec_dbg_func("%p out\n", dec);
     return ret;
 }
@@ -1508,12 +1895,17 @@ MPP_RET mpp_dec_reset(MppDec ctx)
         // signal parser thread to reset
         mpp_dec_notify(dec, MPP_DEC_RESET);
         parser->unlock(THREAD_CONTROL);
+        // drop output frames pending on full frame ring
+        MPP_STORE_RELEASE(&dec->frame_ring_abort, 1);
         sem_wait(&dec->parser_reset);
+        MPP_STORE_RELEASE(&dec->frame_ring_abort, 0);
     }
 
     dec->dec_in_pkt_count = 0;
     dec->dec_hw_run_count = 0;
     dec->dec_out_frame_count = 0;
+    dec->dec_hal_copy_size = 0;
+    dec->dec_hal_ref_size = 0;
 
     dec_dbg_func("%p out\n", dec);
     return MPP_OK;
@@ -1556,6 +1948,22 @@ MPP_RET mpp_dec_notify(MppDec ctx, RK_U32 flag)
         }
     }
     thd_dec->unlock();
+
+    // user got frames then push pending frames and resume hal job
+    if ((flag & MPP_DEC_NOTIFY_FRAME_DEQUEUE) && dec->frame_pending &&
+        dec->thread_hal) {
+        MppThread *thd_hal = dec->thread_hal;
+
+        dec_flush_pending_frames(dec);
+
+        thd_hal->lock();
+        if (dec->hal_frame_wait) {
+            dec->hal_frame_wait = 0;
+            thd_hal->signal();
+        }
+        thd_hal->unlock();
+    }
+
     dec_dbg_func("%p out\n", dec);
     return MPP_OK;
 }
@@ -1606,6 +2014,51 @@ MPP_RET mpp_dec_control(MppDec ctx, MpiCmd cmd, void *param)
         dec->enable_deinterlace = (param) ? (*((RK_U32 *)param)) : (1);
         dec_dbg_func("enable deinterlace %d\n", dec->enable_deinterlace);
     } break;
+    case MPP_DEC_SET_ZERO_COPY_INPUT: {
+        dec->zero_copy_input = (param) ? (*((RK_U32 *)param)) : (1);
+        dec_dbg_func("zero copy input %d\n", dec->zero_copy_input);
+    } break;
+    case MPP_DEC_SET_PERF_STATS: {
+        RK_U32 enable = (param) ? (*((RK_U32 *)param)) : (1);
+        RK_S32 i;
+
+        for (i = 0; i < DEC_TIMING_BUTT; i++) {
+            mpp_clock_enable_histogram(dec->clocks[i], enable);
+            mpp_clock_enable(dec->clocks[i], enable);
+        }
+        dec->statistics_en = enable;
+        dec_dbg_func("perf stats %d\n", enable);
+    } break;
+    case MPP_DEC_GET_PERF_STATS: {
+        if (NULL == param) {
+            ret = MPP_ERR_NULL_PTR;
+            break;
+        }
+
+        mpp_dec_get_perf_stats(dec, (MppPerfStats *)param);
+    } break;
+    case MPP_DEC_GET_WAIT_STATS: {
+        MppDecWaitStats *stats = (MppDecWaitStats *)param;
+        Mpp *mpp = (Mpp *)dec->mpp;
+        RK_U32 count = 0;
+
+        if (NULL == stats) {
+            ret = MPP_ERR_NULL_PTR;
+            break;
+        }
+
+        memcpy(stats->reasons, dec->wait_stats, sizeof(stats->reasons));
+        stats->wait_count = dec->parser_wait_count;
+        stats->work_count = dec->parser_work_count;
+        stats->packet_queue = mpp->mPackets->ring_size();
+        stats->frame_queue = mpp->mFrames->ring_size();
+
+        hal_task_get_count(dec->tasks, TASK_PROCESSING, &count);
+        stats->task_processing = count;
+        count = 0;
+        hal_task_get_count(dec->tasks, TASK_IDLE, &count);
+        stats->task_idle = count;
+    } break;
     case MPP_DEC_QUERY: {
         MppDecQueryCfg *query = (MppDecQueryCfg *)param;
         RK_U32 flag = query->query_flag;
@@ -1632,6 +2085,15 @@ MPP_RET mpp_dec_control(MppDec ctx, MpiCmd cmd, void *param)
 
         if (flag & MPP_DEC_QUERY_DEC_OUT_FRM)
             query->dec_out_frm_cnt = dec->dec_out_frame_count;
+
+        if (flag & MPP_DEC_QUERY_STRM_COPY) {
+            Mpp *mpp = (Mpp *)dec->mpp;
+
+            query->in_copy_size = mpp->mPacketCopySize;
+            query->in_ref_size = mpp->mPacketRefSize;
+            query->hal_copy_size = dec->dec_hal_copy_size;
+            query->hal_ref_size = dec->dec_hal_ref_size;
+        }
     } break;
     default : {
     } break;
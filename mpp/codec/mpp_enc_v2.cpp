@@ -24,7 +24,9 @@
 #include "mpp_mem.h"
 #include "mpp_info.h"
 #include "mpp_time.h"
+#include "mpp_trace.h"
 #include "mpp_common.h"
+#include "mpp_atomic.h"
 
 #include "mpp_packet_impl.h"
 
@@ -59,6 +61,24 @@ typedef struct RcApiStatus_t {
     RK_U32              rc_api_user_cfg : 1;
 } RcApiStatus;
 
+// for timing record
+typedef enum MppEncTimingType_e {
+    ENC_FRM_TOTAL,
+    ENC_PROC_HAL,
+    ENC_GEN_REG,
+    ENC_HW_START,
+    ENC_HW_WAIT,
+    ENC_TIMING_BUTT,
+} MppEncTimingType;
+
+static const char *timing_str[ENC_TIMING_BUTT] = {
+    "frame",
+    "proc hal",
+    "gen reg",
+    "hw start",
+    "hw wait",
+};
+
 typedef struct MppEncImpl_t {
     MppCodingType       coding;
     EncImpl             impl;
@@ -83,8 +103,23 @@ typedef struct MppEncImpl_t {
     EncRcTask           rc_task;
 
     MppThread           *thread_enc;
+    RK_U32              use_worker_pool;
+    // EncTask kept across encoder job steps
+    void                *task_enc;
     void                *mpp;
 
+    /*
+     * pipeline mode: only one next task and its packet are prefetched while
+     * hardware is encoding. Hal has one register set so the rest of next
+     * frame runs after hal wait of current frame.
+     */
+    RK_U32              pipeline;
+    MppTask             next_in;
+    MppTask             next_out;
+    MppFrame            next_frm;
+    MppPacket           next_pkt;
+    size_t              next_pkt_size;
+
     // internal status and protection
     Mutex               lock;
     RK_U32              reset_flag;
@@ -95,13 +130,15 @@ typedef struct MppEncImpl_t {
     RK_U32              status_flag;
     RK_U32              notify_flag;
 
-    /* control process */
+    /* per stage latency statistic */
+    MppClock            clocks[ENC_TIMING_BUTT];
+
+    /* control process, cmd_send is released after cmd and param are set */
     RK_U32              cmd_send;
     RK_U32              cmd_recv;
     MpiCmd              cmd;
     void                *param;
     MPP_RET             *cmd_ret;
-    sem_t               cmd_start;
     sem_t               cmd_done;
 
     // legacy support for MPP_ENC_GET_EXTRA_INFO
@@ -289,6 +326,105 @@ static MPP_RET release_task_in_port(MppPort port)
     return ret;
 }
 
+/* NOTE: set buffer w * h * 1.5 to avoid buffer overflow */
+static size_t enc_packet_size(MppEncImpl *enc)
+{
+    RK_U32 width  = enc->cfg.prep.width;
+    RK_U32 height = enc->cfg.prep.height;
+
+    return MPP_ALIGN(width, 16) * MPP_ALIGN(height, 16) * 3 / 2;
+}
+
+static MppPacket enc_create_packet(Mpp *mpp, size_t size)
+{
+    MppPacket packet = NULL;
+    MppBuffer buffer = NULL;
+
+    mpp_assert(size);
+    mpp_buffer_get(mpp->mPacketGroup, &buffer, size);
+    mpp_packet_init_with_buffer(&packet, buffer);
+    /* NOTE: clear length for output */
+    mpp_packet_set_length(packet, 0);
+    mpp_buffer_put(buffer);
+
+    enc_dbg_detail("create output pkt %p buf %p\n", packet, buffer);
+    return packet;
+}
+
+/* hardware wait blocks the worker so let worker pool run the other jobs */
+static MPP_RET enc_hal_hw_wait(MppEncHal hal, HalEncTask *task)
+{
+    MPP_RET ret;
+
+    MppThread::block_begin();
+    ret = mpp_enc_hal_wait(hal, task);
+    MppThread::block_end();
+
+    return ret;
+}
+
+/*
+ * Prefetch next input / output task and create its output packet while the
+ * hardware is encoding current frame. Rate control and dpb of next frame are
+ * not touched here so they still start after rc_hal_end of current frame.
+ */
+static void enc_prefetch_task(Mpp *mpp, MppEncImpl *enc)
+{
+    MppPort input  = mpp_task_queue_get_port(mpp->mInputTaskQueue,  MPP_PORT_OUTPUT);
+    MppPort output = mpp_task_queue_get_port(mpp->mOutputTaskQueue, MPP_PORT_INPUT);
+
+    if (!enc->pipeline || enc->next_in)
+        return;
+
+    // pending control or reset will be processed before next frame
+    if (MPP_LOAD_ACQUIRE(&enc->cmd_send) != enc->cmd_recv || enc->reset_flag)
+        return;
+
+    if (mpp_port_poll(input, MPP_POLL_NON_BLOCK) ||
+        mpp_port_poll(output, MPP_POLL_NON_BLOCK))
+        return;
+
+    mpp_port_dequeue(input, &enc->next_in);
+    mpp_port_dequeue(output, &enc->next_out);
+    mpp_assert(enc->next_in && enc->next_out);
+
+    mpp_task_meta_get_frame (enc->next_in, KEY_INPUT_FRAME,  &enc->next_frm);
+    mpp_task_meta_get_packet(enc->next_in, KEY_OUTPUT_PACKET, &enc->next_pkt);
+
+    if (enc->next_frm && mpp_frame_get_buffer(enc->next_frm) && NULL == enc->next_pkt) {
+        enc->next_pkt_size = enc_packet_size(enc);
+        enc->next_pkt = enc_create_packet(mpp, enc->next_pkt_size);
+    }
+
+    enc_dbg_detail("task prefetch frm %p pkt %p\n", enc->next_frm, enc->next_pkt);
+}
+
+static void enc_release_prefetch(Mpp *mpp, MppEncImpl *enc)
+{
+    MppPort input  = mpp_task_queue_get_port(mpp->mInputTaskQueue,  MPP_PORT_OUTPUT);
+    MppPort output = mpp_task_queue_get_port(mpp->mOutputTaskQueue, MPP_PORT_INPUT);
+
+    if (NULL == enc->next_in)
+        return;
+
+    // return the frame to user and drop the packet created by encoder
+    if (enc->next_pkt_size && enc->next_pkt)
+        mpp_packet_deinit(&enc->next_pkt);
+
+    if (enc->next_pkt)
+        mpp_task_meta_set_packet(enc->next_in, KEY_OUTPUT_PACKET, enc->next_pkt);
+
+    mpp_task_meta_set_frame(enc->next_in, KEY_INPUT_FRAME, enc->next_frm);
+    mpp_port_enqueue(input, enc->next_in);
+    mpp_port_enqueue(output, enc->next_out);
+
+    enc->next_in = NULL;
+    enc->next_out = NULL;
+    enc->next_frm = NULL;
+    enc->next_pkt = NULL;
+    enc->next_pkt_size = 0;
+}
+
 static MPP_RET check_enc_task_wait(MppEncImpl *enc, EncTask *task)
 {
     MPP_RET ret = MPP_OK;
@@ -687,6 +823,19 @@ MPP_RET mpp_enc_proc_cfg(MppEncImpl *enc, MpiCmd cmd, void *param)
         goto TASK_DONE;                                 \
     }
 
+/* trace span and clock are always closed before going to TASK_DONE */
+#define ENC_RUN_FUNC_TRACE(name, clk, seq, func, ctx, task, mpp, ret) \
+    mpp_trace_begin(mpp, name, seq, 0);                 \
+    mpp_clock_start(enc->clocks[clk]);                  \
+    ret = func(ctx, task);                              \
+    mpp_clock_pause(enc->clocks[clk]);                  \
+    mpp_trace_end(mpp, name, seq, ret);                 \
+    if (ret) {                                          \
+        mpp_err("mpp %p "#func":%-4d failed return %d", \
+                mpp, __LINE__, ret);                    \
+        goto TASK_DONE;                                 \
+    }
+
 static const char *name_of_rc_mode[] = {
     "cbr",
     "vbr",
@@ -962,7 +1111,8 @@ static MPP_RET mpp_enc_normal(Mpp *mpp, EncTask *task)
     }
 
     enc_dbg_detail("task %d enc proc hal\n", frm->seq_idx);
-    ENC_RUN_FUNC2(enc_impl_proc_hal, impl, hal_task, mpp, ret);
+    ENC_RUN_FUNC_TRACE("enc proc hal", ENC_PROC_HAL, frm->seq_idx,
+                       enc_impl_proc_hal, impl, hal_task, mpp, ret);
 
     enc_dbg_detail("task %d hal get task\n", frm->seq_idx);
     ENC_RUN_FUNC2(mpp_enc_hal_get_task, hal, hal_task, mpp, ret);
@@ -971,13 +1121,19 @@ static MPP_RET mpp_enc_normal(Mpp *mpp, EncTask *task)
     ENC_RUN_FUNC2(rc_hal_start, enc->rc_ctx, rc_task, mpp, ret);
 
     enc_dbg_detail("task %d hal generate reg\n", frm->seq_idx);
-    ENC_RUN_FUNC2(mpp_enc_hal_gen_regs, hal, hal_task, mpp, ret);
+    ENC_RUN_FUNC_TRACE("enc gen reg", ENC_GEN_REG, frm->seq_idx,
+                       mpp_enc_hal_gen_regs, hal, hal_task, mpp, ret);
 
     enc_dbg_detail("task %d hal start\n", frm->seq_idx);
-    ENC_RUN_FUNC2(mpp_enc_hal_start, hal, hal_task, mpp, ret);
+    ENC_RUN_FUNC_TRACE("enc hw start", ENC_HW_START, frm->seq_idx,
+                       mpp_enc_hal_start, hal, hal_task, mpp, ret);
+
+    // prepare next task during hardware encoding on pipeline mode
+    enc_prefetch_task(mpp, enc);
 
     enc_dbg_detail("task %d hal wait\n", frm->seq_idx);
-    ENC_RUN_FUNC2(mpp_enc_hal_wait,  hal, hal_task, mpp, ret);
+    ENC_RUN_FUNC_TRACE("enc hw wait", ENC_HW_WAIT, frm->seq_idx,
+                       enc_hal_hw_wait, hal, hal_task, mpp, ret);
 
     enc_dbg_detail("task %d rc hal end\n", frm->seq_idx);
     ENC_RUN_FUNC2(rc_hal_end, enc->rc_ctx, rc_task, mpp, ret);
@@ -1004,7 +1160,8 @@ static MPP_RET mpp_enc_reenc_simple(Mpp *mpp, EncTask *task)
     enc_dbg_func("enter\n");
 
     enc_dbg_detail("task %d enc proc hal\n", frm->seq_idx);
-    ENC_RUN_FUNC2(enc_impl_proc_hal, enc->impl, hal_task, mpp, ret);
+    ENC_RUN_FUNC_TRACE("enc proc hal", ENC_PROC_HAL, frm->seq_idx,
+                       enc_impl_proc_hal, enc->impl, hal_task, mpp, ret);
 
     enc_dbg_detail("task %d hal get task\n", frm->seq_idx);
     ENC_RUN_FUNC2(mpp_enc_hal_get_task, hal, hal_task, mpp, ret);
@@ -1013,13 +1170,16 @@ static MPP_RET mpp_enc_reenc_simple(Mpp *mpp, EncTask *task)
     ENC_RUN_FUNC2(rc_hal_start, enc->rc_ctx, rc_task, mpp, ret);
 
     enc_dbg_detail("task %d hal generate reg\n", frm->seq_idx);
-    ENC_RUN_FUNC2(mpp_enc_hal_gen_regs, hal, hal_task, mpp, ret);
+    ENC_RUN_FUNC_TRACE("enc gen reg", ENC_GEN_REG, frm->seq_idx,
+                       mpp_enc_hal_gen_regs, hal, hal_task, mpp, ret);
 
     enc_dbg_detail("task %d hal start\n", frm->seq_idx);
-    ENC_RUN_FUNC2(mpp_enc_hal_start, hal, hal_task, mpp, ret);
+    ENC_RUN_FUNC_TRACE("enc hw start", ENC_HW_START, frm->seq_idx,
+                       mpp_enc_hal_start, hal, hal_task, mpp, ret);
 
     enc_dbg_detail("task %d hal wait\n", frm->seq_idx);
-    ENC_RUN_FUNC2(mpp_enc_hal_wait,  hal, hal_task, mpp, ret);
+    ENC_RUN_FUNC_TRACE("enc hw wait", ENC_HW_WAIT, frm->seq_idx,
+                       enc_hal_hw_wait, hal, hal_task, mpp, ret);
 
     enc_dbg_detail("task %d rc hal end\n", frm->seq_idx);
     ENC_RUN_FUNC2(rc_hal_end, enc->rc_ctx, rc_task, mpp, ret);
@@ -1098,7 +1258,22 @@ TASK_DONE:
     return ret;
 }
 
-void *mpp_enc_thread(void *data)
+static void mpp_enc_job_exit(Mpp *mpp)
+{
+    MppPort input  = mpp_task_queue_get_port(mpp->mInputTaskQueue,  MPP_PORT_OUTPUT);
+
+    enc_release_prefetch(mpp, (MppEncImpl *)mpp->mEnc);
+
+    // clear remain task in output port
+    release_task_in_port(input);
+    release_task_in_port(mpp->mOutputPort);
+}
+
+/*
+ * One step of encoder working loop. It is driven by encoder thread or by the
+ * shared worker pool and resumed by mpp_enc_notify_v2.
+ */
+static MppJobRet mpp_enc_job(void *data)
 {
     Mpp *mpp = (Mpp*)data;
     MppEncImpl *enc = (MppEncImpl *)mpp->mEnc;
@@ -1111,8 +1286,8 @@ void *mpp_enc_thread(void *data)
     EncFrmStatus *frm = &rc_task->frm;
     MppEncRefFrmUsrCfg *frm_cfg = &enc->frm_cfg;
     MppEncHeaderStatus *hdr_status = &enc->hdr_status;
-    EncTask task;
-    HalTaskInfo *task_info = &task.info;
+    EncTask *task = (EncTask *)enc->task_enc;
+    HalTaskInfo *task_info = &task->info;
     HalEncTask *hal_task = &task_info->enc;
     MppPort input  = mpp_task_queue_get_port(mpp->mInputTaskQueue,  MPP_PORT_OUTPUT);
     MppPort output = mpp_task_queue_get_port(mpp->mOutputTaskQueue, MPP_PORT_INPUT);
@@ -1121,104 +1296,122 @@ void *mpp_enc_thread(void *data)
     MPP_RET ret = MPP_OK;
     MppFrame frame = NULL;
     MppPacket packet = NULL;
+    RK_U32 running = 1;
+    RK_U32 frm_started = 0;
 
-    memset(&task, 0, sizeof(task));
+    {
+        AutoMutex autolock(thd_enc->mutex());
+        if (MPP_THREAD_RUNNING != thd_enc->get_status())
+            running = 0;
 
-    enc->time_base = mpp_time();
+        if (running && check_enc_task_wait(enc, task))
+            return MPP_JOB_WAIT;
+    }
+
+    if (!running) {
+        mpp_enc_job_exit(mpp);
+        return MPP_JOB_EXIT;
+    }
+
+    // 1. process user control
+    if (MPP_LOAD_ACQUIRE(&enc->cmd_send) != enc->cmd_recv) {
+        enc_dbg_detail("ctrl proc %d cmd %08x\n", enc->cmd_recv, enc->cmd);
+        ret = mpp_enc_proc_cfg(enc, enc->cmd, enc->param);
+        if (ret)
+            *enc->cmd_ret = ret;
+        enc->cmd_recv++;
+        enc_dbg_detail("ctrl proc %d done send %d\n", enc->cmd_recv,
+                       enc->cmd_send);
+        mpp_assert(enc->cmd_send == enc->cmd_send);
+        enc->param = NULL;
+        enc->cmd = (MpiCmd)0;
+        sem_post(&enc->cmd_done);
+        return MPP_JOB_CONTINUE;
+    }
 
-    while (1) {
+    // 2. process reset
+    if (enc->reset_flag) {
+        enc_dbg_detail("thread reset start\n");
         {
             AutoMutex autolock(thd_enc->mutex());
-            if (MPP_THREAD_RUNNING != thd_enc->get_status())
-                break;
-
-            if (check_enc_task_wait(enc, &task))
-                thd_enc->wait();
+            enc->status_flag = 0;
         }
 
-        // 1. process user control
-        if (enc->cmd_send != enc->cmd_recv) {
-            enc_dbg_detail("ctrl proc %d cmd %08x\n", enc->cmd_recv, enc->cmd);
-            sem_wait(&enc->cmd_start);
-            ret = mpp_enc_proc_cfg(enc, enc->cmd, enc->param);
-            if (ret)
-                *enc->cmd_ret = ret;
-            enc->cmd_recv++;
-            enc_dbg_detail("ctrl proc %d done send %d\n", enc->cmd_recv,
-                           enc->cmd_send);
-            mpp_assert(enc->cmd_send == enc->cmd_send);
-            enc->param = NULL;
-            enc->cmd = (MpiCmd)0;
-            sem_post(&enc->cmd_done);
-            continue;
-        }
+        AutoMutex autolock(thd_enc->mutex(THREAD_CONTROL));
+        enc->reset_flag = 0;
+        sem_post(&enc->enc_reset);
+        enc_dbg_detail("thread reset done\n");
+        return MPP_JOB_CONTINUE;
+    }
 
-        // 2. process reset
-        if (enc->reset_flag) {
-            enc_dbg_detail("thread reset start\n");
-            {
-                AutoMutex autolock(thd_enc->mutex());
-                enc->status_flag = 0;
-            }
+    // 3. check and update rate control api
+    if (!enc->rc_status.rc_api_inited || enc->rc_status.rc_api_updated) {
+        RcApiBrief *brief = &enc->rc_brief;
 
-            AutoMutex autolock(thd_enc->mutex(THREAD_CONTROL));
-            enc->reset_flag = 0;
-            sem_post(&enc->enc_reset);
-            enc_dbg_detail("thread reset done\n");
-            continue;
+        if (enc->rc_ctx) {
+            enc_dbg_detail("rc deinit %p\n", enc->rc_ctx);
+            rc_deinit(enc->rc_ctx);
+            enc->rc_ctx = NULL;
         }
 
-        // 3. check and update rate control api
-        if (!enc->rc_status.rc_api_inited || enc->rc_status.rc_api_updated) {
-            RcApiBrief *brief = &enc->rc_brief;
-
-            if (enc->rc_ctx) {
-                enc_dbg_detail("rc deinit %p\n", enc->rc_ctx);
-                rc_deinit(enc->rc_ctx);
-                enc->rc_ctx = NULL;
-            }
+        /* NOTE: default name is NULL */
+        ret = rc_init(&enc->rc_ctx, enc->coding, &brief->name);
+        if (ret)
+            mpp_err("enc %p fail to init rc %s\n", enc, brief->name);
+        else
+            enc->rc_status.rc_api_inited = 1;
 
-            /* NOTE: default name is NULL */
-            ret = rc_init(&enc->rc_ctx, enc->coding, &brief->name);
-            if (ret)
-                mpp_err("enc %p fail to init rc %s\n", enc, brief->name);
-            else
-                enc->rc_status.rc_api_inited = 1;
+        enc_dbg_detail("rc init %p name %s ret %d\n", enc->rc_ctx, brief->name, ret);
+        enc->rc_status.rc_api_updated = 0;
 
-            enc_dbg_detail("rc init %p name %s ret %d\n", enc->rc_ctx, brief->name, ret);
-            enc->rc_status.rc_api_updated = 0;
+        enc->rc_cfg_length = 0;
+        update_rc_cfg_log(enc, "%s:", brief->name);
+        enc->rc_cfg_pos = enc->rc_cfg_length;
+    }
 
-            enc->rc_cfg_length = 0;
-            update_rc_cfg_log(enc, "%s:", brief->name);
-            enc->rc_cfg_pos = enc->rc_cfg_length;
+    // 4. check input task
+    if (!task->status.task_in_rdy && !enc->next_in) {
+        ret = mpp_port_poll(input, MPP_POLL_NON_BLOCK);
+        if (ret) {
+            task->wait.enc_frm_in = 1;
+            return MPP_JOB_CONTINUE;
         }
 
-        // 4. check input task
-        if (!task.status.task_in_rdy) {
-            ret = mpp_port_poll(input, MPP_POLL_NON_BLOCK);
-            if (ret) {
-                task.wait.enc_frm_in = 1;
-                continue;
-            }
+        task->status.task_in_rdy = 1;
+        task->wait.enc_frm_in = 0;
+        enc_dbg_detail("task in ready\n");
+    }
 
-            task.status.task_in_rdy = 1;
-            task.wait.enc_frm_in = 0;
-            enc_dbg_detail("task in ready\n");
+    // 5. check output task
+    if (!task->status.task_out_rdy && !enc->next_in) {
+        ret = mpp_port_poll(output, MPP_POLL_NON_BLOCK);
+        if (ret) {
+            task->wait.enc_pkt_out = 1;
+            return MPP_JOB_CONTINUE;
         }
 
-        // 5. check output task
-        if (!task.status.task_out_rdy) {
-            ret = mpp_port_poll(output, MPP_POLL_NON_BLOCK);
-            if (ret) {
-                task.wait.enc_pkt_out = 1;
-                continue;
-            }
-
-            task.status.task_out_rdy = 1;
-            task.wait.enc_pkt_out = 0;
-            enc_dbg_detail("task out ready\n");
-        }
+        task->status.task_out_rdy = 1;
+        task->wait.enc_pkt_out = 0;
+        enc_dbg_detail("task out ready\n");
+    }
 
+    if (enc->next_in) {
+        // use the task prefetched on previous frame encoding
+        task_in  = enc->next_in;
+        task_out = enc->next_out;
+        frame    = enc->next_frm;
+        packet   = enc->next_pkt;
+
+        // config changed after prefetch then create packet again
+        if (enc->next_pkt_size && enc->next_pkt_size != enc_packet_size(enc))
+            mpp_packet_deinit(&packet);
+
+        enc->next_in = NULL;
+        enc->next_out = NULL;
+        enc->next_frm = NULL;
+        enc->next_pkt = NULL;
+        enc->next_pkt_size = 0;
+    } else {
         // get tasks from both input and output
         ret = mpp_port_dequeue(input, &task_in);
         mpp_assert(task_in);
@@ -1232,230 +1425,224 @@ void *mpp_enc_thread(void *data)
          */
         mpp_task_meta_get_frame (task_in, KEY_INPUT_FRAME,  &frame);
         mpp_task_meta_get_packet(task_in, KEY_OUTPUT_PACKET, &packet);
+    }
 
-        enc_dbg_detail("task dequeue done frm %p pkt %p\n", frame, packet);
+    enc_dbg_detail("task dequeue done frm %p pkt %p\n", frame, packet);
 
-        /*
-         * 6. check empty task for signaling
-         * If there is no input frame just return empty packet task
-         */
-        if (NULL == frame)
-            goto TASK_RETURN;
-
-        if (NULL == mpp_frame_get_buffer(frame))
-            goto TASK_RETURN;
-
-        // 7. check and update rate control config
-        if (enc->rc_status.rc_api_user_cfg) {
-            RcCfg usr_cfg;
-
-            enc_dbg_detail("rc update cfg start\n");
-
-            memset(&usr_cfg, 0 , sizeof(usr_cfg));
-            set_rc_cfg(&usr_cfg, cfg);
-            ret = rc_update_usr_cfg(enc->rc_ctx, &usr_cfg);
-            rc_cfg->change = 0;
-            prep_cfg->change = 0;
-
-            enc_dbg_detail("rc update cfg done\n");
-            enc->rc_status.rc_api_user_cfg = 0;
-
-            enc->rc_cfg_length = enc->rc_cfg_pos;
-            update_rc_cfg_log(enc, "%s-b:%d[%d:%d]-g:%d-q:%d:[%d:%d]:[%d:%d]:%d\n",
-                              name_of_rc_mode[usr_cfg.mode],
-                              usr_cfg.bps_target,
-                              usr_cfg.bps_min, usr_cfg.bps_max, usr_cfg.igop,
-                              usr_cfg.init_quality,
-                              usr_cfg.min_quality, usr_cfg.max_quality,
-                              usr_cfg.min_i_quality, usr_cfg.max_i_quality,
-                              usr_cfg.i_quality_delta);
-        }
+    /*
+     * 6. check empty task for signaling
+     * If there is no input frame just return empty packet task
+     */
+    if (NULL == frame)
+        goto TASK_RETURN;
+
+    if (NULL == mpp_frame_get_buffer(frame))
+        goto TASK_RETURN;
+
+    // 7. check and update rate control config
+    if (enc->rc_status.rc_api_user_cfg) {
+        RcCfg usr_cfg;
+
+        enc_dbg_detail("rc update cfg start\n");
+
+        memset(&usr_cfg, 0 , sizeof(usr_cfg));
+        set_rc_cfg(&usr_cfg, cfg);
+        ret = rc_update_usr_cfg(enc->rc_ctx, &usr_cfg);
+        rc_cfg->change = 0;
+        prep_cfg->change = 0;
+
+        enc_dbg_detail("rc update cfg done\n");
+        enc->rc_status.rc_api_user_cfg = 0;
+
+        enc->rc_cfg_length = enc->rc_cfg_pos;
+        update_rc_cfg_log(enc, "%s-b:%d[%d:%d]-g:%d-q:%d:[%d:%d]:[%d:%d]:%d\n",
+                          name_of_rc_mode[usr_cfg.mode],
+                          usr_cfg.bps_target,
+                          usr_cfg.bps_min, usr_cfg.bps_max, usr_cfg.igop,
+                          usr_cfg.init_quality,
+                          usr_cfg.min_quality, usr_cfg.max_quality,
+                          usr_cfg.min_i_quality, usr_cfg.max_i_quality,
+                          usr_cfg.i_quality_delta);
+    }
 
-        // 8. all task ready start encoding one frame
-        reset_hal_enc_task(hal_task);
-        reset_enc_rc_task(rc_task);
-        hal_task->rc_task = rc_task;
-        hal_task->frm_cfg = frm_cfg;
-        frm->seq_idx = task.seq_idx++;
-        rc_task->frame = frame;
+    // 8. all task ready start encoding one frame
+    reset_hal_enc_task(hal_task);
+    reset_enc_rc_task(rc_task);
+    hal_task->rc_task = rc_task;
+    hal_task->frm_cfg = frm_cfg;
+    frm->seq_idx = task->seq_idx++;
+    rc_task->frame = frame;
 
-        enc_dbg_detail("task seq idx %d start\n", frm->seq_idx);
+    enc_dbg_detail("task seq idx %d start\n", frm->seq_idx);
 
-        /*
-         * 9. check and create packet for output
-         * if there is available buffer in the input frame do encoding
-         */
-        if (NULL == packet) {
-            /* NOTE: set buffer w * h * 1.5 to avoid buffer overflow */
-            RK_U32 width  = enc->cfg.prep.width;
-            RK_U32 height = enc->cfg.prep.height;
-            RK_U32 size = MPP_ALIGN(width, 16) * MPP_ALIGN(height, 16) * 3 / 2;
-            MppBuffer buffer = NULL;
-
-            mpp_assert(size);
-            mpp_buffer_get(mpp->mPacketGroup, &buffer, size);
-            mpp_packet_init_with_buffer(&packet, buffer);
-            /* NOTE: clear length for output */
-            mpp_packet_set_length(packet, 0);
-            mpp_buffer_put(buffer);
-
-            enc_dbg_detail("create output pkt %p buf %p\n", packet, buffer);
-        }
-
-        mpp_assert(packet);
+    /*
+     * 9. check and create packet for output
+     * if there is available buffer in the input frame do encoding
+     */
+    if (NULL == packet)
+        packet = enc_create_packet(mpp, enc_packet_size(enc));
 
-        // 10. bypass pts to output
-        {
-            RK_S64 pts = mpp_frame_get_pts(frame);
-            mpp_packet_set_pts(packet, pts);
-            enc_dbg_detail("task %d pts %lld\n", frm->seq_idx, pts);
-        }
+    mpp_assert(packet);
 
-        // 11. check frame drop by frame rate conversion
-        ENC_RUN_FUNC2(rc_frm_check_drop, enc->rc_ctx, rc_task, mpp, ret);
-        task.status.rc_check_frm_drop = 1;
-        enc_dbg_detail("task %d drop %d\n", frm->seq_idx, frm->drop);
+    // 10. bypass pts to output
+    {
+        RK_S64 pts = mpp_frame_get_pts(frame);
+        mpp_packet_set_pts(packet, pts);
+        enc_dbg_detail("task %d pts %lld\n", frm->seq_idx, pts);
+    }
 
-        // when the frame should be dropped just return empty packet
-        if (frm->drop) {
-            hal_task->valid = 0;
-            hal_task->length = 0;
-            goto TASK_DONE;
-        }
+    // 11. check frame drop by frame rate conversion
+    ENC_RUN_FUNC2(rc_frm_check_drop, enc->rc_ctx, rc_task, mpp, ret);
+    task->status.rc_check_frm_drop = 1;
+    enc_dbg_detail("task %d drop %d\n", frm->seq_idx, frm->drop);
 
-        if (!enc->hal_info_updated) {
-            update_hal_info(enc);
-            enc->hal_info_updated = 1;
-        }
+    // when the frame should be dropped just return empty packet
+    if (frm->drop) {
+        hal_task->valid = 0;
+        hal_task->length = 0;
+        goto TASK_DONE;
+    }
 
-        // start encoder task process here
-        hal_task->valid = 1;
+    if (!enc->hal_info_updated) {
+        update_hal_info(enc);
+        enc->hal_info_updated = 1;
+    }
 
-        // 12. generate header before hardware stream
-        if (!hdr_status->ready) {
-            /* config cpb before generating header */
-            enc_impl_gen_hdr(impl, enc->hdr_pkt);
-            enc->hdr_len = mpp_packet_get_length(enc->hdr_pkt);
-            hdr_status->ready = 1;
+    // start encoder task process here
+    hal_task->valid = 1;
 
-            enc_dbg_detail("task %d update header length %d\n",
-                           frm->seq_idx, enc->hdr_len);
+    // 12. generate header before hardware stream
+    if (!hdr_status->ready) {
+        /* config cpb before generating header */
+        enc_impl_gen_hdr(impl, enc->hdr_pkt);
+        enc->hdr_len = mpp_packet_get_length(enc->hdr_pkt);
+        hdr_status->ready = 1;
 
-            mpp_packet_append(packet, enc->hdr_pkt);
-            hal_task->header_length = enc->hdr_len;
-            hal_task->length += enc->hdr_len;
-            hdr_status->added_by_change = 1;
-        }
+        enc_dbg_detail("task %d update header length %d\n",
+                       frm->seq_idx, enc->hdr_len);
 
-        mpp_assert(hal_task->length == mpp_packet_get_length(packet));
+        mpp_packet_append(packet, enc->hdr_pkt);
+        hal_task->header_length = enc->hdr_len;
+        hal_task->length += enc->hdr_len;
+        hdr_status->added_by_change = 1;
+    }
 
-        // 13. setup input frame and output packet
-        hal_task->frame  = frame;
-        hal_task->input  = mpp_frame_get_buffer(frame);
-        hal_task->packet = packet;
-        hal_task->output = mpp_packet_get_buffer(packet);
-        hal_task->length = mpp_packet_get_length(packet);
-        mpp_task_meta_get_buffer(task_in, KEY_MOTION_INFO, &hal_task->mv_info);
+    mpp_assert(hal_task->length == mpp_packet_get_length(packet));
 
-        /* 14. check frm_meta data force key in input frame and start one frame */
-        enc_dbg_detail("task %d enc start\n", frm->seq_idx);
-        ENC_RUN_FUNC2(enc_impl_start, impl, hal_task, mpp, ret);
+    // 13. setup input frame and output packet
+    hal_task->frame  = frame;
+    hal_task->input  = mpp_frame_get_buffer(frame);
+    hal_task->packet = packet;
+    hal_task->output = mpp_packet_get_buffer(packet);
+    hal_task->length = mpp_packet_get_length(packet);
+    mpp_task_meta_get_buffer(task_in, KEY_MOTION_INFO, &hal_task->mv_info);
 
-        // 14. setup user_cfg to dpb
-        if (frm_cfg->force_flag)
-            mpp_enc_refs_set_usr_cfg(enc->refs, frm_cfg);
+    /* 14. check frm_meta data force key in input frame and start one frame */
+    enc_dbg_detail("task %d enc start\n", frm->seq_idx);
+    mpp_clock_start(enc->clocks[ENC_FRM_TOTAL]);
+    mpp_trace_begin(mpp, "enc frame", frm->seq_idx, 0);
+    frm_started = 1;
+    ENC_RUN_FUNC2(enc_impl_start, impl, hal_task, mpp, ret);
 
-        // 15. backup dpb
-        mpp_enc_refs_stash(enc->refs);
-        task.status.enc_backup = 1;
+    // 14. setup user_cfg to dpb
+    if (frm_cfg->force_flag)
+        mpp_enc_refs_set_usr_cfg(enc->refs, frm_cfg);
 
-        ENC_RUN_FUNC2(mpp_enc_normal, mpp, &task, mpp, ret);
+    // 15. backup dpb
+    mpp_enc_refs_stash(enc->refs);
+    task->status.enc_backup = 1;
 
-        // reencode process
-        while (frm->reencode && frm->reencode_times < rc_cfg->max_reenc_times) {
-            hal_task->length -= hal_task->hw_length;
-            hal_task->hw_length = 0;
+    ENC_RUN_FUNC2(mpp_enc_normal, mpp, task, mpp, ret);
 
-            enc_dbg_detail("task %d reenc %d times %d\n", frm->seq_idx, frm->reencode, frm->reencode_times);
+    // reencode process
+    while (frm->reencode && frm->reencode_times < rc_cfg->max_reenc_times) {
+        hal_task->length -= hal_task->hw_length;
+        hal_task->hw_length = 0;
 
-            if (frm->drop) {
-                mpp_enc_reenc_drop(mpp, &task);
-                break;
-            }
+        enc_dbg_detail("task %d reenc %d times %d\n", frm->seq_idx, frm->reencode, frm->reencode_times);
 
-            if (frm->force_pskip && !frm->is_idr && !frm->is_lt_ref) {
-                mpp_enc_reenc_force_pskip(mpp, &task);
-                break;
-            }
+        if (frm->drop) {
+            mpp_enc_reenc_drop(mpp, task);
+            break;
+        }
 
-            mpp_enc_reenc_simple(mpp, &task);
+        if (frm->force_pskip && !frm->is_idr && !frm->is_lt_ref) {
+            mpp_enc_reenc_force_pskip(mpp, task);
+            break;
         }
-        enc_dbg_detail("task %d rc frame end\n", frm->seq_idx);
-        ENC_RUN_FUNC2(rc_frm_end, enc->rc_ctx, rc_task, mpp, ret);
 
-        enc->time_end = mpp_time();
-        enc->frame_count++;
+        mpp_enc_reenc_simple(mpp, task);
+    }
+    enc_dbg_detail("task %d rc frame end\n", frm->seq_idx);
+    ENC_RUN_FUNC2(rc_frm_end, enc->rc_ctx, rc_task, mpp, ret);
+    mpp_clock_pause(enc->clocks[ENC_FRM_TOTAL]);
+    mpp_trace_end(mpp, "enc frame", frm->seq_idx, frm->reencode_times);
+    frm_started = 0;
 
-        if (enc->dev && enc->time_base && enc->time_end &&
-            ((enc->time_end - enc->time_base) >= (RK_S64)(1000 * 1000)))
-            update_hal_info_fps(enc);
+    enc->time_end = mpp_time();
+    enc->frame_count++;
 
-        frm->reencode = 0;
-        frm->reencode_times = 0;
-        frm_cfg->force_flag = 0;
+    if (enc->dev && enc->time_base && enc->time_end &&
+        ((enc->time_end - enc->time_base) >= (RK_S64)(1000 * 1000)))
+        update_hal_info_fps(enc);
 
-    TASK_DONE:
-        /* setup output packet and meta data */
-        mpp_packet_set_length(packet, hal_task->length);
+    frm->reencode = 0;
+    frm->reencode_times = 0;
+    frm_cfg->force_flag = 0;
 
-        {
-            MppMeta meta = mpp_packet_get_meta(packet);
+TASK_DONE:
+    /* close the frame span on error */
+    if (frm_started) {
+        mpp_clock_pause(enc->clocks[ENC_FRM_TOTAL]);
+        mpp_trace_end(mpp, "enc frame", frm->seq_idx, ret);
+    }
 
-            if (hal_task->mv_info)
-                mpp_meta_set_buffer(meta, KEY_MOTION_INFO, hal_task->mv_info);
+    /* setup output packet and meta data */
+    mpp_packet_set_length(packet, hal_task->length);
 
-            mpp_meta_set_s32(meta, KEY_OUTPUT_INTRA, frm->is_intra);
-        }
+    {
+        MppMeta meta = mpp_packet_get_meta(packet);
 
-    TASK_RETURN:
-        /*
-         * First return output packet.
-         * Then enqueue task back to input port.
-         * Final user will release the mpp_frame they had input.
-         */
-        if (NULL == packet)
-            mpp_packet_new(&packet);
+        if (hal_task->mv_info)
+            mpp_meta_set_buffer(meta, KEY_MOTION_INFO, hal_task->mv_info);
 
-        if (frame && mpp_frame_get_eos(frame))
-            mpp_packet_set_eos(packet);
-        else
-            mpp_packet_clr_eos(packet);
+        mpp_meta_set_s32(meta, KEY_OUTPUT_INTRA, frm->is_intra);
+    }
 
-        enc_dbg_detail("task %d enqueue packet pts %lld\n", frm->seq_idx, mpp_packet_get_pts(packet));
+TASK_RETURN:
+    /*
+     * First return output packet.
+     * Then enqueue task back to input port.
+     * Final user will release the mpp_frame they had input.
+     */
+    if (NULL == packet)
+        mpp_packet_new(&packet);
 
-        mpp_task_meta_set_packet(task_out, KEY_OUTPUT_PACKET, packet);
-        mpp_port_enqueue(output, task_out);
+    if (frame && mpp_frame_get_eos(frame))
+        mpp_packet_set_eos(packet);
+    else
+        mpp_packet_clr_eos(packet);
 
-        enc_dbg_detail("task %d enqueue frame pts %lld\n", frm->seq_idx, mpp_frame_get_pts(frame));
+    enc_dbg_detail("task %d enqueue packet pts %lld\n", frm->seq_idx, mpp_packet_get_pts(packet));
 
-        mpp_task_meta_set_frame(task_in, KEY_INPUT_FRAME, frame);
-        mpp_port_enqueue(input, task_in);
+    mpp_task_meta_set_packet(task_out, KEY_OUTPUT_PACKET, packet);
+    mpp_port_enqueue(output, task_out);
 
-        task_in = NULL;
-        task_out = NULL;
-        packet = NULL;
-        frame = NULL;
+    enc_dbg_detail("task %d enqueue frame pts %lld\n", frm->seq_idx, mpp_frame_get_pts(frame));
 
-        task.status.val = 0;
-        /* NOTE: clear add_by flags */
-        hdr_status->val = hdr_status->ready;
-    }
+    mpp_task_meta_set_frame(task_in, KEY_INPUT_FRAME, frame);
+    mpp_port_enqueue(input, task_in);
 
-    // clear remain task in output port
-    release_task_in_port(input);
-    release_task_in_port(mpp->mOutputPort);
+    task_in = NULL;
+    task_out = NULL;
+    packet = NULL;
+    frame = NULL;
 
-    return NULL;
+    task->status.val = 0;
+    /* NOTE: clear add_by flags */
+    hdr_status->val = hdr_status->ready;
+
+    return MPP_JOB_CONTINUE;
 }
 
 MPP_RET mpp_enc_init_v2(MppEnc *enc, MppEncInitCfg *cfg)
@@ -1467,6 +1654,7 @@ MPP_RET mpp_enc_init_v2(MppEnc *enc, MppEncInitCfg *cfg)
     MppEncHal enc_hal = NULL;
     MppEncHalCfg enc_hal_cfg;
     EncImplCfg ctrl_cfg;
+    RK_S32 i;
 
     mpp_env_get_u32("mpp_enc_debug", &mpp_enc_debug, 0);
 
@@ -1528,6 +1716,8 @@ MPP_RET mpp_enc_init_v2(MppEnc *enc, MppEncInitCfg *cfg)
     p->enc_hal  = enc_hal;
     p->dev      = enc_hal_cfg.dev;
     p->mpp      = cfg->mpp;
+    p->use_worker_pool = cfg->worker_pool;
+    p->pipeline = ((Mpp *)cfg->mpp)->mEncPipeDepth > 1;
     p->sei_mode = MPP_ENC_SEI_MODE_ONE_SEQ;
     p->version_info = get_mpp_version();
     p->version_length = strlen(p->version_info);
@@ -1550,8 +1740,12 @@ MPP_RET mpp_enc_init_v2(MppEnc *enc, MppEncInitCfg *cfg)
     ret = mpp_enc_ref_cfg_copy(p->cfg.ref_cfg, mpp_enc_ref_default());
     ret = mpp_enc_refs_set_cfg(p->refs, mpp_enc_ref_default());
 
+    for (i = 0; i < ENC_TIMING_BUTT; i++) {
+        p->clocks[i] = mpp_clock_get(timing_str[i]);
+        mpp_assert(p->clocks[i]);
+    }
+
     sem_init(&p->enc_reset, 0, 0);
-    sem_init(&p->cmd_start, 0, 0);
     sem_init(&p->cmd_done, 0, 0);
 
     *enc = p;
@@ -1564,6 +1758,7 @@ ERR_RET:
 MPP_RET mpp_enc_deinit_v2(MppEnc ctx)
 {
     MppEncImpl *enc = (MppEncImpl *)ctx;
+    RK_S32 i;
 
     if (NULL == enc) {
         mpp_err_f("found NULL input\n");
@@ -1605,12 +1800,18 @@ MPP_RET mpp_enc_deinit_v2(MppEnc ctx)
         enc->rc_ctx = NULL;
     }
 
+    for (i = 0; i < ENC_TIMING_BUTT; i++) {
+        if (enc->clocks[i]) {
+            mpp_clock_put(enc->clocks[i]);
+            enc->clocks[i] = NULL;
+        }
+    }
+
     MPP_FREE(enc->rc_cfg_info);
     enc->rc_cfg_size = 0;
     enc->rc_cfg_length = 0;
 
     sem_destroy(&enc->enc_reset);
-    sem_destroy(&enc->cmd_start);
     sem_destroy(&enc->cmd_done);
 
     mpp_free(enc);
@@ -1623,8 +1824,15 @@ MPP_RET mpp_enc_start_v2(MppEnc ctx)
 
     enc_dbg_func("%p in\n", enc);
 
-    enc->thread_enc = new MppThread(mpp_enc_thread,
-                                    enc->mpp, "mpp_enc");
+    enc->task_enc = mpp_calloc(EncTask, 1);
+    if (NULL == enc->task_enc) {
+        mpp_err_f("failed to malloc encoder task\n");
+        return MPP_ERR_MALLOC;
+    }
+
+    enc->time_base = mpp_time();
+    enc->thread_enc = new MppThread(mpp_enc_job, enc->mpp, "mpp_enc",
+                                    enc->use_worker_pool);
     enc->thread_enc->start();
 
     enc_dbg_func("%p out\n", enc);
@@ -1645,6 +1853,8 @@ MPP_RET mpp_enc_stop_v2(MppEnc ctx)
         enc->thread_enc = NULL;
     }
 
+    MPP_FREE(enc->task_enc);
+
     enc_dbg_func("%p out\n", enc);
     return ret;
 
@@ -1707,6 +1917,32 @@ MPP_RET mpp_enc_notify_v2(MppEnc ctx, RK_U32 flag)
  *
  * codec related config will be set in each hal component
  */
+static void mpp_enc_get_perf_stats(MppEncImpl *enc, MppPerfStats *stats)
+{
+    RK_S32 i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (i = 0; i < ENC_TIMING_BUTT && i < MPP_PERF_STAGE_MAX; i++) {
+        MppPerfStage *stage = &stats->stages[i];
+        MppClockStat stat;
+
+        mpp_clock_get_stat(enc->clocks[i], &stat);
+
+        strncpy(stage->name, timing_str[i], sizeof(stage->name) - 1);
+        stage->count = stat.count;
+        stage->sum   = stat.sum;
+        stage->min   = stat.min;
+        stage->max   = stat.max;
+        stage->p50   = stat.p50;
+        stage->p90   = stat.p90;
+        stage->p99   = stat.p99;
+        stage->p999  = stat.p999;
+    }
+
+    stats->stage_count = i;
+}
+
 MPP_RET mpp_enc_control_v2(MppEnc ctx, MpiCmd cmd, void *param)
 {
     MppEncImpl *enc = (MppEncImpl *)ctx;
@@ -1758,14 +1994,38 @@ MPP_RET mpp_enc_control_v2(MppEnc ctx, MpiCmd cmd, void *param)
         enc_dbg_ctrl("get osd plt cfg\n");
         memcpy(param, &enc->cfg.plt_cfg, sizeof(enc->cfg.plt_cfg));
     } break;
+    case MPP_ENC_SET_PERF_STATS : {
+        RK_U32 enable;
+        RK_S32 i;
+
+        if (NULL == param) {
+            ret = MPP_ERR_NULL_PTR;
+            break;
+        }
+
+        enable = *((RK_U32 *)param);
+        enc_dbg_ctrl("set perf stats %d\n", enable);
+        for (i = 0; i < ENC_TIMING_BUTT; i++) {
+            mpp_clock_enable_histogram(enc->clocks[i], enable);
+            mpp_clock_enable(enc->clocks[i], enable);
+        }
+    } break;
+    case MPP_ENC_GET_PERF_STATS : {
+        enc_dbg_ctrl("get perf stats\n");
+        if (NULL == param) {
+            ret = MPP_ERR_NULL_PTR;
+            break;
+        }
+
+        mpp_enc_get_perf_stats(enc, (MppPerfStats *)param);
+    } break;
     default : {
         // Cmd which is not get configure will handle by enc_impl
         enc->cmd = cmd;
         enc->param = param;
         enc->cmd_ret = &ret;
-        enc->cmd_send++;
+        MPP_STORE_RELEASE(&enc->cmd_send, enc->cmd_send + 1);
         mpp_enc_notify_v2(ctx, MPP_ENC_CONTROL);
-        sem_post(&enc->cmd_start);
         sem_wait(&enc->cmd_done);
 
         /* check the command is processed */
@@ -161,6 +161,24 @@ MPP_RET mpp_parser_parse(Parser prs, HalDecTask *task)
     return p->api->parse(p->ctx, task);
 }
 
+/*
+ * return MPP_NOK when parser does not fill the stream and the input_packet
+ * of task should be copied by caller
+ */
+MPP_RET mpp_parser_fill_stream(Parser prs, HalDecTask *task, void *dst)
+{
+    if (NULL == prs || NULL == task || NULL == dst) {
+        mpp_err_f("found NULL input\n");
+        return MPP_ERR_NULL_PTR;
+    }
+
+    ParserImpl *p = (ParserImpl *)prs;
+    if (!p->api->fill_stream)
+        return MPP_NOK;
+
+    return p->api->fill_stream(p->ctx, task, dst);
+}
+
 MPP_RET mpp_hal_callback(void *prs, void *err_info)
 {
     if (NULL == prs) {
@@ -17,13 +17,50 @@
 
 #define MODULE_TAG "hal_dummy_dec"
 
+#include "mpp_env.h"
+#include "mpp_log.h"
+#include "mpp_time.h"
+#include "mpp_common.h"
+#include "mpp_atomic.h"
+#include "mpp_thread.h"
+#include "mpp_buf_slot.h"
+
 #include "hal_dummy_dec_api.h"
 
+/* max task count on hardware at the same time */
+#define DUMMY_HW_QUEUE_SIZE     8
+
+/*
+ * Simulated hardware decoding time in microsecond from hal_dummy_dec_hw_time
+ * Hardware runs tasks in order. Each task starts when it is started and the
+ * previous task is finished. Wait returns when its task is finished.
+ *
+ * Start is called on parser thread and wait on hal thread. start_cnt is only
+ * written by start and wait_cnt by wait and reset so they are released after
+ * done_time is updated and acquired by the other side.
+ *
+ * hal_dummy_dec_err_period reports hardware error on the frame with pts in
+ * (period - 1, 2 * period - 1, ...) for error attribution test.
+ */
+typedef struct HalDummyDec_t {
+    MppBufSlots     frame_slots;
+    IOInterruptCB   int_cb;
+    RK_U32          hw_time;
+    RK_U32          err_period;
+    RK_S64          hw_done;
+    RK_S64          done_time[DUMMY_HW_QUEUE_SIZE];
+    RK_U32          start_cnt;
+    RK_U32          wait_cnt;
+} HalDummyDec;
 
 MPP_RET hal_dummy_dec_init(void *hal, MppHalCfg *cfg)
 {
-    (void)hal;
-    (void)cfg;
+    HalDummyDec *p = (HalDummyDec *)hal;
+
+    p->frame_slots = cfg->frame_slots;
+    p->int_cb = cfg->hal_int_cb;
+    mpp_env_get_u32("hal_dummy_dec_hw_time", &p->hw_time, 0);
+    mpp_env_get_u32("hal_dummy_dec_err_period", &p->err_period, 0);
     return MPP_OK;
 }
 
@@ -41,21 +78,68 @@ MPP_RET hal_dummy_dec_gen_regs(void *hal, HalTaskInfo *task)
 }
 MPP_RET hal_dummy_dec_start(void *hal, HalTaskInfo *task)
 {
-    (void)hal;
+    HalDummyDec *p = (HalDummyDec *)hal;
+    RK_U32 start_cnt = p->start_cnt;
+    RK_S64 now;
+
     (void)task;
+    if (!p->hw_time)
+        return MPP_OK;
+
+    if (start_cnt - MPP_LOAD_ACQUIRE(&p->wait_cnt) >= DUMMY_HW_QUEUE_SIZE) {
+        mpp_err_f("too many task on hardware\n");
+        return MPP_NOK;
+    }
+
+    now = mpp_time();
+    p->hw_done = MPP_MAX(p->hw_done, now) + p->hw_time;
+    p->done_time[start_cnt % DUMMY_HW_QUEUE_SIZE] = p->hw_done;
+    MPP_STORE_RELEASE(&p->start_cnt, start_cnt + 1);
     return MPP_OK;
 }
 
+static void hal_dummy_dec_callback(HalDummyDec *p, HalDecTask *task)
+{
+    IOCallbackCtx ctx = { 0, NULL, NULL, 0 };
+    MppFrame frame = NULL;
+
+    if (NULL == p->int_cb.callBack || task->output < 0)
+        return;
+
+    if (p->err_period) {
+        mpp_buf_slot_get_prop(p->frame_slots, task->output, SLOT_FRAME_PTR, &frame);
+        if (frame && mpp_frame_get_pts(frame) % p->err_period == p->err_period - 1)
+            ctx.hard_err = 1;
+    }
+
+    ctx.task = (void *)task;
+    p->int_cb.callBack(p->int_cb.opaque, &ctx);
+}
+
 MPP_RET hal_dummy_dec_wait(void *hal, HalTaskInfo *task)
 {
-    (void)hal;
-    (void)task;
+    HalDummyDec *p = (HalDummyDec *)hal;
+    RK_U32 wait_cnt = p->wait_cnt;
+    RK_S64 left;
+
+    if (p->hw_time && wait_cnt != MPP_LOAD_ACQUIRE(&p->start_cnt)) {
+        left = p->done_time[wait_cnt % DUMMY_HW_QUEUE_SIZE] - mpp_time();
+        if (left > 0)
+            usleep(left);
+
+        MPP_STORE_RELEASE(&p->wait_cnt, wait_cnt + 1);
+    }
+
+    hal_dummy_dec_callback(p, &task->dec);
     return MPP_OK;
 }
 
 MPP_RET hal_dummy_dec_reset(void *hal)
 {
-    (void)hal;
+    HalDummyDec *p = (HalDummyDec *)hal;
+
+    p->hw_done = 0;
+    MPP_STORE_RELEASE(&p->wait_cnt, MPP_LOAD_ACQUIRE(&p->start_cnt));
     return MPP_OK;
 }
 
@@ -77,7 +161,7 @@ const MppHalApi hal_api_dummy_dec = {
     .name = "dummy_hw_dec",
     .type = MPP_CTX_DEC,
     .coding = MPP_VIDEO_CodingUnused,
-    .ctx_size = 0,
+    .ctx_size = sizeof(HalDummyDec),
     .flag = 0,
     .init = hal_dummy_dec_init,
     .deinit = hal_dummy_dec_deinit,
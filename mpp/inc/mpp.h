@@ -17,7 +17,7 @@
 #ifndef __MPP_H__
 #define __MPP_H__
 
-#include "mpp_queue.h"
+#include "mpp_ring.h"
 #include "mpp_task_impl.h"
 
 #include "mpp_dec.h"
@@ -50,6 +50,7 @@
 #define MPP_DEC_NOTIFY_TASK_HND_VALID       (0x00000100)
 #define MPP_DEC_NOTIFY_TASK_PREV_DONE       (0x00000200)
 #define MPP_DEC_NOTIFY_BUFFER_MATCH         (0x00000400)
+#define MPP_DEC_NOTIFY_TIMESTAMP_VALID      (0x00000800)
 #define MPP_DEC_RESET                       (MPP_RESET)
 
 /* mpp enc event flags */
@@ -98,12 +99,24 @@ public:
     Mpp();
     ~Mpp();
     MPP_RET init(MppCtxType type, MppCodingType coding);
+    /* test only: init on dummy codec which is not in the support list */
+    MPP_RET init_dummy(MppCtxType type);
     MPP_RET put_packet(MppPacket packet);
     MPP_RET get_frame(MppFrame *frame);
 
     MPP_RET put_frame(MppFrame frame);
     MPP_RET get_packet(MppPacket *packet);
 
+    /*
+     * batch data flow with one queue operation and one thread wakeup
+     * done returns the number of objects moved. Return MPP_OK when at least
+     * one object is moved otherwise the error from the single object call.
+     */
+    MPP_RET put_packets(MppPacket *packets, RK_S32 count, RK_S32 *done);
+    MPP_RET get_frames(MppFrame *frames, RK_S32 count, RK_S32 *done);
+    MPP_RET put_frames(MppFrame *frames, RK_S32 count, RK_S32 *done);
+    MPP_RET get_packets(MppPacket *packets, RK_S32 count, RK_S32 *done);
+
     MPP_RET poll(MppPortType type, MppPollType timeout);
     MPP_RET dequeue(MppPortType type, MppTask *task);
     MPP_RET enqueue(MppPortType type, MppTask task);
@@ -114,9 +127,34 @@ public:
     MPP_RET notify(RK_U32 flag);
     MPP_RET notify(MppBufferGroup group);
 
-    mpp_list        *mPackets;
-    mpp_list        *mFrames;
-    mpp_list        *mTimeStamps;
+    /*
+     * drop all input packets and keep the extra data packet for seek
+     * NOTE: only be called on packet consumer side on reset
+     */
+    void    flush_packets();
+
+    /*
+     * readiness event for event driven user
+     * set_event is called by decoder threads to raise MPP_DEC_EVENT_XXX bits
+     * get_event is called by user thread to read and clear the bits
+     */
+    void    set_event(RK_U32 event);
+    RK_U32  get_event();
+
+    /*
+     * single-producer / single-consumer rings
+     * mPackets     - user thread to decoder parser thread
+     * mFrames      - decoder hal / vproc thread to user thread, producers
+     *                are serialized by the decoder pending frame list
+     * mTimeStamps  - decoder parser thread to decoder hal thread
+     */
+    MppRing         *mPackets;
+    MppRing         *mFrames;
+    MppRing         *mTimeStamps;
+    /* decoder queue depth limit for packet / frame / task queue */
+    MppDecPipeCfg   mPipeCfg;
+    /* encoder input frame count in flight, larger than 1 for async put_frame */
+    RK_S32          mEncPipeDepth;
     /* counters for debug */
     RK_U32          mPacketPutCount;
     RK_U32          mPacketGetCount;
@@ -124,6 +162,9 @@ public:
     RK_U32          mFrameGetCount;
     RK_U32          mTaskPutCount;
     RK_U32          mTaskGetCount;
+    /* input stream bytes copied / referenced on put_packet */
+    RK_U64          mPacketCopySize;
+    RK_U64          mPacketRefSize;
 
     /*
      * packet buffer group
@@ -155,6 +196,7 @@ public:
     RK_U32          mEncVersion;
 
 private:
+    MPP_RET init_ctx(MppCtxType type, MppCodingType coding);
     void clear();
 
     MppCtxType      mType;
@@ -167,11 +209,20 @@ private:
 
     /* decoder paramter before init */
     RK_U32          mParserFastMode;
+    RK_U32          mParserPipeline;
     RK_U32          mParserNeedSplit;
     RK_U32          mParserInternalPts;     /* for MPEG2/MPEG4 */
     RK_U32          mImmediateOut;
+    /* run parser / hal / encoder on shared worker pool */
+    RK_U32          mWorkerPool;
     /* backup extra packet for seek */
     MppPacket       mExtraPacket;
+    /* extra packet is saved by parser on reset and sent by user put_packet */
+    Mutex           mPacketLock;
+
+    /* readiness eventfd and pending event bits, -1 for polling mode */
+    RK_S32          mEventFd;
+    volatile RK_U32 mEvents;
 
     /* dump info for debug */
     MppDump         mDump;
@@ -182,6 +233,15 @@ private:
     MPP_RET control_dec(MpiCmd cmd, MppParam param);
     MPP_RET control_enc(MpiCmd cmd, MppParam param);
     MPP_RET control_isp(MpiCmd cmd, MppParam param);
+    MPP_RET set_pipe_cfg(MppDecPipeCfg *cfg);
+
+    MPP_RET prepare_input_task(MppFrame frame, MppPollType timeout);
+    MPP_RET put_frame_async(MppFrame frame);
+    MPP_RET push_packet(MppPacket packet);
+    MPP_RET wait_frame();
+    void    frame_dequeued(RK_S32 count);
+    RK_S32  pop_frames(MppFrame *frames, RK_S32 count, RK_U32 link);
+    MPP_RET get_packet(MppPacket *packet, MppPollType timeout);
 
     Mpp(const Mpp &);
     Mpp &operator=(const Mpp &);
@@ -40,6 +40,12 @@ MPP_RET mpp_ops_enc_get_pkt(MppDump info, MppPacket pkt);
 MPP_RET mpp_ops_ctrl(MppDump info, MpiCmd cmd);
 MPP_RET mpp_ops_reset(MppDump info);
 
+/*
+ * test only: init context on dummy parser and hal without hardware
+ * It is not in rk_mpi.h and not for application.
+ */
+MPP_RET mpp_init_dummy(MppCtx ctx, MppCtxType type);
+
 #ifdef  __cplusplus
 }
 #endif
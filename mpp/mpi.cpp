@@ -24,6 +24,7 @@
 #include "mpp_mem.h"
 
 #include "mpi_impl.h"
+#include "mpp_impl.h"
 #include "mpp_info.h"
 #include "mpp_common.h"
 #include "mpp_env.h"
@@ -261,6 +262,87 @@ static MPP_RET mpi_encode_get_packet(MppCtx ctx, MppPacket *packet)
     return ret;
 }
 
+static MPP_RET mpi_batch_check(MpiImpl *p, void *objs, RK_S32 count, RK_S32 *done)
+{
+    MPP_RET ret = check_mpp_ctx(p);
+
+    if (ret)
+        return ret;
+
+    if (NULL == objs || NULL == done) {
+        mpp_err_f("found NULL input objs %p done %p\n", objs, done);
+        return MPP_ERR_NULL_PTR;
+    }
+
+    *done = 0;
+    if (count <= 0) {
+        mpp_err_f("invalid batch count %d\n", count);
+        return MPP_ERR_VALUE;
+    }
+
+    return MPP_OK;
+}
+
+static MPP_RET mpi_decode_put_packets(MppCtx ctx, MppPacket *packets,
+                                      RK_S32 count, RK_S32 *done)
+{
+    MPP_RET ret = MPP_NOK;
+    MpiImpl *p = (MpiImpl *)ctx;
+
+    mpi_dbg_func("enter ctx %p packets %p count %d\n", ctx, packets, count);
+    ret = mpi_batch_check(p, packets, count, done);
+    if (MPP_OK == ret)
+        ret = p->ctx->put_packets(packets, count, done);
+
+    mpi_dbg_func("leave ret %d\n", ret);
+    return ret;
+}
+
+static MPP_RET mpi_decode_get_frames(MppCtx ctx, MppFrame *frames,
+                                     RK_S32 count, RK_S32 *done)
+{
+    MPP_RET ret = MPP_NOK;
+    MpiImpl *p = (MpiImpl *)ctx;
+
+    mpi_dbg_func("enter ctx %p frames %p count %d\n", ctx, frames, count);
+    ret = mpi_batch_check(p, frames, count, done);
+    if (MPP_OK == ret)
+        ret = p->ctx->get_frames(frames, count, done);
+
+    mpi_dbg_func("leave ret %d\n", ret);
+    return ret;
+}
+
+static MPP_RET mpi_encode_put_frames(MppCtx ctx, MppFrame *frames,
+                                     RK_S32 count, RK_S32 *done)
+{
+    MPP_RET ret = MPP_NOK;
+    MpiImpl *p = (MpiImpl *)ctx;
+
+    mpi_dbg_func("enter ctx %p frames %p count %d\n", ctx, frames, count);
+    ret = mpi_batch_check(p, frames, count, done);
+    if (MPP_OK == ret)
+        ret = p->ctx->put_frames(frames, count, done);
+
+    mpi_dbg_func("leave ret %d\n", ret);
+    return ret;
+}
+
+static MPP_RET mpi_encode_get_packets(MppCtx ctx, MppPacket *packets,
+                                      RK_S32 count, RK_S32 *done)
+{
+    MPP_RET ret = MPP_NOK;
+    MpiImpl *p = (MpiImpl *)ctx;
+
+    mpi_dbg_func("enter ctx %p packets %p count %d\n", ctx, packets, count);
+    ret = mpi_batch_check(p, packets, count, done);
+    if (MPP_OK == ret)
+        ret = p->ctx->get_packets(packets, count, done);
+
+    mpi_dbg_func("leave ret %d\n", ret);
+    return ret;
+}
+
 static MPP_RET mpi_isp(MppCtx ctx, MppFrame dst, MppFrame src)
 {
     MPP_RET ret = MPP_OK;
@@ -421,6 +503,10 @@ static MppApi mpp_api = {
     mpi_enqueue,
     mpi_reset,
     mpi_control,
+    mpi_decode_put_packets,
+    mpi_decode_get_frames,
+    mpi_encode_put_frames,
+    mpi_encode_get_packets,
     {0},
 };
 
@@ -495,6 +581,32 @@ MPP_RET mpp_init(MppCtx ctx, MppCtxType type, MppCodingType coding)
     return ret;
 }
 
+MPP_RET mpp_init_dummy(MppCtx ctx, MppCtxType type)
+{
+    MPP_RET ret = MPP_OK;
+    MpiImpl *p = (MpiImpl*)ctx;
+
+    mpi_dbg_func("enter ctx %p type %d\n", ctx, type);
+    do {
+        ret = check_mpp_ctx(p);
+        if (ret)
+            break;
+
+        if (type >= MPP_CTX_BUTT) {
+            mpp_err_f("invalid input type %d\n", type);
+            ret = MPP_ERR_UNKNOW;
+            break;
+        }
+
+        ret = p->ctx->init_dummy(type);
+        p->type     = type;
+        p->coding   = MPP_VIDEO_CodingUnused;
+    } while (0);
+
+    mpi_dbg_func("leave ret %d\n", ret);
+    return ret;
+}
+
 MPP_RET mpp_destroy(MppCtx ctx)
 {
     mpi_dbg_func("enter ctx %p\n", ctx);
@@ -25,6 +25,9 @@
 #include "mpp_env.h"
 #include "mpp_time.h"
 #include "mpp_impl.h"
+#include "mpp_trace.h"
+#include "mpp_eventfd.h"
+#include "mpp_atomic.h"
 
 #include "mpp.h"
 #include "mpp_hal.h"
@@ -33,10 +36,35 @@
 #include "mpp_buffer_impl.h"
 #include "mpp_frame_impl.h"
 #include "mpp_packet_impl.h"
+#include "mpp_meta_impl.h"
 
 #define MPP_TEST_FRAME_SIZE     SZ_1M
 #define MPP_TEST_PACKET_SIZE    SZ_512K
 
+/* ring element count for input packet / output frame / timestamp */
+#define MPP_PACKET_RING_COUNT   16
+#define MPP_FRAME_RING_COUNT    64
+#define MPP_TS_RING_COUNT       128
+
+/* max encoder input frame count queued on async put_frame, not encoded at once */
+#define MPP_ENC_PIPE_DEPTH_MAX  8
+
+/* packet_queue / frame_queue / task_queue / packet_bufs for MppDecPipePreset */
+static const MppDecPipeCfg dec_pipe_presets[MPP_DEC_PIPE_BUTT] = {
+    {   4,  4,  4,  3,  },
+    {   1,  1,  1,  2,  },
+    {   16, 16, 8,  6,  },
+};
+
+static void release_input_frame(MppTask task)
+{
+    MppFrame frame = NULL;
+
+    mpp_task_meta_get_frame(task, KEY_INPUT_FRAME, &frame);
+    if (frame)
+        mpp_frame_deinit(&frame);
+}
+
 static void mpp_notify_by_buffer_group(void *arg, void *group)
 {
     Mpp *mpp = (Mpp *)arg;
@@ -66,6 +94,8 @@ Mpp::Mpp()
       mFrameGetCount(0),
       mTaskPutCount(0),
       mTaskGetCount(0),
+      mPacketCopySize(0),
+      mPacketRefSize(0),
       mPacketGroup(NULL),
       mFrameGroup(NULL),
       mExternalFrameGroup(0),
@@ -85,13 +115,20 @@ Mpp::Mpp()
       mMultiFrame(0),
       mStatus(0),
       mParserFastMode(0),
+      mParserPipeline(0),
       mParserNeedSplit(0),
       mParserInternalPts(0),
       mImmediateOut(0),
+      mWorkerPool(0),
       mExtraPacket(NULL),
+      mEventFd(-1),
+      mEvents(0),
       mDump(NULL)
 {
+    mPipeCfg = dec_pipe_presets[MPP_DEC_PIPE_DEFAULT];
+    mEncPipeDepth = 1;
     mpp_env_get_u32("mpp_debug", &mpp_debug, 0);
+    mpp_trace_init();
     mpp_dump_init(&mDump);
 }
 
@@ -102,6 +139,16 @@ MPP_RET Mpp::init(MppCtxType type, MppCodingType coding)
         return MPP_NOK;
     }
 
+    return init_ctx(type, coding);
+}
+
+MPP_RET Mpp::init_dummy(MppCtxType type)
+{
+    return init_ctx(type, MPP_VIDEO_CodingUnused);
+}
+
+MPP_RET Mpp::init_ctx(MppCtxType type, MppCodingType coding)
+{
     mpp_ops_init(mDump, type, coding);
 
     mType = type;
@@ -112,9 +159,14 @@ MPP_RET Mpp::init(MppCtxType type, MppCodingType coding)
 
     switch (mType) {
     case MPP_CTX_DEC : {
-        mPackets    = new mpp_list(list_wraper_packet);
-        mFrames     = new mpp_list(list_wraper_frame);
-        mTimeStamps = new mpp_list(list_wraper_packet);
+        /* keep ring larger than queue depth for eos and extra packet */
+        RK_S32 pkt_cnt = MPP_MAX(MPP_PACKET_RING_COUNT, mPipeCfg.packet_queue * 2);
+        RK_S32 frm_cnt = MPP_MAX(MPP_FRAME_RING_COUNT, mPipeCfg.frame_queue * 2);
+
+        mPackets    = new MppRing(pkt_cnt, sizeof(MppPacket), list_wraper_packet);
+        mFrames     = new MppRing(frm_cnt, sizeof(MppFrame), list_wraper_frame);
+        mTimeStamps = new MppRing(MPP_TS_RING_COUNT, sizeof(MppPacket),
+                                  list_wraper_packet);
 
         if (mInputTimeout == MPP_POLL_BUTT)
             mInputTimeout = MPP_POLL_NON_BLOCK;
@@ -124,10 +176,12 @@ MPP_RET Mpp::init(MppCtxType type, MppCodingType coding)
 
         if (mCoding != MPP_VIDEO_CodingMJPEG) {
             mpp_buffer_group_get_internal(&mPacketGroup, MPP_BUFFER_TYPE_ION);
-            mpp_buffer_group_limit_config(mPacketGroup, 0, 3);
+            mpp_buffer_group_limit_config(mPacketGroup, 0, mPipeCfg.packet_bufs);
+            /* keep small stream buffer for P frame when I frame needs larger one */
+            mpp_buffer_group_cache_config(mPacketGroup, SZ_4M, 0);
 
-            mpp_task_queue_setup(mInputTaskQueue, 4);
-            mpp_task_queue_setup(mOutputTaskQueue, 4);
+            mpp_task_queue_setup(mInputTaskQueue, mPipeCfg.task_queue);
+            mpp_task_queue_setup(mOutputTaskQueue, mPipeCfg.task_queue);
         } else {
             mpp_task_queue_setup(mInputTaskQueue, 1);
             mpp_task_queue_setup(mOutputTaskQueue, 1);
@@ -139,9 +193,11 @@ MPP_RET Mpp::init(MppCtxType type, MppCodingType coding)
         MppDecCfg cfg = {
             coding,
             mParserFastMode,
+            mParserPipeline,
             mParserNeedSplit,
             mParserInternalPts,
             mImmediateOut,
+            mWorkerPool,
             this,
         };
 
@@ -151,8 +207,9 @@ MPP_RET Mpp::init(MppCtxType type, MppCodingType coding)
         mInitDone = 1;
     } break;
     case MPP_CTX_ENC : {
-        mFrames     = new mpp_list(NULL);
-        mPackets    = new mpp_list(list_wraper_packet);
+        mFrames     = new MppRing(MPP_FRAME_RING_COUNT, sizeof(MppFrame));
+        mPackets    = new MppRing(MPP_PACKET_RING_COUNT, sizeof(MppPacket),
+                                  list_wraper_packet);
 
         if (mInputTimeout == MPP_POLL_BUTT)
             mInputTimeout = MPP_POLL_BLOCK;
@@ -163,14 +220,15 @@ MPP_RET Mpp::init(MppCtxType type, MppCodingType coding)
         mpp_buffer_group_get_internal(&mPacketGroup, MPP_BUFFER_TYPE_ION);
         mpp_buffer_group_get_internal(&mFrameGroup, MPP_BUFFER_TYPE_ION);
 
-        mpp_task_queue_setup(mInputTaskQueue, 1);
-        mpp_task_queue_setup(mOutputTaskQueue, 1);
+        mpp_task_queue_setup(mInputTaskQueue, mEncPipeDepth);
+        mpp_task_queue_setup(mOutputTaskQueue, mEncPipeDepth);
 
         mInputPort  = mpp_task_queue_get_port(mInputTaskQueue,  MPP_PORT_INPUT);
         mOutputPort = mpp_task_queue_get_port(mOutputTaskQueue, MPP_PORT_OUTPUT);
 
         MppEncInitCfg cfg = {
             coding,
+            mWorkerPool,
             this,
         };
 
@@ -217,6 +275,18 @@ void Mpp::clear()
             mpp_enc_deinit_v2(mEnc);
             mEnc = NULL;
         }
+
+        /* release frames referenced by async put_frame */
+        if (mEncPipeDepth > 1 && mInputPort) {
+            MppTask task = mInputTask;
+
+            mInputTask = NULL;
+            do {
+                if (task)
+                    release_input_frame(task);
+                task = NULL;
+            } while (MPP_OK == mpp_port_dequeue(mInputPort, &task) && task);
+        }
     }
 
     if (mInputTaskQueue) {
@@ -236,6 +306,11 @@ void Mpp::clear()
         mExtraPacket = NULL;
     }
 
+    if (mEventFd >= 0) {
+        mpp_eventfd_put(mEventFd);
+        mEventFd = -1;
+    }
+
     if (mPackets) {
         delete mPackets;
         mPackets = NULL;
@@ -265,20 +340,78 @@ MPP_RET Mpp::put_packet(MppPacket packet)
     if (!mInitDone)
         return MPP_ERR_INIT;
 
-    AutoMutex autoLock(mPackets->mutex());
+    MPP_RET ret;
+
+    {
+        AutoMutex auto_lock(&mPacketLock);
+        ret = push_packet(packet);
+    }
+
+    if (MPP_OK == ret)
+        notify(MPP_INPUT_ENQUEUE);
+
+    return ret;
+}
+
+MPP_RET Mpp::put_packets(MppPacket *packets, RK_S32 count, RK_S32 *done)
+{
+    MPP_RET ret = MPP_OK;
+    RK_S32 i;
+
+    if (!mInitDone)
+        return MPP_ERR_INIT;
+
+    {
+        AutoMutex auto_lock(&mPacketLock);
+
+        for (i = 0; i < count; i++) {
+            ret = push_packet(packets[i]);
+            if (ret)
+                break;
+        }
+    }
+
+    /* wake up parser once for the whole batch */
+    if (i)
+        notify(MPP_INPUT_ENQUEUE);
+
+    *done = i;
+    return (i) ? MPP_OK : ret;
+}
+
+MPP_RET Mpp::push_packet(MppPacket packet)
+{
+    /* NOTE: put_packet is the only producer of packet ring, called with mPacketLock */
     if (mExtraPacket) {
-        mPackets->add_at_tail(&mExtraPacket, sizeof(mExtraPacket));
+        if (mPackets->push(&mExtraPacket))
+            return MPP_ERR_BUFFER_FULL;
+
         mExtraPacket = NULL;
         mPacketPutCount++;
     }
 
     RK_U32 eos = mpp_packet_get_eos(packet);
-    if (mPackets->list_size() < 4 || eos) {
+    if (mPackets->ring_size() < mPipeCfg.packet_queue || eos) {
         MppPacket pkt;
+        size_t length = mpp_packet_get_length(packet);
+
+        /*
+         * NOTE: packet with MppBuffer is held by reference and will be
+         * released when parser has consumed it. Other packet is copied.
+         */
         if (MPP_OK != mpp_packet_copy_init(&pkt, packet))
             return MPP_NOK;
 
-        mPackets->add_at_tail(&pkt, sizeof(pkt));
+        if (mPackets->push(&pkt)) {
+            mpp_packet_deinit(&pkt);
+            return MPP_ERR_BUFFER_FULL;
+        }
+
+        if (mpp_packet_get_buffer(packet))
+            mPacketRefSize += length;
+        else
+            mPacketCopySize += length;
+
         mPacketPutCount++;
         // dump input packet
         mpp_ops_dec_put_pkt(mDump, packet);
@@ -286,74 +419,119 @@ MPP_RET Mpp::put_packet(MppPacket packet)
         // when packet has been send clear the length
         mpp_packet_set_length(packet, 0);
 
-        notify(MPP_INPUT_ENQUEUE);
         return MPP_OK;
     }
 
     return MPP_ERR_BUFFER_FULL;
 }
 
-MPP_RET Mpp::get_frame(MppFrame *frame)
+MPP_RET Mpp::wait_frame()
 {
-    if (!mInitDone)
-        return MPP_ERR_INIT;
-
-    AutoMutex autoFrameLock(mFrames->mutex());
-    MppFrame first = NULL;
-
-    if (0 == mFrames->list_size()) {
+    /* NOTE: get_frame is the only consumer of frame ring */
+    if (mFrames->is_empty()) {
         if (mOutputTimeout) {
-            if (mOutputTimeout < 0) {
-                /* block wait */
-                mFrames->wait();
-            } else {
-                RK_S32 ret = mFrames->wait(mOutputTimeout);
-                if (ret) {
-                    if (ret == ETIMEDOUT)
-                        return MPP_ERR_TIMEOUT;
-                    else
-                        return MPP_NOK;
-                }
+            /* block wait when timeout is negative */
+            RK_S32 ret = mFrames->wait_data(mOutputTimeout);
+            if (ret) {
+                if (ret == ETIMEDOUT)
+                    return MPP_ERR_TIMEOUT;
+                else
+                    return MPP_NOK;
             }
-        } else {
-            /* NOTE: in non-block mode the sleep is to avoid user's dead loop */
+        } else if (mEventFd < 0) {
+            /*
+             * NOTE: in non-block polling mode the sleep is to avoid user's
+             * dead loop. Event driven user waits on the readiness fd instead.
+             */
             msleep(1);
         }
     }
 
-    if (mFrames->list_size()) {
-        mFrames->del_at_head(&first, sizeof(frame));
-        mFrameGetCount++;
-        notify(MPP_OUTPUT_DEQUEUE);
+    return MPP_OK;
+}
 
-        if (mMultiFrame) {
-            MppFrame prev = first;
-            MppFrame next = NULL;
-            while (mFrames->list_size()) {
-                mFrames->del_at_head(&next, sizeof(frame));
-                mFrameGetCount++;
-                notify(MPP_OUTPUT_DEQUEUE);
-                mpp_frame_set_next(prev, next);
-                prev = next;
-            }
-        }
-    } else {
+void Mpp::frame_dequeued(RK_S32 count)
+{
+    if (count) {
+        /* wake up parser once for all frames taken out */
+        mFrameGetCount += count;
+        notify(MPP_OUTPUT_DEQUEUE);
+    } else if (mEventFd < 0) {
         // NOTE: Add signal here is not efficient
         // This is for fix bug of stucking on decoder parser thread
         // When decoder parser thread is block by info change and enter waiting.
         // There is no way to wake up parser thread to continue decoding.
         // The put_packet only signal sem on may be it better to use sem on info
         // change too.
-        AutoMutex autoPacketLock(mPackets->mutex());
-        if (mPackets->list_size())
+        // Event driven user gets MPP_DEC_EVENT_INFO_CHANGE and replies with
+        // MPP_DEC_SET_INFO_CHANGE_READY which wakes up parser explicitly.
+        if (!mPackets->is_empty())
             notify(MPP_INPUT_ENQUEUE);
     }
+}
 
-    *frame = first;
+/*
+ * Take out up to count ready frames from frame ring. On multi frame mode the
+ * frames are linked to the first one by mpp_frame_set_next. Otherwise they are
+ * stored to the frame array in order.
+ */
+RK_S32 Mpp::pop_frames(MppFrame *frames, RK_S32 count, RK_U32 link)
+{
+    MppFrame prev = NULL;
+    MppFrame next = NULL;
+    RK_S32 i = 0;
+
+    while (i < count && MPP_OK == mFrames->pop(&next)) {
+        // dump output
+        mpp_ops_dec_get_frm(mDump, next);
+
+        if (!link)
+            frames[i] = next;
+        else if (prev)
+            mpp_frame_set_next(prev, next);
+        else
+            frames[0] = next;
 
-    // dump output
-    mpp_ops_dec_get_frm(mDump, first);
+        prev = next;
+        i++;
+    }
+
+    frame_dequeued(i);
+    return i;
+}
+
+MPP_RET Mpp::get_frame(MppFrame *frame)
+{
+    if (!mInitDone)
+        return MPP_ERR_INIT;
+
+    MPP_RET ret = wait_frame();
+
+    *frame = NULL;
+    if (ret)
+        return ret;
+
+    if (mMultiFrame)
+        pop_frames(frame, mFrames->ring_count(), 1);
+    else
+        pop_frames(frame, 1, 0);
+
+    return MPP_OK;
+}
+
+MPP_RET Mpp::get_frames(MppFrame *frames, RK_S32 count, RK_S32 *done)
+{
+    if (!mInitDone)
+        return MPP_ERR_INIT;
+
+    MPP_RET ret = wait_frame();
 
+    *done = 0;
+    if (ret)
+        return ret;
+
+    /* same as multi frame mode but frames are returned in array */
+    *done = pop_frames(frames, count, 0);
     return MPP_OK;
 }
 
@@ -362,6 +540,9 @@ MPP_RET Mpp::put_frame(MppFrame frame)
     if (!mInitDone)
         return MPP_ERR_INIT;
 
+    if (mEncPipeDepth > 1)
+        return put_frame_async(frame);
+
     MPP_RET ret = MPP_NOK;
 
     if (mInputTask == NULL) {
@@ -434,15 +615,173 @@ RET:
     return ret;
 }
 
+/*
+ * Take an idle or returned input task and set a reference of the frame and its
+ * buffer to it. The reference is released when the task returned by encoder is
+ * reused or on close.
+ */
+MPP_RET Mpp::prepare_input_task(MppFrame frame, MppPollType timeout)
+{
+    MPP_RET ret = MPP_NOK;
+    MppFrame frm = NULL;
+    MppBuffer buffer = NULL;
+
+    if (mInputTask == NULL) {
+        /* poll input port for idle or returned task */
+        ret = poll(MPP_PORT_INPUT, timeout);
+        if (ret) {
+            if (timeout)
+                mpp_log_f("poll on set timeout %d ret %d\n", timeout, ret);
+            return ret;
+        }
+
+        ret = dequeue(MPP_PORT_INPUT, &mInputTask);
+        if (ret || NULL == mInputTask) {
+            mpp_log_f("dequeue on set ret %d task %p\n", ret, mInputTask);
+            return (ret) ? ret : MPP_NOK;
+        }
+
+        /* the frame in returned task has been encoded */
+        release_input_frame(mInputTask);
+    }
+
+    ret = mpp_frame_init(&frm);
+    if (ret)
+        return ret;
+
+    mpp_frame_copy(frm, frame);
+    buffer = mpp_frame_get_buffer(frm);
+    if (buffer)
+        mpp_buffer_inc_ref(buffer);
+
+    ret = mpp_task_meta_set_frame(mInputTask, KEY_INPUT_FRAME, frm);
+    if (ret) {
+        mpp_log_f("set input frame to task ret %d\n", ret);
+        mpp_frame_deinit(&frm);
+        return ret;
+    }
+
+    if (mpp_frame_has_meta(frame)) {
+        MppMeta meta = mpp_frame_get_meta(frame);
+        MppPacket packet = NULL;
+
+        mpp_meta_get_packet(meta, KEY_OUTPUT_PACKET, &packet);
+        if (packet)
+            mpp_task_meta_set_packet(mInputTask, KEY_OUTPUT_PACKET, packet);
+    }
+
+    // dump input
+    mpp_ops_enc_put_frm(mDump, frame);
+
+    return MPP_OK;
+}
+
+/* Queue the frame to encoder and return without waiting for encoding done. */
+MPP_RET Mpp::put_frame_async(MppFrame frame)
+{
+    MPP_RET ret = prepare_input_task(frame, mInputTimeout);
+
+    if (ret)
+        return ret;
+
+    ret = enqueue(MPP_PORT_INPUT, mInputTask);
+    if (ret) {
+        mpp_log_f("enqueue ret %d\n", ret);
+        release_input_frame(mInputTask);
+        return ret;
+    }
+
+    mInputTask = NULL;
+    return MPP_OK;
+}
+
+MPP_RET Mpp::put_frames(MppFrame *frames, RK_S32 count, RK_S32 *done)
+{
+    MPP_RET ret = MPP_OK;
+    RK_S32 i;
+
+    if (!mInitDone)
+        return MPP_ERR_INIT;
+
+    /*
+     * NOTE: on pipe depth 1 the frame is encoded before put_frame returns and
+     * user may reuse it. Then frames are sent in turn and each one waits.
+     */
+    if (mEncPipeDepth <= 1) {
+        for (i = 0; i < count; i++) {
+            ret = put_frame(frames[i]);
+            if (ret)
+                break;
+        }
+
+        *done = i;
+        return (i) ? MPP_OK : ret;
+    }
+
+    /*
+     * Each frame takes one input task from the pipe depth. Only the first frame
+     * waits with input timeout then the batch stops at the first frame without
+     * free task. Encoder is woken up once for the whole batch.
+     */
+    for (i = 0; i < count; i++) {
+        ret = prepare_input_task(frames[i], (i) ? MPP_POLL_NON_BLOCK : mInputTimeout);
+        if (ret)
+            break;
+
+        ret = mpp_port_enqueue(mInputPort, mInputTask);
+        if (ret) {
+            mpp_log_f("enqueue ret %d\n", ret);
+            release_input_frame(mInputTask);
+            break;
+        }
+
+        mInputTask = NULL;
+    }
+
+    if (i)
+        notify(MPP_INPUT_ENQUEUE);
+
+    *done = i;
+    return (i) ? MPP_OK : ret;
+}
+
 MPP_RET Mpp::get_packet(MppPacket *packet)
 {
     if (!mInitDone)
         return MPP_ERR_INIT;
 
+    return get_packet(packet, mOutputTimeout);
+}
+
+MPP_RET Mpp::get_packets(MppPacket *packets, RK_S32 count, RK_S32 *done)
+{
+    MPP_RET ret = MPP_OK;
+    RK_S32 i;
+
+    if (!mInitDone)
+        return MPP_ERR_INIT;
+
+    /* only the first packet waits with output timeout then drain the ready ones */
+    for (i = 0; i < count; i++) {
+        MppPacket packet = NULL;
+
+        ret = get_packet(&packet, (i) ? MPP_POLL_NON_BLOCK : mOutputTimeout);
+        if (ret || NULL == packet)
+            break;
+
+        packets[i] = packet;
+    }
+
+    *done = i;
+    return (i) ? MPP_OK : ret;
+}
+
+MPP_RET Mpp::get_packet(MppPacket *packet, MppPollType timeout)
+{
     MPP_RET ret = MPP_OK;
     MppTask task = NULL;
 
-    ret = poll(MPP_PORT_OUTPUT, mOutputTimeout);
+    ret = poll(MPP_PORT_OUTPUT, timeout);
     if (ret) {
         // NOTE: Do not treat poll failure as error. Just clear output
         ret = MPP_OK;
@@ -594,7 +933,7 @@ MPP_RET Mpp::control(MpiCmd cmd, MppParam param)
             ret = control_dec(cmd, param);
         } break;
         case CMD_CTX_ID_ENC : {
-            mpp_assert(mType == MPP_CTX_ENC);
+            mpp_assert(mType == MPP_CTX_ENC || mType == MPP_CTX_BUTT);
             mpp_assert(cmd > MPP_ENC_CMD_BASE);
             mpp_assert(cmd < MPP_ENC_CMD_END);
 
@@ -637,45 +976,86 @@ MPP_RET Mpp::reset()
          * To avoid this case happen we need to save it on reset beginning
          * then restore it on reset end.
          */
-        mPackets->lock();
-        while (mPackets->list_size()) {
-            MppPacket pkt = NULL;
-            mPackets->del_at_head(&pkt, sizeof(pkt));
-            mPacketGetCount++;
-
-            RK_U32 flags = mpp_packet_get_flag(pkt);
-            if (flags & MPP_PACKET_FLAG_EXTRA_DATA) {
-                if (mExtraPacket) {
-                    mpp_packet_deinit(&mExtraPacket);
-                }
-                mExtraPacket = pkt;
-            } else {
-                mpp_packet_deinit(&pkt);
-            }
-        }
-        mPackets->flush();
-        mPackets->unlock();
+        /*
+         * The packet ring is consumed by decoder parser thread. So packets
+         * are dropped by parser thread on its reset. For MJPEG there is no
+         * parser thread working on packet ring then drop them here.
+         */
+        if (mCoding == MPP_VIDEO_CodingMJPEG)
+            flush_packets();
 
         mpp_dec_reset(mDec);
 
-        mFrames->lock();
+        mPacketCopySize = 0;
+        mPacketRefSize = 0;
         mFrames->flush();
-        mFrames->unlock();
     } else {
-        mFrames->lock();
         mFrames->flush();
-        mFrames->unlock();
 
         mpp_enc_reset_v2(mEnc);
 
-        mPackets->lock();
         mPackets->flush();
-        mPackets->unlock();
     }
 
     return MPP_OK;
 }
 
+/*
+ * Called by packet ring consumer. It is decoder parser thread on reset while
+ * user thread may be in put_packet so the extra packet is saved under lock.
+ */
+void Mpp::flush_packets()
+{
+    AutoMutex auto_lock(&mPacketLock);
+    MppPacket pkt = NULL;
+
+    while (MPP_OK == mPackets->pop(&pkt)) {
+        RK_U32 flags = mpp_packet_get_flag(pkt);
+
+        mPacketGetCount++;
+        if (flags & MPP_PACKET_FLAG_EXTRA_DATA) {
+            if (mExtraPacket) {
+                mpp_packet_deinit(&mExtraPacket);
+            }
+            mExtraPacket = pkt;
+        } else {
+            mpp_packet_deinit(&pkt);
+        }
+        pkt = NULL;
+    }
+}
+
+void Mpp::set_event(RK_U32 event)
+{
+    RK_S32 fd = MPP_LOAD_ACQUIRE(&mEventFd);
+
+    if (fd < 0)
+        return;
+
+    /* only write eventfd when new event bit is raised */
+    if ((MPP_FETCH_OR(&mEvents, event) & event) != event)
+        mpp_eventfd_write(fd, 1);
+}
+
+RK_U32 Mpp::get_event()
+{
+    if (mEventFd < 0)
+        return 0;
+
+    /* clear eventfd before event bits so that no event will be lost */
+    mpp_eventfd_read(mEventFd, NULL, 0);
+
+    return MPP_FETCH_AND(&mEvents, 0);
+}
+
+static void pool_info_to_stat(MppMemPoolInfo *info, MppPoolStat *stat)
+{
+    stat->hits = info->hits;
+    stat->misses = info->misses;
+    stat->used = info->used;
+    stat->high_water = info->high_water;
+}
+
 MPP_RET Mpp::control_mpp(MpiCmd cmd, MppParam param)
 {
     MPP_RET ret = MPP_OK;
@@ -717,6 +1097,39 @@ MPP_RET Mpp::control_mpp(MpiCmd cmd, MppParam param)
         else
             mOutputTimeout = timeout;
     } break;
+    case MPP_SET_WORKER_POOL : {
+        if (mInitDone) {
+            mpp_err("worker pool mode should be set before init\n");
+            ret = MPP_NOK;
+            break;
+        }
+
+        mWorkerPool = (param) ? *((RK_U32 *)param) : 1;
+    } break;
+    case MPP_GET_POOL_STATS : {
+        MppPoolStats *stats = (MppPoolStats *)param;
+        MppMemPoolInfo info;
+
+        if (NULL == stats) {
+            ret = MPP_ERR_NULL_PTR;
+            break;
+        }
+
+        mpp_frame_pool_info(&info);
+        pool_info_to_stat(&info, &stats->frame);
+        mpp_packet_pool_info(&info);
+        pool_info_to_stat(&info, &stats->packet);
+        mpp_meta_pool_info(&info);
+        pool_info_to_stat(&info, &stats->meta);
+    } break;
+    case MPP_SET_TRACE : {
+        RK_U32 size = (param) ? *((RK_U32 *)param) : MPP_TRACE_DEFAULT_SIZE;
+
+        ret = mpp_trace_enable(size);
+    } break;
+    case MPP_DUMP_TRACE : {
+        ret = mpp_trace_dump((const char *)param);
+    } break;
 
     default : {
         ret = MPP_NOK;
@@ -788,6 +1201,7 @@ MPP_RET Mpp::control_dec(MpiCmd cmd, MppParam param)
         if (mpp_debug & MPP_DBG_INFO)
             mpp_log("set info change ready\n");
 
+        MPP_FETCH_AND(&mEvents, ~MPP_DEC_EVENT_INFO_CHANGE);
         ret = mpp_dec_control(mDec, cmd, param);
         notify(MPP_DEC_NOTIFY_INFO_CHG_DONE | MPP_DEC_NOTIFY_BUFFER_MATCH);
     } break;
@@ -801,9 +1215,17 @@ MPP_RET Mpp::control_dec(MpiCmd cmd, MppParam param)
         mParserFastMode = flag;
         ret = MPP_OK;
     } break;
+    case MPP_DEC_SET_PARSER_PIPELINE_MODE: {
+        if (mInitDone) {
+            mpp_err("parser pipeline mode should be set before init\n");
+            break;
+        }
+
+        mParserPipeline = (param) ? *((RK_U32 *)param) : 1;
+        ret = MPP_OK;
+    } break;
     case MPP_DEC_GET_STREAM_COUNT: {
-        AutoMutex autoLock(mPackets->mutex());
-        *((RK_S32 *)param) = mPackets->list_size();
+        *((RK_S32 *)param) = mPackets->ring_size();
         ret = MPP_OK;
     } break;
     case MPP_DEC_SET_IMMEDIATE_OUT: {
@@ -812,11 +1234,83 @@ MPP_RET Mpp::control_dec(MpiCmd cmd, MppParam param)
         if (mDec)
             ret = mpp_dec_control(mDec, cmd, param);
     } break;
+    case MPP_DEC_GET_EVENT_FD: {
+        if (NULL == param) {
+            ret = MPP_ERR_NULL_PTR;
+            break;
+        }
+
+        if (mEventFd < 0) {
+            RK_S32 fd = mpp_eventfd_get(0);
+
+            if (fd < 0) {
+                mpp_err_f("failed to get eventfd ret %d\n", fd);
+                ret = MPP_NOK;
+                break;
+            }
+            MPP_STORE_RELEASE(&mEventFd, fd);
+
+            /* raise the current readiness for the first wait */
+            if (mPackets->ring_size() < mPipeCfg.packet_queue)
+                set_event(MPP_DEC_EVENT_INPUT_READY);
+            if (!mFrames->is_empty())
+                set_event(MPP_DEC_EVENT_FRAME_READY);
+        }
+
+        *((RK_S32 *)param) = mEventFd;
+        ret = MPP_OK;
+    } break;
+    case MPP_DEC_SET_PIPE_CFG: {
+        ret = set_pipe_cfg((MppDecPipeCfg *)param);
+    } break;
+    case MPP_DEC_GET_PIPE_CFG: {
+        if (NULL == param) {
+            ret = MPP_ERR_NULL_PTR;
+            break;
+        }
+
+        *((MppDecPipeCfg *)param) = mPipeCfg;
+        ret = MPP_OK;
+    } break;
+    case MPP_DEC_SET_PIPE_PRESET: {
+        MppDecPipePreset preset = (param) ? *((MppDecPipePreset *)param) :
+                                  MPP_DEC_PIPE_DEFAULT;
+        MppDecPipeCfg cfg;
+
+        if (preset < MPP_DEC_PIPE_DEFAULT || preset >= MPP_DEC_PIPE_BUTT) {
+            mpp_err_f("invalid pipeline preset %d\n", preset);
+            ret = MPP_ERR_VALUE;
+            break;
+        }
+
+        /* rings and task queue are sized by the preset on init */
+        if (mInitDone) {
+            mpp_err("pipeline preset should be set before init\n");
+            ret = MPP_NOK;
+            break;
+        }
+
+        cfg = dec_pipe_presets[preset];
+        ret = set_pipe_cfg(&cfg);
+    } break;
+    case MPP_DEC_GET_EVENT: {
+        if (NULL == param) {
+            ret = MPP_ERR_NULL_PTR;
+            break;
+        }
+
+        *((RK_U32 *)param) = get_event();
+        ret = MPP_OK;
+    } break;
     case MPP_DEC_GET_VPUMEM_USED_COUNT:
     case MPP_DEC_SET_OUTPUT_FORMAT:
     case MPP_DEC_SET_DISABLE_ERROR:
     case MPP_DEC_SET_PRESENT_TIME_ORDER:
     case MPP_DEC_SET_ENABLE_DEINTERLACE:
+    case MPP_DEC_SET_ZERO_COPY_INPUT:
+    case MPP_DEC_SET_PERF_STATS:
+    case MPP_DEC_GET_PERF_STATS:
+    case MPP_DEC_GET_WAIT_STATS:
     case MPP_DEC_QUERY: {
         ret = mpp_dec_control(mDec, cmd, param);
     }
@@ -826,9 +1320,86 @@ MPP_RET Mpp::control_dec(MpiCmd cmd, MppParam param)
     return ret;
 }
 
+MPP_RET Mpp::set_pipe_cfg(MppDecPipeCfg *cfg)
+{
+    if (NULL == cfg)
+        return MPP_ERR_NULL_PTR;
+
+    if (cfg->packet_queue < 0 || cfg->frame_queue < 0 ||
+        cfg->task_queue < 0 || cfg->packet_bufs < 0) {
+        mpp_err_f("invalid pipeline depth packet %d frame %d task %d buffer %d\n",
+                  cfg->packet_queue, cfg->frame_queue, cfg->task_queue,
+                  cfg->packet_bufs);
+        return MPP_ERR_VALUE;
+    }
+
+    if (mInitDone && ((cfg->task_queue && cfg->task_queue != mPipeCfg.task_queue) ||
+                      (cfg->packet_bufs && cfg->packet_bufs != mPipeCfg.packet_bufs))) {
+        mpp_err("task queue and packet buffer depth should be set before init\n");
+        return MPP_NOK;
+    }
+
+    /* rings are created on init and one element is kept for eos and extra packet */
+    if (mPackets && mFrames && (cfg->packet_queue >= mPackets->ring_count() ||
+                                cfg->frame_queue >= mFrames->ring_count())) {
+        mpp_err_f("packet queue %d frame queue %d exceed ring size %d %d after init\n",
+                  cfg->packet_queue, cfg->frame_queue,
+                  mPackets->ring_count() - 1, mFrames->ring_count() - 1);
+        return MPP_ERR_VALUE;
+    }
+
+    if (cfg->packet_queue)
+        mPipeCfg.packet_queue = cfg->packet_queue;
+    if (cfg->frame_queue)
+        mPipeCfg.frame_queue = cfg->frame_queue;
+    if (cfg->task_queue)
+        mPipeCfg.task_queue = cfg->task_queue;
+    if (cfg->packet_bufs)
+        mPipeCfg.packet_bufs = cfg->packet_bufs;
+
+    if (mpp_debug & MPP_DBG_INFO)
+        mpp_log("pipeline depth packet %d frame %d task %d buffer %d\n",
+                mPipeCfg.packet_queue, mPipeCfg.frame_queue,
+                mPipeCfg.task_queue, mPipeCfg.packet_bufs);
+
+    if (mInitDone) {
+        /* deeper queue may unblock user input and parser on display queue */
+        if (mPackets->ring_size() < mPipeCfg.packet_queue)
+            set_event(MPP_DEC_EVENT_INPUT_READY);
+        notify(MPP_DEC_NOTIFY_FRAME_DEQUEUE);
+    }
+
+    return MPP_OK;
+}
+
 MPP_RET Mpp::control_enc(MpiCmd cmd, MppParam param)
 {
+    switch (cmd) {
+    case MPP_ENC_SET_PIPE_DEPTH: {
+        RK_S32 depth = (param) ? *((RK_S32 *)param) : 1;
+
+        if (mInitDone) {
+            mpp_err("pipe depth should be set before init\n");
+            return MPP_NOK;
+        }
+
+        if (depth < 1 || depth > MPP_ENC_PIPE_DEPTH_MAX) {
+            mpp_err("invalid pipe depth %d range [1:%d]\n", depth,
+                    MPP_ENC_PIPE_DEPTH_MAX);
+            return MPP_ERR_VALUE;
+        }
+
+        mEncPipeDepth = depth;
+        return MPP_OK;
+    } break;
+    default : {
+    } break;
+    }
+
     mpp_assert(mEnc);
+    if (NULL == mEnc)
+        return MPP_ERR_INIT;
+
     return mpp_enc_control_v2(mEnc, cmd, param);
 }
 
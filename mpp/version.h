@@ -0,0 +1,33 @@
+/*
+ * Copyright 2010 Rockchip Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VERSION_H__
+#define __VERSION_H__
+
+#define MPP_VERSION             "3864942 author: agent          2026-10-17 [user-017] fix: reject pipe depth beyond ring after init and measure presets on dummy decoder"
+#define MPP_VER_HIST_CNT        10
+#define MPP_VER_HIST_0          "3864942 author: agent          2026-10-17 [user-017] fix: reject pipe depth beyond ring after init and measure presets on dummy decoder  (HEAD -> master)"
+#define MPP_VER_HIST_1          "5ae0d78 author: agent          2026-10-17 [user-019] fix: share multi frame path in get_frames and batch encoder input"
+#define MPP_VER_HIST_2          "39eed3a author: agent          2026-10-17 [user-002] fix: keep frame output non-blocking and lock extra packet on reset"
+#define MPP_VER_HIST_3          "51db81b author: agent          2026-10-17 [user-012] fix: keep meta pool on exit and skip pool recycle under mpp_mem debug"
+#define MPP_VER_HIST_4          "59db5d4 author: agent          2026-10-17 [user-001] fix: only copy stream into packet group buffer on packet slot"
+#define MPP_VER_HIST_5          "1ac7bc9 author: agent          2026-10-17 [user-018] fix: same reference error on both pipeline modes and test only dummy init"
+#define MPP_VER_HIST_6          "70bd560 author: agent          2026-10-17 [user-004] fix: keep pool jobs non-blocking and add worker pool test"
+#define MPP_VER_HIST_7          "cc839d9 author: agent          2026-10-17 [user-020] fix: scope encoder pipeline docs to task and packet prefetch"
+#define MPP_VER_HIST_8          "b014936 author: agent          2026-10-17 [user-018] fix: drop HEVC from parser pipeline and test error attribution"
+#define MPP_VER_HIST_9          "bcc49a2 author: agent          2026-10-17 [user-002] fix: block on full frame ring and drop unused ring eventfd"
+
+#endif /*__VERSION_H__*/
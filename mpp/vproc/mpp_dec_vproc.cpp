@@ -21,6 +21,7 @@
 #include "mpp_env.h"
 #include "mpp_mem.h"
 #include "mpp_common.h"
+#include "mpp_trace.h"
 
 #include "mpp_dec_impl.h"
 
@@ -74,7 +75,6 @@ typedef struct MppDecVprocCtxImpl_t {
 
 static void dec_vproc_put_frame(Mpp *mpp, MppFrame frame, MppBuffer buf, RK_S64 pts)
 {
-    mpp_list *list = mpp->mFrames;
     MppFrame out = NULL;
     MppFrameImpl *impl = NULL;
 
@@ -86,15 +86,10 @@ static void dec_vproc_put_frame(Mpp *mpp, MppFrame frame, MppBuffer buf, RK_S64
     if (buf)
         impl->buffer = buf;
 
-    list->lock();
-    list->add_at_tail(&out, sizeof(out));
-
     if (mpp_debug & MPP_DBG_PTS)
         mpp_log("output frame pts %lld\n", mpp_frame_get_pts(out));
 
-    mpp->mFramePutCount++;
-    list->signal();
-    list->unlock();
+    mpp_dec_push_frame((MppDecImpl *)mpp->mDec, out);
 }
 
 static void dec_vproc_clr_prev(MppDecVprocCtxImpl *ctx)
@@ -464,11 +459,13 @@ static void *dec_vproc_thread(void *data)
             mpp_assert(tmp == index);
 
             if (!dec->reset_flag && ctx->iep_ctx) {
+                mpp_trace_begin(mpp, "vproc", index, 0);
                 if (ctx->com_ctx->ver == 1) {
                     dec_vproc_set_dei_v1(ctx, frm);
                 } else {
                     dec_vproc_set_dei_v2(ctx, frm);
                 }
+                mpp_trace_end(mpp, "vproc", index, 0);
             }
 
             dec_vproc_clr_prev(ctx);
@@ -214,7 +214,7 @@ static MPP_RET os_allocator_drm_open(void **ctx, MppAllocatorCfg *cfg)
          * default drm use cma, do nothing here
          */
         p->alignment    = cfg->alignment;
-        p->flags        = cfg->flags;
+        p->flags        = cfg->flags & (MPP_BUFFER_FLAGS_DRM_MASK >> 16);
         p->drm_device   = fd;
         *ctx = p;
     }
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "allocator_memfd"
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "mpp_env.h"
+#include "mpp_mem.h"
+#include "mpp_log.h"
+#include "mpp_common.h"
+
+#include "allocator_memfd.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB         0x0004U
+#endif
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE       14
+#endif
+
+#define MEMFD_DBG_OPS       (0x00000001)
+
+#define memfd_dbg(flag, fmt, ...)   _mpp_dbg(memfd_debug, flag, fmt, ## __VA_ARGS__)
+#define memfd_dbg_ops(fmt, ...)     memfd_dbg(MEMFD_DBG_OPS, fmt, ## __VA_ARGS__)
+
+#define MEMFD_NAME          "mpp_buffer"
+#define MEMFD_HUGE_SIZE     SZ_2M
+
+static RK_U32 memfd_debug = 0;
+
+typedef struct {
+    size_t alignment;
+    RK_U32 flags;
+    /* hugetlb memfd failed once then only use transparent hugepage */
+    RK_U32 hugetlb_fail;
+} allocator_ctx;
+
+static int memfd_create_fd(RK_U32 flags)
+{
+#if defined(__NR_memfd_create)
+    return syscall(__NR_memfd_create, MEMFD_NAME, flags);
+#else
+    (void)flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* hugetlb mapping can only be unmapped with the hugepage aligned file size */
+static size_t memfd_map_size(int fd, size_t size)
+{
+    struct stat st;
+
+    if (!fstat(fd, &st) && (size_t)st.st_size > size)
+        return st.st_size;
+
+    return size;
+}
+
+static void *memfd_map(int fd, size_t size, RK_U32 populate)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | (populate ? MAP_POPULATE : 0), fd, 0);
+
+    return (ptr == MAP_FAILED) ? NULL : ptr;
+}
+
+static MPP_RET allocator_memfd_open(void **ctx, MppAllocatorCfg *cfg)
+{
+    MPP_RET ret = MPP_OK;
+    allocator_ctx *p = NULL;
+
+    if (NULL == ctx) {
+        mpp_err_f("do not accept NULL input\n");
+        return MPP_ERR_NULL_PTR;
+    }
+
+    mpp_env_get_u32("memfd_debug", &memfd_debug, 0);
+
+    p = mpp_malloc(allocator_ctx, 1);
+    if (NULL == p) {
+        mpp_err_f("failed to allocate context\n");
+        ret = MPP_ERR_MALLOC;
+    } else {
+        p->alignment = cfg->alignment;
+        p->flags = cfg->flags << 16;
+        p->hugetlb_fail = 0;
+    }
+
+    *ctx = p;
+    return ret;
+}
+
+static MPP_RET allocator_memfd_alloc(void *ctx, MppBufferInfo *info)
+{
+    allocator_ctx *p = (allocator_ctx *)ctx;
+    RK_U32 hugepage = 0;
+    RK_U32 populate = 0;
+    size_t size = 0;
+    void *ptr = NULL;
+    int fd = -1;
+
+    if (!p || !info) {
+        mpp_err_f("found NULL context input\n");
+        return MPP_ERR_VALUE;
+    }
+
+    hugepage = p->flags & MPP_BUFFER_FLAGS_HUGEPAGE;
+    populate = p->flags & MPP_BUFFER_FLAGS_POPULATE;
+
+    if (hugepage && !p->hugetlb_fail) {
+        size = MPP_ALIGN(info->size, MEMFD_HUGE_SIZE);
+        fd = memfd_create_fd(MFD_CLOEXEC | MFD_HUGETLB);
+        if (fd >= 0) {
+            /* no reserved hugepage will fail on ftruncate or mmap */
+            if (!ftruncate(fd, size))
+                ptr = memfd_map(fd, size, populate);
+
+            if (NULL == ptr) {
+                close(fd);
+                fd = -1;
+            }
+        }
+
+        if (fd < 0) {
+            memfd_dbg_ops("hugetlb memfd unavailable fallback to thp\n");
+            p->hugetlb_fail = 1;
+        }
+    }
+
+    if (fd < 0) {
+        size = MPP_ALIGN(info->size, p->alignment);
+        fd = memfd_create_fd(MFD_CLOEXEC);
+        if (fd < 0) {
+            mpp_err_f("memfd_create failed errno %d\n", errno);
+            return MPP_ERR_NOMEM;
+        }
+
+        if (ftruncate(fd, size)) {
+            mpp_err_f("ftruncate size %d failed errno %d\n", (RK_S32)size, errno);
+            close(fd);
+            return MPP_ERR_NOMEM;
+        }
+
+        ptr = memfd_map(fd, size, populate);
+        if (NULL == ptr) {
+            mpp_err_f("mmap size %d failed errno %d\n", (RK_S32)size, errno);
+            close(fd);
+            return MPP_ERR_NOMEM;
+        }
+
+        if (hugepage)
+            madvise(ptr, size, MADV_HUGEPAGE);
+    }
+
+    memfd_dbg_ops("alloc fd %d ptr %p size %d map %d\n", fd, ptr,
+                  (RK_S32)info->size, (RK_S32)size);
+
+    info->fd  = fd;
+    info->ptr = ptr;
+    info->hnd = NULL;
+
+    return MPP_OK;
+}
+
+static MPP_RET allocator_memfd_free(void *ctx, MppBufferInfo *info)
+{
+    if (!ctx || !info) {
+        mpp_err_f("found NULL context input\n");
+        return MPP_ERR_VALUE;
+    }
+
+    memfd_dbg_ops("free fd %d ptr %p size %d\n", info->fd, info->ptr,
+                  (RK_S32)info->size);
+
+    if (info->ptr)
+        munmap(info->ptr, memfd_map_size(info->fd, info->size));
+
+    if (info->fd >= 0)
+        close(info->fd);
+
+    info->ptr   = NULL;
+    info->fd    = -1;
+
+    return MPP_OK;
+}
+
+static MPP_RET allocator_memfd_import(void *ctx, MppBufferInfo *info)
+{
+    mpp_assert(ctx);
+    mpp_assert(info->size);
+
+    if (info->ptr) {
+        mpp_err_f("The memfd is not used for userptr\n");
+        return MPP_ERR_VALUE;
+    }
+
+    return ((info->fd < 0) ? MPP_ERR_VALUE : MPP_OK);
+}
+
+static MPP_RET allocator_memfd_mmap(void *ctx, MppBufferInfo *info)
+{
+    void *ptr = NULL;
+
+    mpp_assert(ctx);
+    mpp_assert(info->size);
+    mpp_assert(info->fd >= 0);
+
+    if (info->ptr)
+        return MPP_OK;
+
+    ptr = memfd_map(info->fd, memfd_map_size(info->fd, info->size), 0);
+    if (NULL == ptr)
+        return MPP_ERR_NULL_PTR;
+
+    info->ptr = ptr;
+
+    return MPP_OK;
+}
+
+static MPP_RET allocator_memfd_release(void *ctx, MppBufferInfo *info)
+{
+    mpp_assert(ctx);
+    mpp_assert(info->size);
+
+    /* imported fd is owned by user and only the mapping is released here */
+    if (info->ptr)
+        munmap(info->ptr, memfd_map_size(info->fd, info->size));
+
+    info->ptr   = NULL;
+    info->hnd   = NULL;
+    info->fd    = -1;
+    info->size  = 0;
+
+    return MPP_OK;
+}
+
+static MPP_RET allocator_memfd_close(void *ctx)
+{
+    if (ctx) {
+        mpp_free(ctx);
+        return MPP_OK;
+    }
+
+    mpp_err_f("found NULL context input\n");
+    return MPP_ERR_VALUE;
+}
+
+os_allocator allocator_memfd = {
+    .open = allocator_memfd_open,
+    .close = allocator_memfd_close,
+    .alloc = allocator_memfd_alloc,
+    .free = allocator_memfd_free,
+    .import = allocator_memfd_import,
+    .release = allocator_memfd_release,
+    .mmap = allocator_memfd_mmap,
+};
@@ -63,7 +63,7 @@ void mpp_show_mem_status();
  * usage:
  * call mpp_mem_get_snapshot on context init get one snapshot
  * call mpp_mem_get_snapshot on context deinit get another snapshot
- * call mpp_mem_diff_snapshot to show the difference between these two snapshot
+ * call mpp_mem_squash_snapshot to show the difference between these two snapshot
  * call mpp_mem_put_snapshot twice to release these two snapshot
  */
 typedef void* MppMemSnapshot;
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MPP_MEM_POOL_H__
+#define __MPP_MEM_POOL_H__
+
+#include <stddef.h>
+
+#include "rk_type.h"
+#include "mpp_err.h"
+
+typedef void* MppMemPool;
+
+/*
+ * MppMemPool recycles fixed size objects to avoid heap call on hot path
+ *
+ * hits       - get served by a recycled object
+ * misses     - get served by a new heap allocation
+ * used       - object currently in use
+ * high_water - max object in use at the same time
+ * unused     - recycled object kept in pool
+ */
+typedef struct MppMemPoolInfo_t {
+    RK_U64          hits;
+    RK_U64          misses;
+    RK_S32          used;
+    RK_S32          high_water;
+    RK_S32          unused;
+} MppMemPoolInfo;
+
+#define mpp_mem_pool_init(size)     mpp_mem_pool_init_f(MODULE_TAG, size)
+#define mpp_mem_pool_get(pool)      mpp_mem_pool_get_f(__FUNCTION__, pool)
+#define mpp_mem_pool_put(pool, p)   mpp_mem_pool_put_f(__FUNCTION__, pool, p)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+MppMemPool mpp_mem_pool_init_f(const char *name, size_t size);
+void mpp_mem_pool_deinit(MppMemPool pool);
+
+// return zeroed object
+void *mpp_mem_pool_get_f(const char *caller, MppMemPool pool);
+void mpp_mem_pool_put_f(const char *caller, MppMemPool pool, void *p);
+
+MPP_RET mpp_mem_pool_info(MppMemPool pool, MppMemPoolInfo *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*__MPP_MEM_POOL_H__*/
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MPP_RING_H__
+#define __MPP_RING_H__
+
+#include "mpp_list.h"
+
+/*
+ * MppRing wakeup mode
+ *
+ * MPP_RING_WAKE_NONE    - no blocking wait, user poll the ring by itself
+ * MPP_RING_WAKE_FUTEX   - waiter sleep on ring index and wake by the peer
+ */
+#define MPP_RING_WAKE_NONE          (0x00000000)
+#define MPP_RING_WAKE_FUTEX         (0x00000001)
+
+#define MPP_RING_CACHE_LINE         64
+
+#ifdef __cplusplus
+
+/*
+ * MppRing is a bounded single-producer / single-consumer ring queue
+ *
+ * Elements are stored by value with the fixed size given on creation. The
+ * producer and the consumer work on their own index without lock. Only one
+ * producer thread and one consumer thread are allowed at the same time.
+ *
+ * producer side : push / wait_space
+ * consumer side : pop / wait_data / flush
+ * any thread    : ring_size / ring_count / is_empty / is_full
+ *
+ * NOTE: flush must be called from consumer thread or when consumer is idle.
+ */
+class MppRing
+{
+public:
+    MppRing(RK_S32 count, RK_S32 size, node_destructor func = NULL,
+            RK_U32 mode = MPP_RING_WAKE_FUTEX);
+    ~MppRing();
+
+    // return MPP_OK on success and MPP_NOK on ring full
+    RK_S32 push(void *data);
+    // return MPP_OK on success and MPP_NOK on ring empty
+    RK_S32 pop(void *data);
+    // copy the head element without removing it
+    RK_S32 peek(void *data);
+    // drop all element with the node destructor
+    RK_S32 flush();
+
+    RK_S32 ring_size();
+    RK_S32 ring_count();
+    RK_S32 is_empty() { return ring_size() == 0; };
+    RK_S32 is_full()  { return ring_size() >= ring_count(); };
+
+    /*
+     * blocking wait with mpp timeout rule
+     * zero     - non block
+     * negative - block with no timeout
+     * positive - timeout in milisecond
+     * return 0 on ready and ETIMEDOUT on timeout
+     */
+    RK_S32 wait_data(RK_S64 timeout);
+    RK_S32 wait_space(RK_S64 timeout);
+
+private:
+    RK_U32              mCount;
+    RK_U32              mMask;
+    RK_S32              mSize;
+    RK_U32              mMode;
+    RK_U8               *mData;
+    node_destructor     destroy;
+
+    // producer / consumer index are separated to avoid false sharing
+    RK_U8               mPad0[MPP_RING_CACHE_LINE];
+    volatile RK_U32     mWrIdx;
+    volatile RK_U32     mWrWait;
+    RK_U8               mPad1[MPP_RING_CACHE_LINE];
+    volatile RK_U32     mRdIdx;
+    volatile RK_U32     mRdWait;
+    RK_U8               mPad2[MPP_RING_CACHE_LINE];
+
+    MppRing(const MppRing &);
+    MppRing &operator=(const MppRing &);
+};
+
+#endif
+
+#endif /*__MPP_RING_H__*/
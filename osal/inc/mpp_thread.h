@@ -56,6 +56,21 @@ int pthread_setname_np(pthread_t thread, const char *name);
 
 typedef void *(*MppThreadFunc)(void *);
 
+/*
+ * resumable job for MppThread job mode
+ *
+ * MPP_JOB_CONTINUE - job has done some work and should be run again
+ * MPP_JOB_WAIT     - job is waiting for next signal
+ * MPP_JOB_EXIT     - job is stopped and will not be run anymore
+ */
+typedef enum MppJobRet_e {
+    MPP_JOB_CONTINUE,
+    MPP_JOB_WAIT,
+    MPP_JOB_EXIT,
+} MppJobRet;
+
+typedef MppJobRet (*MppJobFunc)(void *);
+
 typedef enum {
     MPP_THREAD_UNINITED,
     MPP_THREAD_RUNNING,
@@ -144,6 +159,7 @@ public:
     RK_S32 timedwait(Mutex& mutex, RK_S64 timeout);
     RK_S32 timedwait(Mutex* mutex, RK_S64 timeout);
     RK_S32 signal();
+    RK_S32 broadcast();
 
 private:
     pthread_cond_t mCond;
@@ -187,6 +203,10 @@ inline RK_S32 Condition::signal()
 {
     return pthread_cond_signal(&mCond);
 }
+inline RK_S32 Condition::broadcast()
+{
+    return pthread_cond_broadcast(&mCond);
+}
 
 class MppMutexCond
 {
@@ -217,10 +237,24 @@ typedef enum MppThreadSignal_e {
 #define THREAD_NORMAL       0
 #define THRE       0
 
+class MppWorkerPool;
+
+/*
+ * MppThread has two working mode:
+ *
+ * thread mode - MppThreadFunc runs the whole working loop by itself.
+ *
+ * job mode    - MppJobFunc does one loop step and returns MppJobRet instead
+ *               of calling wait. The job is resumed by signal on THREAD_WORK.
+ *               It is driven by its own thread or by the process-wide worker
+ *               pool when use_pool is set.
+ *               NOTE: signal on THREAD_WORK must be called with lock held.
+ */
 class MppThread
 {
 public:
     MppThread(MppThreadFunc func, void *ctx, const char *name = NULL);
+    MppThread(MppJobFunc job, void *ctx, const char *name, RK_U32 use_pool);
     ~MppThread() {};
 
     MppThreadStatus get_status(MppThreadSignal id = THREAD_WORK);
@@ -254,15 +288,30 @@ public:
 
     void signal(MppThreadSignal id = THREAD_WORK) {
         mpp_assert(id < THREAD_SIGNAL_BUTT);
+        if (mJob && id == THREAD_WORK) {
+            signal_job();
+            return;
+        }
         mMutexCond[id].signal();
     }
 
+    /*
+     * Job on worker pool should return MPP_JOB_WAIT instead of waiting on the
+     * other job. Blocking call like hardware wait is put between block_begin
+     * and block_end then the pool keeps the other jobs running. They are no-op
+     * on thread which is not a pool worker.
+     */
+    static void block_begin();
+    static void block_end();
+
     Mutex *mutex(MppThreadSignal id = THREAD_WORK) {
         mpp_assert(id < THREAD_SIGNAL_BUTT);
         return mMutexCond[id].mutex();
     }
 
 private:
+    friend class MppWorkerPool;
+
     pthread_t       mThread;
     MppMutexCond    mMutexCond[THREAD_SIGNAL_BUTT];
     MppThreadStatus mStatus[THREAD_SIGNAL_BUTT];
@@ -271,6 +320,20 @@ private:
     char            mName[THREAD_NAME_LEN];
     void            *mContext;
 
+    /* job mode */
+    MppJobFunc      mJob;
+    RK_U32          mUsePool;
+    /* signal flag for own thread driven job */
+    RK_U32          mJobSignal;
+    /* job state and deque node for worker pool driven job */
+    volatile RK_U32 mJobState;
+    MppThread       *mJobPrev;
+    MppThread       *mJobNext;
+    sem_t           mJobExit;
+
+    void signal_job();
+    static void *job_loop(void *ctx);
+
     MppThread();
     MppThread(const MppThread &);
     MppThread &operator=(const MppThread &);
@@ -18,6 +18,7 @@
 #define __MPP_TIME_H__
 
 #include "rk_type.h"
+#include "mpp_err.h"
 #include "mpp_thread.h"
 
 #if defined(_WIN32) && !defined(__MINGW32CE__)
@@ -70,6 +71,27 @@ RK_S64 mpp_clock_get_sum(MppClock clock);
 RK_S64 mpp_clock_get_count(MppClock clock);
 const char *mpp_clock_get_name(MppClock clock);
 
+/*
+ * Clock latency histogram is disabled by default. When enabled each pause
+ * after start records the time diff into a log bucketed histogram without
+ * lock. mpp_clock_get_stat can be called from any thread and returns the
+ * count / sum in microsecond. min / max / percentile are only valid with
+ * histogram enabled and percentile has the bucket precision of 1 / 16.
+ */
+typedef struct MppClockStat_t {
+    RK_S64  count;
+    RK_S64  sum;
+    RK_S64  min;
+    RK_S64  max;
+    RK_S64  p50;
+    RK_S64  p90;
+    RK_S64  p99;
+    RK_S64  p999;
+} MppClockStat;
+
+void mpp_clock_enable_histogram(MppClock clock, RK_U32 enable);
+MPP_RET mpp_clock_get_stat(MppClock clock, MppClockStat *stat);
+
 /*
  * MppTimer is for timer with callback function
  * It will provide the ability to repeat doing something until it is
@@ -84,12 +106,17 @@ const char *mpp_clock_get_name(MppClock clock);
  *    ... running ...
  * 5. mpp_timer_set_enable(initial, 0)
  * 6. mpp_timer_put
+ *
+ * All timers share one timer thread so the callback should return quickly.
+ * Timing is in millisecond on monotonic clock. Zero interval is one shot.
+ * mpp_timer_get_wakeups returns the shared timer thread wakeup count.
  */
 MppTimer mpp_timer_get(const char *name);
 void mpp_timer_set_callback(MppTimer timer, MppThreadFunc func, void *ctx);
 void mpp_timer_set_timing(MppTimer timer, RK_S32 initial, RK_S32 interval);
 void mpp_timer_set_enable(MppTimer timer, RK_S32 enable);
 void mpp_timer_put(MppTimer timer);
+RK_S64 mpp_timer_get_wakeups(void);
 
 /*
  * MppStopwatch is for timer to record event and time
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MPP_TRACE_H__
+#define __MPP_TRACE_H__
+
+#include "rk_type.h"
+#include "mpp_err.h"
+
+/*
+ * mpp_trace - low overhead pipeline event recorder
+ *
+ * Begin / end / instant events are recorded into one process-wide ring
+ * without lock and the oldest events are overwritten. The ring can be
+ * dumped to Chrome trace JSON for chrome://tracing or ui.perfetto.dev.
+ *
+ * env mpp_trace_size - ring size in event count, 0 for disabled
+ * env mpp_trace_file - dump the ring to this file on process exit
+ *
+ * name must be a static string. task is the task / slot index and arg is
+ * an extra value shown in hex, for example the parser wait reason bits.
+ */
+#define MPP_TRACE_BEGIN             'B'
+#define MPP_TRACE_END               'E'
+#define MPP_TRACE_INSTANT           'i'
+
+#define MPP_TRACE_DEFAULT_SIZE      (64 * 1024)
+
+#define mpp_trace_begin(ctx, name, task, arg) \
+    do { if (mpp_trace_en) mpp_trace_record(ctx, name, MPP_TRACE_BEGIN, task, arg); } while (0)
+
+#define mpp_trace_end(ctx, name, task, arg) \
+    do { if (mpp_trace_en) mpp_trace_record(ctx, name, MPP_TRACE_END, task, arg); } while (0)
+
+#define mpp_trace_instant(ctx, name, task, arg) \
+    do { if (mpp_trace_en) mpp_trace_record(ctx, name, MPP_TRACE_INSTANT, task, arg); } while (0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern RK_U32 mpp_trace_en;
+
+/* read env and enable trace once, it is called on each mpp context init */
+void mpp_trace_init(void);
+/*
+ * enable with ring size in event count or disable with zero size
+ * The ring is allocated on first enable and kept until exit. Later size is
+ * ignored for the lock-free recording.
+ */
+MPP_RET mpp_trace_enable(RK_U32 size);
+void mpp_trace_record(void *ctx, const char *name, RK_S32 phase,
+                      RK_S32 task, RK_U32 arg);
+/* dump to path or to env mpp_trace_file path when path is NULL */
+MPP_RET mpp_trace_dump(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*__MPP_TRACE_H__*/
@@ -15,12 +15,14 @@
  */
 
 #if defined(__gnu_linux__)
+#include "mpp_env.h"
 #include "mpp_log.h"
 #include "mpp_runtime.h"
 
 #include "allocator_drm.h"
 #include "allocator_ext_dma.h"
 #include "allocator_ion.h"
+#include "allocator_memfd.h"
 #include "allocator_std.h"
 
 /*
@@ -28,6 +30,19 @@
  * we can support MPP_BUFFER_TYPE_V4L2 later
  */
 
+/*
+ * When ion / drm is not available the buffer is from allocator_std by default.
+ * Set env mpp_buffer_memfd=1 to use memfd buffer instead so that the buffer
+ * has a real fd for sharing. Userptr import is not allowed in this case.
+ */
+static RK_U32 os_allocator_memfd_fallback(void)
+{
+    RK_U32 val = 0;
+
+    mpp_env_get_u32("mpp_buffer_memfd", &val, 0);
+    return val && mpp_rt_allcator_is_valid(MPP_BUFFER_TYPE_MEMFD);
+}
+
 MPP_RET os_allocator_get(os_allocator *api, MppBufferType type)
 {
     MPP_RET ret = MPP_OK;
@@ -40,6 +55,7 @@ MPP_RET os_allocator_get(os_allocator *api, MppBufferType type)
 #if HAVE_DRM
                (mpp_rt_allcator_is_valid(MPP_BUFFER_TYPE_DRM)) ? allocator_drm :
 #endif
+               (os_allocator_memfd_fallback()) ? allocator_memfd :
                allocator_std;
     } break;
     case MPP_BUFFER_TYPE_EXT_DMA: {
@@ -52,6 +68,11 @@ MPP_RET os_allocator_get(os_allocator *api, MppBufferType type)
         * api =
 #endif
                (mpp_rt_allcator_is_valid(MPP_BUFFER_TYPE_ION)) ? allocator_ion :
+               (os_allocator_memfd_fallback()) ? allocator_memfd :
+               allocator_std;
+    } break;
+    case MPP_BUFFER_TYPE_MEMFD : {
+        *api = (mpp_rt_allcator_is_valid(MPP_BUFFER_TYPE_MEMFD)) ? allocator_memfd :
                allocator_std;
     } break;
     default : {
@@ -24,8 +24,10 @@
 #include "mpp_log.h"
 #include "mpp_env.h"
 #include "mpp_mem.h"
+#include "mpp_time.h"
 #include "mpp_list.h"
 #include "mpp_common.h"
+#include "mpp_thread.h"
 
 #include "os_mem.h"
 
@@ -44,12 +46,31 @@
 #define MEM_ALIGNED(x)          (((x) + MEM_ALIGN) & (~MEM_ALIGN_MASK))
 #define MEM_HEAD_ROOM(debug)    ((debug & MEM_EXT_ROOM) ? (MEM_ALIGN) : (0))
 #define MEM_NODE_MAX            (1024)
+#define MEM_CALLER_MAX          (256)
 #define MEM_FREE_MAX            (512)
 #define MEM_LOG_MAX             (1024)
 #define MEM_CHECK_MARK          (0xdd)
 #define MEM_HEAD_MASK           (0xab)
 #define MEM_TAIL_MASK           (0xcd)
 
+/*
+ * mpp_mem_cache: per-thread size-class cache mode
+ *
+ * Small memory is allocated by size class and cached in per-thread
+ * magazines on free. When magazine is full half of it is returned to the
+ * central depot of the class and the empty magazine is refilled from depot.
+ * Each memory in cache mode has a MEM_ALIGN head to record its size class.
+ * The cache sits below mpp_mem_debug so that node tracking, extra room and
+ * poison check work on top of it.
+ */
+#define MEM_CACHE_CLASS_NUM     8
+#define MEM_CACHE_CLASS_MIN     32
+#define MEM_CACHE_CLASS_SIZE(i) (MEM_CACHE_CLASS_MIN << (i))
+#define MEM_CACHE_MAG_SIZE      32
+#define MEM_CACHE_DEPOT_MAX     1024
+#define MEM_CACHE_HEAD          MEM_ALIGN
+#define MEM_CACHE_LARGE         (-1)
+
 #define MPP_MEM_ASSERT(cond) \
     do { \
         if (!(cond)) { \
@@ -82,6 +103,27 @@ typedef struct MppMemNode_s {
     const char  *caller;
 } MppMemNode;
 
+/*
+ * Memory usage aggregated by caller function name
+ * The caller string from __FUNCTION__ is used as key by its address.
+ */
+typedef struct MppMemCaller_s {
+    const char  *caller;
+    RK_S32      count;          // live memory count
+    size_t      size;           // live memory size
+    size_t      peak;           // peak live memory size
+    RK_U64      alloc_cnt;      // total malloc / realloc count
+    RK_U64      alloc_size;     // total malloc / realloc size
+} MppMemCaller;
+
+typedef struct MppMemSnapshotImpl_t {
+    RK_S64          time;
+    RK_S32          nodes_cnt;
+    RK_U32          total_size;
+    RK_S32          callers_cnt;
+    MppMemCaller    *callers;
+} MppMemSnapshotImpl;
+
 typedef struct MppMemLog_s {
     RK_U32      index;
     MppMemOps   ops;
@@ -101,14 +143,8 @@ public:
     ~MppMemService();
 
     void    add_node(const char *caller, void *ptr, size_t size);
-    /*
-     * try delete node will return index in nodes
-     * return 1 for need os_free call to real free
-     * return 0 for reserve memory for check
-     */
-    RK_S32  find_node(const char *caller, void *ptr, size_t *size, RK_S32 *idx);
-    /*
-     */
+    // find valid node by pointer return NULL when not found
+    MppMemNode *find_node(void *ptr);
     void    del_node(const char *caller, void *ptr, size_t *size);
     void*   delay_del_node(const char *caller, void *ptr, size_t *size);
     void    reset_node(const char *caller, void *ptr, void *ret, size_t size);
@@ -121,13 +157,26 @@ public:
                     size_t size_0, size_t size_1);
 
     void    dump(const char *caller);
+    void    dump_caller();
+
+    MPP_RET get_snapshot(MppMemSnapshot *hnd);
 
     Mutex       lock;
     RK_U32      debug;
 
 private:
+    // open addressing hash table operation on nodes
+    MppMemNode *ins_node(void *ptr);
+    void    rm_node(MppMemNode *node);
+
+    MppMemCaller *get_caller(const char *caller);
+    void    inc_caller(const char *caller, size_t size);
+    void    dec_caller(const char *caller, size_t size);
+
     // data for node record and delay free check
     RK_S32      nodes_max;
+    RK_S32      nodes_size;
+    RK_U32      nodes_mask;
     RK_S32      nodes_idx;
     RK_S32      nodes_cnt;
     RK_S32      frees_max;
@@ -146,12 +195,352 @@ private:
     MppMemLog   *logs;
     RK_U32      total_size;
 
+    // data for caller aggregation
+    RK_S32      callers_cnt;
+    MppMemCaller *callers;
+    RK_S64      time_start;
+
     MppMemService(const MppMemService &);
     MppMemService &operator=(const MppMemService &);
 };
 
 static MppMemService service;
 
+typedef struct MemCacheHead_t {
+    RK_S32              cls;
+} MemCacheHead;
+
+typedef struct MemCacheStat_t {
+    RK_U64              alloc;
+    RK_U64              hit;
+    RK_U64              depot;
+    RK_U64              miss;
+} MemCacheStat;
+
+typedef struct MemCacheMag_t {
+    RK_S32              count;
+    void                *blocks[MEM_CACHE_MAG_SIZE];
+} MemCacheMag;
+
+typedef struct MemThreadCache_t {
+    struct MemThreadCache_t *prev;
+    struct MemThreadCache_t *next;
+    MemCacheMag         mags[MEM_CACHE_CLASS_NUM];
+    MemCacheStat        stats[MEM_CACHE_CLASS_NUM];
+} MemThreadCache;
+
+typedef struct MemCacheDepot_t {
+    pthread_mutex_t     lock;
+    void                *head;
+    RK_S32              count;
+} MemCacheDepot;
+
+/*
+ * NOTE: cache data is plain static data without constructor and destructor
+ * to be safe on static object init / deinit order.
+ */
+static pthread_once_t   cache_once = PTHREAD_ONCE_INIT;
+static RK_U32           cache_en = 0;
+static pthread_key_t    cache_key;
+static pthread_mutex_t  cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static MemThreadCache   *cache_list = NULL;
+static MemCacheStat     cache_retired[MEM_CACHE_CLASS_NUM];
+static MemCacheDepot    cache_depots[MEM_CACHE_CLASS_NUM];
+
+#define MEM_CACHE_NEXT(raw)     (*(void **)((RK_U8 *)(raw) + MEM_CACHE_HEAD))
+
+static void mem_cache_thread_exit(void *ctx);
+
+static void mem_cache_init(void)
+{
+    RK_S32 i;
+
+    mpp_env_get_u32("mpp_mem_cache", &cache_en, 0);
+    if (!cache_en)
+        return;
+
+    for (i = 0; i < MEM_CACHE_CLASS_NUM; i++) {
+        pthread_mutex_init(&cache_depots[i].lock, NULL);
+        cache_depots[i].head = NULL;
+        cache_depots[i].count = 0;
+    }
+
+    if (pthread_key_create(&cache_key, mem_cache_thread_exit))
+        cache_en = 0;
+}
+
+static RK_S32 mem_cache_class(size_t size)
+{
+    RK_S32 i;
+
+    for (i = 0; i < MEM_CACHE_CLASS_NUM; i++) {
+        if (size <= (size_t)MEM_CACHE_CLASS_SIZE(i))
+            return i;
+    }
+
+    return MEM_CACHE_LARGE;
+}
+
+/* put blocks to depot and release the blocks beyond depot limit */
+static void mem_cache_depot_put(RK_S32 cls, void **blocks, RK_S32 count)
+{
+    MemCacheDepot *depot = &cache_depots[cls];
+    RK_S32 i = 0;
+
+    pthread_mutex_lock(&depot->lock);
+    for (; i < count && depot->count < MEM_CACHE_DEPOT_MAX; i++) {
+        MEM_CACHE_NEXT(blocks[i]) = depot->head;
+        depot->head = blocks[i];
+        depot->count++;
+    }
+    pthread_mutex_unlock(&depot->lock);
+
+    for (; i < count; i++)
+        os_free(blocks[i]);
+}
+
+static RK_S32 mem_cache_depot_get(RK_S32 cls, void **blocks, RK_S32 count)
+{
+    MemCacheDepot *depot = &cache_depots[cls];
+    RK_S32 i = 0;
+
+    pthread_mutex_lock(&depot->lock);
+    for (; i < count && depot->head; i++) {
+        blocks[i] = depot->head;
+        depot->head = MEM_CACHE_NEXT(depot->head);
+        depot->count--;
+    }
+    pthread_mutex_unlock(&depot->lock);
+
+    return i;
+}
+
+static MemThreadCache *mem_cache_get_thread(void)
+{
+    MemThreadCache *tc = (MemThreadCache *)pthread_getspecific(cache_key);
+
+    if (tc)
+        return tc;
+
+    os_malloc((void **)&tc, MEM_ALIGN, sizeof(*tc));
+    if (NULL == tc)
+        return NULL;
+
+    memset(tc, 0, sizeof(*tc));
+    pthread_setspecific(cache_key, tc);
+
+    pthread_mutex_lock(&cache_lock);
+    tc->next = cache_list;
+    if (cache_list)
+        cache_list->prev = tc;
+    cache_list = tc;
+    pthread_mutex_unlock(&cache_lock);
+
+    return tc;
+}
+
+static void mem_cache_thread_exit(void *ctx)
+{
+    MemThreadCache *tc = (MemThreadCache *)ctx;
+    RK_S32 i;
+
+    for (i = 0; i < MEM_CACHE_CLASS_NUM; i++) {
+        MemCacheMag *mag = &tc->mags[i];
+
+        mem_cache_depot_put(i, mag->blocks, mag->count);
+        mag->count = 0;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    for (i = 0; i < MEM_CACHE_CLASS_NUM; i++) {
+        cache_retired[i].alloc += tc->stats[i].alloc;
+        cache_retired[i].hit   += tc->stats[i].hit;
+        cache_retired[i].depot += tc->stats[i].depot;
+        cache_retired[i].miss  += tc->stats[i].miss;
+    }
+
+    if (tc->prev)
+        tc->prev->next = tc->next;
+    else
+        cache_list = tc->next;
+    if (tc->next)
+        tc->next->prev = tc->prev;
+    pthread_mutex_unlock(&cache_lock);
+
+    os_free(tc);
+}
+
+/*
+ * raw memory interface under mpp_mem_debug layer
+ * It goes to os_malloc directly or through the size-class cache.
+ */
+static void *mem_raw_malloc(size_t size)
+{
+    MemThreadCache *tc = NULL;
+    void *raw = NULL;
+    RK_S32 cls;
+
+    pthread_once(&cache_once, mem_cache_init);
+
+    if (!cache_en) {
+        os_malloc(&raw, MEM_ALIGN, size);
+        return raw;
+    }
+
+    cls = mem_cache_class(size);
+    if (cls != MEM_CACHE_LARGE)
+        tc = mem_cache_get_thread();
+
+    if (tc) {
+        MemCacheMag *mag = &tc->mags[cls];
+        MemCacheStat *stat = &tc->stats[cls];
+
+        stat->alloc++;
+
+        if (mag->count) {
+            stat->hit++;
+            raw = mag->blocks[--mag->count];
+        } else {
+            mag->count = mem_cache_depot_get(cls, mag->blocks,
+                                             MEM_CACHE_MAG_SIZE / 2);
+            if (mag->count) {
+                stat->depot++;
+                raw = mag->blocks[--mag->count];
+            }
+        }
+
+        if (raw)
+            return (RK_U8 *)raw + MEM_CACHE_HEAD;
+
+        stat->miss++;
+    }
+
+    os_malloc(&raw, MEM_ALIGN, MEM_CACHE_HEAD +
+              ((cls == MEM_CACHE_LARGE) ? size : (size_t)MEM_CACHE_CLASS_SIZE(cls)));
+    if (NULL == raw)
+        return NULL;
+
+    ((MemCacheHead *)raw)->cls = cls;
+    return (RK_U8 *)raw + MEM_CACHE_HEAD;
+}
+
+static void mem_raw_free(void *ptr)
+{
+    MemThreadCache *tc = NULL;
+    void *raw = NULL;
+    RK_S32 cls;
+
+    if (!cache_en) {
+        os_free(ptr);
+        return;
+    }
+
+    raw = (RK_U8 *)ptr - MEM_CACHE_HEAD;
+    cls = ((MemCacheHead *)raw)->cls;
+
+    if (cls == MEM_CACHE_LARGE) {
+        os_free(raw);
+        return;
+    }
+
+    tc = mem_cache_get_thread();
+    if (NULL == tc) {
+        mem_cache_depot_put(cls, &raw, 1);
+        return;
+    }
+
+    MemCacheMag *mag = &tc->mags[cls];
+
+    if (mag->count >= MEM_CACHE_MAG_SIZE) {
+        // return the older half to depot
+        RK_S32 half = MEM_CACHE_MAG_SIZE / 2;
+
+        mem_cache_depot_put(cls, mag->blocks, half);
+        memmove(mag->blocks, mag->blocks + half,
+                (mag->count - half) * sizeof(mag->blocks[0]));
+        mag->count -= half;
+    }
+
+    mag->blocks[mag->count++] = raw;
+}
+
+static void *mem_raw_realloc(void *ptr, size_t size)
+{
+    void *raw = NULL;
+    void *ret = NULL;
+    RK_S32 cls;
+
+    if (!cache_en) {
+        os_realloc(ptr, &ret, MEM_ALIGN, size);
+        return ret;
+    }
+
+    raw = (RK_U8 *)ptr - MEM_CACHE_HEAD;
+    cls = ((MemCacheHead *)raw)->cls;
+
+    if (cls == MEM_CACHE_LARGE && mem_cache_class(size) == MEM_CACHE_LARGE) {
+        os_realloc(raw, &ret, MEM_ALIGN, size + MEM_CACHE_HEAD);
+        return (ret) ? ((RK_U8 *)ret + MEM_CACHE_HEAD) : (NULL);
+    }
+
+    if (cls != MEM_CACHE_LARGE && size <= (size_t)MEM_CACHE_CLASS_SIZE(cls))
+        return ptr;
+
+    ret = mem_raw_malloc(size);
+    if (ret) {
+        size_t old_size = (cls == MEM_CACHE_LARGE) ? size :
+                          (size_t)MEM_CACHE_CLASS_SIZE(cls);
+
+        memcpy(ret, ptr, MPP_MIN(old_size, size));
+        mem_raw_free(ptr);
+    }
+
+    return ret;
+}
+
+static void mem_cache_dump(void)
+{
+    MemCacheStat stats[MEM_CACHE_CLASS_NUM];
+    RK_S64 cached[MEM_CACHE_CLASS_NUM];
+    MemThreadCache *tc;
+    RK_S32 i;
+
+    if (!cache_en)
+        return;
+
+    pthread_mutex_lock(&cache_lock);
+    memcpy(stats, cache_retired, sizeof(stats));
+    memset(cached, 0, sizeof(cached));
+
+    // NOTE: per-thread counters are read without lock for status only
+    for (tc = cache_list; tc; tc = tc->next) {
+        for (i = 0; i < MEM_CACHE_CLASS_NUM; i++) {
+            stats[i].alloc += tc->stats[i].alloc;
+            stats[i].hit   += tc->stats[i].hit;
+            stats[i].depot += tc->stats[i].depot;
+            stats[i].miss  += tc->stats[i].miss;
+            cached[i] += tc->mags[i].count;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    mpp_log("mpp_mem cache status:\n");
+    for (i = 0; i < MEM_CACHE_CLASS_NUM; i++) {
+        MemCacheStat *stat = &stats[i];
+        RK_S32 size = MEM_CACHE_CLASS_SIZE(i);
+
+        pthread_mutex_lock(&cache_depots[i].lock);
+        cached[i] += cache_depots[i].count;
+        pthread_mutex_unlock(&cache_depots[i].lock);
+
+        mpp_log("class %4d alloc %-10llu hit %6.2f%% depot %6.2f%% miss %-8llu cached %lld bytes\n",
+                size, stat->alloc,
+                stat->alloc ? stat->hit * 100.0 / stat->alloc : 0.0,
+                stat->alloc ? stat->depot * 100.0 / stat->alloc : 0.0,
+                stat->miss, cached[i] * size);
+    }
+}
+
 static const char *ops2str[MEM_OPS_BUTT] = {
     "malloc",
     "realloc",
@@ -193,9 +582,25 @@ static void set_mem_ext_room(void *p, size_t size)
     memset((RK_U8 *)p + size,      MEM_TAIL_MASK, MEM_ALIGN);
 }
 
+/*
+ * Live nodes are kept in an open addressing hash table keyed by pointer with
+ * linear probing. The table size is power of 2 and at least twice of
+ * nodes_max to keep the probe sequence short. Node deletion shifts the
+ * following nodes backward so no tombstone is needed.
+ */
+static inline RK_U32 mem_hash_ptr(const void *ptr)
+{
+    RK_U64 val = (RK_U64)(intptr_t)ptr;
+
+    // memory is at least 8 byte aligned drop the low bits before hashing
+    return (RK_U32)(((val >> 3) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
 MppMemService::MppMemService()
     : debug(0),
       nodes_max(MEM_NODE_MAX),
+      nodes_size(0),
+      nodes_mask(0),
       nodes_idx(0),
       nodes_cnt(0),
       frees_max(MEM_FREE_MAX),
@@ -208,7 +613,10 @@ MppMemService::MppMemService()
       log_idx(0),
       log_cnt(0),
       logs(NULL),
-      total_size(0)
+      total_size(0),
+      callers_cnt(0),
+      callers(NULL),
+      time_start(0)
 {
     mpp_env_get_u32("mpp_mem_debug", &debug, 0);
 
@@ -222,23 +630,37 @@ MppMemService::MppMemService()
         mpp_log_f("mpp_mem_debug enabled %x max node %d\n",
                   debug, nodes_max);
 
-        size_t size = nodes_max * sizeof(MppMemNode);
-        os_malloc((void **)&nodes, MEM_ALIGN, size);
+        nodes_size = 1;
+        while (nodes_size < nodes_max * 2)
+            nodes_size <<= 1;
+        nodes_mask = nodes_size - 1;
+        time_start = mpp_time();
+
+        size_t nodes_bytes = nodes_size * sizeof(MppMemNode);
+        os_malloc((void **)&nodes, MEM_ALIGN, nodes_bytes);
         mpp_assert(nodes);
-        memset(nodes, 0xff, size);
-        add_node(__FUNCTION__, nodes, size);
+        memset(nodes, 0xff, nodes_bytes);
 
-        size = frees_max * sizeof(MppMemNode);
-        os_malloc((void **)&frees, MEM_ALIGN, size);
+        size_t frees_bytes = frees_max * sizeof(MppMemNode);
+        os_malloc((void **)&frees, MEM_ALIGN, frees_bytes);
         mpp_assert(frees);
-        memset(frees, 0xff, size);
-        add_node(__FUNCTION__, frees, size);
+        memset(frees, 0xff, frees_bytes);
 
-        size = log_max * sizeof(MppMemLog);
-        os_malloc((void **)&logs, MEM_ALIGN, size);
+        size_t logs_bytes = log_max * sizeof(MppMemLog);
+        os_malloc((void **)&logs, MEM_ALIGN, logs_bytes);
         mpp_assert(logs);
-        add_node(__FUNCTION__, logs, size);
 
+        // the extra one caller is for overflow when caller table is full
+        size_t callers_bytes = (MEM_CALLER_MAX + 1) * sizeof(MppMemCaller);
+        os_malloc((void **)&callers, MEM_ALIGN, callers_bytes);
+        mpp_assert(callers);
+        memset(callers, 0, callers_bytes);
+        callers[MEM_CALLER_MAX].caller = "others";
+
+        add_node(__FUNCTION__, nodes, nodes_bytes);
+        add_node(__FUNCTION__, frees, frees_bytes);
+        add_node(__FUNCTION__, logs, logs_bytes);
+        add_node(__FUNCTION__, callers, callers_bytes);
         add_node(__FUNCTION__, this, sizeof(MppMemService));
     }
 }
@@ -258,10 +680,11 @@ MppMemService::~MppMemService()
         del_node(__FUNCTION__, nodes, &size);
         del_node(__FUNCTION__, frees, &size);
         del_node(__FUNCTION__, logs,  &size);
+        del_node(__FUNCTION__, callers, &size);
 
         // then check leak memory
         if (nodes_cnt) {
-            for (i = 0; i < nodes_max; i++, node++) {
+            for (i = 0; i < nodes_size; i++, node++) {
                 if (node->index >= 0) {
                     mpp_log("found idx %8d mem %10p size %d leaked\n",
                             node->index, node->ptr, node->size);
@@ -280,7 +703,7 @@ MppMemService::~MppMemService()
 
             for (i = 0; i < frees_max; i++, node++) {
                 if (node->index >= 0) {
-                    os_free((RK_U8 *)node->ptr - MEM_HEAD_ROOM(debug));
+                    mem_raw_free((RK_U8 *)node->ptr - MEM_HEAD_ROOM(debug));
                     node->index = ~node->index;
                     frees_cnt--;
                     add_log(MEM_FREE_DELAY, __FUNCTION__, node->ptr, NULL,
@@ -294,13 +717,104 @@ MppMemService::~MppMemService()
         os_free(nodes);
         os_free(frees);
         os_free(logs);
+        os_free(callers);
     }
 }
 
-void MppMemService::add_node(const char *caller, void *ptr, size_t size)
+MppMemNode *MppMemService::ins_node(void *ptr)
 {
-    RK_S32 i = 0;
+    RK_U32 pos = mem_hash_ptr(ptr) & nodes_mask;
+
+    // table is never full so there is always empty slot
+    while (nodes[pos].index >= 0)
+        pos = (pos + 1) & nodes_mask;
+
+    return &nodes[pos];
+}
+
+void MppMemService::rm_node(MppMemNode *node)
+{
+    RK_U32 hole = (RK_U32)(node - nodes);
+    RK_U32 pos = hole;
+
+    node->index = ~node->index;
+
+    while (1) {
+        MppMemNode *next;
+        RK_U32 home;
+
+        pos = (pos + 1) & nodes_mask;
+        next = &nodes[pos];
+        if (next->index < 0)
+            break;
+
+        // move node back to the hole if the hole is on its probe sequence
+        home = mem_hash_ptr(next->ptr) & nodes_mask;
+        if (((pos - home) & nodes_mask) >= ((pos - hole) & nodes_mask)) {
+            nodes[hole] = *next;
+            next->index = ~next->index;
+            hole = pos;
+        }
+    }
+}
+
+MppMemNode *MppMemService::find_node(void *ptr)
+{
+    RK_U32 pos = mem_hash_ptr(ptr) & nodes_mask;
+
+    while (nodes[pos].index >= 0) {
+        if (nodes[pos].ptr == ptr)
+            return &nodes[pos];
+
+        pos = (pos + 1) & nodes_mask;
+    }
+
+    return NULL;
+}
+
+MppMemCaller *MppMemService::get_caller(const char *caller)
+{
+    RK_U32 pos = mem_hash_ptr(caller) & (MEM_CALLER_MAX - 1);
+
+    while (callers[pos].caller) {
+        if (callers[pos].caller == caller)
+            return &callers[pos];
+
+        pos = (pos + 1) & (MEM_CALLER_MAX - 1);
+    }
+
+    // keep table load under 3/4 and put the rest caller to overflow slot
+    if (callers_cnt >= MEM_CALLER_MAX * 3 / 4)
+        return &callers[MEM_CALLER_MAX];
+
+    callers[pos].caller = caller;
+    callers_cnt++;
+    return &callers[pos];
+}
+
+void MppMemService::inc_caller(const char *caller, size_t size)
+{
+    MppMemCaller *stat = get_caller(caller ? caller : "unknown");
+
+    stat->count++;
+    stat->size += size;
+    if (stat->size > stat->peak)
+        stat->peak = stat->size;
+
+    stat->alloc_cnt++;
+    stat->alloc_size += size;
+}
+
+void MppMemService::dec_caller(const char *caller, size_t size)
+{
+    MppMemCaller *stat = get_caller(caller ? caller : "unknown");
+
+    stat->count--;
+    stat->size -= size;
+}
 
+void MppMemService::add_node(const char *caller, void *ptr, size_t size)
+{
     if (debug & MEM_NODE_LOG)
         mpp_log("mem cnt: %5d total %8d inc size %8d at %s\n",
                 nodes_cnt, total_size, size, caller);
@@ -314,74 +828,50 @@ void MppMemService::add_node(const char *caller, void *ptr, size_t size)
         mpp_abort();
     }
 
-    MppMemNode *node = nodes;
-    for (i = 0; i < nodes_max; i++, node++) {
-        if (node->index < 0) {
-            node->index = nodes_idx++;
-            node->size  = size;
-            node->ptr   = ptr;
-            node->caller = caller;
-
-            // NOTE: reset node index on revert
-            if (nodes_idx < 0)
-                nodes_idx = 0;
-
-            nodes_cnt++;
-            total_size += size;
-            break;
-        }
-    }
-}
+    MppMemNode *node = ins_node(ptr);
 
-RK_S32 MppMemService::find_node(const char *caller, void *ptr, size_t *size, RK_S32 *idx)
-{
-    RK_S32 i = 0;
-    MppMemNode *node = nodes;
+    node->index = nodes_idx++;
+    node->size  = size;
+    node->ptr   = ptr;
+    node->caller = caller;
 
-    MPP_MEM_ASSERT(nodes_cnt <= nodes_max);
-    for (i = 0; i < nodes_max; i++, node++) {
-        if (node->index >= 0 && node->ptr == ptr) {
-            *size = node->size;
-            *idx  = i;
-            return 1;
-        }
-    }
+    // NOTE: reset node index on revert
+    if (nodes_idx < 0)
+        nodes_idx = 0;
 
-    mpp_err("%s can NOT found node with ptr %p\n", caller, ptr);
-    mpp_abort();
-    return 0;
+    nodes_cnt++;
+    total_size += size;
+    inc_caller(caller, size);
 }
 
 void MppMemService::del_node(const char *caller, void *ptr, size_t *size)
 {
-    RK_S32 i = 0;
-    MppMemNode *node = nodes;
+    MppMemNode *node = find_node(ptr);
 
     MPP_MEM_ASSERT(nodes_cnt <= nodes_max);
 
-    for (i = 0; i < nodes_max; i++, node++) {
-        if (node->index >= 0 && node->ptr == ptr) {
-            *size = node->size;
-            node->index = ~node->index;
-            nodes_cnt--;
-            total_size -= node->size;
-
-            if (debug & MEM_NODE_LOG)
-                mpp_log("mem cnt: %5d total %8d dec size %8d at %s\n",
-                        nodes_cnt, total_size, node->size, caller);
-            return ;
-        }
+    if (NULL == node) {
+        mpp_err("%s fail to find node with ptr %p\n", caller, ptr);
+        mpp_abort();
+        return ;
     }
 
-    mpp_err("%s fail to find node with ptr %p\n", caller, ptr);
-    mpp_abort();
-    return ;
+    *size = node->size;
+    nodes_cnt--;
+    total_size -= node->size;
+    dec_caller(node->caller, node->size);
+
+    if (debug & MEM_NODE_LOG)
+        mpp_log("mem cnt: %5d total %8d dec size %8d at %s\n",
+                nodes_cnt, total_size, node->size, caller);
+
+    rm_node(node);
 }
 
 void *MppMemService::delay_del_node(const char *caller, void *ptr, size_t *size)
 {
     RK_S32 i = 0;
-    MppMemNode *node = nodes;
+    MppMemNode *node = find_node(ptr);
 
     // clear output first
     void *ret = NULL;
@@ -389,14 +879,9 @@ void *MppMemService::delay_del_node(const char *caller, void *ptr, size_t *size)
 
     // find the node to save
     MPP_MEM_ASSERT(nodes_cnt <= nodes_max);
-    for (i = 0; i < nodes_max; i++, node++) {
-        if (node->index >= 0 && node->ptr == ptr) {
-            chk_node(caller, node);
-            break;
-        }
-    }
+    MPP_MEM_ASSERT(node);
+    chk_node(caller, node);
 
-    MPP_MEM_ASSERT(i < nodes_max);
     if (debug & MEM_NODE_LOG)
         mpp_log("mem cnt: %5d total %8d dec size %8d at %s\n",
                 nodes_cnt, total_size, node->size, caller);
@@ -447,14 +932,15 @@ void *MppMemService::delay_del_node(const char *caller, void *ptr, size_t *size)
 
     MPP_MEM_ASSERT(frees_cnt <= frees_max);
 
-    memcpy(&frees[frees_idx], node, sizeof(*node));
+    memcpy(free_node, node, sizeof(*node));
 
     if ((debug & MEM_POISON) && (node->size < 1024))
         memset(node->ptr, MEM_CHECK_MARK, node->size);
 
-    node->index = ~node->index;
     total_size -= node->size;
     nodes_cnt--;
+    dec_caller(node->caller, node->size);
+    rm_node(node);
 
     return ret;
 }
@@ -530,8 +1016,7 @@ RK_S32 MppMemService::chk_poison(MppMemNode *node)
 
 void MppMemService::reset_node(const char *caller, void *ptr, void *ret, size_t size)
 {
-    RK_S32 i = 0;
-    MppMemNode *node = nodes;
+    MppMemNode *node = find_node(ptr);
 
     if (debug & MEM_NODE_LOG)
         mpp_log("mem cnt: %5d total %8d equ size %8d at %s\n",
@@ -539,20 +1024,29 @@ void MppMemService::reset_node(const char *caller, void *ptr, void *ret, size_t
 
     MPP_MEM_ASSERT(nodes_cnt <= nodes_max);
 
-    for (i = 0; i < nodes_max; i++, node++) {
-        if (node->index >= 0 && node->ptr == ptr) {
-            total_size  += size;
-            total_size  -= node->size;
+    if (NULL == node)
+        return ;
 
-            node->ptr   = ret;
-            node->size  = size;
-            node->caller = caller;
+    total_size  += size;
+    total_size  -= node->size;
+    dec_caller(node->caller, node->size);
+    inc_caller(caller, size);
 
-            if (debug & MEM_EXT_ROOM)
-                set_mem_ext_room(ret, size);
-            break;
-        }
+    // pointer is the hash key so the node should be moved on pointer change
+    if (ret != ptr) {
+        RK_S32 index = node->index;
+
+        rm_node(node);
+        node = ins_node(ret);
+        node->index = index;
     }
+
+    node->ptr   = ret;
+    node->size  = size;
+    node->caller = caller;
+
+    if (debug & MEM_EXT_ROOM)
+        set_mem_ext_room(ret, size);
 }
 
 void MppMemService::add_log(MppMemOps ops, const char *caller,
@@ -590,7 +1084,7 @@ void MppMemService::dump(const char *caller)
 
     mpp_log("mpp_mem node count %d:\n", nodes_cnt);
     if (nodes_cnt) {
-        for (i = 0; i < nodes_max; i++, node++) {
+        for (i = 0; i < nodes_size; i++, node++) {
             if (node->index < 0)
                 continue;
 
@@ -634,28 +1128,85 @@ void MppMemService::dump(const char *caller)
     }
 }
 
+void MppMemService::dump_caller()
+{
+    RK_S64 elapsed = mpp_time() - time_start;
+    MppMemCaller *stat = callers;
+    RK_S32 i;
+
+    if (elapsed <= 0)
+        elapsed = 1;
+
+    mpp_log("mpp_mem caller count %d total size %u:\n", callers_cnt, total_size);
+
+    for (i = 0; i <= MEM_CALLER_MAX; i++, stat++) {
+        if (NULL == stat->caller || 0 == stat->alloc_cnt)
+            continue;
+
+        mpp_log("caller %-32s live %5d size %-8u peak %-8u alloc %-8llu rate %lld/s\n",
+                stat->caller, stat->count, (RK_U32)stat->size, (RK_U32)stat->peak,
+                stat->alloc_cnt, stat->alloc_cnt * 1000000 / elapsed);
+    }
+}
+
+MPP_RET MppMemService::get_snapshot(MppMemSnapshot *hnd)
+{
+    MppMemSnapshotImpl *impl = NULL;
+    MppMemCaller *dst;
+    RK_S32 i;
+
+    // snapshot is not recorded as node to keep the statistic unchanged
+    os_malloc((void **)&impl, MEM_ALIGN, sizeof(MppMemSnapshotImpl) +
+              (MEM_CALLER_MAX + 1) * sizeof(MppMemCaller));
+    if (NULL == impl) {
+        mpp_err_f("failed to malloc snapshot\n");
+        return MPP_ERR_MALLOC;
+    }
+
+    impl->time = mpp_time();
+    impl->nodes_cnt = nodes_cnt;
+    impl->total_size = total_size;
+    impl->callers_cnt = 0;
+    impl->callers = (MppMemCaller *)(impl + 1);
+
+    dst = impl->callers;
+    for (i = 0; i <= MEM_CALLER_MAX; i++) {
+        if (NULL == callers[i].caller)
+            continue;
+
+        *dst++ = callers[i];
+        impl->callers_cnt++;
+    }
+
+    *hnd = impl;
+    return MPP_OK;
+}
+
 void *mpp_osal_malloc(const char *caller, size_t size)
 {
-    AutoMutex auto_lock(&service.lock);
     RK_U32 debug = service.debug;
     size_t size_align = MEM_ALIGNED(size);
     size_t size_real = (debug & MEM_EXT_ROOM) ? (size_align + 2 * MEM_ALIGN) :
                        (size_align);
     void *ptr;
 
-    os_malloc(&ptr, MEM_ALIGN, size_real);
+    // NOTE: service lock is only for debug record
+    if (!debug)
+        return mem_raw_malloc(size_align);
 
-    if (debug) {
-        service.add_log(MEM_MALLOC, caller, NULL, ptr, size, size_real);
+    AutoMutex auto_lock(&service.lock);
 
-        if (ptr) {
-            if (debug & MEM_EXT_ROOM) {
-                ptr = (RK_U8 *)ptr + MEM_ALIGN;
-                set_mem_ext_room(ptr, size);
-            }
+    ptr = mem_raw_malloc(size_real);
 
-            service.add_node(caller, ptr, size);
+    service.add_log(MEM_MALLOC, caller, NULL, ptr, size, size_real);
+
+    if (ptr) {
+        if (debug & MEM_EXT_ROOM) {
+            ptr = (RK_U8 *)ptr + MEM_ALIGN;
+            set_mem_ext_room(ptr, size);
         }
+
+        service.add_node(caller, ptr, size);
     }
 
     return ptr;
@@ -671,7 +1222,6 @@ void *mpp_osal_calloc(const char *caller, size_t size)
 
 void *mpp_osal_realloc(const char *caller, void *ptr, size_t size)
 {
-    AutoMutex auto_lock(&service.lock);
     RK_U32 debug = service.debug;
     void *ret;
 
@@ -688,21 +1238,29 @@ void *mpp_osal_realloc(const char *caller, void *ptr, size_t size)
                        (size_align);
     void *ptr_real = (RK_U8 *)ptr - MEM_HEAD_ROOM(debug);
 
-    os_realloc(ptr_real, &ret, MEM_ALIGN, size_align);
+    if (!debug) {
+        ret = mem_raw_realloc(ptr_real, size_align);
+        if (NULL == ret)
+            mpp_err("mpp_realloc ptr %p to size %d failed\n", ptr, size);
+
+        return ret;
+    }
+
+    AutoMutex auto_lock(&service.lock);
+
+    ret = mem_raw_realloc(ptr_real, size_real);
 
     if (NULL == ret) {
         // if realloc fail the original buffer will be kept the same.
         mpp_err("mpp_realloc ptr %p to size %d failed\n", ptr, size);
     } else {
         // if realloc success reset the node and record
-        if (debug) {
-            void *ret_ptr = (debug & MEM_EXT_ROOM) ?
-                            ((RK_U8 *)ret + MEM_ALIGN) : (ret);
+        void *ret_ptr = (debug & MEM_EXT_ROOM) ?
+                        ((RK_U8 *)ret + MEM_ALIGN) : (ret);
 
-            service.reset_node(caller, ptr, ret_ptr, size);
-            service.add_log(MEM_REALLOC, caller, ptr, ret_ptr, size, size_real);
-            ret = ret_ptr;
-        }
+        service.reset_node(caller, ptr, ret_ptr, size);
+        service.add_log(MEM_REALLOC, caller, ptr, ret_ptr, size, size_real);
+        ret = ret_ptr;
     }
 
     return ret;
@@ -710,23 +1268,23 @@ void *mpp_osal_realloc(const char *caller, void *ptr, size_t size)
 
 void mpp_osal_free(const char *caller, void *ptr)
 {
-    AutoMutex auto_lock(&service.lock);
     RK_U32 debug = service.debug;
     if (NULL == ptr)
         return;
 
     if (!debug) {
-        os_free(ptr);
+        mem_raw_free(ptr);
         return ;
     }
 
+    AutoMutex auto_lock(&service.lock);
     size_t size = 0;
 
     if (debug & MEM_POISON) {
         // NODE: keep this node and  delete delay node
         void *ret = service.delay_del_node(caller, ptr, &size);
         if (ret)
-            os_free((RK_U8 *)ret - MEM_ALIGN);
+            mem_raw_free((RK_U8 *)ret - MEM_HEAD_ROOM(debug));
 
         service.add_log(MEM_FREE_DELAY, caller, ptr, ret, size, 0);
     } else {
@@ -734,7 +1292,7 @@ void mpp_osal_free(const char *caller, void *ptr)
         // NODE: delete node and return size here
         service.del_node(caller, ptr, &size);
         service.chk_mem(caller, ptr, size);
-        os_free(ptr_real);
+        mem_raw_free(ptr_real);
         service.add_log(MEM_FREE, caller, ptr, ptr_real, size, 0);
     }
 }
@@ -742,7 +1300,93 @@ void mpp_osal_free(const char *caller, void *ptr)
 /* dump memory status */
 void mpp_show_mem_status()
 {
+    {
+        AutoMutex auto_lock(&service.lock);
+        if (service.debug & MEM_DEBUG_EN) {
+            service.dump(__FUNCTION__);
+            service.dump_caller();
+        }
+    }
+
+    mem_cache_dump();
+}
+
+MPP_RET mpp_mem_get_snapshot(MppMemSnapshot *hnd)
+{
+    if (NULL == hnd) {
+        mpp_err_f("invalid NULL input\n");
+        return MPP_ERR_NULL_PTR;
+    }
+
+    *hnd = NULL;
+
+    if (!(service.debug & MEM_DEBUG_EN)) {
+        mpp_err_f("snapshot requires env mpp_mem_debug enabled\n");
+        return MPP_NOK;
+    }
+
     AutoMutex auto_lock(&service.lock);
-    if (service.debug & MEM_DEBUG_EN)
-        service.dump(__FUNCTION__);
+    return service.get_snapshot(hnd);
+}
+
+MPP_RET mpp_mem_put_snapshot(MppMemSnapshot *hnd)
+{
+    if (NULL == hnd) {
+        mpp_err_f("invalid NULL input\n");
+        return MPP_ERR_NULL_PTR;
+    }
+
+    if (*hnd) {
+        os_free(*hnd);
+        *hnd = NULL;
+    }
+
+    return MPP_OK;
+}
+
+MPP_RET mpp_mem_squash_snapshot(MppMemSnapshot hnd0, MppMemSnapshot hnd1)
+{
+    MppMemSnapshotImpl *p0 = (MppMemSnapshotImpl *)hnd0;
+    MppMemSnapshotImpl *p1 = (MppMemSnapshotImpl *)hnd1;
+    RK_S64 elapsed;
+    RK_S32 i;
+    RK_S32 j;
+
+    if (NULL == p0 || NULL == p1) {
+        mpp_err_f("invalid snapshot %p %p\n", p0, p1);
+        return MPP_ERR_NULL_PTR;
+    }
+
+    elapsed = p1->time - p0->time;
+    if (elapsed <= 0)
+        elapsed = 1;
+
+    mpp_log("mpp_mem snapshot diff in %lld ms: node %+d size %+d\n",
+            elapsed / 1000, p1->nodes_cnt - p0->nodes_cnt,
+            (RK_S32)(p1->total_size - p0->total_size));
+
+    // caller is never removed from table so snapshot 1 has all callers
+    for (i = 0; i < p1->callers_cnt; i++) {
+        MppMemCaller *c1 = &p1->callers[i];
+        MppMemCaller c0;
+
+        memset(&c0, 0, sizeof(c0));
+        for (j = 0; j < p0->callers_cnt; j++) {
+            if (p0->callers[j].caller == c1->caller) {
+                c0 = p0->callers[j];
+                break;
+            }
+        }
+
+        if (c1->count == c0.count && c1->size == c0.size &&
+            c1->alloc_cnt == c0.alloc_cnt)
+            continue;
+
+        mpp_log("caller %-32s live %+5d size %+9d alloc %-8llu rate %lld/s\n",
+                c1->caller, c1->count - c0.count,
+                (RK_S32)(c1->size - c0.size), c1->alloc_cnt - c0.alloc_cnt,
+                (c1->alloc_cnt - c0.alloc_cnt) * 1000000 / elapsed);
+    }
+
+    return MPP_OK;
 }
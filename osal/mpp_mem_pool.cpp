@@ -0,0 +1,247 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_mem_pool"
+
+#include <string.h>
+
+#include "mpp_err.h"
+#include "mpp_env.h"
+#include "mpp_log.h"
+#include "mpp_mem.h"
+#include "mpp_common.h"
+#include "mpp_list.h"
+#include "mpp_mem_pool.h"
+
+#include "os_mem.h"
+
+typedef struct MppMemPoolNode_t {
+    struct MppMemPoolNode_t *next;
+} MppMemPoolNode;
+
+typedef struct MppMemPoolImpl_t {
+    const char          *name;
+    size_t              size;
+    Mutex               *lock;
+    struct list_head    list;
+
+    MppMemPoolNode      *unused;
+    MppMemPoolInfo      info;
+    // no more recycle after service is destroyed on exit
+    RK_U32              finished;
+    /*
+     * no recycle with mpp_mem_debug. Then mpp_mem node record only has the
+     * objects in use and leaked objects are still found by mpp_mem.
+     */
+    RK_U32              no_recycle;
+} MppMemPoolImpl;
+
+class MppMemPoolService
+{
+public:
+    static MppMemPoolService *get_instance() {
+        static MppMemPoolService instance;
+        return &instance;
+    }
+    static Mutex *get_lock() {
+        static Mutex lock;
+        return &lock;
+    }
+
+    MppMemPoolImpl *get_pool(const char *name, size_t size);
+    void put_pool(MppMemPoolImpl *pool);
+
+private:
+    MppMemPoolService();
+    ~MppMemPoolService();
+    MppMemPoolService(const MppMemPoolService &);
+    MppMemPoolService &operator=(const MppMemPoolService &);
+
+    struct list_head    mLink;
+    RK_U32              mMemDebug;
+};
+
+MppMemPoolService::MppMemPoolService()
+    : mMemDebug(0)
+{
+    INIT_LIST_HEAD(&mLink);
+    mpp_env_get_u32("mpp_mem_debug", &mMemDebug, 0);
+}
+
+MppMemPoolService::~MppMemPoolService()
+{
+    MppMemPoolImpl *pos, *n;
+
+    /*
+     * Pools with static lifetime may still be used by other static object
+     * destructor. So only the recycled objects are released here and the
+     * pool itself is kept.
+     */
+    list_for_each_entry_safe(pos, n, &mLink, MppMemPoolImpl, list) {
+        pos->lock->lock();
+        while (pos->unused) {
+            MppMemPoolNode *node = pos->unused;
+
+            pos->unused = node->next;
+            mpp_free(node);
+        }
+        pos->info.unused = 0;
+        pos->finished = 1;
+        pos->lock->unlock();
+
+        list_del_init(&pos->list);
+    }
+}
+
+MppMemPoolImpl *MppMemPoolService::get_pool(const char *name, size_t size)
+{
+    MppMemPoolImpl *pool = NULL;
+
+    os_malloc((void **)&pool, sizeof(void *), sizeof(*pool));
+    if (NULL == pool) {
+        mpp_err_f("failed to malloc pool %s\n", name);
+        return NULL;
+    }
+
+    memset(pool, 0, sizeof(*pool));
+    pool->name = name;
+    pool->size = MPP_MAX(size, sizeof(MppMemPoolNode));
+    pool->lock = new Mutex();
+    pool->no_recycle = (mMemDebug) ? 1 : 0;
+    INIT_LIST_HEAD(&pool->list);
+
+    list_add_tail(&pool->list, &mLink);
+    return pool;
+}
+
+void MppMemPoolService::put_pool(MppMemPoolImpl *pool)
+{
+    if (pool->info.used)
+        mpp_err_f("pool %s found %d object still in use\n", pool->name, pool->info.used);
+
+    while (pool->unused) {
+        MppMemPoolNode *node = pool->unused;
+
+        pool->unused = node->next;
+        mpp_free(node);
+    }
+
+    list_del_init(&pool->list);
+    delete pool->lock;
+    os_free(pool);
+}
+
+MppMemPool mpp_mem_pool_init_f(const char *name, size_t size)
+{
+    MppMemPoolService *srv = MppMemPoolService::get_instance();
+    AutoMutex auto_lock(srv->get_lock());
+
+    return (MppMemPool)srv->get_pool(name, size);
+}
+
+void mpp_mem_pool_deinit(MppMemPool pool)
+{
+    if (NULL == pool) {
+        mpp_err_f("found NULL input\n");
+        return;
+    }
+
+    MppMemPoolService *srv = MppMemPoolService::get_instance();
+    AutoMutex auto_lock(srv->get_lock());
+
+    srv->put_pool((MppMemPoolImpl *)pool);
+}
+
+void *mpp_mem_pool_get_f(const char *caller, MppMemPool pool)
+{
+    MppMemPoolImpl *impl = (MppMemPoolImpl *)pool;
+    MppMemPoolNode *node = NULL;
+
+    if (NULL == impl) {
+        mpp_err_f("found NULL pool from %s\n", caller);
+        return NULL;
+    }
+
+    impl->lock->lock();
+    node = impl->unused;
+    if (node) {
+        impl->unused = node->next;
+        impl->info.unused--;
+        impl->info.hits++;
+    } else {
+        impl->info.misses++;
+    }
+    impl->info.used++;
+    if (impl->info.used > impl->info.high_water)
+        impl->info.high_water = impl->info.used;
+    impl->lock->unlock();
+
+    if (NULL == node) {
+        node = (MppMemPoolNode *)mpp_osal_malloc(caller, impl->size);
+        if (NULL == node) {
+            mpp_err_f("pool %s failed to malloc size %d from %s\n",
+                      impl->name, (RK_S32)impl->size, caller);
+            impl->lock->lock();
+            impl->info.used--;
+            impl->lock->unlock();
+            return NULL;
+        }
+    }
+
+    memset(node, 0, impl->size);
+    return node;
+}
+
+void mpp_mem_pool_put_f(const char *caller, MppMemPool pool, void *p)
+{
+    MppMemPoolImpl *impl = (MppMemPoolImpl *)pool;
+    MppMemPoolNode *node = (MppMemPoolNode *)p;
+
+    if (NULL == impl || NULL == node) {
+        mpp_err_f("found NULL input pool %p p %p from %s\n", pool, p, caller);
+        return;
+    }
+
+    impl->lock->lock();
+    impl->info.used--;
+    mpp_assert(impl->info.used >= 0);
+    if (!impl->finished && !impl->no_recycle) {
+        node->next = impl->unused;
+        impl->unused = node;
+        impl->info.unused++;
+        node = NULL;
+    }
+    impl->lock->unlock();
+
+    if (node)
+        mpp_osal_free(caller, node);
+}
+
+MPP_RET mpp_mem_pool_info(MppMemPool pool, MppMemPoolInfo *info)
+{
+    MppMemPoolImpl *impl = (MppMemPoolImpl *)pool;
+
+    if (NULL == impl || NULL == info) {
+        mpp_err_f("found NULL input pool %p info %p\n", pool, info);
+        return MPP_ERR_NULL_PTR;
+    }
+
+    impl->lock->lock();
+    *info = impl->info;
+    impl->lock->unlock();
+
+    return MPP_OK;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_ring"
+
+#include <string.h>
+#include <errno.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "mpp_err.h"
+#include "mpp_log.h"
+#include "mpp_mem.h"
+#include "mpp_time.h"
+#include "mpp_ring.h"
+#include "mpp_atomic.h"
+
+#if defined(__linux__)
+static void ring_futex_wait(volatile RK_U32 *addr, RK_U32 val, RK_S64 timeout_us)
+{
+    struct timespec ts;
+    struct timespec *pts = NULL;
+
+    if (timeout_us >= 0) {
+        ts.tv_sec  = timeout_us / 1000000;
+        ts.tv_nsec = (timeout_us % 1000000) * 1000;
+        pts = &ts;
+    }
+
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, pts, NULL, 0);
+}
+
+static void ring_futex_wake(volatile RK_U32 *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+#else
+static void ring_futex_wait(volatile RK_U32 *addr, RK_U32 val, RK_S64 timeout_us)
+{
+    (void)addr;
+    (void)val;
+    (void)timeout_us;
+    /* NOTE: no futex on this platform fallback to sleep polling */
+    msleep(1);
+}
+
+static void ring_futex_wake(volatile RK_U32 *addr)
+{
+    (void)addr;
+}
+#endif
+
+/*
+ * Sleep on index word until it is changed from val or timeout
+ * The waiter flag is set before index recheck so that the peer side will
+ * always see the flag after its index update and wake up the waiter.
+ */
+static RK_S32 ring_wait_index(volatile RK_U32 *idx, volatile RK_U32 *waiter,
+                              RK_U32 val, RK_S64 deadline)
+{
+    RK_S64 left = -1;
+
+    if (deadline >= 0) {
+        left = deadline - mpp_time();
+        if (left <= 0)
+            return ETIMEDOUT;
+    }
+
+    *waiter = 1;
+    MPP_SYNC();
+
+    if (MPP_LOAD_ACQUIRE(idx) == val)
+        ring_futex_wait(idx, val, left);
+
+    *waiter = 0;
+    return 0;
+}
+
+static void ring_wake_index(volatile RK_U32 *idx, volatile RK_U32 *waiter)
+{
+    MPP_SYNC();
+
+    if (*waiter)
+        ring_futex_wake(idx);
+}
+
+MppRing::MppRing(RK_S32 count, RK_S32 size, node_destructor func, RK_U32 mode)
+    : mCount(1),
+      mMask(0),
+      mSize(size),
+      mMode(mode),
+      mData(NULL),
+      destroy(func),
+      mWrIdx(0),
+      mWrWait(0),
+      mRdIdx(0),
+      mRdWait(0)
+{
+    /* round up to power of 2 for index mask */
+    while ((RK_S32)mCount < count)
+        mCount <<= 1;
+
+    mMask = mCount - 1;
+    mData = mpp_calloc(RK_U8, mCount * mSize);
+    if (NULL == mData)
+        mpp_err_f("failed to malloc ring count %d size %d\n", mCount, mSize);
+}
+
+MppRing::~MppRing()
+{
+    flush();
+
+    MPP_FREE(mData);
+}
+
+RK_S32 MppRing::push(void *data)
+{
+    RK_U32 wr = mWrIdx;
+    RK_U32 rd = MPP_LOAD_ACQUIRE(&mRdIdx);
+
+    if (NULL == mData || wr - rd >= mCount)
+        return MPP_NOK;
+
+    memcpy(mData + (wr & mMask) * mSize, data, mSize);
+    MPP_STORE_RELEASE(&mWrIdx, wr + 1);
+
+    if (mMode & MPP_RING_WAKE_FUTEX)
+        ring_wake_index(&mWrIdx, &mWrWait);
+
+    return MPP_OK;
+}
+
+RK_S32 MppRing::pop(void *data)
+{
+    RK_U32 rd = mRdIdx;
+    RK_U32 wr = MPP_LOAD_ACQUIRE(&mWrIdx);
+
+    if (NULL == mData || wr == rd)
+        return MPP_NOK;
+
+    if (data)
+        memcpy(data, mData + (rd & mMask) * mSize, mSize);
+
+    MPP_STORE_RELEASE(&mRdIdx, rd + 1);
+
+    if (mMode & MPP_RING_WAKE_FUTEX)
+        ring_wake_index(&mRdIdx, &mRdWait);
+
+    return MPP_OK;
+}
+
+RK_S32 MppRing::peek(void *data)
+{
+    RK_U32 rd = mRdIdx;
+    RK_U32 wr = MPP_LOAD_ACQUIRE(&mWrIdx);
+
+    if (NULL == mData || NULL == data || wr == rd)
+        return MPP_NOK;
+
+    memcpy(data, mData + (rd & mMask) * mSize, mSize);
+    return MPP_OK;
+}
+
+RK_S32 MppRing::flush()
+{
+    if (NULL == mData)
+        return MPP_OK;
+
+    if (destroy) {
+        void *node = mpp_malloc_size(void, mSize);
+
+        while (node && MPP_OK == pop(node))
+            destroy(node);
+
+        MPP_FREE(node);
+    }
+
+    while (MPP_OK == pop(NULL))
+        ;
+
+    return MPP_OK;
+}
+
+RK_S32 MppRing::ring_size()
+{
+    RK_U32 wr = MPP_LOAD_ACQUIRE(&mWrIdx);
+    RK_U32 rd = MPP_LOAD_ACQUIRE(&mRdIdx);
+
+    return (RK_S32)(wr - rd);
+}
+
+RK_S32 MppRing::ring_count()
+{
+    return (RK_S32)mCount;
+}
+
+RK_S32 MppRing::wait_data(RK_S64 timeout)
+{
+    RK_S64 deadline = (timeout > 0) ? (mpp_time() + timeout * 1000) : (-1);
+
+    while (1) {
+        RK_U32 wr = MPP_LOAD_ACQUIRE(&mWrIdx);
+
+        if (wr != MPP_LOAD_ACQUIRE(&mRdIdx))
+            return 0;
+
+        if (!timeout || !(mMode & MPP_RING_WAKE_FUTEX))
+            return ETIMEDOUT;
+
+        if (ring_wait_index(&mWrIdx, &mWrWait, wr, deadline))
+            return ETIMEDOUT;
+    }
+
+    return 0;
+}
+
+RK_S32 MppRing::wait_space(RK_S64 timeout)
+{
+    RK_S64 deadline = (timeout > 0) ? (mpp_time() + timeout * 1000) : (-1);
+
+    while (1) {
+        RK_U32 rd = MPP_LOAD_ACQUIRE(&mRdIdx);
+
+        if (MPP_LOAD_ACQUIRE(&mWrIdx) - rd < mCount)
+            return 0;
+
+        if (!timeout || !(mMode & MPP_RING_WAKE_FUTEX))
+            return ETIMEDOUT;
+
+        if (ring_wait_index(&mRdIdx, &mRdWait, rd, deadline))
+            return ETIMEDOUT;
+    }
+
+    return 0;
+}
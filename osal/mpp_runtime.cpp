@@ -18,6 +18,7 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/syscall.h>
 
 #include "mpp_log.h"
 #include "mpp_common.h"
@@ -48,6 +49,20 @@ static const char *mpp_vpu_address[] = {
     "@ff650000",        /* rk3399       */
 };
 
+static RK_U32 mpp_memfd_detect(void)
+{
+#if defined(__NR_memfd_create)
+    /* MFD_CLOEXEC */
+    int fd = syscall(__NR_memfd_create, "mpp_rt", 1);
+
+    if (fd >= 0) {
+        close(fd);
+        return 1;
+    }
+#endif
+    return 0;
+}
+
 class MppRuntimeService
 {
 private:
@@ -77,6 +92,7 @@ RK_U32 MppRuntimeService::get_allocator_valid(MppBufferType type)
 MppRuntimeService::MppRuntimeService()
 {
     allocator_valid[MPP_BUFFER_TYPE_NORMAL] = 1;
+    allocator_valid[MPP_BUFFER_TYPE_MEMFD] = mpp_memfd_detect();
 
     if (access("/dev/ion", F_OK | R_OK | W_OK)) {
         allocator_valid[MPP_BUFFER_TYPE_ION] = 0;
@@ -18,29 +18,523 @@
 
 #include <string.h>
 
+#include "mpp_err.h"
 #include "mpp_log.h"
+#include "mpp_env.h"
 #include "mpp_common.h"
+#include "mpp_atomic.h"
 #include "mpp_thread.h"
 
 #define MPP_THREAD_DBG_FUNCTION     (0x00000001)
+#define MPP_THREAD_DBG_POOL         (0x00000002)
 
 static RK_U32 thread_debug = 0;
 
 #define thread_dbg(flag, fmt, ...)  _mpp_dbg(thread_debug, flag, fmt, ## __VA_ARGS__)
 
+/*
+ * worker pool job state
+ *
+ * IDLE     - job is waiting for signal
+ * QUEUED   - job is in one worker deque
+ * RUNNING  - job is running on one worker
+ * PENDING  - job is signaled during running and will be queued again
+ * EXIT     - job returns MPP_JOB_EXIT
+ */
+#define JOB_IDLE                    0
+#define JOB_QUEUED                  1
+#define JOB_RUNNING                 2
+#define JOB_PENDING                 3
+#define JOB_EXIT                    4
+
+#define MAX_WORKER_COUNT            32
+
+/* job list with lock, both owner and thief access it with lock held */
+typedef struct MppJobDeque_t {
+    Mutex           lock;
+    /* head is the oldest job for stealing, tail is the newest job for owner */
+    MppThread       *head;
+    MppThread       *tail;
+} MppJobDeque;
+
+typedef struct MppWorker_t {
+    MppWorkerPool   *pool;
+    RK_S32          idx;
+    pthread_t       thd;
+} MppWorker;
+
+/*
+ * Process-wide fixed-size worker pool for MppThread job mode
+ *
+ * Each worker owns a job deque. Worker pops its own newest job first and
+ * steals the oldest job from other workers when its deque is empty. The job
+ * signaled on a worker is queued to the local deque for cache locality and
+ * the job signaled from user thread is queued in round-robin.
+ *
+ * Job returns MPP_JOB_WAIT instead of waiting on the other job. The blocking
+ * which can not be avoided like hardware wait is marked by block_begin and
+ * block_end. Then another worker is woken up or started to keep mCount
+ * workers running. The extra worker goes idle when the blocking is done.
+ */
+class MppWorkerPool
+{
+public:
+    static MppWorkerPool *get_instance() {
+        static MppWorkerPool instance;
+        return &instance;
+    }
+
+    void    notify(MppThread *job);
+    // return worker index of current thread or -1 for non-worker thread
+    RK_S32  get_worker_idx();
+    // current worker is going to block or has returned from blocking
+    void    block_begin();
+    void    block_end();
+
+private:
+    MppWorkerPool();
+    ~MppWorkerPool();
+
+    Mutex           mLock;
+    Condition       mCond;
+    // running worker count target
+    RK_S32          mCount;
+    volatile RK_S32 mStarted;
+    RK_S32          mQuit;
+    volatile RK_S32 mQueued;
+    volatile RK_S32 mIdle;
+    // worker count neither idle nor blocked
+    volatile RK_S32 mRunning;
+    volatile RK_U32 mNext;
+    pthread_key_t   mKey;
+
+    MppWorker       mWorkers[MAX_WORKER_COUNT];
+    MppJobDeque     mDeques[MAX_WORKER_COUNT];
+
+    void        start_workers();
+    MPP_RET     start_worker(RK_S32 idx);
+    void        compensate();
+    void        push(RK_S32 idx, MppThread *job, RK_S32 to_head);
+    MppThread   *pop(RK_S32 idx);
+    MppThread   *steal(RK_S32 idx);
+    void        run_job(RK_S32 idx, MppThread *job);
+    RK_S32      run_once(RK_S32 idx);
+
+    static void *worker_thread(void *ctx);
+
+    MppWorkerPool(const MppWorkerPool &);
+    MppWorkerPool &operator=(const MppWorkerPool &);
+};
+
+MppWorkerPool::MppWorkerPool()
+    : mCount(0),
+      mStarted(0),
+      mQuit(0),
+      mQueued(0),
+      mIdle(0),
+      mRunning(0),
+      mNext(0)
+{
+    RK_U32 count = 0;
+
+    mpp_env_get_u32("mpp_thread_debug", &thread_debug, 0);
+    mpp_env_get_u32("mpp_worker_count", &count, 0);
+
+#if defined(_WIN32)
+    if (!count)
+        count = 4;
+#else
+    if (!count)
+        count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    mCount = MPP_CLIP3(2, MAX_WORKER_COUNT, (RK_S32)count);
+    pthread_key_create(&mKey, NULL);
+
+    for (RK_S32 i = 0; i < MAX_WORKER_COUNT; i++) {
+        mDeques[i].head = NULL;
+        mDeques[i].tail = NULL;
+    }
+}
+
+MppWorkerPool::~MppWorkerPool()
+{
+    mLock.lock();
+    mQuit = 1;
+    mCond.broadcast();
+    mLock.unlock();
+
+    for (RK_S32 i = 0; i < mStarted; i++) {
+        void *dummy;
+        pthread_join(mWorkers[i].thd, &dummy);
+    }
+
+    pthread_key_delete(mKey);
+}
+
+/* NOTE: called with mLock held */
+MPP_RET MppWorkerPool::start_worker(RK_S32 idx)
+{
+    MppWorker *worker = &mWorkers[idx];
+    char name[THREAD_NAME_LEN];
+
+    worker->pool = this;
+    worker->idx = idx;
+
+    /* new worker is running until it goes idle */
+    MPP_ADD_FETCH(&mRunning, 1);
+    if (pthread_create(&worker->thd, NULL, worker_thread, worker)) {
+        MPP_SUB_FETCH(&mRunning, 1);
+        mpp_err_f("failed to create worker %d\n", idx);
+        return MPP_NOK;
+    }
+
+    snprintf(name, sizeof(name), "mpp_worker%d", (RK_U8)idx);
+#ifndef ARMLINUX
+    pthread_setname_np(worker->thd, name);
+#endif
+    MPP_STORE_RELEASE(&mStarted, idx + 1);
+
+    return MPP_OK;
+}
+
+void MppWorkerPool::start_workers()
+{
+    AutoMutex autolock(mLock);
+
+    if (mStarted)
+        return;
+
+    for (RK_S32 i = 0; i < mCount; i++) {
+        if (start_worker(i))
+            break;
+    }
+
+    /* NOTE: at least one worker is required for job running */
+    mpp_assert(mStarted);
+    mCount = mStarted;
+
+    thread_dbg(MPP_THREAD_DBG_POOL, "worker pool start %d workers\n", mCount);
+}
+
+/*
+ * Wake up an idle worker or start a new one when there is queued job and
+ * less than mCount workers are running.
+ */
+void MppWorkerPool::compensate()
+{
+    AutoMutex autolock(mLock);
+
+    if (mQuit || !MPP_ADD_FETCH(&mQueued, 0) ||
+        MPP_ADD_FETCH(&mRunning, 0) >= mCount)
+        return;
+
+    if (mIdle) {
+        mCond.signal();
+    } else if (mStarted < MAX_WORKER_COUNT) {
+        if (!start_worker(mStarted))
+            thread_dbg(MPP_THREAD_DBG_POOL, "worker pool start worker %d on blocking\n",
+                       mStarted - 1);
+    }
+}
+
+void MppWorkerPool::block_begin()
+{
+    MPP_SUB_FETCH(&mRunning, 1);
+    compensate();
+}
+
+void MppWorkerPool::block_end()
+{
+    MPP_ADD_FETCH(&mRunning, 1);
+}
+
+void MppWorkerPool::push(RK_S32 idx, MppThread *job, RK_S32 to_head)
+{
+    MppJobDeque *deque = &mDeques[idx];
+
+    deque->lock.lock();
+    if (to_head) {
+        job->mJobPrev = NULL;
+        job->mJobNext = deque->head;
+        if (deque->head)
+            deque->head->mJobPrev = job;
+        else
+            deque->tail = job;
+        deque->head = job;
+    } else {
+        job->mJobPrev = deque->tail;
+        job->mJobNext = NULL;
+        if (deque->tail)
+            deque->tail->mJobNext = job;
+        else
+            deque->head = job;
+        deque->tail = job;
+    }
+    deque->lock.unlock();
+
+    /*
+     * NOTE: queued count and running count are updated with full barrier on
+     * both side so that either worker sees the job or we see it is not running
+     */
+    MPP_ADD_FETCH(&mQueued, 1);
+    if (MPP_ADD_FETCH(&mRunning, 0) < mCount)
+        compensate();
+}
+
+MppThread *MppWorkerPool::pop(RK_S32 idx)
+{
+    MppJobDeque *deque = &mDeques[idx];
+    MppThread *job = NULL;
+
+    deque->lock.lock();
+    job = deque->tail;
+    if (job) {
+        deque->tail = job->mJobPrev;
+        if (deque->tail)
+            deque->tail->mJobNext = NULL;
+        else
+            deque->head = NULL;
+        job->mJobPrev = NULL;
+    }
+    deque->lock.unlock();
+
+    if (job)
+        MPP_SUB_FETCH(&mQueued, 1);
+
+    return job;
+}
+
+MppThread *MppWorkerPool::steal(RK_S32 idx)
+{
+    RK_S32 count = MPP_LOAD_ACQUIRE(&mStarted);
+    RK_S32 i;
+
+    for (i = 1; i < count; i++) {
+        MppJobDeque *deque = &mDeques[(idx + i) % count];
+        MppThread *job = NULL;
+
+        deque->lock.lock();
+        job = deque->head;
+        if (job) {
+            deque->head = job->mJobNext;
+            if (deque->head)
+                deque->head->mJobPrev = NULL;
+            else
+                deque->tail = NULL;
+            job->mJobNext = NULL;
+        }
+        deque->lock.unlock();
+
+        if (job) {
+            MPP_SUB_FETCH(&mQueued, 1);
+            thread_dbg(MPP_THREAD_DBG_POOL, "worker %d steal %s from worker %d\n",
+                       idx, job->mName, (idx + i) % count);
+            return job;
+        }
+    }
+
+    return NULL;
+}
+
+void MppWorkerPool::run_job(RK_S32 idx, MppThread *job)
+{
+    MppJobRet ret;
+
+    MPP_STORE_RELEASE(&job->mJobState, JOB_RUNNING);
+
+    ret = job->mJob(job->mContext);
+
+    switch (ret) {
+    case MPP_JOB_CONTINUE : {
+        /* yield to the other jobs in local deque */
+        MPP_STORE_RELEASE(&job->mJobState, JOB_QUEUED);
+        push(idx, job, 1);
+    } break;
+    case MPP_JOB_WAIT : {
+        /* when signaled during running queue it again */
+        if (!MPP_BOOL_CAS(&job->mJobState, JOB_RUNNING, JOB_IDLE)) {
+            MPP_STORE_RELEASE(&job->mJobState, JOB_QUEUED);
+            push(idx, job, 0);
+        }
+    } break;
+    default : {
+        MPP_STORE_RELEASE(&job->mJobState, JOB_EXIT);
+        sem_post(&job->mJobExit);
+    } break;
+    }
+}
+
+RK_S32 MppWorkerPool::run_once(RK_S32 idx)
+{
+    MppThread *job = pop(idx);
+
+    if (NULL == job)
+        job = steal(idx);
+
+    if (NULL == job)
+        return 0;
+
+    run_job(idx, job);
+    return 1;
+}
+
+RK_S32 MppWorkerPool::get_worker_idx()
+{
+    intptr_t val = (intptr_t)pthread_getspecific(mKey);
+
+    return (RK_S32)val - 1;
+}
+
+void MppWorkerPool::notify(MppThread *job)
+{
+    if (!mStarted)
+        start_workers();
+
+    while (1) {
+        RK_U32 state = MPP_LOAD_ACQUIRE(&job->mJobState);
+
+        if (state == JOB_IDLE) {
+            if (MPP_BOOL_CAS(&job->mJobState, JOB_IDLE, JOB_QUEUED)) {
+                RK_S32 idx = get_worker_idx();
+
+                if (idx < 0)
+                    idx = MPP_FETCH_ADD(&mNext, 1) % mCount;
+
+                push(idx, job, 0);
+                return;
+            }
+        } else if (state == JOB_RUNNING) {
+            if (MPP_BOOL_CAS(&job->mJobState, JOB_RUNNING, JOB_PENDING))
+                return;
+        } else {
+            /* queued / pending / exit */
+            return;
+        }
+    }
+}
+
+void *MppWorkerPool::worker_thread(void *ctx)
+{
+    MppWorker *worker = (MppWorker *)ctx;
+    MppWorkerPool *pool = worker->pool;
+    RK_S32 idx = worker->idx;
+
+    pthread_setspecific(pool->mKey, (void *)(intptr_t)(idx + 1));
+
+    while (1) {
+        RK_S32 quit = 0;
+
+        /* extra worker started on blocking goes idle when blocking is done */
+        if (MPP_ADD_FETCH(&pool->mRunning, 0) <= pool->mCount &&
+            pool->run_once(idx))
+            continue;
+
+        pool->mLock.lock();
+        MPP_SUB_FETCH(&pool->mRunning, 1);
+        MPP_ADD_FETCH(&pool->mIdle, 1);
+        while (!pool->mQuit && (!MPP_ADD_FETCH(&pool->mQueued, 0) ||
+                                MPP_ADD_FETCH(&pool->mRunning, 0) >= pool->mCount))
+            pool->mCond.wait(pool->mLock);
+        MPP_SUB_FETCH(&pool->mIdle, 1);
+        MPP_ADD_FETCH(&pool->mRunning, 1);
+        quit = pool->mQuit;
+        pool->mLock.unlock();
+
+        if (quit && !MPP_ADD_FETCH(&pool->mQueued, 0))
+            break;
+    }
+
+    return NULL;
+}
+
 MppThread::MppThread(MppThreadFunc func, void *ctx, const char *name)
     : mFunction(func),
-      mContext(ctx)
+      mContext(ctx),
+      mJob(NULL),
+      mUsePool(0),
+      mJobSignal(0),
+      mJobState(JOB_IDLE),
+      mJobPrev(NULL),
+      mJobNext(NULL)
+{
+    mStatus[THREAD_WORK]    = MPP_THREAD_UNINITED;
+    mStatus[THREAD_INPUT]   = MPP_THREAD_RUNNING;
+    mStatus[THREAD_OUTPUT]  = MPP_THREAD_RUNNING;
+    mStatus[THREAD_CONTROL] = MPP_THREAD_RUNNING;
+
+    snprintf(mName, sizeof(mName), "%s", (name) ? (name) : "mpp_thread");
+}
+
+MppThread::MppThread(MppJobFunc job, void *ctx, const char *name, RK_U32 use_pool)
+    : mFunction(job_loop),
+      mContext(ctx),
+      mJob(job),
+      mUsePool(use_pool),
+      mJobSignal(0),
+      mJobState(JOB_IDLE),
+      mJobPrev(NULL),
+      mJobNext(NULL)
 {
     mStatus[THREAD_WORK]    = MPP_THREAD_UNINITED;
     mStatus[THREAD_INPUT]   = MPP_THREAD_RUNNING;
     mStatus[THREAD_OUTPUT]  = MPP_THREAD_RUNNING;
     mStatus[THREAD_CONTROL] = MPP_THREAD_RUNNING;
 
-    if (name)
-        strncpy(mName, name, sizeof(mName));
+    snprintf(mName, sizeof(mName), "%s", (name) ? (name) : "mpp_job");
+}
+
+/*
+ * working loop for the job driven by its own thread
+ * The signal flag is checked with lock held to avoid missing signal between
+ * the job returning MPP_JOB_WAIT and the thread entering waiting.
+ */
+void *MppThread::job_loop(void *ctx)
+{
+    MppThread *thd = (MppThread *)ctx;
+
+    while (1) {
+        MppJobRet ret = thd->mJob(thd->mContext);
+
+        if (ret == MPP_JOB_EXIT)
+            break;
+
+        if (ret == MPP_JOB_WAIT) {
+            thd->lock();
+            if (!thd->mJobSignal)
+                thd->wait();
+            thd->mJobSignal = 0;
+            thd->unlock();
+        }
+    }
+
+    return NULL;
+}
+
+void MppThread::signal_job()
+{
+    mJobSignal = 1;
+
+    if (mUsePool)
+        MppWorkerPool::get_instance()->notify(this);
     else
-        snprintf(mName, sizeof(mName), "mpp_thread");
+        mMutexCond[THREAD_WORK].signal();
+}
+
+void MppThread::block_begin()
+{
+    MppWorkerPool *pool = MppWorkerPool::get_instance();
+
+    if (pool->get_worker_idx() >= 0)
+        pool->block_begin();
+}
+
+void MppThread::block_end()
+{
+    MppWorkerPool *pool = MppWorkerPool::get_instance();
+
+    if (pool->get_worker_idx() >= 0)
+        pool->block_end();
 }
 
 MppThreadStatus MppThread::get_status(MppThreadSignal id)
@@ -66,10 +560,23 @@ void MppThread::start()
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 
-    if (MPP_THREAD_UNINITED == get_status()) {
+    if (MPP_THREAD_UNINITED == get_status() && mJob && mUsePool) {
+        set_status(MPP_THREAD_RUNNING);
+        sem_init(&mJobExit, 0, 0);
+        mJobState = JOB_IDLE;
+
+        /* run the job once for its initial status check */
+        lock();
+        signal();
+        unlock();
+
+        thread_dbg(MPP_THREAD_DBG_FUNCTION, "job %s %p context %p start on worker pool\n",
+                   mName, mJob, mContext);
+    } else if (MPP_THREAD_UNINITED == get_status()) {
         // NOTE: set status here first to avoid unexpected loop quit racing condition
         set_status(MPP_THREAD_RUNNING);
-        if (0 == pthread_create(&mThread, &attr, mFunction, mContext)) {
+        if (0 == pthread_create(&mThread, &attr, mFunction,
+                                (mJob) ? ((void *)this) : (mContext))) {
 #ifndef ARMLINUX
             RK_S32 ret = pthread_setname_np(mThread, mName);
             if (ret)
@@ -93,8 +600,14 @@ void MppThread::stop()
                    "MPP_THREAD_STOPPING status set mThread %p", this);
         signal();
         unlock();
-        void *dummy;
-        pthread_join(mThread, &dummy);
+
+        if (mJob && mUsePool) {
+            sem_wait(&mJobExit);
+            sem_destroy(&mJobExit);
+        } else {
+            void *dummy;
+            pthread_join(mThread, &dummy);
+        }
         thread_dbg(MPP_THREAD_DBG_FUNCTION,
                    "thread %s %p context %p destroy success\n",
                    mName, mFunction, mContext);
@@ -19,12 +19,13 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/timerfd.h>
-#include <sys/epoll.h>
 
 #include "mpp_log.h"
+#include "mpp_list.h"
 #include "mpp_mem.h"
 #include "mpp_time.h"
 #include "mpp_common.h"
+#include "mpp_atomic.h"
 #include "mpp_thread.h"
 
 #if _WIN32
@@ -57,6 +58,17 @@ void mpp_time_diff(RK_S64 start, RK_S64 end, RK_S64 limit, const char *fmt)
         mpp_dbg(MPP_DBG_TIMING, "%s timing %lld us\n", fmt, diff);
 }
 
+/*
+ * MppClock optional latency histogram
+ *
+ * Log bucketed with 16 linear sub-buckets per power of two so the relative
+ * error is below 1 / 16. Value below 16us has its own bucket and value is
+ * clamped to 32bit microsecond (about 71 minutes).
+ */
+#define CLOCK_HIST_SUB_BITS     4
+#define CLOCK_HIST_SUB          (1 << CLOCK_HIST_SUB_BITS)
+#define CLOCK_HIST_SIZE         ((32 - CLOCK_HIST_SUB_BITS + 1) * CLOCK_HIST_SUB)
+
 typedef struct MppClockImpl_t {
     const char *check;
     char    name[16];
@@ -65,10 +77,60 @@ typedef struct MppClockImpl_t {
     RK_S64  time;
     RK_S64  sum;
     RK_S64  count;
+
+    /* histogram is kept until put once enabled for lock-free recording */
+    RK_U32  hist_en;
+    RK_U32  *hist;
+    /* min is -1 before the first record */
+    volatile RK_S64 min;
+    volatile RK_S64 max;
 } MppClockImpl;
 
 static const char *clock_name = "mpp_clock";
 
+static RK_S32 clock_hist_idx(RK_S64 val)
+{
+    RK_U32 v = (val < 0) ? 0 : (val > 0xffffffffLL) ? 0xffffffff : (RK_U32)val;
+    RK_S32 shift;
+
+    if (v < CLOCK_HIST_SUB)
+        return v;
+
+    shift = 31 - __builtin_clz(v) - CLOCK_HIST_SUB_BITS;
+    return ((shift + 1) << CLOCK_HIST_SUB_BITS) + ((v >> shift) & (CLOCK_HIST_SUB - 1));
+}
+
+/* highest value belongs to the bucket */
+static RK_S64 clock_hist_val(RK_S32 idx)
+{
+    RK_S32 shift;
+
+    if (idx < CLOCK_HIST_SUB)
+        return idx;
+
+    shift = (idx >> CLOCK_HIST_SUB_BITS) - 1;
+    return ((RK_S64)((idx & (CLOCK_HIST_SUB - 1)) + CLOCK_HIST_SUB + 1) << shift) - 1;
+}
+
+static void clock_hist_record(MppClockImpl *p, RK_S64 val)
+{
+    RK_U32 *hist = MPP_LOAD_ACQUIRE(&p->hist);
+    RK_S64 old;
+
+    if (NULL == hist)
+        return;
+
+    MPP_FETCH_ADD(&hist[clock_hist_idx(val)], 1);
+
+    do {
+        old = p->min;
+    } while ((old < 0 || val < old) && !MPP_BOOL_CAS(&p->min, old, val));
+
+    do {
+        old = p->max;
+    } while (val > old && !MPP_BOOL_CAS(&p->max, old, val));
+}
+
 MPP_RET check_is_mpp_clock(void *clock)
 {
     if (clock && ((MppClockImpl*)clock)->check == clock_name)
@@ -98,6 +160,9 @@ void mpp_clock_put(MppClock clock)
         return ;
     }
 
+    MppClockImpl *p = (MppClockImpl *)clock;
+
+    MPP_FREE(p->hist);
     mpp_free(clock);
 }
 
@@ -107,10 +172,36 @@ void mpp_clock_enable(MppClock clock, RK_U32 enable)
         mpp_err_f("invalid clock %p\n", clock);
     } else {
         MppClockImpl *p = (MppClockImpl *)clock;
+        /* drop the start time recorded before last disable */
+        if (!p->enable && enable)
+            p->base = 0;
         p->enable = (enable) ? (1) : (0);
     }
 }
 
+void mpp_clock_enable_histogram(MppClock clock, RK_U32 enable)
+{
+    if (NULL == clock || check_is_mpp_clock(clock)) {
+        mpp_err_f("invalid clock %p\n", clock);
+        return ;
+    }
+
+    MppClockImpl *p = (MppClockImpl *)clock;
+
+    if (enable && NULL == p->hist) {
+        RK_U32 *hist = mpp_calloc(RK_U32, CLOCK_HIST_SIZE);
+
+        if (NULL == hist) {
+            mpp_err_f("malloc histogram failed\n");
+            return ;
+        }
+        p->min = -1;
+        MPP_STORE_RELEASE(&p->hist, hist);
+    }
+
+    p->hist_en = (enable) ? (1) : (0);
+}
+
 RK_S64 mpp_clock_start(MppClock clock)
 {
     if (NULL == clock || check_is_mpp_clock(clock)) {
@@ -137,7 +228,7 @@ RK_S64 mpp_clock_pause(MppClock clock)
 
     MppClockImpl *p = (MppClockImpl *)clock;
 
-    if (!p->enable)
+    if (!p->enable || !p->base)
         return 0;
 
     RK_S64 time = mpp_time();
@@ -146,6 +237,9 @@ RK_S64 mpp_clock_pause(MppClock clock)
         // first pause after start
         p->sum += time - p->base;
         p->count++;
+
+        if (p->hist_en)
+            clock_hist_record(p, time - p->base);
     }
     p->time = time;
     return p->time - p->base;
@@ -162,11 +256,74 @@ RK_S64 mpp_clock_reset(MppClock clock)
         p->time = 0;
         p->sum = 0;
         p->count = 0;
+        p->min = -1;
+        p->max = 0;
+        if (p->hist)
+            memset(p->hist, 0, sizeof(RK_U32) * CLOCK_HIST_SIZE);
     }
 
     return 0;
 }
 
+MPP_RET mpp_clock_get_stat(MppClock clock, MppClockStat *stat)
+{
+    static const RK_S32 permille[4] = { 500, 900, 990, 999, };
+    RK_S64 *vals[4];
+    RK_U64 total = 0;
+    RK_U64 acc = 0;
+    RK_S32 pos = 0;
+    RK_S32 i;
+
+    if (NULL == clock || check_is_mpp_clock(clock) || NULL == stat) {
+        mpp_err_f("invalid clock %p stat %p\n", clock, stat);
+        return MPP_ERR_NULL_PTR;
+    }
+
+    MppClockImpl *p = (MppClockImpl *)clock;
+    RK_U32 *hist = MPP_LOAD_ACQUIRE(&p->hist);
+
+    memset(stat, 0, sizeof(*stat));
+    stat->count = p->count;
+    stat->sum = p->sum;
+
+    if (NULL == hist)
+        return MPP_OK;
+
+    for (i = 0; i < CLOCK_HIST_SIZE; i++)
+        total += hist[i];
+
+    if (!total)
+        return MPP_OK;
+
+    stat->min = p->min;
+    stat->max = p->max;
+    if (stat->min < 0)
+        stat->min = 0;
+
+    vals[0] = &stat->p50;
+    vals[1] = &stat->p90;
+    vals[2] = &stat->p99;
+    vals[3] = &stat->p999;
+
+    for (i = 0; i < CLOCK_HIST_SIZE && pos < 4; i++) {
+        acc += hist[i];
+
+        /* report the bucket upper bound within the recorded range */
+        while (pos < 4 && acc * 1000 >= total * permille[pos]) {
+            RK_S64 val = clock_hist_val(i);
+
+            if (val > stat->max)
+                val = stat->max;
+            if (val < stat->min)
+                val = stat->min;
+
+            *vals[pos++] = val;
+        }
+    }
+
+    return MPP_OK;
+}
+
 RK_S64 mpp_clock_get_sum(MppClock clock)
 {
     if (NULL == clock || check_is_mpp_clock(clock)) {
@@ -200,6 +357,27 @@ const char *mpp_clock_get_name(MppClock clock)
     return p->name;
 }
 
+/*
+ * MppTimer shared service
+ *
+ * All MppTimer handles are served by one CLOCK_MONOTONIC timerfd and one
+ * thread. Timers are kept in a hierarchical timer wheel with 1ms tick:
+ *
+ * level 0 : 64 slots of 1 tick         covers 64 ms
+ * level 1 : 64 slots of 64 ticks       covers 4 s
+ * level 2 : 64 slots of 4096 ticks     covers 4.3 min
+ * level 3 : 64 slots of 262144 ticks   covers 4.6 hours
+ *
+ * Timers further than level 3 are parked in its last slot and replaced on
+ * cascade. The timerfd is only armed for the nearest non-empty slot so the
+ * thread never wakes up when there is no timer to run.
+ */
+#define TIMER_WHEEL_BITS        6
+#define TIMER_WHEEL_SIZE        (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK        (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS      4
+#define TIMER_WHEEL_RANGE       (1LL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
 typedef struct MppTimerImpl_t {
     const char          *check;
     char                name[16];
@@ -207,14 +385,64 @@ typedef struct MppTimerImpl_t {
     RK_S32              enabled;
     RK_S32              initial;
     RK_S32              interval;
-    RK_S32              timer_fd;
-    RK_S32              epoll_fd;
 
-    MppThread           *thd;
+    /* wheel node and expire tick, protected by service lock */
+    struct list_head    list;
+    RK_S64              expire;
+
     MppThreadFunc       func;
     void                *ctx;
 } MppTimerImpl;
 
+class MppTimerService
+{
+private:
+    MppTimerService();
+    ~MppTimerService();
+    MppTimerService(const MppTimerService &);
+    MppTimerService &operator=(const MppTimerService &);
+
+    static void *timer_loop(void *ctx);
+
+    RK_S64  get_tick();
+    void    add_timer(MppTimerImpl *impl);
+    void    cascade();
+    void    run_slot(struct list_head *expired);
+    void    arm(RK_S64 tick);
+    RK_S64  next_tick();
+    void    loop();
+
+    Mutex               mLock;
+    Condition           mCond;
+    MppThread           *mThread;
+    pthread_t           mThreadId;
+    RK_S32              mTimerFd;
+    RK_S32              mQuit;
+
+    RK_S64              mBase;
+    /* next tick to process */
+    RK_S64              mCurr;
+    /* armed tick on timerfd, -1 for disarmed */
+    RK_S64              mArmed;
+    /* timer with callback running on timer thread */
+    MppTimerImpl        *mRunning;
+    RK_S32              mCount;
+    RK_S64              mWakeups;
+
+    RK_U64              mMask[TIMER_WHEEL_LEVELS];
+    struct list_head    mSlots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+
+public:
+    static MppTimerService *get_instance() {
+        static MppTimerService instance;
+        return &instance;
+    }
+
+    void    enable(MppTimerImpl *impl);
+    void    disable(MppTimerImpl *impl);
+    RK_S64  get_wakeups();
+};
+
 static const char *timer_name = "mpp_timer";
 
 MPP_RET check_is_mpp_timer(void *timer)
@@ -227,111 +455,364 @@ MPP_RET check_is_mpp_timer(void *timer)
     return MPP_NOK;
 }
 
-static void *mpp_timer_thread(void *ctx)
+MppTimerService::MppTimerService()
+    : mThread(NULL),
+      mTimerFd(-1),
+      mQuit(0),
+      mBase(mpp_time()),
+      mCurr(0),
+      mArmed(-1),
+      mRunning(NULL),
+      mCount(0),
+      mWakeups(0)
 {
-    struct itimerspec ts;
-    RK_S32 ret = 0;
-    MppTimerImpl *impl = (MppTimerImpl *)ctx;
-    MppThread *thd = impl->thd;
-    RK_S32 timer_fd = impl->timer_fd;
-
-    // first expire time
-    ts.it_value.tv_sec = impl->initial / 1000;
-    ts.it_value.tv_nsec = (impl->initial % 1000) * 1000;
-
-    // last expire time
-    ts.it_interval.tv_sec = impl->interval / 1000;
-    ts.it_interval.tv_nsec = (impl->interval % 1000) * 1000;
-
-    ret = timerfd_settime(timer_fd, 0, &ts, NULL);
-    if (ret < 0) {
-        mpp_err("timerfd_settime error, Error:[%d:%s]", errno, strerror(errno));
-        return NULL;
+    RK_S32 i, j;
+
+    memset(&mThreadId, 0, sizeof(mThreadId));
+    memset(mMask, 0, sizeof(mMask));
+
+    for (i = 0; i < TIMER_WHEEL_LEVELS; i++)
+        for (j = 0; j < TIMER_WHEEL_SIZE; j++)
+            INIT_LIST_HEAD(&mSlots[i][j]);
+
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (mTimerFd < 0)
+        mpp_err_f("timerfd_create failed Error:[%d:%s]\n", errno, strerror(errno));
+}
+
+MppTimerService::~MppTimerService()
+{
+    if (mThread) {
+        mLock.lock();
+        mQuit = 1;
+        mLock.unlock();
+
+        /* kick the timer thread out of its blocking read */
+        arm(0);
+        mThread->stop();
+        delete mThread;
+        mThread = NULL;
+    }
+
+    if (mCount)
+        mpp_err_f("found %d timer still enabled on exit\n", mCount);
+
+    if (mTimerFd >= 0) {
+        close(mTimerFd);
+        mTimerFd = -1;
+    }
+}
+
+RK_S64 MppTimerService::get_tick()
+{
+    return (mpp_time() - mBase) / 1000;
+}
+
+void MppTimerService::add_timer(MppTimerImpl *impl)
+{
+    RK_S64 expire = impl->expire;
+    RK_S64 delta;
+    RK_S32 level = 0;
+    RK_S32 idx;
+
+    if (expire < mCurr)
+        expire = mCurr;
+
+    delta = expire - mCurr;
+    if (delta >= TIMER_WHEEL_RANGE) {
+        expire = mCurr + TIMER_WHEEL_RANGE - 1;
+        delta = TIMER_WHEEL_RANGE - 1;
+    }
+
+    while (delta >= TIMER_WHEEL_SIZE) {
+        delta >>= TIMER_WHEEL_BITS;
+        level++;
     }
 
-    mpp_log("timer %p start looping\n", impl);
+    idx = (RK_S32)(expire >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+    list_add_tail(&impl->list, &mSlots[level][idx]);
+    mMask[level] |= 1ULL << idx;
+}
 
-    while (1) {
-        if (MPP_THREAD_RUNNING != thd->get_status())
+void MppTimerService::cascade()
+{
+    RK_S32 level;
+
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        RK_S32 idx = (RK_S32)(mCurr >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+        struct list_head *slot = &mSlots[level][idx];
+        MppTimerImpl *pos, *n;
+
+        if (mMask[level] & (1ULL << idx)) {
+            mMask[level] &= ~(1ULL << idx);
+
+            list_for_each_entry_safe(pos, n, slot, MppTimerImpl, list) {
+                list_del_init(&pos->list);
+                add_timer(pos);
+            }
+        }
+
+        if (idx)
             break;
+    }
+}
+
+void MppTimerService::run_slot(struct list_head *expired)
+{
+    RK_S32 idx = (RK_S32)mCurr & TIMER_WHEEL_MASK;
+    struct list_head *slot = &mSlots[0][idx];
+    MppTimerImpl *pos, *n;
 
-        struct epoll_event events;
+    if (!(mMask[0] & (1ULL << idx)))
+        return;
 
-        memset(&events, 0, sizeof(events));
+    mMask[0] &= ~(1ULL << idx);
 
-        /* wait epoll event */
-        RK_S32 fd_cnt = epoll_wait(impl->epoll_fd, &events, 1, 500);
-        if (fd_cnt && (events.events & EPOLLIN) && (events.data.fd == timer_fd)) {
-            RK_U64 exp = 0;
+    list_for_each_entry_safe(pos, n, slot, MppTimerImpl, list) {
+        list_del_init(&pos->list);
 
-            ssize_t cnt = read(timer_fd, &exp, sizeof(exp));
-            mpp_assert(cnt == sizeof(exp));
-            impl->func(impl->ctx);
+        if (pos->expire > mCurr) {
+            add_timer(pos);
+            continue;
+        }
+
+        list_add_tail(&pos->list, expired);
+    }
+}
+
+void MppTimerService::arm(RK_S64 tick)
+{
+    struct itimerspec ts;
+
+    memset(&ts, 0, sizeof(ts));
+
+    if (tick >= 0) {
+        RK_S64 time = mBase + tick * 1000;
+
+        ts.it_value.tv_sec = time / 1000000;
+        ts.it_value.tv_nsec = (time % 1000000) * 1000;
+        /* zero it_value disarms the timerfd */
+        if (!ts.it_value.tv_sec && !ts.it_value.tv_nsec)
+            ts.it_value.tv_nsec = 1;
+    }
+
+    if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &ts, NULL) < 0)
+        mpp_err_f("timerfd_settime error, Error:[%d:%s]\n", errno, strerror(errno));
+
+    mArmed = tick;
+}
+
+RK_S64 MppTimerService::next_tick()
+{
+    RK_S64 next = -1;
+    RK_S32 level;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        RK_S32 shift = level * TIMER_WHEEL_BITS;
+        RK_S64 block = mCurr >> shift;
+        RK_S32 pos = (RK_S32)block & TIMER_WHEEL_MASK;
+        RK_U64 mask = mMask[level];
+        RK_S32 dist;
+        RK_S64 tick;
+
+        if (!mask)
+            continue;
+
+        /* rotate the mask so that bit 0 is the current slot */
+        mask = (mask >> pos) | (pos ? (mask << (TIMER_WHEEL_SIZE - pos)) : 0);
+
+        /*
+         * level 0 current slot is not processed yet. Upper level current slot
+         * is only pending when the current tick is on its cascade boundary.
+         */
+        if (level && (mCurr & ((1LL << shift) - 1)))
+            mask &= ~1ULL;
+
+        if (!mask) {
+            /* only the current slot left which wraps to the next round */
+            dist = TIMER_WHEEL_SIZE;
+        } else
+            dist = __builtin_ctzll(mask);
+
+        tick = (block + dist) << shift;
+        if (tick < mCurr)
+            tick = mCurr;
+
+        if (next < 0 || tick < next)
+            next = tick;
+    }
+
+    return next;
+}
+
+void MppTimerService::enable(MppTimerImpl *impl)
+{
+    AutoMutex auto_lock(&mLock);
+
+    if (impl->enabled)
+        return;
+
+    if (mTimerFd < 0) {
+        mpp_err_f("timer service is not ready\n");
+        return;
+    }
+
+    if (NULL == mThread) {
+        mThread = new MppThread(timer_loop, this, "mpp_timer");
+        if (NULL == mThread) {
+            mpp_err_f("failed to create timer thread\n");
+            return;
         }
+        mThread->start();
     }
 
+    /* fast forward an empty wheel instead of stepping through the idle time */
+    if (!mMask[0] && !mMask[1] && !mMask[2] && !mMask[3] && NULL == mRunning)
+        mCurr = get_tick();
+
+    impl->enabled = 1;
+    impl->expire = get_tick() + impl->initial;
+    add_timer(impl);
+    mCount++;
+
+    if (mArmed < 0 || impl->expire < mArmed)
+        arm(impl->expire);
+}
+
+void MppTimerService::disable(MppTimerImpl *impl)
+{
+    AutoMutex auto_lock(&mLock);
+
+    if (!impl->enabled)
+        return;
+
+    impl->enabled = 0;
+    list_del_init(&impl->list);
+    mCount--;
+
+    if (!mCount && mArmed >= 0)
+        arm(-1);
+
+    /* wait the running callback unless it is disabled in its own callback */
+    if (mThread && !pthread_equal(pthread_self(), mThreadId)) {
+        while (mRunning == impl)
+            mCond.wait(mLock);
+    }
+}
+
+RK_S64 MppTimerService::get_wakeups()
+{
+    AutoMutex auto_lock(&mLock);
+    return mWakeups;
+}
+
+void *MppTimerService::timer_loop(void *ctx)
+{
+    MppTimerService *srv = (MppTimerService *)ctx;
+
+    srv->loop();
     return NULL;
 }
 
-MppTimer mpp_timer_get(const char *name)
+void MppTimerService::loop()
 {
-    RK_S32 timer_fd = -1;
-    RK_S32 epoll_fd = -1;
-    MppTimerImpl *impl = NULL;
+    struct list_head expired;
 
-    do {
-        struct epoll_event event;
+    INIT_LIST_HEAD(&expired);
 
-        impl = mpp_calloc(MppTimerImpl, 1);
-        if (NULL == impl) {
-            mpp_err_f("malloc failed\n");
-            break;
+    mLock.lock();
+    mThreadId = pthread_self();
+
+    while (!mQuit) {
+        RK_U64 exp = 0;
+        RK_S64 now;
+        ssize_t cnt;
+
+        mLock.unlock();
+        cnt = read(mTimerFd, &exp, sizeof(exp));
+        mLock.lock();
+
+        if (cnt < 0) {
+            if (errno != EINTR && errno != EAGAIN) {
+                mpp_err_f("timerfd read error, Error:[%d:%s]\n", errno, strerror(errno));
+                break;
+            }
+            continue;
         }
 
-        timer_fd = timerfd_create(CLOCK_REALTIME, 0);
-        if (timer_fd < 0)
+        if (mQuit)
             break;
 
-        epoll_fd = epoll_create(1);
-        if (epoll_fd < 0)
-            break;
+        mWakeups++;
+        now = get_tick();
 
-        memset(&event, 0, sizeof(event));
-        event.data.fd = timer_fd;
-        event.events = EPOLLIN | EPOLLET;
+        while (mCurr <= now) {
+            RK_S32 idx = (RK_S32)mCurr & TIMER_WHEEL_MASK;
 
-        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event) < 0)
-            break;
+            if (!idx)
+                cascade();
 
-        impl->timer_fd = timer_fd;
-        impl->epoll_fd = epoll_fd;
-        /* default 1 second (1000ms) looper */
-        impl->initial  = 1000;
-        impl->interval = 1000;
-        impl->check = timer_name;
-        snprintf(impl->name, sizeof(impl->name), name, NULL);
+            run_slot(&expired);
 
-        return impl;
-    } while (0);
+            /* skip empty level 0 slots until the next cascade boundary */
+            if (!(mMask[0] >> idx >> 1)) {
+                RK_S64 end = (mCurr | TIMER_WHEEL_MASK) + 1;
 
-    mpp_err_f("failed to create timer\n");
+                mCurr = (end <= now) ? end : (now + 1);
+            } else
+                mCurr++;
+        }
 
-    if (impl) {
-        mpp_free(impl);
-        impl = NULL;
-    }
+        /* reload periodic timers before callbacks so they can disable themselves */
+        while (!list_empty(&expired)) {
+            MppTimerImpl *impl = list_entry(expired.next, MppTimerImpl, list);
+
+            list_del_init(&impl->list);
+
+            if (impl->interval > 0) {
+                impl->expire += impl->interval;
+                /* drop the missed period instead of bursting callbacks */
+                if (impl->expire <= now)
+                    impl->expire = now + impl->interval -
+                                   (now - impl->expire) % impl->interval;
+                add_timer(impl);
+            } else {
+                /* one shot timer stays enabled until user disable it */
+                impl->expire = -1;
+            }
+
+            mRunning = impl;
+            mLock.unlock();
+            impl->func(impl->ctx);
+            mLock.lock();
+            mRunning = NULL;
+            mCond.broadcast();
+        }
 
-    if (timer_fd >= 0) {
-        close(timer_fd);
-        timer_fd = -1;
+        arm(next_tick());
     }
 
-    if (epoll_fd >= 0) {
-        close(epoll_fd);
-        epoll_fd = -1;
+    mLock.unlock();
+}
+
+MppTimer mpp_timer_get(const char *name)
+{
+    MppTimerImpl *impl = mpp_calloc(MppTimerImpl, 1);
+
+    if (NULL == impl) {
+        mpp_err_f("malloc failed\n");
+        return NULL;
     }
 
-    return NULL;
+    /* default 1 second (1000ms) looper */
+    impl->initial  = 1000;
+    impl->interval = 1000;
+    impl->expire   = -1;
+    impl->check = timer_name;
+    INIT_LIST_HEAD(&impl->list);
+    snprintf(impl->name, sizeof(impl->name), name, NULL);
+
+    return impl;
 }
 
 void mpp_timer_set_callback(MppTimer timer, MppThreadFunc func, void *ctx)
@@ -378,21 +859,10 @@ void mpp_timer_set_enable(MppTimer timer, RK_S32 enable)
         return ;
     }
 
-    if (enable) {
-        if (!impl->enabled && NULL == impl->thd) {
-            MppThread *thd = new MppThread(mpp_timer_thread, impl, impl->name);
-            if (thd) {
-                impl->thd = thd;
-                impl->enabled = 1;
-                thd->start();
-            }
-        }
-    } else {
-        if (impl->enabled && impl->thd) {
-            impl->thd->stop();
-            impl->enabled = 0;
-        }
-    }
+    if (enable)
+        MppTimerService::get_instance()->enable(impl);
+    else
+        MppTimerService::get_instance()->disable(impl);
 }
 
 void mpp_timer_put(MppTimer timer)
@@ -405,27 +875,14 @@ void mpp_timer_put(MppTimer timer)
     MppTimerImpl *impl = (MppTimerImpl *)timer;
 
     if (impl->enabled)
-        mpp_timer_set_enable(timer, 0);
-
-    if (impl->timer_fd >= 0) {
-        close(impl->timer_fd);
-        impl->timer_fd = -1;
-    }
-
-    if (impl->epoll_fd >= 0) {
-        close(impl->epoll_fd);
-        impl->epoll_fd = -1;
-    }
+        MppTimerService::get_instance()->disable(impl);
 
-    if (impl->thd) {
-        delete impl->thd;
-        impl->thd = NULL;
-    }
+    mpp_free(impl);
+}
 
-    if (impl) {
-        mpp_free(impl);
-        impl = NULL;
-    }
+RK_S64 mpp_timer_get_wakeups(void)
+{
+    return MppTimerService::get_instance()->get_wakeups();
 }
 
 AutoTiming::AutoTiming(const char *name)
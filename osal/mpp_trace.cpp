@@ -0,0 +1,266 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_trace"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include "mpp_env.h"
+#include "mpp_log.h"
+#include "mpp_mem.h"
+#include "mpp_time.h"
+#include "mpp_atomic.h"
+#include "mpp_trace.h"
+
+RK_U32 mpp_trace_en = 0;
+
+typedef struct MppTraceEvent_t {
+    /* event index plus one when the event is complete, zero on writing */
+    volatile RK_U32 seq;
+    RK_S32          phase;
+    RK_S32          tid;
+    RK_S32          task;
+    RK_U32          arg;
+    RK_S64          time;
+    void            *ctx;
+    const char      *name;
+} MppTraceEvent;
+
+class MppTraceService
+{
+private:
+    MppTraceService();
+    ~MppTraceService();
+    MppTraceService(const MppTraceService &);
+    MppTraceService &operator=(const MppTraceService &);
+
+    static void thread_exit(void *val) { (void)val; };
+    RK_S32 get_tid();
+
+    Mutex               mLock;
+    pthread_key_t       mKey;
+    const char          *mFile;
+
+    MppTraceEvent       *mEvents;
+    RK_U32              mCount;
+    RK_U32              mMask;
+    volatile RK_U32     mWrIdx;
+
+public:
+    static MppTraceService *get_instance() {
+        static MppTraceService instance;
+        return &instance;
+    }
+
+    MPP_RET enable(RK_U32 size);
+    void    record(void *ctx, const char *name, RK_S32 phase, RK_S32 task, RK_U32 arg);
+    MPP_RET dump(const char *path);
+};
+
+MppTraceService::MppTraceService()
+    : mFile(NULL),
+      mEvents(NULL),
+      mCount(0),
+      mMask(0),
+      mWrIdx(0)
+{
+    RK_U32 size = 0;
+
+    pthread_key_create(&mKey, thread_exit);
+
+    mpp_env_get_u32("mpp_trace_size", &size, 0);
+    mpp_env_get_str("mpp_trace_file", &mFile, NULL);
+
+    if (size)
+        enable(size);
+}
+
+MppTraceService::~MppTraceService()
+{
+    mpp_trace_en = 0;
+
+    if (mEvents && mFile)
+        dump(mFile);
+
+    MPP_FREE(mEvents);
+    pthread_key_delete(mKey);
+}
+
+RK_S32 MppTraceService::get_tid()
+{
+    /* cache thread id plus one in thread specific data */
+    RK_S32 tid = (RK_S32)(intptr_t)pthread_getspecific(mKey);
+
+    if (!tid) {
+#if defined(__linux__)
+        tid = (RK_S32)syscall(SYS_gettid) + 1;
+#else
+        tid = (RK_S32)(intptr_t)pthread_self() + 1;
+#endif
+        pthread_setspecific(mKey, (void *)(intptr_t)tid);
+    }
+
+    return tid - 1;
+}
+
+MPP_RET MppTraceService::enable(RK_U32 size)
+{
+    AutoMutex auto_lock(&mLock);
+
+    if (!size) {
+        mpp_trace_en = 0;
+        return MPP_OK;
+    }
+
+    if (NULL == mEvents) {
+        RK_U32 count = 1;
+
+        /* round up to power of 2 for index mask */
+        while (count < size)
+            count <<= 1;
+
+        mEvents = mpp_calloc(MppTraceEvent, count);
+        if (NULL == mEvents) {
+            mpp_err_f("failed to malloc %d trace events\n", count);
+            return MPP_ERR_MALLOC;
+        }
+
+        mCount = count;
+        mMask = count - 1;
+        MPP_SYNC();
+        mpp_log("trace enabled with %d events\n", count);
+    }
+
+    mpp_trace_en = 1;
+    return MPP_OK;
+}
+
+void MppTraceService::record(void *ctx, const char *name, RK_S32 phase,
+                             RK_S32 task, RK_U32 arg)
+{
+    MppTraceEvent *event;
+    RK_U32 idx;
+
+    if (NULL == mEvents)
+        return;
+
+    idx = MPP_FETCH_ADD(&mWrIdx, 1);
+    event = &mEvents[idx & mMask];
+
+    event->seq = 0;
+    MPP_SYNC();
+    event->phase = phase;
+    event->tid = get_tid();
+    event->task = task;
+    event->arg = arg;
+    event->time = mpp_time();
+    event->ctx = ctx;
+    event->name = name;
+    MPP_STORE_RELEASE(&event->seq, idx + 1);
+}
+
+MPP_RET MppTraceService::dump(const char *path)
+{
+    AutoMutex auto_lock(&mLock);
+    RK_U32 wr;
+    RK_U32 idx;
+    RK_S32 pid = (RK_S32)getpid();
+    RK_S32 first = 1;
+    RK_S32 cnt = 0;
+    FILE *fp;
+
+    if (NULL == path)
+        path = mFile;
+
+    if (NULL == path) {
+        mpp_err_f("no dump path, set env mpp_trace_file\n");
+        return MPP_ERR_NULL_PTR;
+    }
+
+    if (NULL == mEvents) {
+        mpp_err_f("trace is not enabled\n");
+        return MPP_NOK;
+    }
+
+    fp = fopen(path, "w");
+    if (NULL == fp) {
+        mpp_err_f("failed to open %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+
+    wr = MPP_LOAD_ACQUIRE(&mWrIdx);
+    idx = (wr > mCount) ? (wr - mCount) : 0;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (; idx != wr; idx++) {
+        MppTraceEvent *src = &mEvents[idx & mMask];
+        MppTraceEvent event;
+
+        /* skip the event on writing or overwritten during copy */
+        if (MPP_LOAD_ACQUIRE(&src->seq) != idx + 1)
+            continue;
+
+        memcpy(&event, src, sizeof(event));
+        MPP_SYNC();
+
+        if (MPP_LOAD_ACQUIRE(&src->seq) != idx + 1)
+            continue;
+
+        fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"mpp\",\"ph\":\"%c\",%s"
+                "\"ts\":%lld,\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"ctx\":\"%p\",\"task\":%d,\"arg\":\"0x%08x\"}}",
+                first ? "" : ",\n", event.name, event.phase,
+                (event.phase == MPP_TRACE_INSTANT) ? "\"s\":\"t\"," : "",
+                (long long)event.time, pid, event.tid,
+                event.ctx, event.task, event.arg);
+        first = 0;
+        cnt++;
+    }
+
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    mpp_log("dump %d trace events to %s\n", cnt, path);
+    return MPP_OK;
+}
+
+void mpp_trace_init(void)
+{
+    MppTraceService::get_instance();
+}
+
+MPP_RET mpp_trace_enable(RK_U32 size)
+{
+    return MppTraceService::get_instance()->enable(size);
+}
+
+void mpp_trace_record(void *ctx, const char *name, RK_S32 phase,
+                      RK_S32 task, RK_U32 arg)
+{
+    MppTraceService::get_instance()->record(ctx, name, phase, task, arg);
+}
+
+MPP_RET mpp_trace_dump(const char *path)
+{
+    return MppTraceService::get_instance()->dump(path);
+}
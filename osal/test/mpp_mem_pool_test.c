@@ -0,0 +1,86 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_mem_pool_test"
+
+#include <string.h>
+
+#include "mpp_env.h"
+#include "mpp_log.h"
+#include "mpp_common.h"
+#include "mpp_mem_pool.h"
+
+#define POOL_TEST_SIZE      96
+#define POOL_TEST_COUNT     8
+#define POOL_TEST_LOOP      1000
+
+int main()
+{
+    MppMemPool pool = mpp_mem_pool_init(POOL_TEST_SIZE);
+    void *objs[POOL_TEST_COUNT];
+    MppMemPoolInfo info;
+    RK_U32 mem_debug = 0;
+    RK_S32 ret = 0;
+    RK_S32 i, j;
+
+    mpp_log("mpp_mem_pool_test start\n");
+
+    // pool does not recycle with mpp_mem_debug
+    mpp_env_get_u32("mpp_mem_debug", &mem_debug, 0);
+
+    for (i = 0; i < POOL_TEST_LOOP; i++) {
+        for (j = 0; j < POOL_TEST_COUNT; j++) {
+            RK_U8 *p = (RK_U8 *)mpp_mem_pool_get(pool);
+
+            if (NULL == p || p[0] || p[POOL_TEST_SIZE - 1]) {
+                mpp_err("get invalid object %p on loop %d\n", p, i);
+                ret = -1;
+                goto DONE;
+            }
+
+            // dirty the object to check the zeroing on next get
+            memset(p, 0xff, POOL_TEST_SIZE);
+            objs[j] = p;
+        }
+
+        for (j = 0; j < POOL_TEST_COUNT; j++)
+            mpp_mem_pool_put(pool, objs[j]);
+    }
+
+    mpp_mem_pool_info(pool, &info);
+    mpp_log("hits %lld misses %lld used %d high water %d unused %d\n",
+            info.hits, info.misses, info.used, info.high_water, info.unused);
+
+    if (mem_debug) {
+        // every get goes to heap and every put is freed
+        if (info.misses != (RK_U64)POOL_TEST_COUNT * POOL_TEST_LOOP ||
+            info.used || info.high_water != POOL_TEST_COUNT ||
+            info.unused || info.hits)
+            ret = -1;
+    } else {
+        // only the first loop should go to heap
+        if (info.misses != POOL_TEST_COUNT || info.used ||
+            info.high_water != POOL_TEST_COUNT || info.unused != POOL_TEST_COUNT ||
+            info.hits != (RK_U64)POOL_TEST_COUNT * (POOL_TEST_LOOP - 1))
+            ret = -1;
+    }
+
+DONE:
+    mpp_mem_pool_deinit(pool);
+    mpp_log("mpp_mem_pool_test %s\n", ret ? "failed" : "success");
+
+    return ret;
+}
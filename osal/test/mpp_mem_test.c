@@ -16,15 +16,64 @@
 
 #define MODULE_TAG "mpp_mem_test"
 
+#include <string.h>
+
 #include "mpp_log.h"
 #include "mpp_env.h"
 #include "mpp_mem.h"
+#include "mpp_time.h"
+#include "mpp_thread.h"
+
+#define MEM_TEST_THREAD_CNT     4
+#define MEM_TEST_SLOT_CNT       64
+#define MEM_TEST_LOOP_CNT       100000
+
+/*
+ * pressure test with random size malloc / free on multiple threads
+ * run with env mpp_mem_cache=1 to check the per-thread cache mode
+ */
+static void *mem_test_thread(void *arg)
+{
+    void *slots[MEM_TEST_SLOT_CNT];
+    RK_U32 seed = (RK_U32)(intptr_t)arg;
+    RK_S32 i;
+
+    memset(slots, 0, sizeof(slots));
+
+    for (i = 0; i < MEM_TEST_LOOP_CNT; i++) {
+        RK_S32 idx;
+
+        seed = seed * 1103515245 + 12345;
+        idx = (seed >> 16) % MEM_TEST_SLOT_CNT;
+
+        if (slots[idx]) {
+            mpp_free(slots[idx]);
+            slots[idx] = NULL;
+        } else {
+            /* mostly small size with some large size */
+            size_t size = (seed & 0xf) ? ((seed >> 8) & 0x7ff) + 1 :
+                          ((seed >> 8) & 0xffff) + 1;
+
+            slots[idx] = mpp_malloc_size(void, size);
+            if (slots[idx])
+                memset(slots[idx], 0x5a, size);
+        }
+    }
+
+    for (i = 0; i < MEM_TEST_SLOT_CNT; i++)
+        MPP_FREE(slots[i]);
 
-// TODO: need to add pressure test case and parameter scan case
+    return NULL;
+}
 
 int main()
 {
+    pthread_t thds[MEM_TEST_THREAD_CNT];
+    MppMemSnapshot snap0 = NULL;
+    MppMemSnapshot snap1 = NULL;
     void *tmp = NULL;
+    RK_S64 time;
+    RK_S32 i;
 
     tmp = mpp_calloc(int, 100);
     if (tmp) {
@@ -40,7 +89,38 @@ int main()
             mpp_log("realloc failed\n");
         }
     }
+    if (tmp) {
+        tmp = mpp_realloc(tmp, int, 4096);
+        if (tmp) {
+            mpp_log("realloc success ptr 0x%p\n", tmp);
+        } else {
+            mpp_log("realloc failed\n");
+        }
+    }
     mpp_free(tmp);
+
+    /* snapshot is only available with env mpp_mem_debug enabled */
+    mpp_mem_get_snapshot(&snap0);
+
+    time = mpp_time();
+    for (i = 0; i < MEM_TEST_THREAD_CNT; i++)
+        pthread_create(&thds[i], NULL, mem_test_thread, (void *)(intptr_t)(i + 1));
+
+    for (i = 0; i < MEM_TEST_THREAD_CNT; i++)
+        pthread_join(thds[i], NULL);
+
+    time = mpp_time() - time;
+    mpp_log("pressure test %d threads %d loops cost %lld us\n",
+            MEM_TEST_THREAD_CNT, MEM_TEST_LOOP_CNT, time);
+
+    mpp_mem_get_snapshot(&snap1);
+    if (snap0 && snap1)
+        mpp_mem_squash_snapshot(snap0, snap1);
+
+    mpp_mem_put_snapshot(&snap0);
+    mpp_mem_put_snapshot(&snap1);
+
+    mpp_show_mem_status();
     mpp_log("mpp_mem_test done\n");
 
     return 0;
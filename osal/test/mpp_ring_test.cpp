@@ -0,0 +1,250 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_ring_test"
+
+#include <errno.h>
+
+#include "mpp_log.h"
+#include "mpp_time.h"
+#include "mpp_ring.h"
+#include "mpp_atomic.h"
+#include "mpp_thread.h"
+
+#define RING_TEST_COUNT     4
+#define RING_TEST_LOOP      200000
+
+static RK_S32 destroy_count = 0;
+
+static void *ring_test_destroy(void *data)
+{
+    (void)data;
+    destroy_count++;
+    return NULL;
+}
+
+/* push until full, pop in order, peek and flush with node destructor */
+static MPP_RET ring_test_basic(void)
+{
+    MppRing ring(3, sizeof(RK_S32), ring_test_destroy);
+    RK_S32 val;
+    RK_S32 i;
+
+    /* count is rounded up to power of 2 */
+    if (ring.ring_count() != 4 || !ring.is_empty()) {
+        mpp_err("invalid ring count %d size %d\n", ring.ring_count(), ring.ring_size());
+        return MPP_NOK;
+    }
+
+    for (i = 0; i < ring.ring_count(); i++) {
+        if (ring.push(&i)) {
+            mpp_err("push %d failed\n", i);
+            return MPP_NOK;
+        }
+    }
+
+    val = 100;
+    if (!ring.push(&val) || !ring.is_full()) {
+        mpp_err("push on full ring should fail\n");
+        return MPP_NOK;
+    }
+
+    if (ring.peek(&val) || val != 0) {
+        mpp_err("peek get %d expect 0\n", val);
+        return MPP_NOK;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if (ring.pop(&val) || val != i) {
+            mpp_err("pop get %d expect %d\n", val, i);
+            return MPP_NOK;
+        }
+    }
+
+    if (ring.wait_data(0) || ring.wait_space(0)) {
+        mpp_err("ring should have both data and space\n");
+        return MPP_NOK;
+    }
+
+    destroy_count = 0;
+    ring.flush();
+    if (destroy_count != 2 || !ring.is_empty()) {
+        mpp_err("flush destroy %d expect 2\n", destroy_count);
+        return MPP_NOK;
+    }
+
+    if (!ring.pop(&val)) {
+        mpp_err("pop on empty ring should fail\n");
+        return MPP_NOK;
+    }
+
+    return MPP_OK;
+}
+
+/* timed wait on empty and full ring */
+static MPP_RET ring_test_timeout(void)
+{
+    MppRing ring(1, sizeof(RK_S32));
+    RK_S64 start;
+    RK_S64 used;
+    RK_S32 val = 0;
+
+    if (ring.wait_data(0) != ETIMEDOUT) {
+        mpp_err("non-block wait data on empty ring should timeout\n");
+        return MPP_NOK;
+    }
+
+    start = mpp_time();
+    if (ring.wait_data(20) != ETIMEDOUT) {
+        mpp_err("wait data on empty ring should timeout\n");
+        return MPP_NOK;
+    }
+    used = mpp_time() - start;
+    if (used < 15000) {
+        mpp_err("wait data returned too early %lld us\n", used);
+        return MPP_NOK;
+    }
+
+    ring.push(&val);
+    if (ring.wait_space(20) != ETIMEDOUT) {
+        mpp_err("wait space on full ring should timeout\n");
+        return MPP_NOK;
+    }
+
+    return MPP_OK;
+}
+
+typedef struct RingTestCtx_t {
+    MppRing     *ring;
+    RK_S32      loop;
+    RK_S32      error;
+    RK_U32      done;
+} RingTestCtx;
+
+static void *ring_test_producer(void *arg)
+{
+    RingTestCtx *ctx = (RingTestCtx *)arg;
+    RK_S32 i;
+
+    for (i = 0; i < ctx->loop; i++) {
+        while (ctx->ring->push(&i))
+            ctx->ring->wait_space(-1);
+    }
+
+    MPP_STORE_RELEASE(&ctx->done, 1);
+    return NULL;
+}
+
+/*
+ * one producer and one consumer on a small ring both sleep on futex often
+ * a lost wakeup hangs the test and a broken index loses or reorders data
+ */
+static MPP_RET ring_test_spsc(void)
+{
+    MppRing ring(RING_TEST_COUNT, sizeof(RK_S32));
+    RingTestCtx ctx = { &ring, RING_TEST_LOOP, 0, 0 };
+    pthread_t thd;
+    RK_S64 start = mpp_time();
+    RK_S32 expect;
+
+    pthread_create(&thd, NULL, ring_test_producer, &ctx);
+
+    for (expect = 0; expect < RING_TEST_LOOP; expect++) {
+        RK_S32 val = -1;
+
+        while (ring.pop(&val))
+            ring.wait_data(-1);
+
+        if (val != expect) {
+            mpp_err("pop get %d expect %d\n", val, expect);
+            ctx.error = 1;
+            break;
+        }
+    }
+
+    /* drain the ring on error so that the producer can finish */
+    while (ctx.error && ring.wait_data(100) == 0)
+        ring.flush();
+
+    pthread_join(thd, NULL);
+
+    mpp_log("spsc %d elements in %lld us\n", RING_TEST_LOOP, mpp_time() - start);
+
+    return ctx.error ? MPP_NOK : MPP_OK;
+}
+
+/* consumer side flush wakes up the producer waiting on full ring */
+static MPP_RET ring_test_flush_wake(void)
+{
+    MppRing ring(RING_TEST_COUNT, sizeof(RK_S32));
+    RingTestCtx ctx = { &ring, RING_TEST_COUNT + 1, 0, 0 };
+    pthread_t thd;
+    RK_S32 i;
+
+    pthread_create(&thd, NULL, ring_test_producer, &ctx);
+
+    /* let producer fill the ring and sleep on it */
+    while (!ring.is_full())
+        msleep(1);
+    msleep(10);
+
+    if (MPP_LOAD_ACQUIRE(&ctx.done)) {
+        mpp_err("producer should wait on full ring\n");
+        ctx.error = 1;
+    }
+
+    ring.flush();
+
+    for (i = 0; i < 1000 && !MPP_LOAD_ACQUIRE(&ctx.done); i++)
+        msleep(1);
+
+    if (!MPP_LOAD_ACQUIRE(&ctx.done)) {
+        mpp_err("producer is not woken up by flush\n");
+        ctx.error = 1;
+        /* unblock producer to join */
+        while (!MPP_LOAD_ACQUIRE(&ctx.done))
+            ring.flush();
+    }
+
+    pthread_join(thd, NULL);
+
+    return ctx.error ? MPP_NOK : MPP_OK;
+}
+
+int main()
+{
+    MPP_RET ret;
+
+    mpp_log("mpp_ring_test start\n");
+
+    ret = ring_test_basic();
+    if (ret)
+        goto RET;
+
+    ret = ring_test_timeout();
+    if (ret)
+        goto RET;
+
+    ret = ring_test_spsc();
+    if (ret)
+        goto RET;
+
+    ret = ring_test_flush_wake();
+
+RET:
+    mpp_log("mpp_ring_test %s\n", ret ? "failed" : "success");
+    return ret;
+}
@@ -16,8 +16,119 @@
 
 #define MODULE_TAG "mpp_time_test"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "mpp_log.h"
 #include "mpp_time.h"
+#include "mpp_atomic.h"
+#include "mpp_thread.h"
+
+#define TIMER_TEST_COUNT        64
+#define TIMER_TEST_INTERVAL     10
+#define TIMER_TEST_DURATION     200
+
+static volatile RK_S32 timer_hits = 0;
+
+static void *timer_test_cb(void *ctx)
+{
+    (void)ctx;
+    MPP_FETCH_ADD(&timer_hits, 1);
+    return NULL;
+}
+
+static RK_S32 get_thread_count(void)
+{
+    RK_S32 count = -1;
+    char line[128];
+    FILE *fp = fopen("/proc/self/status", "r");
+
+    if (NULL == fp)
+        return -1;
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (!strncmp(line, "Threads:", 8)) {
+            count = atoi(line + 8);
+            break;
+        }
+    }
+
+    fclose(fp);
+    return count;
+}
+
+/* run count timers for a while and return the timer thread wakeups */
+static RK_S64 timer_test_run(MppTimer *timers, RK_S32 count, RK_S32 *threads)
+{
+    RK_S64 wakeups = mpp_timer_get_wakeups();
+    RK_S32 i;
+
+    timer_hits = 0;
+
+    for (i = 0; i < count; i++) {
+        mpp_timer_set_callback(timers[i], timer_test_cb, NULL);
+        mpp_timer_set_timing(timers[i], TIMER_TEST_INTERVAL, TIMER_TEST_INTERVAL);
+        mpp_timer_set_enable(timers[i], 1);
+    }
+
+    msleep(TIMER_TEST_DURATION);
+    *threads = get_thread_count();
+
+    for (i = 0; i < count; i++)
+        mpp_timer_set_enable(timers[i], 0);
+
+    wakeups = mpp_timer_get_wakeups() - wakeups;
+
+    mpp_log("%2d timers: callbacks %4d wakeups %3lld threads %d\n",
+            count, timer_hits, wakeups, *threads);
+
+    return wakeups;
+}
+
+static RK_S32 timer_test(void)
+{
+    MppTimer timers[TIMER_TEST_COUNT];
+    RK_S32 threads_1 = 0;
+    RK_S32 threads_n = 0;
+    RK_S64 wakeups_1;
+    RK_S64 wakeups_n;
+    RK_S64 wakeups;
+    RK_S32 ret = 0;
+    RK_S32 i;
+
+    for (i = 0; i < TIMER_TEST_COUNT; i++)
+        timers[i] = mpp_timer_get("timer_test");
+
+    wakeups_1 = timer_test_run(timers, 1, &threads_1);
+    wakeups_n = timer_test_run(timers, TIMER_TEST_COUNT, &threads_n);
+
+    if (threads_n != threads_1) {
+        mpp_err("thread count grows from %d to %d\n", threads_1, threads_n);
+        ret = -1;
+    }
+
+    /* allow some phase split on enable across a tick boundary */
+    if (wakeups_n > wakeups_1 * 2 + 2) {
+        mpp_err("wakeups grows from %lld to %lld\n", wakeups_1, wakeups_n);
+        ret = -1;
+    }
+
+    /* no timer enabled, no wakeup */
+    wakeups = mpp_timer_get_wakeups();
+    msleep(TIMER_TEST_DURATION);
+    wakeups = mpp_timer_get_wakeups() - wakeups;
+    mpp_log("idle wakeups %lld\n", wakeups);
+    if (wakeups > 1) {
+        mpp_err("timer thread wakes up on idle\n");
+        ret = -1;
+    }
+
+    for (i = 0; i < TIMER_TEST_COUNT; i++)
+        mpp_timer_put(timers[i]);
+
+    return ret;
+}
 
 int main()
 {
@@ -25,6 +136,7 @@ int main()
     RK_S64 time_1;
     MppClock clock;
     RK_S32 i;
+    RK_S32 ret;
 
     mpp_log("mpp time test start\n");
 
@@ -78,8 +190,37 @@ int main()
     mpp_log("mpp_time pause 0 at %.3f ms pause 1 at %.3f ms\n",
             time_0 / 1000.0, time_1 / 1000.0);
 
+    /* 1ms sleep with every tenth 5ms sleep for percentile check */
+    {
+        MppClockStat stat;
+
+        mpp_clock_reset(clock);
+        mpp_clock_enable_histogram(clock, 1);
+
+        for (i = 0; i < 200; i++) {
+            mpp_clock_start(clock);
+            msleep((i % 10) ? 1 : 5);
+            mpp_clock_pause(clock);
+        }
+
+        mpp_clock_get_stat(clock, &stat);
+        mpp_log("histogram count %lld min %lld max %lld p50 %lld p90 %lld p99 %lld p999 %lld\n",
+                stat.count, stat.min, stat.max, stat.p50, stat.p90, stat.p99, stat.p999);
+
+        if (stat.count != 200 || stat.p50 < 1000 || stat.p50 >= 5000 ||
+            stat.p99 < 5000 || stat.max < stat.p999 || stat.p50 < stat.min) {
+            mpp_err("clock histogram check failed\n");
+            return -1;
+        }
+    }
+
+    mpp_clock_put(clock);
 
     mpp_log("mpp time test done\n");
 
-    return 0;
+    mpp_log("mpp timer test start\n");
+    ret = timer_test();
+    mpp_log("mpp timer test %s\n", ret ? "failed" : "success");
+
+    return ret;
 }
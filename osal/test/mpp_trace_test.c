@@ -0,0 +1,102 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_trace_test"
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mpp_log.h"
+#include "mpp_time.h"
+#include "mpp_trace.h"
+
+#define TRACE_TEST_SIZE         256
+#define TRACE_TEST_LOOP         1000
+#define TRACE_TEST_FILE         "/tmp/mpp_trace_test.json"
+
+static void *trace_test_thread(void *ctx)
+{
+    RK_S32 i;
+
+    for (i = 0; i < TRACE_TEST_LOOP; i++) {
+        mpp_trace_begin(ctx, "test stage", i, 0);
+        mpp_trace_end(ctx, "test stage", i, 0);
+    }
+
+    return NULL;
+}
+
+int main()
+{
+    pthread_t thds[2];
+    RK_S32 events = 0;
+    RK_S64 time;
+    char line[512];
+    FILE *fp;
+    RK_S32 i;
+
+    mpp_log("mpp trace test start\n");
+
+    /* disabled trace should not record */
+    mpp_trace_begin(NULL, "disabled", 0, 0);
+
+    if (mpp_trace_enable(TRACE_TEST_SIZE)) {
+        mpp_err("trace enable failed\n");
+        return -1;
+    }
+
+    mpp_trace_instant(NULL, "wait", -1, 0x4001);
+
+    time = mpp_time();
+    for (i = 0; i < 2; i++)
+        pthread_create(&thds[i], NULL, trace_test_thread, (void *)(intptr_t)(i + 1));
+
+    for (i = 0; i < 2; i++)
+        pthread_join(thds[i], NULL);
+    time = mpp_time() - time;
+
+    mpp_log("record %d events cost %lld us\n", TRACE_TEST_LOOP * 4, time);
+
+    if (mpp_trace_dump(TRACE_TEST_FILE)) {
+        mpp_err("trace dump failed\n");
+        return -1;
+    }
+
+    fp = fopen(TRACE_TEST_FILE, "r");
+    if (NULL == fp) {
+        mpp_err("failed to open %s\n", TRACE_TEST_FILE);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (strstr(line, "\"name\":"))
+            events++;
+    }
+    fclose(fp);
+    remove(TRACE_TEST_FILE);
+
+    mpp_trace_enable(0);
+
+    /* the ring keeps the latest events only */
+    if (events != TRACE_TEST_SIZE) {
+        mpp_err("dump %d events expect %d\n", events, TRACE_TEST_SIZE);
+        return -1;
+    }
+
+    mpp_log("mpp trace test success\n");
+    return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define MODULE_TAG "mpp_worker_pool_test"
+
+#include <string.h>
+
+#include "mpp_env.h"
+#include "mpp_log.h"
+#include "mpp_time.h"
+#include "mpp_atomic.h"
+#include "mpp_thread.h"
+
+#define POOL_TEST_WORKER        4
+#define POOL_TEST_STEAL_JOB     16
+#define POOL_TEST_BLOCK_JOB     (POOL_TEST_WORKER * 2)
+#define POOL_TEST_PING_PONG     1000
+#define POOL_TEST_TIMEOUT       5000
+
+typedef MPP_RET (*PoolTestWork)(void *job);
+
+typedef struct PoolTestJob_t {
+    MppThread       *thd;
+    PoolTestWork    work;
+    RK_U32          signaled;
+    pthread_t       runner;
+    void            *ctx;
+} PoolTestJob;
+
+static volatile RK_S32 done_count = 0;
+
+/* job runs its work once on each signal and exits on stop */
+static MppJobRet pool_test_job(void *ctx)
+{
+    PoolTestJob *job = (PoolTestJob *)ctx;
+
+    {
+        AutoMutex autolock(job->thd->mutex());
+
+        if (MPP_THREAD_RUNNING != job->thd->get_status())
+            return MPP_JOB_EXIT;
+
+        if (!job->signaled)
+            return MPP_JOB_WAIT;
+
+        job->signaled = 0;
+    }
+
+    job->work(job);
+    return MPP_JOB_WAIT;
+}
+
+static void pool_test_signal(PoolTestJob *job)
+{
+    job->thd->lock();
+    job->signaled = 1;
+    job->thd->signal();
+    job->thd->unlock();
+}
+
+static void pool_test_start(PoolTestJob *jobs, RK_S32 count, PoolTestWork work,
+                            void *ctx)
+{
+    RK_S32 i;
+
+    for (i = 0; i < count; i++) {
+        memset(&jobs[i], 0, sizeof(jobs[i]));
+        jobs[i].work = work;
+        jobs[i].ctx = ctx;
+        jobs[i].thd = new MppThread(pool_test_job, &jobs[i], "pool_test", 1);
+        jobs[i].thd->start();
+    }
+}
+
+static void pool_test_stop(PoolTestJob *jobs, RK_S32 count)
+{
+    RK_S32 i;
+
+    for (i = 0; i < count; i++) {
+        jobs[i].thd->stop();
+        delete jobs[i].thd;
+        jobs[i].thd = NULL;
+    }
+}
+
+static MPP_RET pool_test_wait_done(RK_S32 count)
+{
+    RK_S64 start = mpp_time();
+
+    while (MPP_ADD_FETCH(&done_count, 0) < count) {
+        if (mpp_time() - start > POOL_TEST_TIMEOUT * 1000)
+            return MPP_NOK;
+        msleep(1);
+    }
+
+    return MPP_OK;
+}
+
+static MPP_RET steal_work(void *data)
+{
+    PoolTestJob *job = (PoolTestJob *)data;
+    RK_S64 start = mpp_time();
+
+    /* busy for 2ms so that idle workers steal the other jobs */
+    while (mpp_time() - start < 2000)
+        ;
+
+    job->runner = pthread_self();
+    MPP_ADD_FETCH(&done_count, 1);
+    return MPP_OK;
+}
+
+static MPP_RET spawn_work(void *data)
+{
+    PoolTestJob *job = (PoolTestJob *)data;
+    PoolTestJob *jobs = (PoolTestJob *)job->ctx;
+    RK_S32 i;
+
+    /* jobs signaled on worker are queued to the local deque of this worker */
+    for (i = 0; i < POOL_TEST_STEAL_JOB; i++)
+        pool_test_signal(&jobs[i]);
+
+    return MPP_OK;
+}
+
+/* all jobs are queued on one worker and the other workers steal them */
+static MPP_RET pool_test_steal(void)
+{
+    PoolTestJob jobs[POOL_TEST_STEAL_JOB];
+    PoolTestJob spawner;
+    RK_S32 runner_count = 0;
+    MPP_RET ret;
+    RK_S32 i, j;
+
+    done_count = 0;
+    pool_test_start(jobs, POOL_TEST_STEAL_JOB, steal_work, NULL);
+    pool_test_start(&spawner, 1, spawn_work, jobs);
+
+    pool_test_signal(&spawner);
+    ret = pool_test_wait_done(POOL_TEST_STEAL_JOB);
+
+    pool_test_stop(&spawner, 1);
+    pool_test_stop(jobs, POOL_TEST_STEAL_JOB);
+
+    if (ret) {
+        mpp_err("steal test done %d jobs expect %d\n", done_count,
+                POOL_TEST_STEAL_JOB);
+        return ret;
+    }
+
+    for (i = 0; i < POOL_TEST_STEAL_JOB; i++) {
+        for (j = 0; j < i; j++) {
+            if (pthread_equal(jobs[i].runner, jobs[j].runner))
+                break;
+        }
+        if (j == i)
+            runner_count++;
+    }
+
+    mpp_log("steal test %d jobs run on %d workers\n", POOL_TEST_STEAL_JOB,
+            runner_count);
+
+    if (runner_count < 2) {
+        mpp_err("no job is stolen\n");
+        return MPP_NOK;
+    }
+
+    return MPP_OK;
+}
+
+static sem_t block_sem;
+static volatile RK_S32 block_count = 0;
+static volatile RK_S32 ping_pong_count = 0;
+
+static MPP_RET block_work(void *data)
+{
+    (void)data;
+
+    /* blocking like hardware wait */
+    MPP_ADD_FETCH(&block_count, 1);
+    MppThread::block_begin();
+    sem_wait(&block_sem);
+    MppThread::block_end();
+
+    MPP_ADD_FETCH(&done_count, 1);
+    return MPP_OK;
+}
+
+static MPP_RET ping_pong_work(void *data)
+{
+    PoolTestJob *job = (PoolTestJob *)data;
+
+    /* each job waits the other one by MPP_JOB_WAIT instead of blocking */
+    if (MPP_ADD_FETCH(&ping_pong_count, 1) < POOL_TEST_PING_PONG)
+        pool_test_signal((PoolTestJob *)job->ctx);
+    else
+        MPP_ADD_FETCH(&done_count, 1);
+
+    return MPP_OK;
+}
+
+/*
+ * more blocking jobs than workers, then two jobs waiting on each other must
+ * still run while all the blocking jobs are blocked
+ */
+static MPP_RET pool_test_oversubscribe(void)
+{
+    PoolTestJob blocks[POOL_TEST_BLOCK_JOB];
+    PoolTestJob pairs[2];
+    RK_S64 start;
+    MPP_RET ret = MPP_OK;
+    RK_S32 i;
+
+    done_count = 0;
+    block_count = 0;
+    ping_pong_count = 0;
+    sem_init(&block_sem, 0, 0);
+
+    pool_test_start(blocks, POOL_TEST_BLOCK_JOB, block_work, NULL);
+    for (i = 0; i < POOL_TEST_BLOCK_JOB; i++)
+        pool_test_signal(&blocks[i]);
+
+    start = mpp_time();
+    while (MPP_ADD_FETCH(&block_count, 0) < POOL_TEST_BLOCK_JOB) {
+        if (mpp_time() - start > POOL_TEST_TIMEOUT * 1000) {
+            mpp_err("only %d of %d jobs are blocked\n", block_count,
+                    POOL_TEST_BLOCK_JOB);
+            ret = MPP_NOK;
+            break;
+        }
+        msleep(1);
+    }
+
+    pool_test_start(pairs, 2, ping_pong_work, NULL);
+    pairs[0].ctx = &pairs[1];
+    pairs[1].ctx = &pairs[0];
+
+    if (!ret) {
+        start = mpp_time();
+        pool_test_signal(&pairs[0]);
+        ret = pool_test_wait_done(1);
+        if (ret)
+            mpp_err("ping pong %d of %d with %d jobs blocked\n", ping_pong_count,
+                    POOL_TEST_PING_PONG, POOL_TEST_BLOCK_JOB);
+        else
+            mpp_log("oversubscribe test %d jobs blocked on %d workers ping pong %d in %lld us\n",
+                    POOL_TEST_BLOCK_JOB, POOL_TEST_WORKER, POOL_TEST_PING_PONG,
+                    mpp_time() - start);
+    }
+
+    for (i = 0; i < POOL_TEST_BLOCK_JOB; i++)
+        sem_post(&block_sem);
+
+    if (!ret && pool_test_wait_done(POOL_TEST_BLOCK_JOB + 1)) {
+        mpp_err("blocked jobs are not done\n");
+        ret = MPP_NOK;
+    }
+
+    pool_test_stop(pairs, 2);
+    pool_test_stop(blocks, POOL_TEST_BLOCK_JOB);
+    sem_destroy(&block_sem);
+
+    return ret;
+}
+
+int main()
+{
+    MPP_RET ret;
+
+    mpp_log("mpp_worker_pool_test start\n");
+
+    /* NOTE: worker count is read when the pool is created */
+    mpp_env_set_u32("mpp_worker_count", POOL_TEST_WORKER);
+
+    ret = pool_test_steal();
+    if (ret)
+        goto RET;
+
+    ret = pool_test_oversubscribe();
+
+RET:
+    mpp_log("mpp_worker_pool_test %s\n", ret ? "failed" : "success");
+    return ret;
+}
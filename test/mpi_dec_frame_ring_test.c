@@ -0,0 +1,231 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if defined(_WIN32)
+#include "vld.h"
+#endif
+
+#define MODULE_TAG "mpi_dec_frame_ring_test"
+
+#include <string.h>
+#include "rk_mpi.h"
+#include "mpp_log.h"
+#include "mpp_time.h"
+#include "mpp_impl.h"
+#include "mpp_common.h"
+
+#define RING_TEST_FRAME_COUNT       200
+#define RING_TEST_STREAM_SIZE       (SZ_1K)
+/* frame ring has 64 elements by default, keep parser running until it is full */
+#define RING_TEST_FRAME_QUEUE       63
+/* input is stalled when no packet is taken in this time */
+#define RING_TEST_STALL_TIME        200
+#define RING_TEST_BATCH             8
+
+/*
+ * User stops getting frames until the decoder stalls. The output frames
+ * overflow the full frame ring and must come out later in order without loss.
+ * Reset on the stalled decoder must return as output never waits on the ring.
+ */
+typedef struct RingTestCtx_t {
+    MppCtx          ctx;
+    MppApi          *mpi;
+    char            buf[RING_TEST_STREAM_SIZE];
+    RK_S32          put_count;
+    RK_S32          get_count;
+    RK_S32          ring_depth;
+    RK_U32          eos;
+} RingTestCtx;
+
+/* put packets without getting frames until the decoder stops taking them */
+static void ring_test_fill(RingTestCtx *p, RK_S32 total)
+{
+    RK_S64 last = mpp_time();
+
+    while (p->put_count < total &&
+           mpp_time() - last < RING_TEST_STALL_TIME * 1000) {
+        MppPacket packet = NULL;
+
+        mpp_packet_init(&packet, p->buf, sizeof(p->buf));
+        mpp_packet_set_pts(packet, p->put_count);
+        if (p->put_count == total - 1)
+            mpp_packet_set_eos(packet);
+
+        if (MPP_OK == p->mpi->decode_put_packet(p->ctx, packet)) {
+            p->put_count++;
+            last = mpp_time();
+        } else {
+            msleep(1);
+        }
+
+        mpp_packet_deinit(&packet);
+    }
+}
+
+static RK_U32 ring_test_is_full(RingTestCtx *p)
+{
+    MppDecWaitStats stats;
+
+    memset(&stats, 0, sizeof(stats));
+    p->mpi->control(p->ctx, MPP_DEC_GET_WAIT_STATS, &stats);
+
+    mpp_log("stalled at put %d get %d frame queue %d packet queue %d\n",
+            p->put_count, p->get_count, stats.frame_queue, stats.packet_queue);
+
+    return stats.frame_queue >= p->ring_depth;
+}
+
+/* get all frames output so far by batch and check they are in order */
+static MPP_RET ring_test_drain(RingTestCtx *p, RK_S32 count)
+{
+    MppFrame frames[RING_TEST_BATCH];
+    MPP_RET ret = MPP_OK;
+
+    while (!p->eos && p->get_count < count) {
+        RK_S32 done = 0;
+        RK_S32 i;
+
+        ret = p->mpi->decode_get_frames(p->ctx, frames, RING_TEST_BATCH, &done);
+        if (ret || !done) {
+            mpp_err("get frames failed ret %d at %d\n", ret, p->get_count);
+            return MPP_NOK;
+        }
+
+        for (i = 0; i < done; i++) {
+            MppFrame frame = frames[i];
+
+            if (mpp_frame_get_info_change(frame)) {
+                p->mpi->control(p->ctx, MPP_DEC_SET_INFO_CHANGE_READY, NULL);
+            } else if (mpp_frame_get_buffer(frame)) {
+                if (!ret && mpp_frame_get_pts(frame) != p->get_count) {
+                    mpp_err("get frame pts %lld expect %d\n",
+                            mpp_frame_get_pts(frame), p->get_count);
+                    ret = MPP_NOK;
+                }
+                p->get_count++;
+            }
+
+            p->eos = mpp_frame_get_eos(frame);
+            mpp_frame_deinit(&frame);
+        }
+
+        if (ret)
+            break;
+    }
+
+    return ret;
+}
+
+static MPP_RET run_ring(RK_U32 worker_pool)
+{
+    MPP_RET ret = MPP_NOK;
+    RingTestCtx p;
+    MppDecPipeCfg cfg;
+    RK_S64 timeout = 1000;
+    RK_S64 time_start;
+
+    memset(&p, 0, sizeof(p));
+    memset(&cfg, 0, sizeof(cfg));
+
+    ret = mpp_create(&p.ctx, &p.mpi);
+    if (ret) {
+        mpp_err("mpp_create failed ret %d\n", ret);
+        goto RET;
+    }
+
+    p.mpi->control(p.ctx, MPP_SET_WORKER_POOL, &worker_pool);
+
+    ret = mpp_init_dummy(p.ctx, MPP_CTX_DEC);
+    if (ret) {
+        mpp_err("mpp_init_dummy failed ret %d\n", ret);
+        goto RET;
+    }
+
+    p.mpi->control(p.ctx, MPP_SET_OUTPUT_TIMEOUT, &timeout);
+
+    /* parser never pauses on display queue and the frame ring gets full */
+    cfg.frame_queue = RING_TEST_FRAME_QUEUE;
+    ret = p.mpi->control(p.ctx, MPP_DEC_SET_PIPE_CFG, &cfg);
+    if (ret) {
+        mpp_err("failed to set pipe cfg ret %d\n", ret);
+        goto RET;
+    }
+    p.ring_depth = cfg.frame_queue;
+
+    /* get frames until info change is done and output fills the ring */
+    while (1) {
+        ring_test_fill(&p, RING_TEST_FRAME_COUNT);
+        if (ring_test_is_full(&p))
+            break;
+
+        ret = ring_test_drain(&p, p.put_count);
+        if (ret || p.eos) {
+            mpp_err("frame ring is not full before eos\n");
+            ret = MPP_NOK;
+            goto RET;
+        }
+    }
+
+    time_start = mpp_time();
+    p.mpi->reset(p.ctx);
+    mpp_log("worker pool %d reset on full frame ring in %lld us\n", worker_pool,
+            mpp_time() - time_start);
+
+    /* stall on full frame ring then get all frames */
+    p.put_count = 0;
+    p.get_count = 0;
+    while (!p.eos) {
+        ring_test_fill(&p, RING_TEST_FRAME_COUNT);
+        if (p.put_count < RING_TEST_FRAME_COUNT && !ring_test_is_full(&p)) {
+            mpp_err("input stalled without full frame ring\n");
+            ret = MPP_NOK;
+            goto RET;
+        }
+
+        ret = ring_test_drain(&p, p.put_count);
+        if (ret)
+            goto RET;
+    }
+
+    if (p.get_count != RING_TEST_FRAME_COUNT) {
+        mpp_err("worker pool %d get %d frames expect %d\n", worker_pool,
+                p.get_count, RING_TEST_FRAME_COUNT);
+        ret = MPP_NOK;
+    }
+
+RET:
+    if (p.ctx) {
+        p.mpi->reset(p.ctx);
+        mpp_destroy(p.ctx);
+    }
+
+    return ret;
+}
+
+int main()
+{
+    MPP_RET ret;
+
+    mpp_log("mpi_dec_frame_ring_test start\n");
+
+    ret = run_ring(0);
+    if (!ret)
+        ret = run_ring(1);
+
+    mpp_log("mpi_dec_frame_ring_test %s\n", ret ? "failed" : "success");
+
+    return ret;
+}
@@ -51,6 +51,8 @@ typedef struct {
     RK_U32          simple;
     RK_S32          timeout;
     RK_S32          nthreads;
+    /* 0 - thread per context 1 - shared worker pool */
+    RK_U32          worker_pool;
 } MpiDecTestCmd;
 
 /* For each instance thread setup */
@@ -103,6 +105,7 @@ static OptionInfo mpi_dec_cmd[] = {
     {"t",               "type",                 "input stream coding type"},
     {"x",               "timeout",              "output timeout interval"},
     {"n",               "instance_nb",          "number of instances"},
+    {"p",               "worker_pool",          "0 - thread per context 1 - shared worker pool"},
 };
 
 static int decode_simple(MpiDecCtx *data)
@@ -504,6 +507,15 @@ void* mpi_dec_test_decode(void *cmd_ctx)
         goto MPP_TEST_OUT;
     }
 
+    // NOTE: worker pool mode need to be set before init
+    if (cmd->worker_pool) {
+        ret = mpi->control(ctx, MPP_SET_WORKER_POOL, &cmd->worker_pool);
+        if (MPP_OK != ret) {
+            mpp_err("Failed to set worker pool mode ret %d\n", ret);
+            goto MPP_TEST_OUT;
+        }
+    }
+
     // NOTE: timeout value please refer to MppPollType definition
     //  0   - non-block call (default)
     // -1   - block call
@@ -718,6 +730,14 @@ static RK_S32 mpi_dec_multi_test_parse_options(int argc, char **argv, MpiDecTest
                     goto PARSE_OPINIONS_OUT;
                 }
                 break;
+            case 'p':
+                if (next) {
+                    cmd->worker_pool = atoi(next);
+                } else {
+                    mpp_err("invalid worker pool mode\n");
+                    goto PARSE_OPINIONS_OUT;
+                }
+                break;
             default:
                 mpp_err("skip invalid opt %c\n", *opt);
                 break;
@@ -741,6 +761,7 @@ static void mpi_dec_test_show_options(MpiDecTestCmd* cmd)
     mpp_log("width      : %4d\n", cmd->width);
     mpp_log("height     : %4d\n", cmd->height);
     mpp_log("type       : %d\n", cmd->type);
+    mpp_log("worker mode: %s\n", cmd->worker_pool ? "shared pool" : "thread per context");
 }
 
 int main(int argc, char **argv)
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if defined(_WIN32)
+#include "vld.h"
+#endif
+
+#define MODULE_TAG "mpi_dec_pipe_test"
+
+#include <string.h>
+#include "rk_mpi.h"
+#include "mpp_log.h"
+#include "mpp_env.h"
+#include "mpp_time.h"
+#include "mpp_impl.h"
+#include "mpp_common.h"
+
+#define PIPE_TEST_FRAME_COUNT       40
+#define PIPE_TEST_ERR_PERIOD        5
+#define PIPE_TEST_HW_TIME           2000
+#define PIPE_TEST_PARSE_TIME        1000
+#define PIPE_TEST_STREAM_SIZE       (SZ_1K)
+
+/*
+ * dummy decoder with simulated parse and hardware time. The dummy hal reports
+ * hardware error on the frame with pts in (period - 1, 2 * period - 1, ...).
+ * The error must be on that frame and no frame before it has error. The
+ * errinfo of each frame is recorded to check that it does not depend on
+ * whether the next frame is parsed while the frame is on hardware.
+ */
+static MPP_RET check_frame(MppFrame frame, RK_U32 pipeline, RK_U32 *errs)
+{
+    RK_S64 pts = mpp_frame_get_pts(frame);
+    RK_U32 errinfo = mpp_frame_get_errinfo(frame);
+    RK_U32 hw_err = (pts % PIPE_TEST_ERR_PERIOD) == PIPE_TEST_ERR_PERIOD - 1;
+
+    if (pts < 0 || pts >= PIPE_TEST_FRAME_COUNT) {
+        mpp_err("pipeline %d invalid frame pts %lld\n", pipeline, pts);
+        return MPP_NOK;
+    }
+
+    if ((hw_err && !errinfo) || (pts < PIPE_TEST_ERR_PERIOD - 1 && errinfo)) {
+        mpp_err("pipeline %d frame pts %lld errinfo %d expect %d\n",
+                pipeline, pts, errinfo, hw_err);
+        return MPP_NOK;
+    }
+
+    errs[pts] = errinfo ? 1 : 0;
+
+    return MPP_OK;
+}
+
+static MPP_RET run_pipe(RK_U32 pipeline, RK_U32 *errs)
+{
+    MPP_RET ret = MPP_NOK;
+    MppCtx ctx = NULL;
+    MppApi *mpi = NULL;
+    MppPacket packet = NULL;
+    RK_S64 timeout = 1000;
+    char buf[PIPE_TEST_STREAM_SIZE];
+    RK_S32 put_count = 0;
+    RK_S32 get_count = 0;
+    RK_S32 err_count = 0;
+    RK_S64 time_start;
+    RK_U32 eos = 0;
+
+    memset(buf, 0, sizeof(buf));
+
+    ret = mpp_create(&ctx, &mpi);
+    if (ret) {
+        mpp_err("mpp_create failed ret %d\n", ret);
+        return ret;
+    }
+
+    mpi->control(ctx, MPP_DEC_SET_PARSER_PIPELINE_MODE, &pipeline);
+
+    ret = mpp_init_dummy(ctx, MPP_CTX_DEC);
+    if (ret) {
+        mpp_err("mpp_init_dummy failed ret %d\n", ret);
+        goto RET;
+    }
+
+    mpi->control(ctx, MPP_SET_OUTPUT_TIMEOUT, &timeout);
+
+    time_start = mpp_time();
+
+    while (!eos) {
+        MppFrame frame = NULL;
+
+        if (put_count < PIPE_TEST_FRAME_COUNT) {
+            mpp_packet_init(&packet, buf, sizeof(buf));
+            mpp_packet_set_pts(packet, put_count);
+            if (put_count == PIPE_TEST_FRAME_COUNT - 1)
+                mpp_packet_set_eos(packet);
+
+            if (MPP_OK == mpi->decode_put_packet(ctx, packet))
+                put_count++;
+
+            mpp_packet_deinit(&packet);
+        }
+
+        ret = mpi->decode_get_frame(ctx, &frame);
+        if (ret || NULL == frame) {
+            mpp_err("pipeline %d get frame failed ret %d at %d\n",
+                    pipeline, ret, get_count);
+            ret = MPP_NOK;
+            goto RET;
+        }
+
+        if (mpp_frame_get_info_change(frame)) {
+            mpi->control(ctx, MPP_DEC_SET_INFO_CHANGE_READY, NULL);
+        } else if (mpp_frame_get_buffer(frame)) {
+            ret = check_frame(frame, pipeline, errs);
+            err_count += mpp_frame_get_errinfo(frame) ? 1 : 0;
+            get_count++;
+        }
+
+        eos = mpp_frame_get_eos(frame);
+        mpp_frame_deinit(&frame);
+
+        if (ret)
+            goto RET;
+    }
+
+    if (get_count != PIPE_TEST_FRAME_COUNT) {
+        mpp_err("pipeline %d get %d frames expect %d\n", pipeline,
+                get_count, PIPE_TEST_FRAME_COUNT);
+        ret = MPP_NOK;
+        goto RET;
+    }
+
+    mpp_log("pipeline %d %d frames %d error %.2f ms per frame\n",
+            pipeline, get_count, err_count,
+            (float)(mpp_time() - time_start) / 1000 / get_count);
+
+RET:
+    mpi->reset(ctx);
+    mpp_destroy(ctx);
+    return ret;
+}
+
+int main()
+{
+    RK_U32 errs[2][PIPE_TEST_FRAME_COUNT];
+    MPP_RET ret;
+    RK_S32 i;
+
+    mpp_log("mpi_dec_pipe_test start\n");
+
+    mpp_env_set_u32("hal_dummy_dec_hw_time", PIPE_TEST_HW_TIME);
+    mpp_env_set_u32("dummy_dec_parse_time", PIPE_TEST_PARSE_TIME);
+    mpp_env_set_u32("hal_dummy_dec_err_period", PIPE_TEST_ERR_PERIOD);
+
+    memset(errs, 0, sizeof(errs));
+
+    ret = run_pipe(0, errs[0]);
+    if (!ret)
+        ret = run_pipe(1, errs[1]);
+
+    /* pipeline mode must not change the error of any frame */
+    for (i = 0; !ret && i < PIPE_TEST_FRAME_COUNT; i++) {
+        if (errs[0][i] != errs[1][i]) {
+            mpp_err("frame pts %d errinfo %d on pipeline 0 but %d on pipeline 1\n",
+                    i, errs[0][i], errs[1][i]);
+            ret = MPP_NOK;
+        }
+    }
+
+    if (ret)
+        mpp_log("mpi_dec_pipe_test failed\n");
+    else
+        mpp_log("mpi_dec_pipe_test success\n");
+
+    return ret;
+}
@@ -27,12 +27,14 @@
 #include "mpp_mem.h"
 #include "mpp_env.h"
 #include "mpp_time.h"
+#include "mpp_impl.h"
 #include "mpp_common.h"
 
 #include "utils.h"
 
 #define MPI_DEC_LOOP_COUNT          4
 #define MPI_DEC_STREAM_SIZE         (SZ_4K)
+#define MPI_DEC_BATCH_MAX           16
 #define MAX_FILE_NAME_LENGTH        256
 
 typedef struct {
@@ -58,6 +60,19 @@ typedef struct {
     RK_S32          frame_count;
     RK_S32          frame_num;
     size_t          max_usage;
+
+    /*
+     * batch mode packet slots and frame cache
+     * pkts[0, pkt_cnt) are pending and the rest are free for reading stream
+     */
+    RK_S32          batch;
+    MppPacket       pkts[MPI_DEC_BATCH_MAX];
+    char            *pkt_bufs[MPI_DEC_BATCH_MAX];
+    RK_S32          pkt_cnt;
+    RK_S32          pkt_queued;
+    MppFrame        frms[MPI_DEC_BATCH_MAX];
+    RK_S32          frm_cnt;
+    RK_S32          frm_idx;
 } MpiDecLoopData;
 
 typedef struct {
@@ -78,6 +93,8 @@ typedef struct {
     RK_S32          timeout;
     RK_S32          frame_num;
     size_t          pkt_size;
+    MppDecPipePreset pipe_preset;
+    RK_S32          batch;
 
     // report information
     size_t          max_usage;
@@ -89,13 +106,123 @@ static OptionInfo mpi_dec_cmd[] = {
     {"c",               "ops_file",             "input operation config file"},
     {"w",               "width",                "the width of input bitstream"},
     {"h",               "height",               "the height of input bitstream"},
-    {"t",               "type",                 "input stream coding type"},
+    {"t",               "type",                 "input stream coding type, 0 - dummy decoder without hardware"},
     {"f",               "format",               "output frame format type"},
     {"d",               "debug",                "debug flag"},
     {"x",               "timeout",              "output timeout interval"},
     {"n",               "frame_number",         "max output frame number"},
+    {"p",               "pipe_preset",          "pipeline preset 0 - default 1 - low latency 2 - throughput"},
+    {"b",               "batch",                "packet / frame count per batch mpi call"},
 };
 
+static MPP_RET dec_init_packets(MpiDecLoopData *data)
+{
+    RK_S32 i;
+
+    if (data->batch <= 1)
+        return MPP_OK;
+
+    for (i = 0; i < data->batch; i++) {
+        data->pkt_bufs[i] = mpp_malloc(char, data->packet_size);
+        if (NULL == data->pkt_bufs[i])
+            return MPP_ERR_MALLOC;
+
+        if (mpp_packet_init(&data->pkts[i], data->pkt_bufs[i], data->packet_size))
+            return MPP_NOK;
+    }
+
+    return MPP_OK;
+}
+
+static void dec_deinit_packets(MpiDecLoopData *data)
+{
+    RK_S32 i;
+
+    for (i = 0; i < MPI_DEC_BATCH_MAX; i++) {
+        if (data->pkts[i])
+            mpp_packet_deinit(&data->pkts[i]);
+        MPP_FREE(data->pkt_bufs[i]);
+    }
+    data->pkt_cnt = 0;
+}
+
+static void dec_flush_packets(MpiDecLoopData *data)
+{
+    MppPacket sent[MPI_DEC_BATCH_MAX];
+    char *bufs[MPI_DEC_BATCH_MAX];
+    RK_S32 done = 0;
+    RK_S32 i;
+
+    if (!data->pkt_cnt)
+        return;
+
+    data->mpi->decode_put_packets(data->ctx, data->pkts, data->pkt_cnt, &done);
+    if (!done)
+        return;
+
+    /* move sent slots behind the pending ones for reuse */
+    for (i = 0; i < done; i++) {
+        sent[i] = data->pkts[i];
+        bufs[i] = data->pkt_bufs[i];
+    }
+
+    for (i = done; i < data->batch; i++) {
+        data->pkts[i - done] = data->pkts[i];
+        data->pkt_bufs[i - done] = data->pkt_bufs[i];
+    }
+
+    for (i = 0; i < done; i++) {
+        data->pkts[data->batch - done + i] = sent[i];
+        data->pkt_bufs[data->batch - done + i] = bufs[i];
+    }
+
+    data->pkt_cnt -= done;
+}
+
+/*
+ * In batch mode stream is read into the first free packet slot which is
+ * queued here and sent to decoder when all slots are pending or on eos.
+ * Decoder copies the packet data so the slot is reused after sending.
+ */
+static MPP_RET dec_put_packet(MpiDecLoopData *data, MppPacket packet)
+{
+    if (data->batch <= 1)
+        return data->mpi->decode_put_packet(data->ctx, packet);
+
+    if (!data->pkt_queued) {
+        data->pkt_cnt++;
+        data->pkt_queued = 1;
+    }
+
+    if (data->pkt_cnt >= data->batch || mpp_packet_get_eos(packet))
+        dec_flush_packets(data);
+
+    /* keep the packet undone until there is a free slot for next read */
+    if (data->pkt_cnt >= data->batch)
+        return MPP_ERR_BUFFER_FULL;
+
+    data->pkt_queued = 0;
+    return MPP_OK;
+}
+
+static MPP_RET dec_get_frame(MpiDecLoopData *data, MppFrame *frame)
+{
+    MPP_RET ret = MPP_OK;
+
+    if (data->batch <= 1)
+        return data->mpi->decode_get_frame(data->ctx, frame);
+
+    if (data->frm_idx >= data->frm_cnt) {
+        data->frm_idx = 0;
+        data->frm_cnt = 0;
+        ret = data->mpi->decode_get_frames(data->ctx, data->frms, data->batch,
+                                           &data->frm_cnt);
+    }
+
+    *frame = (data->frm_idx < data->frm_cnt) ? data->frms[data->frm_idx++] : NULL;
+    return ret;
+}
+
 static int decode_simple(MpiDecLoopData *data)
 {
     RK_U32 pkt_done = 0;
@@ -109,6 +236,12 @@ static int decode_simple(MpiDecLoopData *data)
     size_t read_size = 0;
     size_t packet_size = data->packet_size;
 
+    // batch mode reads stream into the first free packet slot
+    if (data->batch > 1) {
+        packet = data->pkts[data->pkt_cnt];
+        buf = data->pkt_bufs[data->pkt_cnt];
+    }
+
     do {
         if (data->fp_config) {
             char line[MAX_FILE_NAME_LENGTH];
@@ -176,7 +309,7 @@ static int decode_simple(MpiDecLoopData *data)
         RK_S32 times = 5;
         // send the packet first if packet is not done
         if (!pkt_done) {
-            ret = mpi->decode_put_packet(ctx, packet);
+            ret = dec_put_packet(data, packet);
             if (MPP_OK == ret)
                 pkt_done = 1;
         }
@@ -187,7 +320,7 @@ static int decode_simple(MpiDecLoopData *data)
             RK_U32 frm_eos = 0;
 
         try_again:
-            ret = mpi->decode_get_frame(ctx, &frame);
+            ret = dec_get_frame(data, &frame);
             if (MPP_ERR_TIMEOUT == ret) {
                 if (times > 0) {
                     times--;
@@ -357,6 +490,7 @@ static int decode_simple(MpiDecLoopData *data)
 
             // if last packet is send but last frame is not found continue
             if (pkt_eos && pkt_done && !frm_eos) {
+                dec_flush_packets(data);
                 msleep(10);
                 continue;
             }
@@ -517,6 +651,10 @@ int mpi_dec_test_decode(MpiDecTestCmd *cmd)
     MppBuffer pkt_buf   = NULL;
     MppBuffer frm_buf   = NULL;
 
+    // decoding time for pipeline preset measurement
+    RK_S64 time_start   = 0;
+    RK_S64 time_end     = 0;
+
     MpiDecLoopData data;
 
     mpp_log("mpi_dec_test start\n");
@@ -649,12 +787,32 @@ int mpi_dec_test_decode(MpiDecTestCmd *cmd)
         }
     }
 
-    ret = mpp_init(ctx, MPP_CTX_DEC, type);
+    // NOTE: pipeline task queue and buffer depth need to be set before init
+    if (cmd->pipe_preset != MPP_DEC_PIPE_DEFAULT) {
+        ret = mpi->control(ctx, MPP_DEC_SET_PIPE_PRESET, &cmd->pipe_preset);
+        if (MPP_OK != ret) {
+            mpp_err("%p failed to set pipeline preset %d ret %d\n",
+                    ctx, cmd->pipe_preset, ret);
+            goto MPP_TEST_OUT;
+        }
+    }
+
+    if (type == MPP_VIDEO_CodingUnused)
+        ret = mpp_init_dummy(ctx, MPP_CTX_DEC);
+    else
+        ret = mpp_init(ctx, MPP_CTX_DEC, type);
     if (MPP_OK != ret) {
         mpp_err("%p mpp_init failed\n", ctx);
         goto MPP_TEST_OUT;
     }
 
+    // latency per stage is reported on the end of decoding
+    {
+        RK_U32 perf_en = 1;
+
+        mpi->control(ctx, MPP_DEC_SET_PERF_STATS, &perf_en);
+    }
+
     data.ctx            = ctx;
     data.mpi            = mpi;
     data.eos            = 0;
@@ -664,6 +822,14 @@ int mpi_dec_test_decode(MpiDecTestCmd *cmd)
     data.frame          = frame;
     data.frame_count    = 0;
     data.frame_num      = cmd->frame_num;
+    data.batch          = cmd->batch;
+
+    if (cmd->simple && dec_init_packets(&data)) {
+        mpp_err("%p failed to init batch packets\n", ctx);
+        goto MPP_TEST_OUT;
+    }
+
+    time_start = mpp_time();
 
     if (cmd->simple) {
         while (!data.eos) {
@@ -679,7 +845,40 @@ int mpi_dec_test_decode(MpiDecTestCmd *cmd)
         }
     }
 
+    time_end = mpp_time();
     cmd->max_usage = data.max_usage;
+    {
+        MppDecPipeCfg pipe;
+        float elapsed = (float)(time_end - time_start) / 1000;
+
+        memset(&pipe, 0, sizeof(pipe));
+        mpi->control(ctx, MPP_DEC_GET_PIPE_CFG, &pipe);
+        mpp_log("%p pipeline packet %d frame %d task %d buffer %d\n", ctx,
+                pipe.packet_queue, pipe.frame_queue, pipe.task_queue,
+                pipe.packet_bufs);
+        mpp_log("%p decode %d frames in %.2f ms fps %.2f\n", ctx,
+                data.frame_count, elapsed,
+                (elapsed > 0) ? data.frame_count * 1000 / elapsed : 0);
+    }
+
+    {
+        MppPerfStats perf;
+        RK_S32 i;
+
+        memset(&perf, 0, sizeof(perf));
+        ret = mpi->control(ctx, MPP_DEC_GET_PERF_STATS, &perf);
+        for (i = 0; MPP_OK == ret && i < perf.stage_count; i++) {
+            MppPerfStage *stage = &perf.stages[i];
+
+            if (!stage->count)
+                continue;
+
+            mpp_log("%p stage %-16s count %-6lld p50 %-6lld p99 %-6lld max %-6lld us\n",
+                    ctx, stage->name, stage->count, stage->p50, stage->p99,
+                    stage->max);
+        }
+    }
+
     {
         MppDecQueryCfg query;
 
@@ -700,6 +899,30 @@ int mpi_dec_test_decode(MpiDecTestCmd *cmd)
                 query.dec_in_pkt_cnt, query.dec_out_frm_cnt, query.dec_hw_run_cnt);
     }
 
+    {
+        static const char *reason_str[MPP_DEC_WAIT_BUTT] = {
+            "pkt in", "task hnd", "pkt slot", "frm slot", "dis que full",
+            "buf unused", "info change", "prev task", "others",
+        };
+        MppDecWaitStats stats;
+        RK_S32 i;
+
+        memset(&stats, 0, sizeof(stats));
+        ret = mpi->control(ctx, MPP_DEC_GET_WAIT_STATS, &stats);
+        if (MPP_OK == ret) {
+            mpp_log("%p parser work %llu wait %llu\n", ctx,
+                    stats.work_count, stats.wait_count);
+
+            for (i = 0; i < MPP_DEC_WAIT_BUTT; i++) {
+                if (!stats.reasons[i].count)
+                    continue;
+
+                mpp_log("%p wait %-12s count %-8llu time %-10llu us\n", ctx,
+                        reason_str[i], stats.reasons[i].count, stats.reasons[i].time);
+            }
+        }
+    }
+
     ret = mpi->reset(ctx);
     if (MPP_OK != ret) {
         mpp_err("%p mpi->reset failed\n", ctx);
@@ -707,6 +930,12 @@ int mpi_dec_test_decode(MpiDecTestCmd *cmd)
     }
 
 MPP_TEST_OUT:
+    // release packets and frames left in batch mode
+    dec_deinit_packets(&data);
+
+    while (data.frm_idx < data.frm_cnt)
+        mpp_frame_deinit(&data.frms[data.frm_idx++]);
+
     if (packet) {
         mpp_packet_deinit(&packet);
         packet = NULL;
@@ -862,7 +1091,9 @@ static RK_S32 mpi_dec_test_parse_options(int argc, char **argv, MpiDecTestCmd* c
             case 't':
                 if (next) {
                     cmd->type = (MppCodingType)atoi(next);
-                    err = mpp_check_support_format(MPP_CTX_DEC, cmd->type);
+                    /* dummy decoder measures the pipeline without hardware */
+                    err = (cmd->type == MPP_VIDEO_CodingUnused) ? MPP_OK :
+                          mpp_check_support_format(MPP_CTX_DEC, cmd->type);
                 }
 
                 if (!next || err) {
@@ -900,6 +1131,26 @@ static RK_S32 mpi_dec_test_parse_options(int argc, char **argv, MpiDecTestCmd* c
                     goto PARSE_OPINIONS_OUT;
                 }
                 break;
+            case 'p':
+                if (next) {
+                    cmd->pipe_preset = (MppDecPipePreset)atoi(next);
+                }
+
+                if (!next || cmd->pipe_preset >= MPP_DEC_PIPE_BUTT) {
+                    mpp_err("invalid pipeline preset\n");
+                    goto PARSE_OPINIONS_OUT;
+                }
+                break;
+            case 'b':
+                if (next) {
+                    cmd->batch = atoi(next);
+                }
+
+                if (!next || cmd->batch < 0 || cmd->batch > MPI_DEC_BATCH_MAX) {
+                    mpp_err("invalid batch count\n");
+                    goto PARSE_OPINIONS_OUT;
+                }
+                break;
             default:
                 mpp_err("skip invalid opt %c\n", *opt);
                 break;
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2015 Rockchip Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if defined(_WIN32)
+#include "vld.h"
+#endif
+
+#define MODULE_TAG "mpi_dec_zero_copy_test"
+
+#include <string.h>
+#include "rk_mpi.h"
+#include "mpp_log.h"
+#include "mpp_mem.h"
+#include "mpp_impl.h"
+#include "mpp_common.h"
+
+#define ZC_TEST_FRAME_COUNT         20
+#define ZC_TEST_BUF_SIZE            (SZ_4K)
+/* copy packet larger than the application buffer */
+#define ZC_TEST_COPY_SIZE           (SZ_64K)
+
+/*
+ * zero copy packets from application MppBuffer and copy packets from plain
+ * memory are sent in turn so that they take the same packet slot. Stream of
+ * copy packet must never be copied into the application buffer left on the
+ * slot by the previous zero copy packet.
+ */
+static RK_U8 zc_pattern(RK_S32 idx)
+{
+    return (RK_U8)(0x10 + idx);
+}
+
+static MPP_RET check_buffer(MppBuffer buf, RK_S32 idx)
+{
+    RK_U8 *p = (RK_U8 *)mpp_buffer_get_ptr(buf);
+    RK_S32 i;
+
+    for (i = 0; i < ZC_TEST_BUF_SIZE; i++) {
+        if (p[i] != zc_pattern(idx)) {
+            mpp_err("packet %d buffer overwritten at %d value %02x\n",
+                    idx, i, p[i]);
+            return MPP_NOK;
+        }
+    }
+
+    return MPP_OK;
+}
+
+int main()
+{
+    MPP_RET ret = MPP_NOK;
+    MppCtx ctx = NULL;
+    MppApi *mpi = NULL;
+    MppBufferGroup group = NULL;
+    MppBuffer bufs[ZC_TEST_FRAME_COUNT];
+    MppDecQueryCfg query;
+    RK_U8 *copy_data = NULL;
+    RK_S64 timeout = 1000;
+    RK_U32 zero_copy = 1;
+    RK_U64 copy_size = 0;
+    RK_U64 ref_size = 0;
+    RK_S32 put_count = 0;
+    RK_S32 get_count = 0;
+    RK_U32 eos = 0;
+    RK_S32 i;
+
+    mpp_log("mpi_dec_zero_copy_test start\n");
+
+    memset(bufs, 0, sizeof(bufs));
+
+    copy_data = mpp_malloc(RK_U8, ZC_TEST_COPY_SIZE);
+    if (NULL == copy_data)
+        goto RET;
+
+    ret = mpp_buffer_group_get_internal(&group, MPP_BUFFER_TYPE_ION);
+    if (ret) {
+        mpp_err("failed to get buffer group ret %d\n", ret);
+        goto RET;
+    }
+
+    for (i = 0; i < ZC_TEST_FRAME_COUNT; i += 2) {
+        ret = mpp_buffer_get(group, &bufs[i], ZC_TEST_BUF_SIZE);
+        if (ret) {
+            mpp_err("failed to get buffer ret %d\n", ret);
+            goto RET;
+        }
+        memset(mpp_buffer_get_ptr(bufs[i]), zc_pattern(i), ZC_TEST_BUF_SIZE);
+    }
+
+    ret = mpp_create(&ctx, &mpi);
+    if (ret) {
+        mpp_err("mpp_create failed ret %d\n", ret);
+        goto RET;
+    }
+
+    ret = mpp_init_dummy(ctx, MPP_CTX_DEC);
+    if (ret) {
+        mpp_err("mpp_init_dummy failed ret %d\n", ret);
+        goto RET;
+    }
+
+    ret = mpi->control(ctx, MPP_DEC_SET_ZERO_COPY_INPUT, &zero_copy);
+    if (ret) {
+        mpp_err("failed to set zero copy input ret %d\n", ret);
+        goto RET;
+    }
+
+    mpi->control(ctx, MPP_SET_OUTPUT_TIMEOUT, &timeout);
+
+    while (!eos) {
+        MppFrame frame = NULL;
+
+        if (put_count < ZC_TEST_FRAME_COUNT) {
+            MppPacket packet = NULL;
+
+            if (bufs[put_count]) {
+                mpp_packet_init_with_buffer(&packet, bufs[put_count]);
+                mpp_packet_set_length(packet, ZC_TEST_BUF_SIZE);
+            } else {
+                memset(copy_data, zc_pattern(put_count), ZC_TEST_COPY_SIZE);
+                mpp_packet_init(&packet, copy_data, ZC_TEST_COPY_SIZE);
+            }
+            mpp_packet_set_pts(packet, put_count);
+            if (put_count == ZC_TEST_FRAME_COUNT - 1)
+                mpp_packet_set_eos(packet);
+
+            if (MPP_OK == mpi->decode_put_packet(ctx, packet)) {
+                if (bufs[put_count])
+                    ref_size += ZC_TEST_BUF_SIZE;
+                else
+                    copy_size += ZC_TEST_COPY_SIZE;
+                put_count++;
+            }
+
+            mpp_packet_deinit(&packet);
+        }
+
+        ret = mpi->decode_get_frame(ctx, &frame);
+        if (ret || NULL == frame) {
+            mpp_err("get frame failed ret %d at %d\n", ret, get_count);
+            ret = MPP_NOK;
+            goto RET;
+        }
+
+        if (mpp_frame_get_info_change(frame))
+            mpi->control(ctx, MPP_DEC_SET_INFO_CHANGE_READY, NULL);
+        else if (mpp_frame_get_buffer(frame))
+            get_count++;
+
+        eos = mpp_frame_get_eos(frame);
+        mpp_frame_deinit(&frame);
+    }
+
+    if (get_count != ZC_TEST_FRAME_COUNT) {
+        mpp_err("get %d frames expect %d\n", get_count, ZC_TEST_FRAME_COUNT);
+        ret = MPP_NOK;
+        goto RET;
+    }
+
+    for (i = 0; i < ZC_TEST_FRAME_COUNT; i += 2) {
+        ret = check_buffer(bufs[i], i);
+        if (ret)
+            goto RET;
+    }
+
+    memset(&query, 0, sizeof(query));
+    query.query_flag = MPP_DEC_QUERY_STRM_COPY;
+    mpi->control(ctx, MPP_DEC_QUERY, &query);
+
+    mpp_log("hal copy %lld ref %lld bytes\n", query.hal_copy_size,
+            query.hal_ref_size);
+
+    if (query.hal_copy_size != copy_size || query.hal_ref_size != ref_size) {
+        mpp_err("hal copy %lld ref %lld expect copy %lld ref %lld\n",
+                query.hal_copy_size, query.hal_ref_size, copy_size, ref_size);
+        ret = MPP_NOK;
+    }
+
+RET:
+    if (ctx) {
+        mpi->reset(ctx);
+        mpp_destroy(ctx);
+    }
+
+    for (i = 0; i < ZC_TEST_FRAME_COUNT; i++) {
+        if (bufs[i])
+            mpp_buffer_put(bufs[i]);
+    }
+
+    if (group)
+        mpp_buffer_group_put(group);
+
+    MPP_FREE(copy_data);
+
+    mpp_log("mpi_dec_zero_copy_test %s\n", ret ? "failed" : "success");
+
+    return ret;
+}
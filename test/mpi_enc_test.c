@@ -33,6 +33,9 @@
 #include "mpi_enc_utils.h"
 #include "camera_source.h"
 
+/* same as the max encoder pipe depth */
+#define MPI_ENC_BATCH_MAX   8
+
 typedef struct {
     // global flow control flag
     RK_U32 frm_eos;
@@ -105,6 +108,11 @@ typedef struct {
     RK_S32 gop_mode;
     RK_S32 gop_len;
     RK_S32 vi_len;
+
+    // batch mode buffer slots, one frame in flight on each slot
+    RK_S32 batch;
+    MppBuffer frm_bufs[MPI_ENC_BATCH_MAX];
+    MppBuffer pkt_bufs[MPI_ENC_BATCH_MAX];
 } MpiEncTestData;
 
 MPP_RET test_ctx_init(MpiEncTestData **data, MpiEncTestArgs *cmd)
@@ -145,6 +153,14 @@ MPP_RET test_ctx_init(MpiEncTestData **data, MpiEncTestArgs *cmd)
     p->gop_mode     = cmd->gop_mode;
     p->gop_len      = cmd->gop_len;
     p->vi_len       = cmd->vi_len;
+    p->batch        = cmd->batch;
+
+    if (p->batch < 0 || p->batch > MPI_ENC_BATCH_MAX) {
+        mpp_err("invalid batch count %d range [0:%d]\n", p->batch,
+                MPI_ENC_BATCH_MAX);
+        ret = MPP_ERR_VALUE;
+        goto RET;
+    }
 
     p->fps_in_flex  = cmd->fps_in_flex;
     p->fps_in_den   = cmd->fps_in_den;
@@ -441,6 +457,138 @@ RET:
     return ret;
 }
 
+/*
+ * batch mode sends a batch of frames with one encode_put_frames call then
+ * collects their packets by encode_get_packets. Each frame in the batch has
+ * its own frame and packet buffer as the encoder holds them until the packet
+ * is returned.
+ */
+static MPP_RET test_mpp_run_batch(MpiEncTestData *p)
+{
+    MPP_RET ret = MPP_OK;
+    MppApi *mpi = p->mpi;
+    MppCtx ctx = p->ctx;
+    MppFrame frames[MPI_ENC_BATCH_MAX];
+    MppPacket packets[MPI_ENC_BATCH_MAX];
+    RK_S64 time_start = mpp_time();
+    RK_S64 time_used;
+    RK_S32 i;
+
+    while (!p->pkt_eos) {
+        RK_S32 count = 0;
+        RK_S32 sent = 0;
+        RK_S32 got = 0;
+
+        /* read a batch of frames into the slots */
+        while (count < p->batch && !p->frm_eos) {
+            MppFrame frame = NULL;
+            MppPacket packet = NULL;
+            void *buf = mpp_buffer_get_ptr(p->frm_bufs[count]);
+            RK_S32 frm_idx = p->frame_count + count;
+
+            if (p->num_frames > 0 && frm_idx >= p->num_frames)
+                break;
+
+            if (p->fp_input) {
+                ret = read_image(buf, p->fp_input, p->width, p->height,
+                                 p->hor_stride, p->ver_stride, p->fmt);
+                if (ret == MPP_NOK || feof(p->fp_input)) {
+                    if (p->num_frames < 0 || frm_idx < p->num_frames) {
+                        clearerr(p->fp_input);
+                        rewind(p->fp_input);
+                        mpp_log("%p loop times %d\n", ctx, ++p->loop_times);
+                        continue;
+                    }
+                    p->frm_eos = 1;
+                    mpp_log("%p found last frame. feof %d\n", ctx, feof(p->fp_input));
+                } else if (ret == MPP_ERR_VALUE)
+                    goto RET;
+            } else {
+                ret = fill_image(buf, p->width, p->height, p->hor_stride,
+                                 p->ver_stride, p->fmt, frm_idx);
+                if (ret)
+                    goto RET;
+            }
+
+            ret = mpp_frame_init(&frame);
+            if (ret) {
+                mpp_err_f("mpp_frame_init failed\n");
+                goto RET;
+            }
+
+            mpp_frame_set_width(frame, p->width);
+            mpp_frame_set_height(frame, p->height);
+            mpp_frame_set_hor_stride(frame, p->hor_stride);
+            mpp_frame_set_ver_stride(frame, p->ver_stride);
+            mpp_frame_set_fmt(frame, p->fmt);
+            mpp_frame_set_eos(frame, p->frm_eos);
+            mpp_frame_set_buffer(frame, p->frm_eos ? NULL : p->frm_bufs[count]);
+
+            mpp_packet_init_with_buffer(&packet, p->pkt_bufs[count]);
+            /* NOTE: It is important to clear output packet length!! */
+            mpp_packet_set_length(packet, 0);
+            mpp_meta_set_packet(mpp_frame_get_meta(frame), KEY_OUTPUT_PACKET, packet);
+
+            frames[count++] = frame;
+        }
+
+        if (!count)
+            break;
+
+        ret = mpi->encode_put_frames(ctx, frames, count, &sent);
+        for (i = 0; i < count; i++)
+            mpp_frame_deinit(&frames[i]);
+
+        if (ret || sent != count) {
+            mpp_err("mpp encode put frames failed sent %d/%d\n", sent, count);
+            ret = (ret) ? ret : MPP_NOK;
+            goto RET;
+        }
+
+        /* get all packets of this batch before the slots are reused */
+        while (got < sent && !p->pkt_eos) {
+            RK_S32 done = 0;
+
+            ret = mpi->encode_get_packets(ctx, packets, sent - got, &done);
+            if (ret) {
+                mpp_err("mpp encode get packets failed\n");
+                goto RET;
+            }
+
+            for (i = 0; i < done; i++) {
+                void *ptr   = mpp_packet_get_pos(packets[i]);
+                size_t len  = mpp_packet_get_length(packets[i]);
+
+                p->pkt_eos = mpp_packet_get_eos(packets[i]);
+
+                if (p->fp_output)
+                    fwrite(ptr, 1, len, p->fp_output);
+
+                mpp_log("%p encoded frame %-4d size %-7d\n", ctx,
+                        p->frame_count, (RK_S32)len);
+
+                mpp_packet_deinit(&packets[i]);
+
+                p->stream_size += len;
+                p->frame_count++;
+            }
+            got += done;
+        }
+
+        if (p->num_frames > 0 && p->frame_count >= p->num_frames) {
+            mpp_log("%p encode max %d frames", ctx, p->frame_count);
+            break;
+        }
+    }
+
+    time_used = mpp_time() - time_start;
+    mpp_log("%p batch %d encode %d frames %.2f fps\n", ctx, p->batch,
+            p->frame_count, p->frame_count * 1000000.0 / MPP_MAX(time_used, 1));
+
+RET:
+    return ret;
+}
+
 MPP_RET test_mpp_run(MpiEncTestData *p)
 {
     MPP_RET ret = MPP_OK;
@@ -482,6 +630,10 @@ MPP_RET test_mpp_run(MpiEncTestData *p)
 
         mpp_packet_deinit(&packet);
     }
+
+    if (p->batch > 1)
+        return test_mpp_run_batch(p);
+
     while (!p->pkt_eos) {
         MppMeta meta = NULL;
         MppFrame frame = NULL;
@@ -750,6 +902,20 @@ int mpi_enc_test(MpiEncTestArgs *cmd)
         goto MPP_TEST_OUT;
     }
 
+    if (p->batch > 1) {
+        RK_S32 i;
+
+        for (i = 0; i < p->batch; i++) {
+            ret = mpp_buffer_get(p->buf_grp, &p->frm_bufs[i], p->frame_size + p->header_size);
+            if (!ret)
+                ret = mpp_buffer_get(p->buf_grp, &p->pkt_bufs[i], p->frame_size);
+            if (ret) {
+                mpp_err_f("failed to get buffer for batch %d ret %d\n", i, ret);
+                goto MPP_TEST_OUT;
+            }
+        }
+    }
+
     // encoder demo
     ret = mpp_create(&p->ctx, &p->mpi);
     if (ret) {
@@ -757,6 +923,15 @@ int mpi_enc_test(MpiEncTestArgs *cmd)
         goto MPP_TEST_OUT;
     }
 
+    // NOTE: pipe depth need to be set before init for batch frames in flight
+    if (p->batch > 1) {
+        ret = p->mpi->control(p->ctx, MPP_ENC_SET_PIPE_DEPTH, &p->batch);
+        if (ret) {
+            mpp_err("mpi control set pipe depth %d ret %d\n", p->batch, ret);
+            goto MPP_TEST_OUT;
+        }
+    }
+
     mpp_log("%p mpi_enc_test encoder test start w %d h %d type %d\n",
             p->ctx, p->width, p->height, p->type);
 
@@ -824,6 +999,22 @@ MPP_TEST_OUT:
         p->pkt_buf = NULL;
     }
 
+    {
+        RK_S32 i;
+
+        for (i = 0; i < MPI_ENC_BATCH_MAX; i++) {
+            if (p->frm_bufs[i]) {
+                mpp_buffer_put(p->frm_bufs[i]);
+                p->frm_bufs[i] = NULL;
+            }
+
+            if (p->pkt_bufs[i]) {
+                mpp_buffer_put(p->pkt_bufs[i]);
+                p->pkt_bufs[i] = NULL;
+            }
+        }
+    }
+
     if (p->osd_data.buf) {
         mpp_buffer_put(p->osd_data.buf);
         p->osd_data.buf = NULL;
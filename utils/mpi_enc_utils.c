@@ -300,6 +300,14 @@ MPP_RET mpi_enc_test_cmd_update_by_args(MpiEncTestArgs* cmd, int argc, char **ar
                     goto PARSE_OPINIONS_OUT;
                 }
             } break;
+            case 'k' : {
+                if (next) {
+                    cmd->batch = atoi(next);
+                } else {
+                    mpp_err("invalid batch count\n");
+                    goto PARSE_OPINIONS_OUT;
+                }
+            } break;
             case 'x': {
                 if (next) {
                     size_t len = strnlen(next, MAX_FILE_NAME_LENGTH);
@@ -717,6 +725,7 @@ static OptionInfo mpi_enc_cmd[] = {
     {"b",               "bps target:min:max",   "set tareget bps"},
     {"r",               "in/output fps",        "set input and output frame rate"},
     {"l",               "loop count",           "loop encoding times for each frame"},
+    {"k",               "batch",                "frame / packet count per batch mpi call"},
 };
 
 MPP_RET mpi_enc_test_cmd_show_opt(MpiEncTestArgs* cmd)
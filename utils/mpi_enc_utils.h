@@ -57,6 +57,9 @@ typedef struct MpiEncTestArgs_t {
     MppEncHeaderMode    header_mode;
 
     MppEncSliceSplit    split;
+
+    /* frame / packet count per batch mpi call and encoder pipe depth */
+    RK_S32              batch;
 } MpiEncTestArgs;
 
 #ifdef __cplusplus